@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Lossless 8-bit RGB codecs used next to the PNG/JPG support of stb.
+//  - QOI (https://qoiformat.org/qoi-specification.pdf): a single pass over the pixels with a 64-entry colour cache,
+//    small deltas and run lengths, which compresses flat-colour pixel art well at a fraction of the cost of deflate.
+//  - Raw: a 16-byte header ("PXRW", then width, height and channel count as little-endian uint32) followed by the
+//    uncompressed pixels, for intermediate files that are read back by this program only.
+// Malformed files are reported on std::cerr and raise an exception, like the rest of the framework.
+
+constexpr size_t QOI_HEADER_SIZE    = 14U;
+constexpr size_t QOI_PADDING_SIZE   = 8U;
+constexpr size_t RAW_HEADER_SIZE    = 16U;
+
+// Decoded 8-bit RGB pixels, row by row
+struct Rgb8Pixels {
+    int width = 0, height = 0;
+    std::vector<uint8_t> rgb;
+};
+
+std::vector<uint8_t> encodeQoi(const uint8_t* rgb, int width, int height);
+Rgb8Pixels decodeQoi(const uint8_t* bytes, size_t size);
+
+std::vector<uint8_t> encodeRaw(const uint8_t* rgb, int width, int height);
+Rgb8Pixels decodeRaw(const uint8_t* bytes, size_t size);
+
+std::vector<uint8_t> readFileBytes(const std::filesystem::path& filePath);
+void writeFileBytes(const std::filesystem::path& filePath, const std::vector<uint8_t>& bytes);
@@ -17,6 +17,7 @@ DISABLE_WARNINGS_PUSH()
 #include <stb/stb_image.h>
 #include <stb/stb_image_write.h>
 DISABLE_WARNINGS_POP()
+#include "codecs.h"
 
 enum OutOfBoundsStrategy { ZERO, NEAREST };
 
@@ -24,17 +25,22 @@ template <typename T>
 class Image {
 public:
     Image(const std::filesystem::path& filePath);
+    Image(const std::vector<uint8_t>& encoded, const std::filesystem::path& filePath); // Decodes a file read beforehand.
     Image(const int new_width, const int new_height);
     Image(const Image&) = default;
     Image() : Image(1, 1) {};
 
-    void writeToFile(const std::filesystem::path& filePath);
+    void writeToFile(const std::filesystem::path& filePath) const;
+    std::vector<uint8_t> encode(const std::filesystem::path& filePath) const; // The bytes writeToFile would write.
     size_t getImageOffset(int x, int y) const;
     T safeAccess(int x, int y, OutOfBoundsStrategy out_of_bounds_strategy = NEAREST) const;
 
 public:
     int width, height;
     std::vector<T> data;
+
+private:
+    void decode(const uint8_t* bytes, size_t size, const std::filesystem::path& filePath);
 };
 
 template<typename T> 
@@ -78,14 +84,39 @@ Image<T>::Image(const std::filesystem::path& filePath)
         std::cerr << "Image file " << filePath << " does not exists!" << std::endl;
         throw std::exception();
     }
+    const std::vector<uint8_t> bytes = readFileBytes(filePath);
+    decode(bytes.data(), bytes.size(), filePath);
+}
+
+template <typename T>
+Image<T>::Image(const std::vector<uint8_t>& encoded, const std::filesystem::path& filePath)
+{
+    decode(encoded.data(), encoded.size(), filePath);
+}
 
-    const auto filePathStr = filePath.string(); // Create l-value so c_str() is safe.
+template <typename T>
+void Image<T>::decode(const uint8_t* bytes, size_t size, const std::filesystem::path& filePath)
+{
     int channels;
 
-    if (stbi_is_hdr(filePathStr.c_str())) {
+    // Lossless codecs of the framework, chosen by extension; everything else is left to stb.
+    if (filePath.extension() == ".qoi" || filePath.extension() == ".raw") {
+        const Rgb8Pixels pixels = filePath.extension() == ".qoi" ? decodeQoi(bytes, size) : decodeRaw(bytes, size);
+        width = pixels.width;
+        height = pixels.height;
+        data.resize(width * height);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = stbToType<T>(pixels.rgb.data() + i * 3);
+        }
+    }
+    else if (stbi_is_hdr_from_memory(bytes, int(size))) {
         stbi_hdr_to_ldr_gamma(1.0f);
         stbi_hdr_to_ldr_scale(1.0f);
-        float* stb_data_float = stbi_loadf(filePathStr.c_str(), &width, &height, &channels, 0);
+        float* stb_data_float = stbi_loadf_from_memory(bytes, int(size), &width, &height, &channels, 0);
+        if (!stb_data_float) {
+            std::cerr << "Failed to read image " << filePath << " using stb_image.h" << std::endl;
+            throw std::exception();
+        }
 
         data.resize(width * height);
         for (size_t i = 0; i < data.size(); i++) {
@@ -95,7 +126,7 @@ Image<T>::Image(const std::filesystem::path& filePath)
         stbi_image_free(stb_data_float);
     }
     else {
-        stbi_uc* stb_data = stbi_load(filePathStr.c_str(), &width, &height, &channels, 0);
+        stbi_uc* stb_data = stbi_load_from_memory(bytes, int(size), &width, &height, &channels, 0);
         if (!stb_data) {
             std::cerr << "Failed to read image " << filePath << " using stb_image.h" << std::endl;
             throw std::exception();
@@ -108,8 +139,6 @@ Image<T>::Image(const std::filesystem::path& filePath)
 
         stbi_image_free(stb_data);
     }
-
-
 }
 
 template <typename T>
@@ -121,7 +150,18 @@ Image<T>::Image(const int new_width, const int new_height)
 }
 
 template <typename T>
-inline void Image<T>::writeToFile(const std::filesystem::path& filePath) {
+inline void Image<T>::writeToFile(const std::filesystem::path& filePath) const {
+    const std::vector<uint8_t> bytes = encode(filePath);
+
+    // Create a folder.
+    if (!std::filesystem::is_directory(filePath.parent_path())) {
+        std::filesystem::create_directories(filePath.parent_path());
+    }
+    writeFileBytes(filePath, bytes);
+};
+
+template <typename T>
+inline std::vector<uint8_t> Image<T>::encode(const std::filesystem::path& filePath) const {
 
     // RGB => 3
     const auto channels = 3;
@@ -135,18 +175,23 @@ inline void Image<T>::writeToFile(const std::filesystem::path& filePath) {
         typeToRgbUint8<T>(&std_data[i * channels], data[i]);
     }
 
-    // Create a folder.
-    if (!std::filesystem::is_directory(filePath.parent_path())) {
-        std::filesystem::create_directories(filePath.parent_path());
+    // Decide JPG (default), PNG, QOI or raw based on extension.
+    if (filePath.extension() == ".qoi") {
+        return encodeQoi(std_data.data(), width, height);
+    } else if (filePath.extension() == ".raw") {
+        return encodeRaw(std_data.data(), width, height);
     }
-
-    // Decide JPG (default) or PNG based on extension.
-    const auto filePathStr = filePath.string(); // Create l-value so c_str() is safe.
+    std::vector<uint8_t> bytes;
+    const auto append = [](void* context, void* chunk, int size) {
+        auto* encoded = static_cast<std::vector<uint8_t>*>(context);
+        encoded->insert(encoded->end(), static_cast<uint8_t*>(chunk), static_cast<uint8_t*>(chunk) + size);
+    };
     if (filePath.extension() == ".png") {
-        stbi_write_png(filePathStr.c_str(), width, height, channels, std_data.data(), width * channels);
+        stbi_write_png_to_func(append, &bytes, width, height, channels, std_data.data(), width * channels);
     } else {
-        stbi_write_jpg(filePathStr.c_str(), width, height, channels, std_data.data(), 95);
+        stbi_write_jpg_to_func(append, &bytes, width, height, channels, std_data.data(), 95);
     }
+    return bytes;
 };
 
 template <typename T>
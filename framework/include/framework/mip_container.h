@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "codecs.h"
+
+// Single-file container of all the factors of one chain ("mip levels"), written level by level while the chain runs.
+//  - Header (32 bytes): "PXMC", then version, level count, codec and alignment as little-endian uint32, zero-padded.
+//  - Level table: one 32-byte entry per level with factor, width, height and a reserved word (little-endian uint32),
+//    then the offset and size of the level data (little-endian uint64). A size of 0 marks a level not written yet.
+//  - Level data, every level starting at a multiple of the alignment, so that a memory map of the file can hand out
+//    the pixels of a level in place. Raw levels are tightly packed RGB8 rows; QOI levels are complete QOI files.
+// The entry of a level is only filled once its data is in the file, so a container that is still being written (or
+// whose writer stopped early) is valid and simply misses some levels.
+
+constexpr size_t MIP_HEADER_SIZE        = 32U;
+constexpr size_t MIP_LEVEL_ENTRY_SIZE   = 32U;
+constexpr uint32_t MIP_VERSION          = 1U;
+constexpr uint32_t MIP_ALIGNMENT        = 4096U; // Page size, so that levels can also be mapped on their own
+
+enum MipCodec : uint32_t {
+    MIP_CODEC_RAW = 0,
+    MIP_CODEC_QOI = 1
+};
+
+struct MipLevel {
+    uint32_t factor = 0U;
+    int width = 0, height = 0;
+    uint64_t offset = 0U, size = 0U;
+
+    bool written() const { return size > 0U; }
+};
+
+std::vector<uint8_t> encodeMipHeader(uint32_t levelCount, MipCodec codec);
+std::vector<uint8_t> encodeMipLevelEntry(const MipLevel& level);
+inline uint64_t mipLevelEntryOffset(size_t level) { return MIP_HEADER_SIZE + uint64_t(level) * MIP_LEVEL_ENTRY_SIZE; }
+inline uint64_t mipDataOffset(uint32_t levelCount) { return (mipLevelEntryOffset(levelCount) + MIP_ALIGNMENT - 1U) / MIP_ALIGNMENT * MIP_ALIGNMENT; }
+
+// Read-only view of a container, mapped into memory (read into memory where mmap is not available). Malformed files
+// are reported on std::cerr and raise an exception, like the rest of the framework.
+class MipContainer {
+public:
+    explicit MipContainer(const std::filesystem::path& filePath);
+    MipContainer(const MipContainer&) = delete;
+    MipContainer& operator=(const MipContainer&) = delete;
+    ~MipContainer();
+
+    const MipLevel* findLevel(uint32_t factor) const; // Written level of a factor, or nullptr.
+    const uint8_t* levelData(const MipLevel& level) const { return bytes + level.offset; } // Points into the mapping.
+    Rgb8Pixels decodeLevel(const MipLevel& level) const;
+
+public:
+    MipCodec codec = MIP_CODEC_RAW;
+    std::vector<MipLevel> levels; // In the order of the level table, written or not.
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t size = 0U;
+#ifdef _WIN32
+    std::vector<uint8_t> fallback;
+#endif
+};
@@ -0,0 +1,245 @@
+#include "codecs.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+constexpr uint8_t QOI_OP_INDEX  = 0x00;
+constexpr uint8_t QOI_OP_DIFF   = 0x40;
+constexpr uint8_t QOI_OP_LUMA   = 0x80;
+constexpr uint8_t QOI_OP_RUN    = 0xc0;
+constexpr uint8_t QOI_OP_RGB    = 0xfe;
+constexpr uint8_t QOI_OP_RGBA   = 0xff;
+constexpr uint8_t QOI_MASK_2    = 0xc0;
+constexpr int QOI_MAX_RUN       = 62;
+constexpr uint64_t QOI_MAX_PIXELS = 400000000ULL; // Limit of the specification, which keeps decoded sizes sane
+constexpr uint8_t QOI_PADDING[QOI_PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+struct QoiPixel {
+    uint8_t r, g, b, a;
+
+    bool operator==(const QoiPixel&) const = default;
+};
+
+inline uint32_t qoiHash(const QoiPixel& pixel) {
+    return (uint32_t(pixel.r) * 3U + uint32_t(pixel.g) * 5U + uint32_t(pixel.b) * 7U + uint32_t(pixel.a) * 11U) % 64U;
+}
+
+inline uint8_t* writeBigEndian(uint8_t* dst, uint32_t value) {
+    dst[0] = uint8_t(value >> 24U);
+    dst[1] = uint8_t(value >> 16U);
+    dst[2] = uint8_t(value >> 8U);
+    dst[3] = uint8_t(value);
+    return dst + 4;
+}
+
+inline uint32_t readBigEndian(const uint8_t* src) {
+    return (uint32_t(src[0]) << 24U) | (uint32_t(src[1]) << 16U) | (uint32_t(src[2]) << 8U) | uint32_t(src[3]);
+}
+
+inline uint8_t* writeLittleEndian(uint8_t* dst, uint32_t value) {
+    dst[0] = uint8_t(value);
+    dst[1] = uint8_t(value >> 8U);
+    dst[2] = uint8_t(value >> 16U);
+    dst[3] = uint8_t(value >> 24U);
+    return dst + 4;
+}
+
+inline uint32_t readLittleEndian(const uint8_t* src) {
+    return uint32_t(src[0]) | (uint32_t(src[1]) << 8U) | (uint32_t(src[2]) << 16U) | (uint32_t(src[3]) << 24U);
+}
+
+[[noreturn]] void malformed(const char* format, const char* reason) {
+    std::cerr << "Malformed " << format << " data: " << reason << std::endl;
+    throw std::exception();
+}
+
+}
+
+std::vector<uint8_t> encodeQoi(const uint8_t* rgb, int width, int height) {
+    const size_t pixel_count = size_t(width) * size_t(height);
+    if (width <= 0 || height <= 0 || pixel_count > QOI_MAX_PIXELS) {
+        std::cerr << "Cannot encode a " << width << "x" << height << " image as QOI" << std::endl;
+        throw std::exception();
+    }
+
+    // Worst case is one QOI_OP_RGB per pixel
+    std::vector<uint8_t> bytes(QOI_HEADER_SIZE + (pixel_count * 4U) + QOI_PADDING_SIZE);
+    uint8_t* out = bytes.data();
+    *out++ = 'q';
+    *out++ = 'o';
+    *out++ = 'i';
+    *out++ = 'f';
+    out = writeBigEndian(out, uint32_t(width));
+    out = writeBigEndian(out, uint32_t(height));
+    *out++ = 3U; // RGB
+    *out++ = 0U; // sRGB with linear alpha
+
+    std::array<QoiPixel, 64> index {};
+    QoiPixel previous { 0, 0, 0, 255 };
+    int run = 0;
+    for (size_t i = 0; i < pixel_count; i++) {
+        const QoiPixel pixel { rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2], 255 };
+        if (pixel == previous) {
+            run++;
+            if (run == QOI_MAX_RUN || i + 1 == pixel_count) {
+                *out++ = uint8_t(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *out++ = uint8_t(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        const uint32_t hash = qoiHash(pixel);
+        if (index[hash] == pixel) {
+            *out++ = uint8_t(QOI_OP_INDEX | hash);
+        } else {
+            // Pixels are always opaque, so QOI_OP_RGBA is never needed
+            index[hash] = pixel;
+            const int dr = int8_t(pixel.r - previous.r);
+            const int dg = int8_t(pixel.g - previous.g);
+            const int db = int8_t(pixel.b - previous.b);
+            const int dr_dg = dr - dg;
+            const int db_dg = db - dg;
+            if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                *out++ = uint8_t(QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+            } else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8) {
+                *out++ = uint8_t(QOI_OP_LUMA | (dg + 32));
+                *out++ = uint8_t(((dr_dg + 8) << 4) | (db_dg + 8));
+            } else {
+                *out++ = QOI_OP_RGB;
+                *out++ = pixel.r;
+                *out++ = pixel.g;
+                *out++ = pixel.b;
+            }
+        }
+        previous = pixel;
+    }
+    out = std::copy(std::begin(QOI_PADDING), std::end(QOI_PADDING), out);
+
+    bytes.resize(size_t(out - bytes.data()));
+    return bytes;
+}
+
+Rgb8Pixels decodeQoi(const uint8_t* bytes, size_t size) {
+    if (size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || std::memcmp(bytes, "qoif", 4) != 0) { malformed("QOI", "missing header"); }
+    Rgb8Pixels result;
+    const uint32_t width    = readBigEndian(bytes + 4);
+    const uint32_t height   = readBigEndian(bytes + 8);
+    const uint8_t channels  = bytes[12];
+    if (width == 0U || height == 0U || uint64_t(width) * uint64_t(height) > QOI_MAX_PIXELS) { malformed("QOI", "invalid size"); }
+    if (channels != 3U && channels != 4U) { malformed("QOI", "invalid channel count"); }
+    result.width    = int(width);
+    result.height   = int(height);
+    const size_t pixel_count = size_t(width) * size_t(height);
+    result.rgb.resize(pixel_count * 3U);
+
+    // Ops may not start in the padding, but their operands are only bounded by the end of the data
+    const uint8_t* in           = bytes + QOI_HEADER_SIZE;
+    const uint8_t* ops_end      = bytes + size - QOI_PADDING_SIZE;
+    const uint8_t* data_end     = bytes + size;
+    std::array<QoiPixel, 64> index {};
+    QoiPixel pixel { 0, 0, 0, 255 };
+    int run = 0;
+    uint8_t* out = result.rgb.data();
+    for (size_t i = 0; i < pixel_count; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (in >= ops_end) { malformed("QOI", "truncated pixel data"); }
+            const uint8_t op = *in++;
+            if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+                const ptrdiff_t operands = op == QOI_OP_RGB ? 3 : 4;
+                if (data_end - in < operands) { malformed("QOI", "truncated pixel data"); }
+                pixel.r = in[0];
+                pixel.g = in[1];
+                pixel.b = in[2];
+                if (op == QOI_OP_RGBA) { pixel.a = in[3]; }
+                in += operands;
+            } else if ((op & QOI_MASK_2) == QOI_OP_INDEX) {
+                pixel = index[op];
+            } else if ((op & QOI_MASK_2) == QOI_OP_DIFF) {
+                pixel.r = uint8_t(pixel.r + ((op >> 4) & 0x03) - 2);
+                pixel.g = uint8_t(pixel.g + ((op >> 2) & 0x03) - 2);
+                pixel.b = uint8_t(pixel.b + (op & 0x03) - 2);
+            } else if ((op & QOI_MASK_2) == QOI_OP_LUMA) {
+                if (in >= data_end) { malformed("QOI", "truncated pixel data"); }
+                const uint8_t operand = *in++;
+                const int dg = (op & 0x3f) - 32;
+                pixel.r = uint8_t(pixel.r + dg - 8 + ((operand >> 4) & 0x0f));
+                pixel.g = uint8_t(pixel.g + dg);
+                pixel.b = uint8_t(pixel.b + dg - 8 + (operand & 0x0f));
+            } else {
+                run = op & 0x3f;
+            }
+            index[qoiHash(pixel)] = pixel;
+        }
+        // Alpha is dropped, as images are RGB
+        *out++ = pixel.r;
+        *out++ = pixel.g;
+        *out++ = pixel.b;
+    }
+    return result;
+}
+
+std::vector<uint8_t> encodeRaw(const uint8_t* rgb, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        std::cerr << "Cannot encode a " << width << "x" << height << " image as raw pixels" << std::endl;
+        throw std::exception();
+    }
+    const size_t pixel_bytes = size_t(width) * size_t(height) * 3U;
+    std::vector<uint8_t> bytes(RAW_HEADER_SIZE + pixel_bytes);
+    uint8_t* out = bytes.data();
+    *out++ = 'P';
+    *out++ = 'X';
+    *out++ = 'R';
+    *out++ = 'W';
+    out = writeLittleEndian(out, uint32_t(width));
+    out = writeLittleEndian(out, uint32_t(height));
+    out = writeLittleEndian(out, 3U);
+    std::memcpy(out, rgb, pixel_bytes);
+    return bytes;
+}
+
+Rgb8Pixels decodeRaw(const uint8_t* bytes, size_t size) {
+    if (size < RAW_HEADER_SIZE || std::memcmp(bytes, "PXRW", 4) != 0) { malformed("raw", "missing header"); }
+    const uint32_t width    = readLittleEndian(bytes + 4);
+    const uint32_t height   = readLittleEndian(bytes + 8);
+    const uint32_t channels = readLittleEndian(bytes + 12);
+    if (width == 0U || height == 0U || width > uint32_t(INT32_MAX) || height > uint32_t(INT32_MAX)) { malformed("raw", "invalid size"); }
+    if (channels != 3U) { malformed("raw", "invalid channel count"); }
+    if (uint64_t(size - RAW_HEADER_SIZE) != uint64_t(width) * uint64_t(height) * 3U) { malformed("raw", "pixel data does not match the size"); }
+
+    Rgb8Pixels result;
+    result.width    = int(width);
+    result.height   = int(height);
+    result.rgb.assign(bytes + RAW_HEADER_SIZE, bytes + size);
+    return result;
+}
+
+std::vector<uint8_t> readFileBytes(const std::filesystem::path& filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        std::cerr << "File " << filePath << " could not be opened for reading!" << std::endl;
+        throw std::exception();
+    }
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+void writeFileBytes(const std::filesystem::path& filePath, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(filePath, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    if (!file) {
+        std::cerr << "File " << filePath << " could not be written!" << std::endl;
+        throw std::exception();
+    }
+}
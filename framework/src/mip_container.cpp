@@ -0,0 +1,145 @@
+#include "mip_container.h"
+
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+inline uint8_t* writeLittleEndian(uint8_t* dst, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) { dst[i] = uint8_t(value >> (8 * i)); }
+    return dst + bytes;
+}
+
+inline uint64_t readLittleEndian(const uint8_t* src, int bytes) {
+    uint64_t value = 0U;
+    for (int i = bytes - 1; i >= 0; i--) { value = (value << 8U) | uint64_t(src[i]); }
+    return value;
+}
+
+[[noreturn]] void malformed(const std::filesystem::path& filePath, const char* reason) {
+    std::cerr << "Malformed mip container " << filePath << ": " << reason << std::endl;
+    throw std::exception();
+}
+
+}
+
+std::vector<uint8_t> encodeMipHeader(uint32_t levelCount, MipCodec codec) {
+    std::vector<uint8_t> bytes(MIP_HEADER_SIZE, 0U);
+    std::memcpy(bytes.data(), "PXMC", 4);
+    uint8_t* out = writeLittleEndian(bytes.data() + 4, MIP_VERSION, 4);
+    out = writeLittleEndian(out, levelCount, 4);
+    out = writeLittleEndian(out, codec, 4);
+    writeLittleEndian(out, MIP_ALIGNMENT, 4);
+    return bytes;
+}
+
+std::vector<uint8_t> encodeMipLevelEntry(const MipLevel& level) {
+    std::vector<uint8_t> bytes(MIP_LEVEL_ENTRY_SIZE, 0U);
+    uint8_t* out = writeLittleEndian(bytes.data(), level.factor, 4);
+    out = writeLittleEndian(out, uint32_t(level.width), 4);
+    out = writeLittleEndian(out, uint32_t(level.height), 4);
+    out = writeLittleEndian(out + 4, level.offset, 8); // Skips the reserved word
+    writeLittleEndian(out, level.size, 8);
+    return bytes;
+}
+
+MipContainer::MipContainer(const std::filesystem::path& filePath) {
+#ifdef _WIN32
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Mip container " << filePath << " could not be opened for reading!" << std::endl;
+        throw std::exception();
+    }
+    fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    bytes   = fallback.data();
+    size    = fallback.size();
+#else
+    const int descriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        std::cerr << "Mip container " << filePath << " could not be opened for reading!" << std::endl;
+        throw std::exception();
+    }
+    struct stat status {};
+    if (::fstat(descriptor, &status) == 0 && status.st_size > 0) {
+        void* mapping = ::mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping != MAP_FAILED) {
+            bytes   = static_cast<const uint8_t*>(mapping);
+            size    = size_t(status.st_size);
+        }
+    }
+    ::close(descriptor);
+    if (!bytes && status.st_size > 0) {
+        std::cerr << "Mip container " << filePath << " could not be mapped!" << std::endl;
+        throw std::exception();
+    }
+#endif
+
+    // The destructor does not run if the constructor throws, so a malformed file is unmapped here
+    try {
+        if (size < MIP_HEADER_SIZE || std::memcmp(bytes, "PXMC", 4) != 0) { malformed(filePath, "missing header"); }
+        if (readLittleEndian(bytes + 4, 4) != MIP_VERSION) { malformed(filePath, "unsupported version"); }
+        const uint64_t level_count  = readLittleEndian(bytes + 8, 4);
+        const uint64_t codec_value  = readLittleEndian(bytes + 12, 4);
+        const uint64_t alignment    = readLittleEndian(bytes + 16, 4);
+        if (codec_value != MIP_CODEC_RAW && codec_value != MIP_CODEC_QOI) { malformed(filePath, "unknown codec"); }
+        if (alignment == 0U || (alignment & (alignment - 1U)) != 0U) { malformed(filePath, "alignment is not a power of two"); }
+        if (mipLevelEntryOffset(level_count) > size) { malformed(filePath, "truncated level table"); }
+        codec = MipCodec(codec_value);
+
+        for (size_t index = 0; index < level_count; index++) {
+            const uint8_t* entry = bytes + mipLevelEntryOffset(index);
+            MipLevel level;
+            level.factor            = uint32_t(readLittleEndian(entry, 4));
+            const uint64_t width    = readLittleEndian(entry + 4, 4);
+            const uint64_t height   = readLittleEndian(entry + 8, 4);
+            level.offset            = readLittleEndian(entry + 16, 8);
+            level.size              = readLittleEndian(entry + 24, 8);
+            if (level.factor == 0U) { malformed(filePath, "level without a factor"); }
+            if (level.written()) {
+                if (width == 0U || height == 0U || width > uint64_t(INT32_MAX) || height > uint64_t(INT32_MAX)) { malformed(filePath, "invalid level size"); }
+                if (level.offset % alignment != 0U || level.offset < mipLevelEntryOffset(level_count)) { malformed(filePath, "misplaced level data"); }
+                if (level.offset > size || level.size > size - level.offset) { malformed(filePath, "truncated level data"); }
+                if (codec == MIP_CODEC_RAW && level.size != width * height * 3U) { malformed(filePath, "level data does not match the size"); }
+                level.width     = int(width);
+                level.height    = int(height);
+            }
+            levels.push_back(level);
+        }
+    } catch (const std::exception&) {
+#ifndef _WIN32
+        if (bytes) { ::munmap(const_cast<uint8_t*>(bytes), size); }
+#endif
+        throw;
+    }
+}
+
+MipContainer::~MipContainer() {
+#ifndef _WIN32
+    if (bytes) { ::munmap(const_cast<uint8_t*>(bytes), size); }
+#endif
+}
+
+const MipLevel* MipContainer::findLevel(uint32_t factor) const {
+    for (const MipLevel& level : levels) {
+        if (level.factor == factor && level.written()) { return &level; }
+    }
+    return nullptr;
+}
+
+Rgb8Pixels MipContainer::decodeLevel(const MipLevel& level) const {
+    if (codec == MIP_CODEC_QOI) { return decodeQoi(levelData(level), size_t(level.size)); }
+    Rgb8Pixels result;
+    result.width    = level.width;
+    result.height   = level.height;
+    result.rgb.assign(levelData(level), levelData(level) + level.size);
+    return result;
+}
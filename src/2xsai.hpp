@@ -5,6 +5,9 @@
 #include <framework/image.h>
 
 #include "common.hpp"
+#include "kernel.hpp"
+
+constexpr int SAI_HALO = 2; // Source rows/columns read around each pixel
 
 /**
  * Compute if C and D exclusively match either A or B.
@@ -28,78 +31,76 @@ inline int8_t majorityMatch(T A, T B, T C, T D) {
 }
 
 template<typename T>
-Image<T> scale2xSaI(const Image<T>& src) {
-    auto result = Image<T>(src.width * 2, src.height * 2);
-
-    for (int y = 0; y < src.height; y++) {
-        for (int x = 0; x < src.width; x++) {
-            // Acquire original pixel grid values (row by row)
-            T I, E, F, J;
-            I = src.safeAccess(x - 1, y - 1), E = src.safeAccess(x, y - 1), F = src.safeAccess(x + 1, y - 1), J = src.safeAccess(x + 2, y - 1);
-            T G, A, B, K;
-            G = src.safeAccess(x - 1, y), A = src.safeAccess(x, y), B = src.safeAccess(x + 1, y), K = src.safeAccess(x + 2, y);
-            T H, C, D, L;
-            H = src.safeAccess(x - 1, y + 1), C = src.safeAccess(x, y + 1), D = src.safeAccess(x + 1, y + 1), L = src.safeAccess(x + 2, y + 1);
-            T M, N, O, P;
-            M = src.safeAccess(x - 1, y + 2), N = src.safeAccess(x, y + 2), O = src.safeAccess(x + 1, y + 2), P = src.safeAccess(x + 2, y + 2);
-
-            T right_interp, bottom_interp, bottom_right_interp;
-
-            // First filter layer: check for edges (i.e. same colour) along A-D and B-C edge
-            // Second filter layer: acquire concrete values for interpolated pixels based on matching of neighbour pixel colours
-            if (A == D && B != C) {
-                if ((A == E && B == L) || (A == C && A == F && B != E && B == J)) { right_interp = A; }
-                else { right_interp = glm::mix(A, B, 0.50f); }
-
-                if ((A == G && C == O) || (A == B && A == H && G != C && C == M)) { bottom_interp = A; }
-                else { bottom_interp = A; }
-
-                bottom_right_interp = A;
-            } else if (A != D && B == C) {
-                if ((B == F && A == H) || (B == E && B == D && A != F && A == I)) { right_interp = B; }
-                else { right_interp = glm::mix(A, B, 0.5f); }
-
-                if ((C == H && A == F) || (C == G && C == D && A != H && A == I)) { bottom_interp = C; }
-                else { bottom_interp = glm::mix(A, C, 0.5f); }
-
-                bottom_right_interp = B;
-            } else if (A == D && B == C) {
-                if (A == B) { right_interp = bottom_interp = bottom_right_interp = A; }
-                else {
-                    right_interp = glm::mix(A, B, 0.5f);
-
-                    bottom_interp = glm::mix(A, C, 0.5f);
-
-                    int8_t majority_accumulator = 0;
-                    majority_accumulator += majorityMatch(B, A, G, E);
-                    majority_accumulator += majorityMatch(B, A, K, F);
-                    majority_accumulator += majorityMatch(B, A, H, N);
-                    majority_accumulator += majorityMatch(B, A, L, O);
-                    if (majority_accumulator > 0) { bottom_right_interp = A; }
-                    else if (majority_accumulator < 0) { bottom_right_interp = B; }
-                    else { bottom_right_interp = bilinearInterpolation(A, B, C, D, 0.5f, 0.5f); }
-                }
-            } else {
-                bottom_right_interp = bilinearInterpolation(A, B, C, D, 0.5f, 0.5f);
-
-                if (A == C && A == F && B != E && B == J) { right_interp = A; }
-                else if (B == E && B == D && A != F && A == I) { right_interp = B; }
-                else { right_interp = glm::mix(A, B, 0.5f); }
-
-                if (A == B && A == H && G != C && C == M) { bottom_interp = A; }
-                else if (C == G && C == D && A != H && A == I) { bottom_interp = C; }
-                else { bottom_interp = glm::mix(A, C, 0.5f); }
+struct SaiRule {
+    static constexpr int RADIUS = SAI_HALO;
+    static constexpr int FACTOR = 2;
+
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window) const {
+        // Acquire original pixel grid values (row by row)
+        T I, E, F, J;
+        I = window(-1, -1), E = window(0, -1), F = window(1, -1), J = window(2, -1);
+        T G, A, B, K;
+        G = window(-1, 0), A = window(0, 0), B = window(1, 0), K = window(2, 0);
+        T H, C, D, L;
+        H = window(-1, 1), C = window(0, 1), D = window(1, 1), L = window(2, 1);
+        T M, N, O, P;
+        M = window(-1, 2), N = window(0, 2), O = window(1, 2), P = window(2, 2);
+
+        T right_interp, bottom_interp, bottom_right_interp;
+
+        // First filter layer: check for edges (i.e. same colour) along A-D and B-C edge
+        // Second filter layer: acquire concrete values for interpolated pixels based on matching of neighbour pixel colours
+        if (A == D && B != C) {
+            if ((A == E && B == L) || (A == C && A == F && B != E && B == J)) { right_interp = A; }
+            else { right_interp = glm::mix(A, B, 0.50f); }
+
+            if ((A == G && C == O) || (A == B && A == H && G != C && C == M)) { bottom_interp = A; }
+            else { bottom_interp = A; }
+
+            bottom_right_interp = A;
+        } else if (A != D && B == C) {
+            if ((B == F && A == H) || (B == E && B == D && A != F && A == I)) { right_interp = B; }
+            else { right_interp = glm::mix(A, B, 0.5f); }
+
+            if ((C == H && A == F) || (C == G && C == D && A != H && A == I)) { bottom_interp = C; }
+            else { bottom_interp = glm::mix(A, C, 0.5f); }
+
+            bottom_right_interp = B;
+        } else if (A == D && B == C) {
+            if (A == B) { right_interp = bottom_interp = bottom_right_interp = A; }
+            else {
+                right_interp = glm::mix(A, B, 0.5f);
+
+                bottom_interp = glm::mix(A, C, 0.5f);
+
+                int8_t majority_accumulator = 0;
+                majority_accumulator += majorityMatch(B, A, G, E);
+                majority_accumulator += majorityMatch(B, A, K, F);
+                majority_accumulator += majorityMatch(B, A, H, N);
+                majority_accumulator += majorityMatch(B, A, L, O);
+                if (majority_accumulator > 0) { bottom_right_interp = A; }
+                else if (majority_accumulator < 0) { bottom_right_interp = B; }
+                else { bottom_right_interp = bilinearInterpolation(A, B, C, D, 0.5f, 0.5f); }
             }
+        } else {
+            bottom_right_interp = bilinearInterpolation(A, B, C, D, 0.5f, 0.5f);
+
+            if (A == C && A == F && B != E && B == J) { right_interp = A; }
+            else if (B == E && B == D && A != F && A == I) { right_interp = B; }
+            else { right_interp = glm::mix(A, B, 0.5f); }
 
-            int dst_x = 2 * x;
-            int dst_y = 2 * y;
-            result.data[result.getImageOffset(dst_x, dst_y)]            = A;
-            result.data[result.getImageOffset(dst_x + 1, dst_y)]        = right_interp;
-            result.data[result.getImageOffset(dst_x, dst_y + 1)]        = bottom_interp;
-            result.data[result.getImageOffset(dst_x + 1, dst_y + 1)]    = bottom_right_interp;
+            if (A == B && A == H && G != C && C == M) { bottom_interp = A; }
+            else if (C == G && C == D && A != H && A == I) { bottom_interp = C; }
+            else { bottom_interp = glm::mix(A, C, 0.5f); }
         }
+        return { A, right_interp, bottom_interp, bottom_right_interp };
     }
-    return result;
+};
+
+template<typename T>
+Image<T> scale2xSaI(const Image<T>& src) {
+    return applyKernel<SaiRule<T>, NEAREST>(src);
 }
 
 #endif
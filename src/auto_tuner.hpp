@@ -0,0 +1,277 @@
+#ifndef AUTO_TUNER_HPP
+#define AUTO_TUNER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "2xsai.hpp"
+#include "eagle.hpp"
+#include "epx.hpp"
+#include "equality_mask.hpp"
+#include "fused_chain.hpp"
+#include "hq2x.hpp"
+#include "xbr.hpp"
+
+// Calibration of the settings of fin-proj that depend on the machine and on the sizes of the images: which
+// implementation of a raster scaler runs (the kernel of its rule, or the shared equality pre-stage of the rules that only
+// compare pixels) and the tile size of fused chains. Short fused chains are timed on synthetic sprites of every size
+// class, and the fastest settings are kept in a text profile that later runs load at startup:
+//
+//     fin-proj-tuning 2
+//     threads <hardware threads>
+//     <algorithm> <size class> <variant> <tile size> <seconds>
+//     ...
+//
+// All implementations of a scaler produce exactly the same pixels (see the golden tests), so a profile only changes how
+// fast a run is. NEDI is not tuned, as it runs on float pixels and is never fused. The raster scalers have no parallel
+// loops of their own, so there is no split of the hardware threads to tune: the scheduler runs one image per hardware
+// thread. The number of hardware threads is still recorded, so that profiles of another machine are noticed
+
+constexpr std::string_view TUNING_PROFILE_HEADER = "fin-proj-tuning 2";
+constexpr uint32_t CALIBRATION_PASSES = 2U; // Of every timed chain
+
+enum SizeClass : uint8_t { SIZE_SMALL, SIZE_MEDIUM, SIZE_LARGE, SIZE_CLASS_COUNT };
+
+constexpr std::array<std::string_view, SIZE_CLASS_COUNT> SIZE_CLASS_NAMES = { "small", "medium", "large" };
+constexpr std::array<uint64_t, SIZE_CLASS_COUNT - 1U> SIZE_CLASS_LIMITS = { 128U * 128U, 512U * 512U }; // Source pixels from which the next class starts
+
+inline SizeClass sizeClassOf(int width, int height) {
+    const uint64_t pixels = uint64_t(std::max(width, 0)) * uint64_t(std::max(height, 0));
+    return SizeClass(std::upper_bound(SIZE_CLASS_LIMITS.begin(), SIZE_CLASS_LIMITS.end(), pixels) - SIZE_CLASS_LIMITS.begin());
+}
+
+struct KernelVariant {
+    std::string_view name;
+    ScaleFunction<glm::uvec3> scale;
+};
+
+struct TunableScaler {
+    std::string_view algorithm; // As in the output file names of fin-proj
+    int halo;
+    std::vector<KernelVariant> variants; // The first one runs without a profile
+};
+
+inline const std::vector<TunableScaler> TUNABLE_SCALERS = {
+    { "epx",      EPX_HALO,   { { "kernel", scaleEpx<glm::uvec3> },     { "equality_mask", scaleEpxEquality<glm::uvec3> } } },
+    { "adv_mame", EPX_HALO,   { { "kernel", scaleAdvMame<glm::uvec3> }, { "equality_mask", scaleAdvMameEquality<glm::uvec3> } } },
+    { "eagle",    EAGLE_HALO, { { "kernel", scaleEagle<glm::uvec3> },   { "equality_mask", scaleEagleEquality<glm::uvec3> } } },
+    { "2xSaI",    SAI_HALO,   { { "kernel", scale2xSaI<glm::uvec3> },   { "equality_mask", scale2xSaIEquality<glm::uvec3> } } },
+    { "hq2x",     HQ2X_HALO,  { { "kernel", scaleHq2x<glm::uvec3> } } },
+    { "xbr",      XBR_HALO,   { { "kernel", scaleXbr<glm::uvec3> } } }};
+
+// Tunable scaler of an algorithm, or nullptr
+inline const TunableScaler* findTunableScaler(std::string_view algorithm) {
+    const auto scaler = std::find_if(TUNABLE_SCALERS.begin(), TUNABLE_SCALERS.end(), [&](const TunableScaler& s) { return s.algorithm == algorithm; });
+    return scaler == TUNABLE_SCALERS.end() ? nullptr : &*scaler;
+}
+
+struct TunedConfig {
+    size_t variant = 0U;                        // Index in the variants of the scaler
+    int tile_size = DEFAULT_FUSED_TILE_SIZE;    // Of fused chains
+    double seconds = 0.0;                       // Of the calibration chain, 0 if not calibrated
+};
+
+struct TuningProfile {
+    unsigned hardware_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    std::vector<std::array<TunedConfig, SIZE_CLASS_COUNT>> configs = std::vector<std::array<TunedConfig, SIZE_CLASS_COUNT>>(TUNABLE_SCALERS.size());
+
+    // Settings of a scaler for a source image
+    const TunedConfig& lookup(const TunableScaler& scaler, int width, int height) const {
+        return configs[size_t(&scaler - TUNABLE_SCALERS.data())][sizeClassOf(width, height)];
+    }
+};
+
+/**
+ * Generate a sprite-like image: a few colours in blocks, diagonal staircases and some smooth gradients, so that the
+ * calibration runs through the same branches of the rules as real inputs
+ *
+ * @param width Width of the image
+ * @param height Height of the image
+ * @param seed Seed of the pseudo-random shapes
+ *
+ * @return Generated image
+*/
+inline Image<glm::uvec3> syntheticSprite(int width, int height, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::array<glm::uvec3, 8> palette;
+    for (glm::uvec3& colour : palette) { colour = glm::uvec3(random() % 256U, random() % 256U, random() % 256U); }
+
+    Image<glm::uvec3> sprite(width, height);
+    std::fill(sprite.data.begin(), sprite.data.end(), palette[0]);
+    const int shapes = std::max(1, width * height / 64);
+    for (int shape = 0; shape < shapes; shape++) {
+        const int x0 = int(random() % uint32_t(width)), y0 = int(random() % uint32_t(height));
+        const int size = 2 + int(random() % 15U);
+        const glm::uvec3 colour = palette[random() % palette.size()];
+        const uint32_t kind = random() % 4U;
+        for (int y = y0; y < std::min(y0 + size, height); y++) {
+            for (int x = x0; x < std::min(x0 + size, width); x++) {
+                glm::uvec3& pixel = sprite.data[sprite.getImageOffset(x, y)];
+                if (kind == 0U) { pixel = colour; }                                       // Block
+                else if (kind == 1U && x - x0 == (y - y0) / 2) { pixel = colour; }        // Staircase
+                else if (kind == 2U && x - x0 >= y - y0) { pixel = colour; }              // Diagonal edge
+                else if (kind == 3U) { pixel = glm::min(colour + glm::uvec3(3 * (x - x0 + y - y0)), glm::uvec3(255)); } // Gradient
+            }
+        }
+    }
+    return sprite;
+}
+
+struct CalibrationOptions {
+    std::array<int, SIZE_CLASS_COUNT> sides = { 64, 256, 512 }; // Of the square sprites of every size class
+    std::vector<int> tile_sizes = { 32, 64, 128, 256 };
+    int max_repeats = 3;        // The fastest of the repeated runs counts
+    double min_seconds = 0.05;  // Runs are only repeated until they took this long in total
+    unsigned hardware_threads = std::max(std::thread::hardware_concurrency(), 1U);
+};
+
+/**
+ * Time the fused calibration chain of a scaler
+ *
+ * @return Seconds of the fastest of the repeated runs
+*/
+inline double timeCalibrationChain(const Image<glm::uvec3>& sprite, ScaleFunction<glm::uvec3> scale, int halo, int tile_size, const CalibrationOptions& options) {
+    double fastest = std::numeric_limits<double>::infinity(), total = 0.0;
+    for (int repeat = 0; repeat < std::max(options.max_repeats, 1) && (repeat == 0 || total < options.min_seconds); repeat++) {
+        const auto start = std::chrono::steady_clock::now();
+        scaleChainFused(sprite, scale, halo, std::vector<bool>(CALIBRATION_PASSES, true), tile_size);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fastest = std::min(fastest, seconds);
+        total += seconds;
+    }
+    return fastest;
+}
+
+/**
+ * Find the fastest variant and tile size of a scaler on a sprite
+ *
+ * @return Fastest settings, with the seconds of their calibration chain
+*/
+inline TunedConfig calibrateScaler(const TunableScaler& scaler, const Image<glm::uvec3>& sprite, const CalibrationOptions& options) {
+    TunedConfig best;
+    best.seconds = std::numeric_limits<double>::infinity();
+    for (size_t variant = 0; variant < scaler.variants.size(); variant++) {
+        for (int tile_size : options.tile_sizes) {
+            const double seconds = timeCalibrationChain(sprite, scaler.variants[variant].scale, scaler.halo, tile_size, options);
+            if (seconds < best.seconds) { best = { variant, tile_size, seconds }; }
+        }
+    }
+    return best;
+}
+
+/**
+ * Calibrate every tunable scaler on a synthetic sprite of every size class
+ *
+ * @param options Sizes, candidate tile sizes and repeats of the calibration
+ *
+ * @return Profile of the fastest settings
+*/
+inline TuningProfile calibrate(const CalibrationOptions& options = {}) {
+    TuningProfile profile;
+    profile.hardware_threads = std::max(options.hardware_threads, 1U);
+
+    // Scalers are calibrated one at a time on the calling thread, the way every image runs
+    std::array<Image<glm::uvec3>, SIZE_CLASS_COUNT> sprites;
+    for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+        sprites[size_class] = syntheticSprite(options.sides[size_class], options.sides[size_class], uint32_t(size_class) + 1U);
+    }
+    for (size_t scaler = 0; scaler < TUNABLE_SCALERS.size(); scaler++) {
+        for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+            profile.configs[scaler][size_class] = calibrateScaler(TUNABLE_SCALERS[scaler], sprites[size_class], options);
+        }
+    }
+    return profile;
+}
+
+/**
+ * Write a profile as text (see the top of this file)
+ *
+ * @param profile Profile to write
+ * @param file_path Path of the profile, whose parent directories are created if needed
+*/
+inline void saveProfile(const TuningProfile& profile, const std::filesystem::path& file_path) {
+    if (!file_path.parent_path().empty()) { std::filesystem::create_directories(file_path.parent_path()); }
+    std::ofstream file(file_path);
+    file << TUNING_PROFILE_HEADER << "\n";
+    file << "threads " << profile.hardware_threads << "\n";
+    for (size_t scaler = 0; scaler < TUNABLE_SCALERS.size(); scaler++) {
+        for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+            const TunedConfig& config = profile.configs[scaler][size_class];
+            file << TUNABLE_SCALERS[scaler].algorithm << " " << SIZE_CLASS_NAMES[size_class] << " " << TUNABLE_SCALERS[scaler].variants[config.variant].name
+                 << " " << config.tile_size << " " << config.seconds << "\n";
+        }
+    }
+    if (!file) {
+        std::cerr << "Tuning profile " << file_path << " could not be written!" << std::endl;
+        throw std::exception();
+    }
+}
+
+/**
+ * Read a profile written by saveProfile. Scalers and size classes missing from the file keep their defaults
+ *
+ * @param file_path Path of the profile
+ *
+ * @return Profile, or nothing if the file does not exist or is invalid (which is reported)
+*/
+inline std::optional<TuningProfile> loadProfile(const std::filesystem::path& file_path) {
+    std::ifstream file(file_path);
+    if (!file) { return std::nullopt; }
+    std::string line;
+    if (!std::getline(file, line) || line != TUNING_PROFILE_HEADER) {
+        std::cerr << "File " << file_path << " is not a tuning profile of this version, ignoring it" << std::endl;
+        return std::nullopt;
+    }
+
+    TuningProfile profile;
+    for (size_t line_number = 2U; std::getline(file, line); line_number++) {
+        if (line.empty()) { continue; }
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        bool valid = false;
+        if (key == "threads") {
+            fields >> profile.hardware_threads;
+            valid = !fields.fail() && profile.hardware_threads > 0U;
+        } else if (const TunableScaler* scaler = findTunableScaler(key)) {
+            std::string size_class_name, variant_name;
+            TunedConfig config;
+            fields >> size_class_name >> variant_name >> config.tile_size >> config.seconds;
+            const auto size_class = std::find(SIZE_CLASS_NAMES.begin(), SIZE_CLASS_NAMES.end(), size_class_name);
+            const auto variant = std::find_if(scaler->variants.begin(), scaler->variants.end(), [&](const KernelVariant& v) { return v.name == variant_name; });
+            valid = !fields.fail() && size_class != SIZE_CLASS_NAMES.end() && variant != scaler->variants.end() && config.tile_size > 0;
+            if (valid) {
+                config.variant = size_t(variant - scaler->variants.begin());
+                profile.configs[size_t(scaler - TUNABLE_SCALERS.data())][size_t(size_class - SIZE_CLASS_NAMES.begin())] = config;
+            }
+        }
+        if (!valid) {
+            std::cerr << "Line " << line_number << " of tuning profile " << file_path << " is invalid, ignoring the profile" << std::endl;
+            return std::nullopt;
+        }
+    }
+    return profile;
+}
+
+#endif
@@ -0,0 +1,546 @@
+#ifndef BATCHED_IO_HPP
+#define BATCHED_IO_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <ios>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <framework/codecs.h>
+
+// Asynchronous reads and writes of whole files, for runs over many small files where opening, reading and writing
+// every file would otherwise block the threads that decode, scale and encode them. Reads return a future of the bytes of
+// the file, so that inputs are prefetched long before they are decoded; writes take ownership of an encoded buffer and
+// only report failures once flush() is called.
+//
+// On Linux, every request is a chain of open, statx (reads only), read/write and close operations on an io_uring set up
+// with raw system calls, driven by one I/O thread. The operations of all requests in flight are submitted together, so a
+// batch of small files costs a few system calls instead of several per file. Where io_uring is missing or blocked (older
+// kernels, seccomp filters, other systems), a pool of threads runs the same requests with blocking calls
+
+constexpr unsigned DEFAULT_IO_QUEUE_DEPTH   = 64U; // Requests in flight at once on io_uring
+constexpr unsigned DEFAULT_IO_THREADS       = 4U;  // Of the fallback pool
+constexpr size_t MAX_IO_CHUNK_BYTES         = 1U << 30U; // Of a single read or write operation
+constexpr std::chrono::milliseconds RING_DRAIN_TIMEOUT { 1000 }; // Wait for the operations of a failed io_uring
+
+using FileBytes = std::vector<uint8_t>;
+
+enum IoBackend : uint8_t { IO_BACKEND_URING, IO_BACKEND_THREADS };
+
+struct IoStats {
+    size_t reads = 0U, writes = 0U;                 // Finished requests, failed or not
+    uint64_t bytes_read = 0U, bytes_written = 0U;
+    size_t submissions = 0U;                        // System calls submitting io_uring operations (0 for the fallback)
+    size_t operations = 0U;                         // io_uring operations they submitted
+};
+
+class BatchedIo {
+public:
+    /**
+     * @param use_io_uring Whether to try io_uring before falling back to the thread pool
+     * @param queue_depth Requests in flight at once on io_uring
+     * @param fallback_threads Threads of the fallback pool
+    */
+    explicit BatchedIo(bool use_io_uring = true, unsigned queue_depth = DEFAULT_IO_QUEUE_DEPTH, unsigned fallback_threads = DEFAULT_IO_THREADS) {
+        #ifdef __linux__
+        if (use_io_uring && ring.setup(std::max(queue_depth, 1U))) {
+            io_backend = IO_BACKEND_URING;
+            threads.emplace_back([this] { ringLoop(); });
+            return;
+        }
+        #else
+        (void)use_io_uring;
+        (void)queue_depth;
+        #endif
+        io_backend = IO_BACKEND_THREADS;
+        for (unsigned thread = 0U; thread < std::max(fallback_threads, 1U); thread++) { threads.emplace_back([this] { poolLoop(); }); }
+    }
+
+    BatchedIo(const BatchedIo&) = delete;
+    BatchedIo& operator=(const BatchedIo&) = delete;
+
+    // Finishes every queued request (failed writes were already reported)
+    ~BatchedIo() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) { thread.join(); }
+    }
+
+    IoBackend backend() const { return io_backend; }
+
+    /**
+     * Read a whole file in the background
+     *
+     * @param file_path Path of the file
+     *
+     * @return Future of the bytes of the file, which rethrows (after reporting on std::cerr) if it could not be read
+    */
+    std::future<FileBytes> read(const std::filesystem::path& file_path) {
+        auto request = std::make_unique<Request>();
+        request->path = file_path;
+        std::future<FileBytes> bytes = request->promise.get_future();
+        enqueue(std::move(request));
+        return bytes;
+    }
+
+    /**
+     * Write a whole file in the background, creating its parent directories if needed
+     *
+     * @param file_path Path of the file, which is replaced if it exists
+     * @param bytes Content of the file
+    */
+    void write(const std::filesystem::path& file_path, FileBytes bytes) {
+        auto request = std::make_unique<Request>();
+        request->path   = file_path;
+        request->bytes  = std::move(bytes);
+        request->write  = true;
+        {
+            std::lock_guard lock(mutex);
+            pending_writes++;
+        }
+        enqueue(std::move(request));
+    }
+
+    // Wait until every write issued so far is on disk (or failed, which throws once all of them finished)
+    void flush() {
+        std::unique_lock lock(mutex);
+        writes_done.wait(lock, [this] { return pending_writes == 0U; });
+        if (failed_writes > 0U) {
+            std::cerr << failed_writes << " files could not be written!" << std::endl;
+            failed_writes = 0U;
+            throw std::exception();
+        }
+    }
+
+    IoStats stats() const {
+        std::lock_guard lock(mutex);
+        return io_stats;
+    }
+
+private:
+    enum Stage : uint8_t { STAGE_OPEN, STAGE_STAT, STAGE_TRANSFER, STAGE_CLOSE };
+
+    struct Request {
+        std::filesystem::path path;
+        FileBytes bytes;        // Read so far, or to be written
+        bool write = false;
+        std::promise<FileBytes> promise; // Of reads
+        int error = 0;          // errno of the first failed operation
+        bool reported = false;  // Whether the failure was reported on std::cerr already
+
+        // State of the chain of io_uring operations
+        std::string path_string;
+        Stage stage = STAGE_OPEN;
+        int fd = -1;
+        size_t transferred = 0U;
+        #ifdef __linux__
+        struct statx file_status;
+        #endif
+    };
+
+    void enqueue(std::unique_ptr<Request> request) {
+        {
+            std::lock_guard lock(mutex);
+            pending.push_back(std::move(request));
+        }
+        wake.notify_one();
+    }
+
+    // Fulfil a request whose operations all finished
+    void finish(std::unique_ptr<Request> request) {
+        std::lock_guard lock(mutex);
+        if (request->write) {
+            io_stats.writes++;
+            if (request->error == 0) {
+                io_stats.bytes_written += request->bytes.size();
+            } else {
+                if (!request->reported) { std::cerr << "File " << request->path << " could not be written: " << std::strerror(request->error) << std::endl; }
+                failed_writes++;
+            }
+            if (--pending_writes == 0U) { writes_done.notify_all(); }
+            return;
+        }
+        io_stats.reads++;
+        if (request->error == 0) {
+            io_stats.bytes_read += request->bytes.size();
+            request->promise.set_value(std::move(request->bytes));
+        } else {
+            if (!request->reported) { std::cerr << "File " << request->path << " could not be read: " << std::strerror(request->error) << std::endl; }
+            request->promise.set_exception(std::make_exception_ptr(std::exception()));
+        }
+    }
+
+    // Create the parent directories of an output once per directory (failures show when the file is opened). The
+    // directories are created under the lock, so that no other write skips them before they exist
+    void createParentDirectories(const std::filesystem::path& file_path) {
+        const std::filesystem::path parent = file_path.parent_path();
+        if (parent.empty()) { return; }
+        std::lock_guard lock(directories_mutex);
+        if (created_directories.contains(parent)) { return; }
+        std::error_code error;
+        std::filesystem::create_directories(parent, error);
+        if (!error) { created_directories.insert(parent); }
+    }
+
+    // Run a request with blocking calls of the framework
+    void runBlocking(std::unique_ptr<Request> request) {
+        try {
+            if (request->write) {
+                createParentDirectories(request->path);
+                writeFileBytes(request->path, request->bytes);
+            } else {
+                request->bytes = readFileBytes(request->path);
+            }
+        } catch (const std::ios_base::failure&) {
+            request->error      = EIO; // Thrown by the standard library, e.g. when reading a directory
+        } catch (const std::exception&) {
+            request->error      = EIO; // Thrown by the framework, which reported the failure
+            request->reported   = true;
+        }
+        finish(std::move(request));
+    }
+
+    void poolLoop() {
+        for (;;) {
+            std::unique_ptr<Request> request;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [this] { return !pending.empty() || stopping; });
+                if (pending.empty()) { return; }
+                request = std::move(pending.front());
+                pending.pop_front();
+            }
+            runBlocking(std::move(request));
+        }
+    }
+
+    #ifdef __linux__
+    // Submission and completion rings of io_uring, mapped from the kernel
+    struct Ring {
+        int fd = -1;
+        void* sq_map = MAP_FAILED;
+        void* cq_map = MAP_FAILED;
+        size_t sq_map_size = 0U, cq_map_size = 0U;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqes_size = 0U;
+        unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+        unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        unsigned entries = 0U;
+
+        ~Ring() { teardown(); }
+
+        void teardown() {
+            if (sqes != MAP_FAILED) { munmap(sqes, sqes_size); }
+            if (cq_map != MAP_FAILED && cq_map != sq_map) { munmap(cq_map, cq_map_size); }
+            if (sq_map != MAP_FAILED) { munmap(sq_map, sq_map_size); }
+            if (fd >= 0) { close(fd); }
+            sqes    = static_cast<io_uring_sqe*>(MAP_FAILED);
+            sq_map  = cq_map = MAP_FAILED;
+            fd      = -1;
+        }
+
+        // Set up the ring and check that it supports every operation of the requests
+        bool setup(unsigned depth) {
+            io_uring_params params {};
+            fd = int(syscall(__NR_io_uring_setup, depth, &params));
+            if (fd < 0) { return false; }
+
+            std::vector<uint8_t> probe_storage(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op), 0U);
+            auto* probe = reinterpret_cast<io_uring_probe*>(probe_storage.data());
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) { return false; }
+            for (unsigned op : { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE }) {
+                if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) { return false; }
+            }
+
+            sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) { sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size); }
+            sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sq_map == MAP_FAILED) { return false; }
+            cq_map = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_map
+                                                                 : mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq_map == MAP_FAILED) { return false; }
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) { return false; }
+
+            auto* sq = static_cast<uint8_t*>(sq_map);
+            auto* cq = static_cast<uint8_t*>(cq_map);
+            sq_head     = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sq_tail     = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask     = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_array    = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cq_head     = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail     = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask     = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes        = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            entries     = params.sq_entries;
+            return true;
+        }
+
+        // Next free submission entry, cleared; only valid until submit() as the tail is published there
+        io_uring_sqe& prepare(unsigned queued) {
+            const unsigned tail = *sq_tail + queued;
+            const unsigned index = tail & *sq_mask;
+            sq_array[index] = index;
+            std::memset(&sqes[index], 0, sizeof(io_uring_sqe));
+            return sqes[index];
+        }
+
+        /**
+         * Publish the prepared entries and submit them in one system call, which returns once some operations completed
+         *
+         * @param queued Number of prepared entries
+         * @param completions Number of completions to wait for
+         *
+         * @return False if the ring failed
+        */
+        bool submit(unsigned queued, unsigned completions) {
+            std::atomic_ref<unsigned>(*sq_tail).store(*sq_tail + queued, std::memory_order_release);
+            while (queued > 0U || completions > 0U) {
+                const long submitted = syscall(__NR_io_uring_enter, fd, queued, completions, completions > 0U ? IORING_ENTER_GETEVENTS : 0U, nullptr, 0);
+                if (submitted < 0) {
+                    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) { continue; }
+                    return false;
+                }
+                queued -= unsigned(submitted);
+                completions = 0U;
+            }
+            return true;
+        }
+    };
+
+    // Queue the next operation of a request on the ring
+    void prepareOperation(Request& request, unsigned queued) {
+        io_uring_sqe& sqe = ring.prepare(queued);
+        sqe.user_data = reinterpret_cast<uint64_t>(&request);
+        switch (request.stage) {
+            case STAGE_OPEN:
+                sqe.opcode      = IORING_OP_OPENAT;
+                sqe.fd          = AT_FDCWD;
+                sqe.addr        = reinterpret_cast<uint64_t>(request.path_string.c_str());
+                sqe.open_flags  = request.write ? (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC);
+                sqe.len         = 0644;
+                break;
+            case STAGE_STAT:
+                sqe.opcode      = IORING_OP_STATX;
+                sqe.fd          = request.fd;
+                sqe.addr        = reinterpret_cast<uint64_t>("");
+                sqe.statx_flags = AT_EMPTY_PATH;
+                sqe.len         = STATX_SIZE;
+                sqe.off         = reinterpret_cast<uint64_t>(&request.file_status);
+                break;
+            case STAGE_TRANSFER:
+                sqe.opcode      = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+                sqe.fd          = request.fd;
+                sqe.addr        = reinterpret_cast<uint64_t>(request.bytes.data() + request.transferred);
+                sqe.len         = unsigned(std::min(request.bytes.size() - request.transferred, MAX_IO_CHUNK_BYTES));
+                sqe.off         = request.transferred;
+                break;
+            case STAGE_CLOSE:
+                sqe.opcode      = IORING_OP_CLOSE;
+                sqe.fd          = request.fd;
+                break;
+        }
+    }
+
+    /**
+     * Advance a request with the result of its last operation
+     *
+     * @return Whether the request needs another operation
+    */
+    bool advance(Request& request, int result) {
+        if (result < 0 && request.stage != STAGE_CLOSE) {
+            request.error = -result;
+            if (request.fd < 0) { return false; }
+            request.stage = STAGE_CLOSE;
+            return true;
+        }
+        switch (request.stage) {
+            case STAGE_OPEN:
+                request.fd      = result;
+                request.stage   = request.write ? STAGE_TRANSFER : STAGE_STAT;
+                break;
+            case STAGE_STAT:
+                request.bytes.resize(size_t(request.file_status.stx_size));
+                request.stage   = STAGE_TRANSFER;
+                break;
+            case STAGE_TRANSFER:
+                request.transferred += size_t(result);
+                if (result == 0 && !request.write) { request.bytes.resize(request.transferred); } // Shrunk since statx
+                else if (result == 0) { request.error = EIO; }
+                break;
+            case STAGE_CLOSE:
+                if (result < 0 && request.error == 0) { request.error = -result; }
+                request.fd = -1;
+                return false;
+        }
+        if (request.stage == STAGE_TRANSFER && (request.transferred >= request.bytes.size() || request.error != 0)) { request.stage = STAGE_CLOSE; }
+        return true;
+    }
+
+    // Submit the operations of new requests and the follow-up operations of earlier ones together, then wait until all of
+    // them completed, so that the requests move through their stages in batches. Every request has one operation in
+    // flight, so the ring never holds more entries than requests
+    void ringLoop() {
+        std::vector<std::unique_ptr<Request>> in_flight;
+        unsigned queued = 0U; // Follow-up operations prepared while reaping
+        for (;;) {
+            const size_t started = in_flight.size();
+            {
+                std::unique_lock lock(mutex);
+                if (in_flight.empty()) { wake.wait(lock, [this] { return !pending.empty() || stopping; }); }
+                if (in_flight.empty() && pending.empty()) { return; }
+                while (!pending.empty() && in_flight.size() < ring.entries) {
+                    in_flight.push_back(std::move(pending.front()));
+                    pending.pop_front();
+                }
+            }
+            for (size_t i = started; i < in_flight.size(); i++) {
+                Request& request = *in_flight[i];
+                request.path_string = request.path.string();
+                if (request.write) { createParentDirectories(request.path); }
+                prepareOperation(request, queued++);
+            }
+            {
+                std::lock_guard lock(mutex);
+                io_stats.submissions++;
+                io_stats.operations += queued;
+            }
+
+            const unsigned submitted_tail = *ring.sq_tail;
+            if (!ring.submit(queued, unsigned(in_flight.size()))) {
+                std::cerr << "io_uring failed: " << std::strerror(errno) << ", falling back to blocking I/O" << std::endl;
+                abandonRing(in_flight, submitted_tail, queued);
+                for (;;) {
+                    std::unique_ptr<Request> request;
+                    {
+                        std::unique_lock lock(mutex);
+                        wake.wait(lock, [this] { return !pending.empty() || stopping; });
+                        if (pending.empty()) { return; }
+                        request = std::move(pending.front());
+                        pending.pop_front();
+                    }
+                    runBlocking(std::move(request));
+                }
+            }
+
+            queued = 0U;
+            unsigned head = *ring.cq_head;
+            const unsigned tail = std::atomic_ref<unsigned>(*ring.cq_tail).load(std::memory_order_acquire);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = ring.cqes[head & *ring.cq_mask];
+                Request* request = reinterpret_cast<Request*>(cqe.user_data);
+                if (advance(*request, cqe.res)) {
+                    prepareOperation(*request, queued++);
+                    continue;
+                }
+                const auto owned = std::find_if(in_flight.begin(), in_flight.end(), [&](const std::unique_ptr<Request>& r) { return r.get() == request; });
+                std::unique_ptr<Request> finished = std::move(*owned);
+                *owned = std::move(in_flight.back());
+                in_flight.pop_back();
+                finish(std::move(finished));
+            }
+            std::atomic_ref<unsigned>(*ring.cq_head).store(head, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Hand the requests in flight on a failed ring over to blocking calls. The kernel may still complete the operations
+     * it consumed into their requests, so those are only reused once their completion arrived; a request whose operation
+     * never completes is left to the kernel (and leaked) and replaced by a copy
+     *
+     * @param in_flight Requests with one operation prepared in the failed submission
+     * @param submitted_tail Tail of the submission queue before that submission
+     * @param queued Number of operations of that submission
+    */
+    void abandonRing(std::vector<std::unique_ptr<Request>>& in_flight, unsigned submitted_tail, unsigned queued) {
+        std::set<const Request*> outstanding;
+        const unsigned consumed = std::atomic_ref<unsigned>(*ring.sq_head).load(std::memory_order_acquire) - submitted_tail;
+        for (unsigned i = 0U; i < std::min(consumed, queued); i++) {
+            outstanding.insert(reinterpret_cast<const Request*>(ring.sqes[(submitted_tail + i) & *ring.sq_mask].user_data));
+        }
+        const auto deadline = std::chrono::steady_clock::now() + RING_DRAIN_TIMEOUT;
+        unsigned head = *ring.cq_head;
+        while (!outstanding.empty() && std::chrono::steady_clock::now() < deadline) {
+            const unsigned tail = std::atomic_ref<unsigned>(*ring.cq_tail).load(std::memory_order_acquire);
+            if (head == tail) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = ring.cqes[head & *ring.cq_mask];
+                Request* request = reinterpret_cast<Request*>(cqe.user_data);
+                if (request->stage == STAGE_OPEN && cqe.res >= 0) { request->fd = cqe.res; } // Closed below
+                if (request->stage == STAGE_CLOSE) { request->fd = -1; }
+                outstanding.erase(request);
+            }
+        }
+        if (outstanding.empty()) { ring.teardown(); } // Otherwise the kernel may still write to the leaked requests
+
+        for (std::unique_ptr<Request>& request : in_flight) {
+            if (outstanding.contains(request.get())) {
+                auto copy = std::make_unique<Request>();
+                copy->path      = request->path;
+                copy->bytes     = request->write ? request->bytes : FileBytes();
+                copy->write     = request->write;
+                copy->promise   = std::move(request->promise);
+                request.release();
+                request = std::move(copy);
+            } else if (request->fd >= 0) {
+                close(request->fd);
+            }
+            if (!request->write) { request->bytes.clear(); }
+            request->error  = 0;
+            request->fd     = -1;
+            runBlocking(std::move(request));
+        }
+        in_flight.clear();
+    }
+
+    Ring ring;
+    #endif
+
+    IoBackend io_backend;
+    std::vector<std::thread> threads;
+
+    std::mutex directories_mutex;
+    std::set<std::filesystem::path> created_directories;
+
+    mutable std::mutex mutex; // Guards everything below
+    std::condition_variable wake, writes_done;
+    std::deque<std::unique_ptr<Request>> pending;
+    size_t pending_writes = 0U, failed_writes = 0U;
+    bool stopping = false;
+    IoStats io_stats;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "scale_server.hpp"
+
+// Thin client of a fin-proj server (fin-proj --serve), for build pipelines that would otherwise launch fin-proj per image
+
+static constexpr std::string_view SOCKET_ARGUMENT = "--socket=";
+static constexpr std::string_view REPEAT_ARGUMENT = "--repeat=";
+
+static void printUsage() {
+    std::cerr << "Usage: fin-proj-client [--socket=<path>] [--shm] [--repeat=<count>] <algorithm> <factor> <input> <output>\n"
+                 "       fin-proj-client [--socket=<path>] --stats|--shutdown" << std::endl;
+}
+
+static void printLatencies(const std::string& label, const LatencySummary& summary) {
+    std::cout << label << ": " << summary.requests << " requests, p50 " << summary.p50 << " us, p90 " << summary.p90 << " us, p99 "
+              << summary.p99 << " us, max " << summary.max << " us" << std::endl;
+}
+
+/**
+ * Run one scale job, passing the pixels through shared memory if requested
+ *
+ * @return The response of the server
+*/
+static std::vector<std::string> scale(ScaleClient& client, const std::string& algorithm, const std::string& factor, const std::string& input,
+                                      const std::string& output, const Image<glm::uvec3>* shared_input) {
+    if (!shared_input) { return client.request({ "SCALE", algorithm, factor, input, output }); }
+
+    // The input lives as long as the request; the server creates the output, which is unlinked as soon as it is mapped
+    static size_t job = 0U;
+    const std::string name = "/fin-proj-" + std::to_string(getpid()) + "-" + std::to_string(job++);
+    const SharedBuffer source(name + "-in", shared_input->data.size() * 3U, true);
+    if (!source.valid()) {
+        std::cerr << "Shared memory " << source.name << " could not be created: " << std::strerror(errno) << std::endl;
+        throw std::exception();
+    }
+    for (size_t i = 0; i < shared_input->data.size(); i++) { typeToRgbUint8(source.bytes + (i * 3U), shared_input->data[i]); }
+    const std::string sized_input = std::string(SHARED_MEMORY_PREFIX) + source.name + ":" + std::to_string(shared_input->width) + "x" +
+                                    std::to_string(shared_input->height);
+    std::vector<std::string> response = client.request({ "SCALE", algorithm, factor, sized_input, std::string(SHARED_MEMORY_PREFIX) + name + "-out" });
+    source.unlink();
+    if (response[0] != "OK" || response.size() != 4U) { return response; }
+
+    const int width = std::stoi(response[1]), height = std::stoi(response[2]);
+    const SharedBuffer result(name + "-out", size_t(width) * size_t(height) * 3U, false);
+    result.unlink();
+    if (!result.valid()) { return { "ERROR", "Shared memory output " + result.name + " could not be mapped" }; }
+    if (output != "-") {
+        Image<glm::uvec3> image(width, height);
+        for (size_t i = 0; i < image.data.size(); i++) { image.data[i] = stbToType<glm::uvec3>(result.bytes + (i * 3U)); }
+        image.writeToFile(output);
+    }
+    return response;
+}
+
+int main(int argc, char** argv) {
+    // --socket=<path>: socket of the server (DEFAULT_SERVER_SOCKET by default)
+    // --shm: decode the input here and exchange pixels with the server through shared memory (an output of - is discarded)
+    // --repeat=<count>: run the job that many times and report the round-trip latency percentiles
+    // --stats: print the latency percentiles measured by the server
+    // --shutdown: stop the server
+    std::filesystem::path socket_path = DEFAULT_SERVER_SOCKET;
+    bool shared = false, stats = false, shutdown_server = false;
+    size_t repeat = 1U;
+    std::vector<std::string> positional;
+    for (int arg = 1; arg < argc; arg++) {
+        const std::string argument = argv[arg];
+        if (argument.starts_with(SOCKET_ARGUMENT)) { socket_path = argument.substr(SOCKET_ARGUMENT.size()); }
+        else if (argument.starts_with(REPEAT_ARGUMENT)) { repeat = std::max<size_t>(std::stoull(argument.substr(REPEAT_ARGUMENT.size())), 1U); }
+        else if (argument == "--shm") { shared = true; }
+        else if (argument == "--stats") { stats = true; }
+        else if (argument == "--shutdown") { shutdown_server = true; }
+        else { positional.push_back(argument); }
+    }
+    if ((stats || shutdown_server) ? !positional.empty() : positional.size() != 4U) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        ScaleClient client(socket_path);
+        if (stats || shutdown_server) {
+            const std::vector<std::string> response = client.request({ stats ? "STATS" : "SHUTDOWN" });
+            if (response[0] != "OK") {
+                std::cerr << "Server error: " << response.back() << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (stats && response.size() == 6U) {
+                printLatencies("Server latency", { std::stoull(response[1]), std::stod(response[2]), std::stod(response[3]),
+                                                   std::stod(response[4]), std::stod(response[5]) });
+            }
+            return EXIT_SUCCESS;
+        }
+
+        const std::string &algorithm = positional[0], &factor = positional[1], &input = positional[2], &output = positional[3];
+        const std::optional<Image<glm::uvec3>> shared_input = shared ? std::optional(Image<glm::uvec3>(input)) : std::nullopt;
+        std::vector<double> latencies;
+        for (size_t job = 0U; job < repeat; job++) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<std::string> response = scale(client, algorithm, factor, input, output, shared_input ? &*shared_input : nullptr);
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            if (response[0] != "OK") {
+                std::cerr << "Server error: " << response.back() << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        if (repeat > 1U) { printLatencies("Round-trip latency", summariseLatencies(latencies, latencies.size())); }
+    } catch (const std::exception&) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -2,6 +2,13 @@
 #define COMMON_HPP
 
 #include <stdint.h>
+#include <stdlib.h>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
 
 /**
  * Compute if three or more of the given values are equal/identical
@@ -15,30 +22,10 @@
 */
 template<typename T>
 bool threeOrMoreIdentical(T a, T b, T c, T d) {
-    return ((a == b && b == c) ||
-            (a == b && b == d) ||
-            (a == c && c == b) ||
-            (a == c && c == d) ||
-            (a == d && d == b) ||
-            (a == d && d == c) ||
-            (b == a && a == c) ||
-            (b == a && a == d) ||
-            (b == c && c == a) ||
-            (b == c && c == d) ||
-            (b == d && d == a) ||
-            (b == d && d == c) ||
-            (c == a && a == b) ||
-            (c == a && a == d) ||
-            (c == b && b == a) ||
-            (c == b && b == d) ||
-            (c == d && d == a) ||
-            (c == d && d == b) ||
-            (d == a && a == b) ||
-            (d == a && a == c) ||
-            (d == b && b == a) ||
-            (d == b && b == c) ||
-            (d == c && c == a) ||
-            (d == c && c == b));
+    // A triple is identical as soon as two of its pairs are, so the 6 unique pairs cover all orderings
+    const bool ab = a == b, ac = a == c, ad = a == d, bc = b == c, bd = b == d, cd = c == d;
+    auto triple = [](bool ij, bool jk, bool ik) { return (ij && jk) || (ij && ik) || (jk && ik); };
+    return triple(ab, bc, ac) || triple(ab, bd, ad) || triple(ac, cd, ad) || triple(bc, cd, bd);
 }
 
 /**
@@ -79,4 +66,24 @@ static inline uint32_t rgbToYuv(uint32_t val) {
     return (y << 16) + (u << 8) + v;
 }
 
+constexpr uint8_t Y_THRESHOLD = 0x30;
+constexpr uint8_t U_THRESHOLD = 0x07;
+constexpr uint8_t V_THRESHOLD = 0x06;
+
+/**
+ * Compute if two pixels differ according to the hqx YUV channel difference thresholds
+ * 
+ * @param lhs First RGB pixel
+ * @param rhs Second RGB pixel
+ * 
+ * @return True if any of the YUV channel differences exceeds its threshold, false otherwise
+*/
+static inline bool yuvDifference(glm::uvec3 lhs, glm::uvec3 rhs) {
+    glm::ivec3 lhs_yuv = rgbToYuv(lhs);
+    glm::ivec3 rhs_yuv = rgbToYuv(rhs);
+    return (abs(lhs_yuv.x - rhs_yuv.x) > Y_THRESHOLD ||
+            abs(lhs_yuv.y - rhs_yuv.y) > U_THRESHOLD ||
+            abs(lhs_yuv.z - rhs_yuv.z) > V_THRESHOLD);
+}
+
 #endif
@@ -5,74 +5,73 @@
 #include <framework/image.h>
 
 #include "common.hpp"
+#include "kernel.hpp"
 
-template<typename T>
-Image<T> scaleEpx(const Image<T>& src) {
-    auto result = Image<T>(src.width * 2, src.height * 2);
+constexpr int EPX_HALO = 1; // Source rows/columns read around each pixel, shared by scaleEpx and scaleAdvMame
 
-    for (int y = 0; y < src.height; y++) {
-        for (int x = 0; x < src.width; x++) {
-            // Acquire neighbour pixel values
-            T A = src.safeAccess(x, y - 1);
-            T B = src.safeAccess(x + 1, y);
-            T C = src.safeAccess(x - 1, y);
-            T D = src.safeAccess(x, y + 1);
+template<typename T>
+struct EpxRule {
+    static constexpr int RADIUS = EPX_HALO;
+    static constexpr int FACTOR = 2;
 
-            // Initial expanded pixel value assignments
-            T original_pixel = src.safeAccess(x, y);
-            T one, two, three, four;
-            one = two = three = four = original_pixel;
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window) const {
+        // Acquire neighbour pixel values
+        T A = window(0, -1);
+        T B = window(1, 0);
+        T C = window(-1, 0);
+        T D = window(0, 1);
 
-            // Interpolation conditions
-            if (C == A) { one = A; }
-            if (A == B) { two = B; }
-            if (D == C) { three = C; }
-            if (B == D) { four = D; }
-            if (threeOrMoreIdentical(A, B, C, D)) { one = two = three = four = original_pixel; }
+        // Initial expanded pixel value assignments
+        T original_pixel = window(0, 0);
+        T one, two, three, four;
+        one = two = three = four = original_pixel;
 
-            int dst_x = 2 * x;
-            int dst_y = 2 * y;
-            result.data[result.getImageOffset(dst_x, dst_y)]            = one;
-            result.data[result.getImageOffset(dst_x + 1, dst_y)]        = two;
-            result.data[result.getImageOffset(dst_x, dst_y + 1)]        = three;
-            result.data[result.getImageOffset(dst_x + 1, dst_y + 1)]    = four;
-        }
+        // Interpolation conditions
+        if (C == A) { one = A; }
+        if (A == B) { two = B; }
+        if (D == C) { three = C; }
+        if (B == D) { four = D; }
+        if (threeOrMoreIdentical(A, B, C, D)) { one = two = three = four = original_pixel; }
+        return { one, two, three, four };
     }
-    return result;
-}
+};
 
 template<typename T>
-Image<T> scaleAdvMame(const Image<T>& src) {
-    auto result = Image<T>(src.width * 2, src.height * 2);
-
-    for (int y = 0; y < src.height; y++) {
-        for (int x = 0; x < src.width; x++) {
-            // Acquire neighbour pixel values
-            T A = src.safeAccess(x, y - 1);
-            T B = src.safeAccess(x + 1, y);
-            T C = src.safeAccess(x - 1, y);
-            T D = src.safeAccess(x, y + 1);
+struct AdvMameRule {
+    static constexpr int RADIUS = EPX_HALO;
+    static constexpr int FACTOR = 2;
 
-            // Initial expanded pixel value assignments
-            T original_pixel = src.safeAccess(x, y);
-            T one, two, three, four;
-            one = two = three = four = original_pixel;
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window) const {
+        // Acquire neighbour pixel values
+        T A = window(0, -1);
+        T B = window(1, 0);
+        T C = window(-1, 0);
+        T D = window(0, 1);
 
-            // Interpolation conditions
-            if (C == A && C != D && A != B) { one = A; }
-            if (A == B && A != C && B != D) { two = B; }
-            if (D == C && D != B && C != A) { three = C; }
-            if (B == D && B != A && D != C) { four = D; }
+        // Initial expanded pixel value assignments
+        T original_pixel = window(0, 0);
+        T one, two, three, four;
+        one = two = three = four = original_pixel;
 
-            int dst_x = 2 * x;
-            int dst_y = 2 * y;
-            result.data[result.getImageOffset(dst_x, dst_y)]            = one;
-            result.data[result.getImageOffset(dst_x + 1, dst_y)]        = two;
-            result.data[result.getImageOffset(dst_x, dst_y + 1)]        = three;
-            result.data[result.getImageOffset(dst_x + 1, dst_y + 1)]    = four;
-        }
+        // Interpolation conditions
+        if (C == A && C != D && A != B) { one = A; }
+        if (A == B && A != C && B != D) { two = B; }
+        if (D == C && D != B && C != A) { three = C; }
+        if (B == D && B != A && D != C) { four = D; }
+        return { one, two, three, four };
     }
-    return result;
+};
+
+template<typename T>
+Image<T> scaleEpx(const Image<T>& src) {
+    return applyKernel<EpxRule<T>, NEAREST>(src);
+}
+
+template<typename T>
+Image<T> scaleAdvMame(const Image<T>& src) {
+    return applyKernel<AdvMameRule<T>, NEAREST>(src);
 }
 
 #endif
@@ -0,0 +1,374 @@
+#ifndef EQUALITY_MASK_HPP
+#define EQUALITY_MASK_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "2xsai.hpp"
+#include "common.hpp"
+#include "kernel.hpp"
+
+// Shared equality pre-stage for the rules that only compare pixels for equality (EPX, AdvMAME, Eagle and 2xSaI).
+// Every pixel stores one bit per 'forward' relation, i.e. whether it equals the neighbour at each offset below. Each
+// unordered pair of pixels is thus compared exactly once, and the bits are shared by all pixels whose neighbourhood
+// contains that pair. Rules then test bits (or index lookup tables) instead of comparing colours
+
+constexpr int EQUALITY_PADDING = 2; // Border replicated around the source, matching the NEAREST policy of the rules
+
+constexpr std::array<glm::ivec2, 10> EQUALITY_RELATION_OFFSETS = {
+    glm::ivec2(1, 0), glm::ivec2(2, 0),
+    glm::ivec2(-2, 1), glm::ivec2(-1, 1), glm::ivec2(0, 1), glm::ivec2(1, 1), glm::ivec2(2, 1),
+    glm::ivec2(-1, 2), glm::ivec2(0, 2), glm::ivec2(1, 2) };
+
+/**
+ * Find the relation bit of an offset
+ *
+ * @param dx Horizontal offset of the forward relation
+ * @param dy Vertical offset of the forward relation
+ *
+ * @return The bit of the relation, or 0 if no such relation is stored
+*/
+constexpr uint16_t equalityRelationBit(int dx, int dy) {
+    for (size_t relation = 0; relation < EQUALITY_RELATION_OFFSETS.size(); relation++) {
+        if (EQUALITY_RELATION_OFFSETS[relation].x == dx && EQUALITY_RELATION_OFFSETS[relation].y == dy) { return uint16_t(1U << relation); }
+    }
+    return 0U;
+}
+
+// Equality relations as seen from a single source pixel
+class EqualityView {
+public:
+    EqualityView(const uint16_t* centre, int stride) : centre(centre), stride(stride) {}
+
+    /**
+     * Test whether the pixels at two offsets from the centre are equal. The stored relation answering this is resolved
+     * at compile time
+     *
+     * @return True if the pixels at (X0, Y0) and (X1, Y1) are equal
+    */
+    template<int X0, int Y0, int X1, int Y1>
+    bool equal() const {
+        constexpr bool forward  = (Y1 > Y0) || (Y1 == Y0 && X1 > X0);
+        constexpr int owner_x   = forward ? X0 : X1;
+        constexpr int owner_y   = forward ? Y0 : Y1;
+        constexpr uint16_t bit  = equalityRelationBit(forward ? X1 - X0 : X0 - X1, forward ? Y1 - Y0 : Y0 - Y1);
+        static_assert(bit != 0U, "Offset pair is not covered by the stored equality relations");
+        static_assert(owner_x >= -EQUALITY_PADDING && owner_y >= -EQUALITY_PADDING, "Offset pair reaches outside of the padding");
+        return (centre[(owner_y * stride) + owner_x] & bit) != 0U;
+    }
+
+private:
+    const uint16_t* centre;
+    int stride;
+};
+
+/**
+ * Compare two pixels without short-circuiting between components, which lets the relation loops vectorise
+*/
+template<typename T>
+inline bool pixelsEqual(const T& a, const T& b) {
+    if constexpr (std::is_same_v<T, glm::uvec3> || std::is_same_v<T, glm::vec3>) { return bool((a.x == b.x) & (a.y == b.y) & (a.z == b.z)); }
+    else { return a == b; }
+}
+
+/**
+ * Compute the relation bits of every pixel
+ *
+ * @tparam Relations Bits of the relations to compute
+ * @param pixels Pixels (or exact keys of them) of the padded image
+ * @param width Width of the padded image
+ * @param height Height of the padded image
+ * @param relations Zero-initialised output bits of every pixel
+*/
+template<uint16_t Relations, typename P>
+void computeEqualityRelations(const P* pixels, int width, int height, uint16_t* relations) {
+    // Rows are processed one relation at a time so that the inner loop vectorises, while the (at most three) rows
+    // involved stay in cache
+    for (int y = 0; y < height; y++) {
+        const P* row    = &pixels[size_t(y) * size_t(width)];
+        uint16_t* bits  = &relations[size_t(y) * size_t(width)];
+        for (size_t relation = 0; relation < EQUALITY_RELATION_OFFSETS.size(); relation++) {
+            const glm::ivec2 offset = EQUALITY_RELATION_OFFSETS[relation];
+            if ((Relations & (1U << relation)) == 0U || y + offset.y >= height) { continue; }
+            const P* other_row  = &pixels[size_t(y + offset.y) * size_t(width)] + offset.x;
+            const int x_begin   = std::max(0, -offset.x), x_end = std::min(width, width - offset.x);
+            for (int x = x_begin; x < x_end; x++) { bits[x] |= uint16_t(uint16_t(pixelsEqual(row[x], other_row[x])) << relation); }
+        }
+    }
+}
+
+/**
+ * Copy an image (or a per-pixel key of it) with EQUALITY_PADDING replicated border pixels on every side, so that all
+ * relations can be computed unconditionally
+*/
+template<typename T, typename KeyFunction>
+auto padEqualityPlane(const Image<T>& src, KeyFunction key) {
+    using Key = decltype(key(src.data[0]));
+    const int padded_width = src.width + (2 * EQUALITY_PADDING), padded_height = src.height + (2 * EQUALITY_PADDING);
+    std::vector<Key> padded(size_t(padded_width) * size_t(padded_height));
+    for (int y = 0; y < padded_height; y++) {
+        const T* src_row    = &src.data[src.getImageOffset(0, std::clamp(y - EQUALITY_PADDING, 0, src.height - 1))];
+        Key* padded_row     = &padded[size_t(y) * size_t(padded_width)];
+        for (int x = 0; x < padded_width; x++) { padded_row[x] = key(src_row[std::clamp(x - EQUALITY_PADDING, 0, src.width - 1)]); }
+    }
+    return padded;
+}
+
+template<typename Rule, bool Interior, typename T>
+inline void applyEqualityRuleAt(const Rule& rule, const Image<T>& src, Image<T>& result, const uint16_t* relation_row, int stride, int x, int y) {
+    constexpr int factor = Rule::FACTOR;
+    const KernelBlock<T, factor> block = rule(KernelWindow<T, NEAREST, Interior>(src, x, y), EqualityView(relation_row + x, stride));
+    T* dst = &result.data[result.getImageOffset(factor * x, factor * y)];
+    for (int block_y = 0; block_y < factor; block_y++) {
+        for (int block_x = 0; block_x < factor; block_x++) { dst[(block_y * result.width) + block_x] = block[(block_y * factor) + block_x]; }
+    }
+}
+
+/**
+ * Scale an image with a rule driven by the equality relations of its neighbourhood. The rule is called as
+ * rule(window, equality) and returns a KernelBlock, like the rules of applyKernel. Besides RADIUS and FACTOR it
+ * declares the relation bits it tests in RELATIONS
+ *
+ * @param src Source image
+ * @param rule Rule functor with a RADIUS of at most EQUALITY_PADDING
+ *
+ * @return Image scaled by Rule::FACTOR
+*/
+template<typename Rule, typename T>
+Image<T> applyEqualityRule(const Image<T>& src, const Rule& rule = {}) {
+    static_assert(Rule::RADIUS <= EQUALITY_PADDING, "Rule reads beyond the padding of the equality planes");
+    constexpr int factor = Rule::FACTOR;
+
+    const int padded_width = src.width + (2 * EQUALITY_PADDING), padded_height = src.height + (2 * EQUALITY_PADDING);
+    std::vector<uint16_t> relations(size_t(padded_width) * size_t(padded_height), 0U);
+    bool packed = false;
+    if constexpr (std::is_same_v<T, glm::uvec3>) {
+        // 8-bit colours (the common case) are compared as exact 32-bit keys, which is much cheaper than 3 components
+        glm::uvec3 channel_bits(0U);
+        for (const glm::uvec3& pixel : src.data) { channel_bits |= pixel; }
+        if (glm::all(glm::lessThan(channel_bits, glm::uvec3(256U)))) {
+            std::vector<uint32_t> keys = padEqualityPlane(src, [](const glm::uvec3& pixel) { return pixel.r | (pixel.g << 8U) | (pixel.b << 16U); });
+            computeEqualityRelations<Rule::RELATIONS>(keys.data(), padded_width, padded_height, relations.data());
+            packed = true;
+        }
+    }
+    if (!packed) {
+        std::vector<T> pixels = padEqualityPlane(src, [](const T& pixel) { return pixel; });
+        computeEqualityRelations<Rule::RELATIONS>(pixels.data(), padded_width, padded_height, relations.data());
+    }
+
+    auto result = Image<T>(src.width * factor, src.height * factor);
+    const int interior_begin = std::min(Rule::RADIUS, src.width);
+    const int interior_end   = std::max(interior_begin, src.width - Rule::RADIUS);
+    for (int y = 0; y < src.height; y++) {
+        const uint16_t* relation_row = &relations[(size_t(y + EQUALITY_PADDING) * size_t(padded_width)) + EQUALITY_PADDING];
+        if (y < Rule::RADIUS || y >= src.height - Rule::RADIUS) {
+            for (int x = 0; x < src.width; x++) { applyEqualityRuleAt<Rule, false>(rule, src, result, relation_row, padded_width, x, y); }
+            continue;
+        }
+        for (int x = 0; x < interior_begin; x++)            { applyEqualityRuleAt<Rule, false>(rule, src, result, relation_row, padded_width, x, y); }
+        for (int x = interior_begin; x < interior_end; x++) { applyEqualityRuleAt<Rule, true>(rule, src, result, relation_row, padded_width, x, y); }
+        for (int x = interior_end; x < src.width; x++)      { applyEqualityRuleAt<Rule, false>(rule, src, result, relation_row, padded_width, x, y); }
+    }
+    return result;
+}
+
+// Sources of the 2x2 block of the EPX family, A/B/C/D being the top/right/left/bottom neighbours
+enum EpxSource : uint8_t { EPX_CENTRE, EPX_A, EPX_B, EPX_C, EPX_D };
+using EpxTable = std::array<std::array<uint8_t, 4>, 64>;
+
+/**
+ * Tabulate the EPX or AdvMAME2x rules over the 6 pairwise equalities of A, B, C and D. Mask bits are (from the least
+ * significant one) C==A, A==B, D==C, B==D, A==D and B==C
+ *
+ * @param adv_mame True for the AdvMAME2x rules, false for the EPX rules
+ *
+ * @return Source of each pixel of the 2x2 block for every mask
+*/
+constexpr EpxTable buildEpxTable(bool adv_mame) {
+    EpxTable table {};
+    for (uint32_t mask = 0U; mask < 64U; mask++) {
+        const bool CA = mask & 1U, AB = mask & 2U, DC = mask & 4U, BD = mask & 8U, AD = mask & 16U, BC = mask & 32U;
+        std::array<uint8_t, 4> block = { EPX_CENTRE, EPX_CENTRE, EPX_CENTRE, EPX_CENTRE };
+        if (adv_mame) {
+            if (CA && !DC && !AB) { block[0] = EPX_A; }
+            if (AB && !CA && !BD) { block[1] = EPX_B; }
+            if (DC && !BD && !CA) { block[2] = EPX_C; }
+            if (BD && !AB && !DC) { block[3] = EPX_D; }
+        } else {
+            // Any triple is identical as soon as two of its three pairs are
+            auto triple = [](bool ij, bool jk, bool ik) { return (ij && jk) || (ij && ik) || (ik && jk); };
+            const bool three_or_more = triple(AB, BC, CA) || triple(AB, BD, AD) || triple(CA, DC, AD) || triple(BC, DC, BD);
+            if (!three_or_more) {
+                if (CA) { block[0] = EPX_A; }
+                if (AB) { block[1] = EPX_B; }
+                if (DC) { block[2] = EPX_C; }
+                if (BD) { block[3] = EPX_D; }
+            }
+        }
+        table[mask] = block;
+    }
+    return table;
+}
+
+constexpr EpxTable EPX_TABLE        = buildEpxTable(false);
+constexpr EpxTable ADV_MAME_TABLE   = buildEpxTable(true);
+
+template<typename T, const EpxTable& Table>
+struct EpxEqualityRule {
+    static constexpr int RADIUS = 1;
+    static constexpr int FACTOR = 2;
+    static constexpr uint16_t RELATIONS = equalityRelationBit(2, 0) | equalityRelationBit(-1, 1) | equalityRelationBit(1, 1) | equalityRelationBit(0, 2);
+
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window, const EqualityView& equality) const {
+        const uint32_t mask =
+            uint32_t(equality.equal<-1, 0, 0, -1>())        | (uint32_t(equality.equal<0, -1, 1, 0>()) << 1U) |
+            (uint32_t(equality.equal<0, 1, -1, 0>()) << 2U) | (uint32_t(equality.equal<1, 0, 0, 1>()) << 3U) |
+            (uint32_t(equality.equal<0, -1, 0, 1>()) << 4U) | (uint32_t(equality.equal<1, 0, -1, 0>()) << 5U);
+        const std::array<T, 5> sources = { window(0, 0), window(0, -1), window(1, 0), window(-1, 0), window(0, 1) };
+        const std::array<uint8_t, 4>& block = Table[mask];
+        return { sources[block[0]], sources[block[1]], sources[block[2]], sources[block[3]] };
+    }
+};
+
+template<typename T>
+struct EagleEqualityRule {
+    static constexpr int RADIUS = 1;
+    static constexpr int FACTOR = 2;
+    static constexpr uint16_t RELATIONS = equalityRelationBit(1, 0) | equalityRelationBit(0, 1);
+
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window, const EqualityView& equality) const {
+        const T original_pixel = window(0, 0);
+        const bool top_left     = equality.equal<-1, -1, 0, -1>() && equality.equal<0, -1, 1, -1>();
+        const bool top_right    = equality.equal<0, -1, 1, -1>() && equality.equal<1, -1, 1, 0>();
+        const bool bottom_left  = equality.equal<-1, 0, -1, 1>() && equality.equal<-1, 1, 0, 1>();
+        const bool bottom_right = equality.equal<1, 0, 1, 1>() && equality.equal<1, 1, 0, 1>();
+        return { top_left ? window(-1, -1) : original_pixel, top_right ? window(1, -1) : original_pixel,
+                 bottom_left ? window(-1, 1) : original_pixel, bottom_right ? window(1, 1) : original_pixel };
+    }
+};
+
+/**
+ * Equivalent of majorityMatch in terms of the equalities it tests
+ *
+ * @return 0 if no majority match on A or B; 1 if majority match ONLY on A; -1 if majority match ONLY on B
+*/
+inline int8_t majorityMatchBits(bool AC, bool BC, bool AD, bool BD) {
+    const int8_t x = int8_t(AC) + int8_t(AD);
+    const int8_t y = int8_t(!AC && BC) + int8_t(!AD && BD);
+    return int8_t((y <= 1) - (x <= 1));
+}
+
+template<typename T>
+struct SaiEqualityRule {
+    static constexpr int RADIUS = SAI_HALO;
+    static constexpr int FACTOR = 2;
+    static constexpr uint16_t RELATIONS = 0x3ffU; // All of them
+
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window, const EqualityView& eq) const {
+        // Same pixel naming as scale2xSaI: A (0, 0), B (1, 0), C (0, 1), D (1, 1), E/F above, G/H left, I top-left,
+        // J top-right, K/L right, M/N/O below
+        const T A = window(0, 0), B = window(1, 0), C = window(0, 1), D = window(1, 1);
+
+        // Equalities are only looked up on the branches that need them, like the short-circuiting reference
+        const bool AD = eq.equal<0, 0, 1, 1>(), BC = eq.equal<1, 0, 0, 1>();
+        auto AB = [&] { return eq.equal<0, 0, 1, 0>(); };
+        auto AC = [&] { return eq.equal<0, 0, 0, 1>(); };
+        auto BD = [&] { return eq.equal<1, 0, 1, 1>(); };
+        auto CD = [&] { return eq.equal<0, 1, 1, 1>(); };
+        auto AE = [&] { return eq.equal<0, 0, 0, -1>(); };
+        auto AF = [&] { return eq.equal<0, 0, 1, -1>(); };
+        auto AG = [&] { return eq.equal<0, 0, -1, 0>(); };
+        auto AH = [&] { return eq.equal<0, 0, -1, 1>(); };
+        auto AI = [&] { return eq.equal<0, 0, -1, -1>(); };
+        auto BE = [&] { return eq.equal<1, 0, 0, -1>(); };
+        auto BF = [&] { return eq.equal<1, 0, 1, -1>(); };
+        auto BJ = [&] { return eq.equal<1, 0, 2, -1>(); };
+        auto BL = [&] { return eq.equal<1, 0, 2, 1>(); };
+        auto CG = [&] { return eq.equal<0, 1, -1, 0>(); };
+        auto CH = [&] { return eq.equal<0, 1, -1, 1>(); };
+        auto CM = [&] { return eq.equal<0, 1, -1, 2>(); };
+
+        T right_interp, bottom_interp, bottom_right_interp;
+        if (AD && !BC) {
+            if ((AE() && BL()) || (AC() && AF() && !BE() && BJ())) { right_interp = A; }
+            else { right_interp = glm::mix(A, B, 0.50f); }
+
+            bottom_interp = A; // Both branches of the reference pick A
+
+            bottom_right_interp = A;
+        } else if (!AD && BC) {
+            if ((BF() && AH()) || (BE() && BD() && !AF() && AI())) { right_interp = B; }
+            else { right_interp = glm::mix(A, B, 0.5f); }
+
+            if ((CH() && AF()) || (CG() && CD() && !AH() && AI())) { bottom_interp = C; }
+            else { bottom_interp = glm::mix(A, C, 0.5f); }
+
+            bottom_right_interp = B;
+        } else if (AD && BC) {
+            if (AB()) { right_interp = bottom_interp = bottom_right_interp = A; }
+            else {
+                right_interp = glm::mix(A, B, 0.5f);
+
+                bottom_interp = glm::mix(A, C, 0.5f);
+
+                int8_t majority_accumulator = 0;
+                majority_accumulator += majorityMatchBits(eq.equal<1, 0, -1, 0>(), AG(), BE(), AE());
+                majority_accumulator += majorityMatchBits(eq.equal<1, 0, 2, 0>(), eq.equal<0, 0, 2, 0>(), BF(), AF());
+                majority_accumulator += majorityMatchBits(eq.equal<1, 0, -1, 1>(), AH(), eq.equal<1, 0, 0, 2>(), eq.equal<0, 0, 0, 2>());
+                majority_accumulator += majorityMatchBits(BL(), eq.equal<0, 0, 2, 1>(), eq.equal<1, 0, 1, 2>(), eq.equal<0, 0, 1, 2>());
+                if (majority_accumulator > 0) { bottom_right_interp = A; }
+                else if (majority_accumulator < 0) { bottom_right_interp = B; }
+                else { bottom_right_interp = bilinearInterpolation(A, B, C, D, 0.5f, 0.5f); }
+            }
+        } else {
+            bottom_right_interp = bilinearInterpolation(A, B, C, D, 0.5f, 0.5f);
+
+            if (AC() && AF() && !BE() && BJ()) { right_interp = A; }
+            else if (BE() && BD() && !AF() && AI()) { right_interp = B; }
+            else { right_interp = glm::mix(A, B, 0.5f); }
+
+            if (AB() && AH() && !CG() && CM()) { bottom_interp = A; }
+            else if (CG() && CD() && !AH() && AI()) { bottom_interp = C; }
+            else { bottom_interp = glm::mix(A, C, 0.5f); }
+        }
+        return { A, right_interp, bottom_interp, bottom_right_interp };
+    }
+};
+
+template<typename T>
+Image<T> scaleEpxEquality(const Image<T>& src) {
+    return applyEqualityRule<EpxEqualityRule<T, EPX_TABLE>>(src);
+}
+
+template<typename T>
+Image<T> scaleAdvMameEquality(const Image<T>& src) {
+    return applyEqualityRule<EpxEqualityRule<T, ADV_MAME_TABLE>>(src);
+}
+
+template<typename T>
+Image<T> scaleEagleEquality(const Image<T>& src) {
+    return applyEqualityRule<EagleEqualityRule<T>>(src);
+}
+
+template<typename T>
+Image<T> scale2xSaIEquality(const Image<T>& src) {
+    return applyEqualityRule<SaiEqualityRule<T>>(src);
+}
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef FUSED_CHAIN_HPP
+#define FUSED_CHAIN_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "streaming.hpp"
+
+// Depth-fused execution of a chain of 2x passes of the same scaler. The output of the last pass is split into tiles and
+// every tile runs through all passes on its own, starting from the smallest source region it depends on (the tile grown
+// by the halo of every pass on the way back to the source). Intermediate tiles are small enough to stay in cache, and
+// only the factors that are asked for are ever written at full size
+
+constexpr int DEFAULT_FUSED_TILE_SIZE = 128; // Side of the tiles of the last pass, in output pixels
+
+// Half-open rectangle of pixels [begin, end)
+struct PixelRect {
+    glm::ivec2 begin, end;
+
+    int width() const { return end.x - begin.x; }
+    int height() const { return end.y - begin.y; }
+};
+
+/**
+ * Rectangle of source pixels a 2x pass reads to produce a rectangle of its output
+ *
+ * @param output Rectangle of output pixels
+ * @param halo Number of source rows/columns read around each pixel by the scaler
+ * @param src_size Size of the source image, to which the rectangle is clipped
+ *
+ * @return Rectangle of source pixels
+*/
+inline PixelRect sourceRect(const PixelRect& output, int halo, const glm::ivec2& src_size) {
+    const glm::ivec2 begin = glm::max((output.begin / 2) - halo, glm::ivec2(0));
+    const glm::ivec2 end   = glm::min(((output.end + 1) / 2) + halo, src_size);
+    return { begin, end };
+}
+
+/**
+ * Copy a rectangle of an image, given in the coordinates of a larger image of which the image covers a rectangle
+ *
+ * @param image Image to copy from
+ * @param image_origin Position of the image within the larger image
+ * @param rect Rectangle to copy, which must lie within the image
+ * @param destination Image receiving the copy
+ * @param destination_origin Position of the destination image within the larger image
+*/
+template<typename T>
+void copyRect(const Image<T>& image, const glm::ivec2& image_origin, const PixelRect& rect, Image<T>& destination,
+              const glm::ivec2& destination_origin) {
+    for (int y = rect.begin.y; y < rect.end.y; y++) {
+        const T* row = &image.data[image.getImageOffset(rect.begin.x - image_origin.x, y - image_origin.y)];
+        std::copy_n(row, rect.width(), &destination.data[destination.getImageOffset(rect.begin.x - destination_origin.x, y - destination_origin.y)]);
+    }
+}
+
+/**
+ * Scale an image by a chain of 2x passes of the same scaler one output tile at a time. Produces exactly the images of
+ * the unfused chain, as every intermediate pixel a tile depends on is computed from the same source pixels
+ *
+ * @param src Source image
+ * @param scale 2x scaler, which must only read source pixels within halo of the pixel being scaled
+ * @param halo Number of source rows/columns read around each pixel by the scaler
+ * @param emit Whether to return the output of every pass (i.e. 2x, 4x, ...); the chain ends at the last emitted pass
+ * @param tile_size Side of the output tiles of the last pass, rounded up to a multiple of the total factor
+ *
+ * @return Outputs of the emitted passes, in order
+*/
+template<typename T>
+std::vector<Image<T>> scaleChainFused(const Image<T>& src, ScaleFunction<T> scale, int halo, const std::vector<bool>& emit,
+                                      int tile_size = DEFAULT_FUSED_TILE_SIZE) {
+    // Passes after the last emitted one would be wasted
+    const int passes = int(emit.rend() - std::find(emit.rbegin(), emit.rend(), true));
+    std::vector<glm::ivec2> sizes = { glm::ivec2(src.width, src.height) };
+    for (int pass = 1; pass <= passes; pass++) { sizes.push_back(sizes.back() * 2); }
+
+    std::vector<Image<T>> outputs;
+    std::vector<Image<T>*> emitted(size_t(passes) + 1U, nullptr);
+    outputs.reserve(size_t(std::count(emit.begin(), emit.end(), true)));
+    for (int pass = 1; pass <= passes; pass++) {
+        if (!emit[size_t(pass - 1)]) { continue; }
+        outputs.emplace_back(sizes[size_t(pass)].x, sizes[size_t(pass)].y);
+        emitted[size_t(pass)] = &outputs.back();
+    }
+
+    // Tiles are laid out on the source so that they partition every intermediate factor, not only the last one
+    const int source_tile = std::max(1, (tile_size + (1 << passes) - 1) >> passes);
+    std::vector<PixelRect> needed(size_t(passes) + 1U);
+    for (int tile_y = 0; tile_y < src.height; tile_y += source_tile) {
+        for (int tile_x = 0; tile_x < src.width; tile_x += source_tile) {
+            const PixelRect tile = { glm::ivec2(tile_x, tile_y), glm::min(glm::ivec2(tile_x, tile_y) + source_tile, sizes[0]) };
+
+            // Walk back from the tile of the last pass to the source region it depends on
+            needed[size_t(passes)] = { tile.begin << passes, tile.end << passes };
+            for (int pass = passes; pass > 0; pass--) { needed[size_t(pass - 1)] = sourceRect(needed[size_t(pass)], halo, sizes[size_t(pass - 1)]); }
+
+            Image<T> level(needed[0].width(), needed[0].height());
+            copyRect(src, glm::ivec2(0), needed[0], level, needed[0].begin);
+            for (int pass = 1; pass <= passes; pass++) {
+                // Pixels near the borders of the scaled region read clamped pixels of the region instead of those of the
+                // full image; they lie outside of the needed rectangle, which is all that is kept
+                const Image<T> scaled = scale(level);
+                const glm::ivec2 scaled_origin = needed[size_t(pass - 1)].begin * 2;
+                if (emitted[size_t(pass)]) {
+                    const PixelRect core = { tile.begin << pass, tile.end << pass };
+                    copyRect(scaled, scaled_origin, core, *emitted[size_t(pass)], glm::ivec2(0));
+                }
+                if (pass < passes) {
+                    level = Image<T>(needed[size_t(pass)].width(), needed[size_t(pass)].height());
+                    copyRect(scaled, scaled_origin, needed[size_t(pass)], level, needed[size_t(pass)].begin);
+                }
+            }
+        }
+    }
+    return outputs;
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef HYBRID_HPP
+#define HYBRID_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "common.hpp"
+#include "fused_chain.hpp"
+#include "scaler_registry.hpp"
+
+// Hybrid 2x scaler. The source is split into tiles that are classified from cheap statistics (palette size,
+// axis-aligned and diagonal edges, smooth steps) and every class is scaled by its own algorithm, so that the expensive ones
+// only run where the content needs them. Horizontal runs of tiles with the same algorithm are scaled together from the
+// source region they depend on (plus the halo of the algorithm), which yields exactly the pixels of that algorithm on
+// the whole image. Where tiles of different algorithms meet, both outputs are blended over a band on each side of the
+// border, with weights that only depend on the distance to the border, so seams look the same from both sides
+
+constexpr int HYBRID_TILE_SIZE         = 16;  // Side of the classified tiles, in source pixels
+constexpr int HYBRID_BLEND_WIDTH       = 2;   // Output pixels blended on each side of a border between algorithms
+constexpr uint32_t HYBRID_PALETTE_LIMIT = 8U; // Palettes larger than this may be gradients
+
+enum TileClass : uint8_t { TILE_FLAT, TILE_AXIS_ALIGNED, TILE_DIAGONAL, TILE_GRADIENT, TILE_CLASS_COUNT };
+
+constexpr std::array<std::string_view, TILE_CLASS_COUNT> TILE_CLASS_NAMES = { "flat", "axis-aligned", "diagonal", "gradient" };
+
+struct TileStatistics {
+    uint32_t palette_size = 0U;     // Counted up to HYBRID_PALETTE_LIMIT + 1
+    uint32_t sharp_steps = 0U;      // Horizontal or vertical neighbours that differ noticeably (see yuvDifference)
+    uint32_t smooth_steps = 0U;     // Horizontal or vertical neighbours that differ, but only slightly
+    uint32_t diagonal_blocks = 0U;  // 2x2 blocks whose only equal pair is a diagonal one (thin diagonal lines)
+    uint32_t corner_blocks = 0U;    // 2x2 blocks of three equal pixels and another one, one or two per step of a staircase
+};
+
+/**
+ * Gather the statistics of a tile; steps and blocks crossing its right and bottom borders are included
+ *
+ * @param src Source image
+ * @param tile Rectangle of the tile
+*/
+inline TileStatistics tileStatistics(const Image<glm::uvec3>& src, const PixelRect& tile) {
+    TileStatistics statistics;
+    std::array<glm::uvec3, HYBRID_PALETTE_LIMIT + 1U> palette;
+    for (int y = tile.begin.y; y < tile.end.y; y++) {
+        for (int x = tile.begin.x; x < tile.end.x; x++) {
+            const glm::uvec3 pixel = src.data[src.getImageOffset(x, y)];
+            if (statistics.palette_size <= HYBRID_PALETTE_LIMIT &&
+                std::find(palette.begin(), palette.begin() + statistics.palette_size, pixel) == palette.begin() + statistics.palette_size) {
+                palette[statistics.palette_size++] = pixel;
+            }
+            const bool has_right = x + 1 < src.width, has_below = y + 1 < src.height;
+            const glm::uvec3 right = has_right ? src.data[src.getImageOffset(x + 1, y)] : pixel;
+            const glm::uvec3 below = has_below ? src.data[src.getImageOffset(x, y + 1)] : pixel;
+            for (const glm::uvec3& neighbour : { right, below }) {
+                if (neighbour == pixel) { continue; }
+                if (yuvDifference(pixel, neighbour)) { statistics.sharp_steps++; }
+                else { statistics.smooth_steps++; }
+            }
+            if (has_right && has_below) {
+                const glm::uvec3 below_right = src.data[src.getImageOffset(x + 1, y + 1)];
+                if ((pixel == below_right && pixel != right && pixel != below) || (right == below && right != pixel && right != below_right)) {
+                    statistics.diagonal_blocks++;
+                }
+                const int equal_pairs = int(pixel == right) + int(pixel == below) + int(pixel == below_right) + int(right == below) +
+                                        int(right == below_right) + int(below == below_right);
+                if (equal_pairs == 3) { statistics.corner_blocks++; } // Only three equal pixels make three equal pairs
+            }
+        }
+    }
+    return statistics;
+}
+
+inline TileClass classifyTile(const TileStatistics& statistics) {
+    if (statistics.palette_size <= 1U) { return TILE_FLAT; }
+    if (statistics.palette_size > HYBRID_PALETTE_LIMIT && statistics.smooth_steps > statistics.sharp_steps) { return TILE_GRADIENT; }
+    // Axis-aligned shapes only have corners at their vertices, while staircases have about one per step
+    const bool diagonal = statistics.diagonal_blocks > 0U || statistics.corner_blocks * 2U > statistics.sharp_steps + statistics.smooth_steps;
+    return diagonal ? TILE_DIAGONAL : TILE_AXIS_ALIGNED;
+}
+
+struct HybridConfig {
+    std::array<const RegisteredScaler*, TILE_CLASS_COUNT> scalers; // Algorithm of every class
+    int tile_size = HYBRID_TILE_SIZE;
+    int blend_width = HYBRID_BLEND_WIDTH;
+};
+
+// EPX and AdvMAME for flat fill and axis-aligned edges, where they match the smoother algorithms, xBR for diagonal
+// edges and NEDI for gradients
+inline HybridConfig defaultHybridConfig() {
+    return { { findScaler("epx"), findScaler("adv_mame"), findScaler("xbr"), findScaler("nedi") } };
+}
+
+/**
+ * Parse the algorithms of classes, as comma-separated class=algorithm pairs (e.g. "diagonal=hq2x,gradient=xbr");
+ * classes that are not named keep the algorithm of defaultHybridConfig
+ *
+ * @return The configuration, or nothing if a class or algorithm is unknown
+*/
+inline std::optional<HybridConfig> parseHybridConfig(std::string_view spec) {
+    HybridConfig config = defaultHybridConfig();
+    while (!spec.empty()) {
+        const size_t comma = std::min(spec.find(','), spec.size());
+        const std::string_view pair = spec.substr(0U, comma);
+        spec.remove_prefix(std::min(comma + 1U, spec.size()));
+        const size_t equals = pair.find('=');
+        if (equals == std::string_view::npos) { return std::nullopt; }
+        const auto name = std::find(TILE_CLASS_NAMES.begin(), TILE_CLASS_NAMES.end(), pair.substr(0U, equals));
+        const RegisteredScaler* scaler = findScaler(pair.substr(equals + 1U));
+        if (name == TILE_CLASS_NAMES.end() || !scaler) { return std::nullopt; }
+        config.scalers[size_t(name - TILE_CLASS_NAMES.begin())] = scaler;
+    }
+    return config;
+}
+
+// Description of every setting of a configuration that affects the output (e.g. "flat=epx,...,gradient=nedi;16;4"), which
+// keys its results
+inline std::string hybridConfigKey(const HybridConfig& config) {
+    std::string key;
+    for (size_t tile_class = 0; tile_class < TILE_CLASS_COUNT; tile_class++) {
+        key += std::string(TILE_CLASS_NAMES[tile_class]) + "=" + std::string(config.scalers[tile_class]->algorithm) + (tile_class + 1U < TILE_CLASS_COUNT ? "," : "");
+    }
+    return key + ";" + std::to_string(config.tile_size) + ";" + std::to_string(config.blend_width);
+}
+
+struct HybridStats {
+    std::array<size_t, TILE_CLASS_COUNT> tiles {};
+    std::array<double, TILE_CLASS_COUNT> scale_seconds {}; // Spent scaling runs, by the class of their first tile, summed over threads
+    double seconds = 0.0; // Wall time of the passes
+
+    void add(const HybridStats& other) {
+        for (size_t tile_class = 0; tile_class < TILE_CLASS_COUNT; tile_class++) {
+            tiles[tile_class] += other.tiles[tile_class];
+            scale_seconds[tile_class] += other.scale_seconds[tile_class];
+        }
+        seconds += other.seconds;
+    }
+};
+
+/**
+ * Scale an image by 2x, every tile with the algorithm of its class
+ *
+ * @param src Source image
+ * @param config Algorithm of every class, tile size and blend width
+ * @param stats If not nullptr, receives the class histogram and the time spent
+ *
+ * @return The scaled image
+*/
+inline Image<glm::uvec3> scaleHybrid(const Image<glm::uvec3>& src, const HybridConfig& config, HybridStats* stats = nullptr) {
+    const auto start = std::chrono::steady_clock::now();
+    const int tile_size = std::max(config.tile_size, 1);
+    const int blend_width = std::clamp(config.blend_width, 0, tile_size);
+    const glm::ivec2 src_size(src.width, src.height), output_size = src_size * 2;
+    const glm::ivec2 tile_count = (src_size + tile_size - 1) / tile_size;
+    const auto tileCore = [&](int tile_x, int tile_y) {
+        const glm::ivec2 begin = glm::ivec2(tile_x, tile_y) * tile_size;
+        return PixelRect { begin, glm::min(begin + tile_size, src_size) };
+    };
+
+    std::vector<TileClass> classes(size_t(tile_count.x) * size_t(tile_count.y));
+    #pragma omp parallel for schedule(static)
+    for (int tile_y = 0; tile_y < tile_count.y; tile_y++) {
+        for (int tile_x = 0; tile_x < tile_count.x; tile_x++) {
+            classes[size_t(tile_y) * size_t(tile_count.x) + size_t(tile_x)] = classifyTile(tileStatistics(src, tileCore(tile_x, tile_y)));
+        }
+    }
+    const auto scalerOf = [&](int tile_x, int tile_y) { return config.scalers[classes[size_t(tile_y) * size_t(tile_count.x) + size_t(tile_x)]]; };
+
+    // Horizontal runs of tiles scaled by the same algorithm, each covering its output plus the blend band around it
+    struct Run {
+        const RegisteredScaler* scaler;
+        TileClass tile_class; // Of the first tile
+        PixelRect extended; // Output pixels of the run
+        Image<glm::uvec3> pixels;
+        double seconds = 0.0;
+    };
+    std::vector<Run> runs;
+    std::vector<uint32_t> tile_runs(classes.size());
+    for (int tile_y = 0; tile_y < tile_count.y; tile_y++) {
+        for (int tile_x = 0; tile_x < tile_count.x; tile_x++) {
+            const PixelRect core = tileCore(tile_x, tile_y);
+            if (tile_x == 0 || scalerOf(tile_x, tile_y) != runs.back().scaler) {
+                runs.push_back({ scalerOf(tile_x, tile_y), classes[size_t(tile_y) * size_t(tile_count.x) + size_t(tile_x)],
+                                 { glm::max(core.begin * 2 - blend_width, glm::ivec2(0)), glm::ivec2(0) }, Image<glm::uvec3>(0, 0) });
+            }
+            runs.back().extended.end = glm::min(core.end * 2 + blend_width, output_size);
+            tile_runs[size_t(tile_y) * size_t(tile_count.x) + size_t(tile_x)] = uint32_t(runs.size() - 1U);
+        }
+    }
+
+    // A single algorithm everywhere needs neither runs nor blending
+    if (std::all_of(runs.begin(), runs.end(), [&](const Run& run) { return run.scaler == runs[0].scaler; })) {
+        Image<glm::uvec3> result = runs[0].scaler->scale_chain(src, 1U);
+        if (stats) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (TileClass tile_class : classes) { stats->tiles[tile_class]++; }
+            stats->scale_seconds[runs[0].tile_class] += seconds;
+            stats->seconds += seconds;
+        }
+        return result;
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < int(runs.size()); i++) {
+        const auto run_start = std::chrono::steady_clock::now();
+        Run& run = runs[size_t(i)];
+        const PixelRect source = sourceRect(run.extended, run.scaler->halo, src_size);
+        Image<glm::uvec3> region(source.width(), source.height());
+        copyRect(src, glm::ivec2(0), source, region, source.begin);
+        const Image<glm::uvec3> scaled = run.scaler->scale_chain(region, 1U);
+        run.pixels = Image<glm::uvec3>(run.extended.width(), run.extended.height());
+        copyRect(scaled, source.begin * 2, run.extended, run.pixels, run.extended.begin);
+        run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+    }
+
+    const auto runPixel = [&](int tile_x, int tile_y, int x, int y) {
+        const Run& run = runs[tile_runs[size_t(tile_y) * size_t(tile_count.x) + size_t(tile_x)]];
+        return run.pixels.data[run.pixels.getImageOffset(x - run.extended.begin.x, y - run.extended.begin.y)];
+    };
+    // Weight of the own tile along one axis, and the side of the neighbouring tile it is blended with (0 for none)
+    const auto axisBlend = [&](int position, int core_begin, int core_end, int tile, int count, float& weight) {
+        weight = 1.0f;
+        const int before = position - core_begin, after = core_end - 1 - position;
+        if (before < blend_width && tile > 0) {
+            weight = 0.5f + (float(before) + 0.5f) / float(2 * blend_width);
+            return -1;
+        }
+        if (after < blend_width && tile + 1 < count) {
+            weight = 0.5f + (float(after) + 0.5f) / float(2 * blend_width);
+            return 1;
+        }
+        return 0;
+    };
+
+    Image<glm::uvec3> result(output_size.x, output_size.y);
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < output_size.y; y++) {
+        const int tile_y = y / (2 * tile_size);
+        for (int x = 0; x < output_size.x; x++) {
+            const int tile_x = x / (2 * tile_size);
+            const PixelRect core = tileCore(tile_x, tile_y);
+            float weight_x, weight_y;
+            const int side_x = axisBlend(x, core.begin.x * 2, core.end.x * 2, tile_x, tile_count.x, weight_x);
+            const int side_y = axisBlend(y, core.begin.y * 2, core.end.y * 2, tile_y, tile_count.y, weight_y);
+
+            const RegisteredScaler* own = scalerOf(tile_x, tile_y);
+            if ((side_x == 0 || scalerOf(tile_x + side_x, tile_y) == own) && (side_y == 0 || scalerOf(tile_x, tile_y + side_y) == own) &&
+                (side_x == 0 || side_y == 0 || scalerOf(tile_x + side_x, tile_y + side_y) == own)) {
+                result.data[result.getImageOffset(x, y)] = runPixel(tile_x, tile_y, x, y);
+                continue;
+            }
+            glm::vec3 blended = glm::vec3(runPixel(tile_x, tile_y, x, y)) * (weight_x * weight_y);
+            if (side_x != 0) { blended += glm::vec3(runPixel(tile_x + side_x, tile_y, x, y)) * ((1.0f - weight_x) * weight_y); }
+            if (side_y != 0) { blended += glm::vec3(runPixel(tile_x, tile_y + side_y, x, y)) * (weight_x * (1.0f - weight_y)); }
+            if (side_x != 0 && side_y != 0) { blended += glm::vec3(runPixel(tile_x + side_x, tile_y + side_y, x, y)) * ((1.0f - weight_x) * (1.0f - weight_y)); }
+            result.data[result.getImageOffset(x, y)] = glm::uvec3(glm::clamp(glm::round(blended), 0.0f, 255.0f));
+        }
+    }
+
+    if (stats) {
+        for (TileClass tile_class : classes) { stats->tiles[tile_class]++; }
+        for (const Run& run : runs) { stats->scale_seconds[run.tile_class] += run.seconds; }
+        stats->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef KERNEL_HPP
+#define KERNEL_HPP
+
+#include <algorithm>
+#include <array>
+
+#include <framework/image.h>
+
+// Generic driver for neighbourhood-based pixel-art scalers. A rule functor maps the window around a source pixel to a
+// FACTOR x FACTOR block of output pixels; the driver owns the loop nest and the write-back. The edge policy, pixel type
+// and factor are all template parameters, so border handling is resolved at compile time and the interior loop reads
+// neighbours through plain pointer offsets without any bounds checks.
+//
+// A rule provides:
+//  - static constexpr int RADIUS: furthest offset (in either axis) of any neighbour it reads
+//  - static constexpr int FACTOR: scale factor, i.e. the side length of the output block
+//  - template<typename Window> KernelBlock<T, FACTOR> operator()(const Window& window) const
+
+template<typename T, int Factor>
+using KernelBlock = std::array<T, Factor * Factor>; // Row-major
+
+/**
+ * Read-only view of the neighbourhood of a source pixel
+ *
+ * @tparam Policy How reads outside of the image are resolved
+ * @tparam Interior True if every read is guaranteed to be inside the image, which skips the edge policy entirely
+*/
+template<typename T, OutOfBoundsStrategy Policy, bool Interior>
+class KernelWindow {
+public:
+    KernelWindow(const Image<T>& src, int x, int y)
+        : src(src), x(x), y(y), centre(&src.data[src.getImageOffset(x, y)]) {}
+
+    /**
+     * Fetch a neighbour of the centre pixel
+     *
+     * @param dx Horizontal offset from the centre pixel, within [-RADIUS..RADIUS] of the rule
+     * @param dy Vertical offset from the centre pixel, within [-RADIUS..RADIUS] of the rule
+     *
+     * @return The neighbour's value, resolved according to the edge policy if it lies outside of the image
+    */
+    T operator()(int dx, int dy) const {
+        if constexpr (Interior) { return centre[(dy * src.width) + dx]; }
+        else {
+            int nx = x + dx, ny = y + dy;
+            if constexpr (Policy == ZERO) {
+                if (nx < 0 || nx >= src.width || ny < 0 || ny >= src.height) { return {}; }
+            } else {
+                nx = std::clamp(nx, 0, src.width - 1);
+                ny = std::clamp(ny, 0, src.height - 1);
+            }
+            return src.data[src.getImageOffset(nx, ny)];
+        }
+    }
+
+private:
+    const Image<T>& src;
+    int x, y;
+    const T* centre;
+};
+
+template<typename Rule, OutOfBoundsStrategy Policy, bool Interior, typename T>
+inline void applyRule(const Rule& rule, const Image<T>& src, Image<T>& result, int x, int y) {
+    constexpr int factor = Rule::FACTOR;
+    const KernelBlock<T, factor> block = rule(KernelWindow<T, Policy, Interior>(src, x, y));
+    T* dst = &result.data[result.getImageOffset(factor * x, factor * y)];
+    for (int block_y = 0; block_y < factor; block_y++) {
+        for (int block_x = 0; block_x < factor; block_x++) { dst[(block_y * result.width) + block_x] = block[(block_y * factor) + block_x]; }
+    }
+}
+
+/**
+ * Scale an image by applying a rule to every source pixel. Pixels closer than RADIUS to the edge go through the edge
+ * policy; all others take the unchecked interior path
+ *
+ * @param src Source image
+ * @param rule Rule functor
+ *
+ * @return Image scaled by Rule::FACTOR
+*/
+template<typename Rule, OutOfBoundsStrategy Policy = NEAREST, typename T>
+Image<T> applyKernel(const Image<T>& src, const Rule& rule = {}) {
+    constexpr int radius = Rule::RADIUS;
+    auto result = Image<T>(src.width * Rule::FACTOR, src.height * Rule::FACTOR);
+
+    const int interior_begin = std::min(radius, src.width);
+    const int interior_end   = std::max(interior_begin, src.width - radius);
+    for (int y = 0; y < src.height; y++) {
+        if (y < radius || y >= src.height - radius) {
+            for (int x = 0; x < src.width; x++) { applyRule<Rule, Policy, false>(rule, src, result, x, y); }
+            continue;
+        }
+        for (int x = 0; x < interior_begin; x++)                { applyRule<Rule, Policy, false>(rule, src, result, x, y); }
+        for (int x = interior_begin; x < interior_end; x++)     { applyRule<Rule, Policy, true>(rule, src, result, x, y); }
+        for (int x = interior_end; x < src.width; x++)          { applyRule<Rule, Policy, false>(rule, src, result, x, y); }
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef KL_PIXEL_GRAPH_HPP
+#define KL_PIXEL_GRAPH_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "kl_similarity_graph.hpp"
+
+// Kopf-Lischinski pixel cell graph (section 3.3 of the paper): the lattice of pixel corners, deformed so that the cells
+// of diagonally connected pixels share an edge, with its valence-2 vertices collapsed.
+// Native counterpart of Vectorizer._create_pixel_graph/_deform_pixel_grid.
+//
+// The graph is implicit. Vertices live on a quarter-pixel grid: every lattice vertex (x, y) owns itself plus four
+// 'quadrant' vertices at (x +- 1/4, y +- 1/4), which is where the deformation moves the corners of pixels to. Edges are
+// bitmasks over the fixed set of offsets that can occur between two vertices (CELL_EDGE_OFFSETS), stored at both ends,
+// and every pixel keeps a bitmask of the vertices that are its corners. Every stage is a sweep in which each vertex (or
+// pixel) only writes its own masks, so the stages run in parallel and in time linear in the number of pixels
+
+constexpr int QUARTERS_PER_PIXEL = 4;
+
+// Quadrants around a lattice vertex, which are also the pixels around it; bit 0 is set for east and bit 1 for south
+enum CellQuadrant : uint8_t { QUADRANT_NW, QUADRANT_NE, QUADRANT_SW, QUADRANT_SE };
+constexpr std::array<glm::ivec2, 4> QUADRANT_OFFSETS = {
+    glm::ivec2(-1, -1), glm::ivec2( 1, -1), glm::ivec2(-1,  1), glm::ivec2( 1,  1)};
+
+// Edges of the undeformed lattice, as seen from a lattice vertex
+enum LatticeDirection : uint8_t { LATTICE_EAST, LATTICE_SOUTH, LATTICE_WEST, LATTICE_NORTH };
+constexpr std::array<glm::ivec2, 4> LATTICE_OFFSETS = {
+    glm::ivec2( 1,  0), glm::ivec2( 0,  1), glm::ivec2(-1,  0), glm::ivec2( 0, -1)};
+constexpr std::array<std::array<CellQuadrant, 2>, 4> LATTICE_EDGE_QUADRANTS = {{ // Pixels on either side of every edge
+    { QUADRANT_NE, QUADRANT_SE }, { QUADRANT_SW, QUADRANT_SE }, { QUADRANT_NW, QUADRANT_SW }, { QUADRANT_NW, QUADRANT_NE } }};
+
+// Every offset (in quarter pixels) between the two ends of an edge, in pairs of opposite offsets:
+//  - lattice edges, and the edges between a lattice vertex and its own quadrant vertices
+//  - edges from a vertex (lattice or quadrant) to a quadrant vertex of the next lattice vertex
+//  - edges between two quadrant vertices of the same lattice vertex, left by collapsing that lattice vertex
+constexpr std::array<glm::ivec2, 24> CELL_EDGE_OFFSETS = {
+    glm::ivec2( 4,  0), glm::ivec2(-4,  0), glm::ivec2( 0,  4), glm::ivec2( 0, -4),
+    glm::ivec2( 1,  1), glm::ivec2(-1, -1), glm::ivec2( 1, -1), glm::ivec2(-1,  1),
+    glm::ivec2( 3,  1), glm::ivec2(-3, -1), glm::ivec2( 3, -1), glm::ivec2(-3,  1),
+    glm::ivec2( 1,  3), glm::ivec2(-1, -3), glm::ivec2(-1,  3), glm::ivec2( 1, -3),
+    glm::ivec2( 2,  2), glm::ivec2(-2, -2), glm::ivec2( 2, -2), glm::ivec2(-2,  2),
+    glm::ivec2( 2,  0), glm::ivec2(-2,  0), glm::ivec2( 0,  2), glm::ivec2( 0, -2)};
+
+constexpr uint32_t CELL_VERTEX_SLOTS    = 5U; // The lattice vertex itself, then one quadrant vertex per CellQuadrant
+constexpr uint32_t CELL_CORNER_BITS     = 5U; // Bits per corner of a pixel, one per vertex slot of the corner's lattice vertex
+
+// Per lattice vertex: the lattice edges whose end at the vertex is moved into a quadrant, and the diagonal causing it
+constexpr uint8_t DEFORMATION_ANTI_DIAGONAL = 0x10; // Unset for the main (north-west to south-east) diagonal
+
+// Index of every offset in CELL_EDGE_OFFSETS (or -1), for offsets within [-4, 4]^2
+constexpr std::array<int8_t, 81> CELL_EDGE_DIRECTIONS = [] {
+    std::array<int8_t, 81> directions {};
+    directions.fill(-1);
+    for (size_t direction = 0; direction < CELL_EDGE_OFFSETS.size(); direction++) {
+        directions[size_t((CELL_EDGE_OFFSETS[direction].y + 4) * 9 + CELL_EDGE_OFFSETS[direction].x + 4)] = int8_t(direction);
+    }
+    return directions;
+}();
+
+constexpr inline int cellEdgeDirection(glm::ivec2 offset) {
+    if (offset.x < -4 || offset.x > 4 || offset.y < -4 || offset.y > 4) { return -1; }
+    return CELL_EDGE_DIRECTIONS[size_t((offset.y + 4) * 9 + offset.x + 4)];
+}
+
+constexpr inline CellQuadrant oppositeSideQuadrant(CellQuadrant quadrant, uint8_t direction) {
+    const std::array<CellQuadrant, 2>& sides = LATTICE_EDGE_QUADRANTS[direction];
+    return sides[0] == quadrant ? sides[1] : sides[0];
+}
+
+/**
+ * Quadrant a lattice edge is bent into at a vertex whose 2x2 block has a diagonal: the side of the pixel that is not part
+ * of the diagonal
+*/
+constexpr inline CellQuadrant deformedQuadrant(uint8_t deformation, uint8_t direction) {
+    constexpr std::array<CellQuadrant, 4> MAIN = { QUADRANT_NE, QUADRANT_SW, QUADRANT_SW, QUADRANT_NE };
+    constexpr std::array<CellQuadrant, 4> ANTI = { QUADRANT_SE, QUADRANT_SE, QUADRANT_NW, QUADRANT_NW };
+    return (deformation & DEFORMATION_ANTI_DIAGONAL) ? ANTI[direction] : MAIN[direction];
+}
+
+// Pixel in the given quadrant of lattice vertex (x, y)
+inline glm::ivec2 quadrantPixel(glm::ivec2 vertex, CellQuadrant quadrant) {
+    return vertex + glm::ivec2((quadrant & 1U) ? 0 : -1, (quadrant & 2U) ? 0 : -1);
+}
+
+struct PixelCellGraph {
+    int width, height; // Of the image; the lattice has (width + 1) x (height + 1) vertices
+    std::vector<std::array<uint32_t, CELL_VERTEX_SLOTS>> edges; // CELL_EDGE_OFFSETS bitmask of every slot of every lattice vertex
+    std::vector<uint32_t> corners; // CELL_CORNER_BITS bits per corner (top left, top right, bottom left, bottom right) of every pixel
+
+    size_t latticeOffset(int x, int y) const { return x + (y * (width + 1)); }
+    bool inLattice(glm::ivec2 vertex) const { return vertex.x >= 0 && vertex.x <= width && vertex.y >= 0 && vertex.y <= height; }
+
+    // Lattice vertex owning a vertex given in quarter pixels, and the slot of the vertex within it
+    static glm::ivec2 owner(glm::ivec2 quarter) { return (quarter + 2) >> 2; } // Rounded division by QUARTERS_PER_PIXEL
+    static uint32_t slot(glm::ivec2 quarter) {
+        const glm::ivec2 remainder = quarter - (owner(quarter) * QUARTERS_PER_PIXEL);
+        if (remainder == glm::ivec2(0)) { return 0U; }
+        return 1U + uint32_t(remainder.x > 0) + (uint32_t(remainder.y > 0) << 1U);
+    }
+    static glm::ivec2 slotVertex(glm::ivec2 lattice_vertex, uint32_t slot) {
+        const glm::ivec2 quarter = lattice_vertex * QUARTERS_PER_PIXEL;
+        return slot == 0U ? quarter : quarter + QUADRANT_OFFSETS[slot - 1U];
+    }
+
+    uint32_t edgeMask(glm::ivec2 quarter) const {
+        const glm::ivec2 vertex = owner(quarter);
+        return inLattice(vertex) ? edges[latticeOffset(vertex.x, vertex.y)][slot(quarter)] : 0U;
+    }
+    bool present(glm::ivec2 quarter) const { return edgeMask(quarter) != 0U; }
+    int valence(glm::ivec2 quarter) const { return std::popcount(edgeMask(quarter)); }
+    static glm::dvec2 position(glm::ivec2 quarter) { return glm::dvec2(quarter) / double(QUARTERS_PER_PIXEL); }
+
+    // Whether a vertex, given in quarter pixels, is one of the corners of a pixel
+    bool isCorner(int x, int y, glm::ivec2 quarter) const {
+        const glm::ivec2 corner = owner(quarter) - glm::ivec2(x, y);
+        if (corner.x < 0 || corner.x > 1 || corner.y < 0 || corner.y > 1) { return false; }
+        return corners[x + (y * width)] & (1U << ((uint32_t(corner.x + (corner.y * 2)) * CELL_CORNER_BITS) + slot(quarter)));
+    }
+
+    // Vertices of the corners of a pixel, in quarter pixels
+    std::vector<glm::ivec2> cellCorners(int x, int y) const {
+        std::vector<glm::ivec2> vertices;
+        const uint32_t mask = corners[x + (y * width)];
+        for (uint32_t corner = 0U; corner < 4U; corner++) {
+            for (uint32_t slot = 0U; slot < CELL_CORNER_BITS; slot++) {
+                if (mask & (1U << ((corner * CELL_CORNER_BITS) + slot))) { vertices.push_back(slotVertex(glm::ivec2(x + int(corner & 1U), y + int(corner >> 1U)), slot)); }
+            }
+        }
+        return vertices;
+    }
+};
+
+/**
+ * Decide at every interior lattice vertex which of its edges are bent by the diagonal of its 2x2 block: an edge is bent
+ * into the cell of the pixel that is not on the diagonal, unless that pixel has the same value as the diagonal pixel on
+ * the other side of the edge (Vectorizer._deform_cell)
+ *
+ * @param src Image the similarity graph was built for
+ * @param similarity Planar similarity graph of the image
+ *
+ * @return Bitmask of bent LatticeDirections (plus DEFORMATION_ANTI_DIAGONAL) of every lattice vertex
+*/
+inline std::vector<uint8_t> computeCellDeformations(const Image<glm::uvec3>& src, const SimilarityGraph& similarity) {
+    std::vector<uint8_t> deformations(size_t(src.width + 1) * size_t(src.height + 1), 0U);
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 1; y < src.height; y++) {
+        for (int x = 1; x < src.width; x++) {
+            const bool main_diagonal = similarity.connected(x - 1, y - 1, SOUTH_EAST);
+            const bool anti_diagonal = similarity.connected(x, y - 1, SOUTH_WEST);
+            if (!main_diagonal && !anti_diagonal) { continue; }
+            uint8_t deformation = main_diagonal ? 0U : DEFORMATION_ANTI_DIAGONAL;
+            for (uint8_t direction = 0U; direction < 4U; direction++) {
+                const CellQuadrant bent_into    = deformedQuadrant(deformation, direction);
+                const glm::ivec2 off_diagonal   = quadrantPixel(glm::ivec2(x, y), bent_into);
+                const glm::ivec2 on_diagonal    = quadrantPixel(glm::ivec2(x, y), oppositeSideQuadrant(bent_into, direction));
+                if (src.data[src.getImageOffset(off_diagonal.x, off_diagonal.y)] != src.data[src.getImageOffset(on_diagonal.x, on_diagonal.y)]) {
+                    deformation |= uint8_t(1U << direction);
+                }
+            }
+            deformations[(y * (src.width + 1)) + x] = deformation;
+        }
+    }
+    return deformations;
+}
+
+/**
+ * Build the deformed lattice. Every lattice edge becomes a path from one end to the other that detours through the
+ * quadrant vertex it is bent into at each end, if any (the midpoint the Python version inserts is already collapsed)
+ *
+ * @param graph Graph whose edges are filled in
+ * @param deformations Output of computeCellDeformations
+*/
+inline void deformPixelLattice(PixelCellGraph& graph, const std::vector<uint8_t>& deformations) {
+    auto connect = [](uint32_t& mask, glm::ivec2 offset) { mask |= 1U << uint32_t(cellEdgeDirection(offset)); };
+    // Vertex at which an edge leaves a lattice vertex
+    auto edgeEnd = [&](glm::ivec2 vertex, uint8_t direction) {
+        const uint8_t deformation = deformations[graph.latticeOffset(vertex.x, vertex.y)];
+        const glm::ivec2 quarter = vertex * QUARTERS_PER_PIXEL;
+        return (deformation & (1U << direction)) ? quarter + QUADRANT_OFFSETS[deformedQuadrant(deformation, direction)] : quarter;
+    };
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y <= graph.height; y++) {
+        for (int x = 0; x <= graph.width; x++) {
+            std::array<uint32_t, CELL_VERTEX_SLOTS>& masks = graph.edges[graph.latticeOffset(x, y)];
+            const glm::ivec2 quarter = glm::ivec2(x, y) * QUARTERS_PER_PIXEL;
+            for (uint8_t direction = 0U; direction < 4U; direction++) {
+                const glm::ivec2 neighbour = glm::ivec2(x, y) + LATTICE_OFFSETS[direction];
+                if (!graph.inLattice(neighbour)) { continue; }
+                const glm::ivec2 near   = edgeEnd(glm::ivec2(x, y), direction);
+                const glm::ivec2 far    = edgeEnd(neighbour, uint8_t((direction + 2U) % 4U));
+                if (near == quarter) {
+                    connect(masks[0], far - quarter);
+                } else {
+                    uint32_t& bent = masks[PixelCellGraph::slot(near)];
+                    connect(masks[0], near - quarter);
+                    connect(bent, quarter - near);
+                    connect(bent, far - near);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Remove every vertex of valence 2 or less, except the corners of the image, joining the ends of every removed chain of
+ * valence-2 vertices by a single edge. Unlike the sequential Python sweep, whose result depends on the order in which
+ * two adjacent valence-2 vertices are visited, all removals are decided on the deformed graph, so whole chains collapse
+ *
+ * @param graph Graph to collapse
+*/
+inline void collapseValenceTwo(PixelCellGraph& graph) {
+    const std::vector<std::array<uint32_t, CELL_VERTEX_SLOTS>> deformed = graph.edges;
+    auto mask = [&](glm::ivec2 quarter) {
+        const glm::ivec2 vertex = PixelCellGraph::owner(quarter);
+        return graph.inLattice(vertex) ? deformed[graph.latticeOffset(vertex.x, vertex.y)][PixelCellGraph::slot(quarter)] : 0U;
+    };
+    const glm::ivec2 image_corner = glm::ivec2(graph.width, graph.height) * QUARTERS_PER_PIXEL;
+    auto removed = [&](glm::ivec2 quarter) {
+        const bool corner = (quarter.x == 0 || quarter.x == image_corner.x) && (quarter.y == 0 || quarter.y == image_corner.y);
+        return !corner && std::popcount(mask(quarter)) <= 2;
+    };
+    // Follow a chain of removed vertices to the first kept one; nothing if the chain ends in a removed dead end
+    auto chainEnd = [&](glm::ivec2 start, glm::ivec2 first) -> std::optional<glm::ivec2> {
+        glm::ivec2 previous = start, current = first;
+        while (removed(current)) {
+            const int back = cellEdgeDirection(previous - current);
+            const uint32_t onwards = mask(current) & ~(1U << uint32_t(back));
+            if (std::popcount(onwards) != 1) { return std::nullopt; }
+            previous    = current;
+            current     = current + CELL_EDGE_OFFSETS[size_t(std::countr_zero(onwards))];
+        }
+        if (current == start) { return std::nullopt; } // Loop back to the start would be a self-loop
+        return current;
+    };
+
+    // Exceptions cannot leave the parallel loop, so the first vertex with an unrepresentable edge is reported after it
+    std::atomic<int64_t> unrepresentable = -1;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y <= graph.height; y++) {
+        for (int x = 0; x <= graph.width; x++) {
+            std::array<uint32_t, CELL_VERTEX_SLOTS>& masks = graph.edges[graph.latticeOffset(x, y)];
+            for (uint32_t slot = 0U; slot < CELL_VERTEX_SLOTS; slot++) {
+                const uint32_t deformed_mask = deformed[graph.latticeOffset(x, y)][slot];
+                const glm::ivec2 quarter = PixelCellGraph::slotVertex(glm::ivec2(x, y), slot);
+                uint32_t collapsed = 0U;
+                if (deformed_mask != 0U && !removed(quarter)) {
+                    for (uint32_t remaining = deformed_mask; remaining != 0U; remaining &= remaining - 1U) {
+                        const glm::ivec2 neighbour = quarter + CELL_EDGE_OFFSETS[size_t(std::countr_zero(remaining))];
+                        const std::optional<glm::ivec2> end = chainEnd(quarter, neighbour);
+                        if (!end) { continue; }
+                        const int direction = cellEdgeDirection(*end - quarter);
+                        if (direction < 0) {
+                            int64_t none = -1;
+                            unrepresentable.compare_exchange_strong(none, int64_t(graph.latticeOffset(x, y)));
+                            continue;
+                        }
+                        collapsed |= 1U << uint32_t(direction);
+                    }
+                }
+                masks[slot] = collapsed;
+            }
+        }
+    }
+    if (unrepresentable >= 0) {
+        const int64_t lattice_width = int64_t(graph.width) + 1;
+        std::cerr << "Collapsed pixel cell edge from " << unrepresentable % lattice_width << ", " << unrepresentable / lattice_width
+                  << " has no representable offset" << std::endl;
+        throw std::exception();
+    }
+}
+
+/**
+ * Compute the corners of every pixel cell: its lattice corners, except where the cell was cut by a bent edge (which moves
+ * the corner into the cell's own quadrant vertex), plus the quadrant vertices of neighbouring cells that bent edges
+ * shared with this cell run through. Only vertices left by the collapse are kept
+ *
+ * @param graph Collapsed graph whose corners are filled in
+ * @param deformations Output of computeCellDeformations
+*/
+inline void computeCellCorners(PixelCellGraph& graph, const std::vector<uint8_t>& deformations) {
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < graph.height; y++) {
+        for (int x = 0; x < graph.width; x++) {
+            uint32_t mask = 0U;
+            for (uint32_t corner = 0U; corner < 4U; corner++) {
+                const glm::ivec2 vertex = glm::ivec2(x + int(corner & 1U), y + int(corner >> 1U));
+                const CellQuadrant own = CellQuadrant(3U - corner); // The pixel lies opposite its corner
+                const uint8_t deformation = deformations[graph.latticeOffset(vertex.x, vertex.y)];
+                uint32_t slots = 0U;
+                for (uint8_t direction = 0U; direction < 4U; direction++) {
+                    if (!(deformation & (1U << direction))) { continue; }
+                    const CellQuadrant bent_into = deformedQuadrant(deformation, direction);
+                    if (bent_into == own) { slots |= 1U << (1U + own); }
+                    else if (oppositeSideQuadrant(bent_into, direction) == own) { slots |= 1U << (1U + bent_into); }
+                }
+                // A quadrant vertex on a single bent edge collapses back onto the straight edge, leaving the lattice
+                // vertex as the corner (the Python version loses the corner altogether)
+                const bool own_collapsed = (slots & (1U << (1U + own))) && !graph.present(PixelCellGraph::slotVertex(vertex, 1U + own));
+                if (!(slots & (1U << (1U + own))) || own_collapsed) { slots |= 1U; }
+
+                for (uint32_t slot = 0U; slot < CELL_VERTEX_SLOTS; slot++) {
+                    if ((slots & (1U << slot)) && graph.present(PixelCellGraph::slotVertex(vertex, slot))) {
+                        mask |= 1U << ((corner * CELL_CORNER_BITS) + slot);
+                    }
+                }
+            }
+            graph.corners[x + (y * graph.width)] = mask;
+        }
+    }
+}
+
+/**
+ * Compute the pixel cell graph of an image as in section 3.3 of the Kopf-Lischinski paper
+ *
+ * @param src Image to build the graph for
+ * @param similarity Planar similarity graph of the image (see computeSimilarityGraph)
+ *
+ * @return Deformed and collapsed pixel cell graph, with the corners of every pixel
+*/
+inline PixelCellGraph computePixelCellGraph(const Image<glm::uvec3>& src, const SimilarityGraph& similarity) {
+    PixelCellGraph graph { src.width, src.height,
+                           std::vector<std::array<uint32_t, CELL_VERTEX_SLOTS>>(size_t(src.width + 1) * size_t(src.height + 1), { 0U, 0U, 0U, 0U, 0U }),
+                           std::vector<uint32_t>(src.data.size(), 0U) };
+    const std::vector<uint8_t> deformations = computeCellDeformations(src, similarity);
+    deformPixelLattice(graph, deformations);
+    collapseValenceTwo(graph);
+    computeCellCorners(graph, deformations);
+    return graph;
+}
+
+#endif
@@ -0,0 +1,350 @@
+#ifndef KL_RASTERIZER_HPP
+#define KL_RASTERIZER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "kl_splines.hpp"
+
+// Scanline rasteriser for the quadratic Bezier shape outlines produced by the Kopf-Lischinski vectoriser.
+// Replaces writing an SVG and rasterising it through CairoSVG once per factor in pixel_io.py
+
+constexpr int RASTER_STRIP_HEIGHT       = 16;       // Output rows per unit of parallel work
+constexpr double FLATTENING_TOLERANCE   = 0.05;     // Max distance (in output pixels) between curve and polyline
+constexpr double SVG_UNITS_PER_PIXEL    = 10.0;     // SVGWriter.PIXEL_SCALE in pixel_io.py
+
+struct VectorShape {
+    glm::vec3 colour;                                   // RGB in [0..1]
+    std::vector<std::vector<QuadraticBezier>> outlines; // Closed outlines in source pixel units, filled with non-zero winding
+    glm::dvec2 bounds_min, bounds_max;                  // Bounding box of the control points of all outlines
+};
+
+// Parsed/converted shapes of one vectorised image, reusable across any number of raster factors
+struct VectorShapeSet {
+    int width, height;  // Dimensions of the source image in pixels
+    std::vector<VectorShape> shapes;
+};
+
+/**
+ * Compute the bounding box of a shape's outlines, which must be called after the outlines are modified
+ *
+ * @param shape Shape whose bounds to update
+*/
+inline void updateBounds(VectorShape& shape) {
+    shape.bounds_min = glm::dvec2(std::numeric_limits<double>::max());
+    shape.bounds_max = glm::dvec2(std::numeric_limits<double>::lowest());
+    for (const auto& outline : shape.outlines) {
+        for (const QuadraticBezier& curve : outline) {
+            shape.bounds_min = glm::min(shape.bounds_min, glm::min(curve.start, glm::min(curve.control, curve.end)));
+            shape.bounds_max = glm::max(shape.bounds_max, glm::max(curve.start, glm::max(curve.control, curve.end)));
+        }
+    }
+}
+
+/**
+ * Parse the colour of an SVG fill attribute
+ *
+ * @param fill Attribute value, either rgb(r,g,b) or #rrggbb
+ * @param colour Output colour in [0..1]
+ *
+ * @return True if the colour could be parsed, false otherwise
+*/
+inline bool parseSvgColour(const std::string& fill, glm::vec3& colour) {
+    unsigned r, g, b;
+    if (std::sscanf(fill.c_str(), "rgb(%u,%u,%u)", &r, &g, &b) == 3 || std::sscanf(fill.c_str(), "#%02x%02x%02x", &r, &g, &b) == 3) {
+        colour = glm::vec3(float(r), float(g), float(b)) / 255.0f;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parse SVG path data consisting of (absolute or relative) M, L, Q and Z commands into closed quadratic outlines
+ *
+ * @param data Value of the d attribute
+ * @param units_per_pixel Number of SVG user units per source pixel
+ *
+ * @return Closed outlines, with lines converted to degenerate quadratic curves
+*/
+inline std::vector<std::vector<QuadraticBezier>> parseSvgPathData(const std::string& data, double units_per_pixel) {
+    std::vector<std::vector<QuadraticBezier>> outlines;
+    std::vector<QuadraticBezier> current_outline;
+    glm::dvec2 current(0.0), subpath_start(0.0);
+    char command = 0;
+    size_t position = 0;
+
+    auto skipSeparators = [&]() { while (position < data.size() && (std::isspace(uint8_t(data[position])) || data[position] == ',')) { position++; } };
+    auto readPoint = [&](bool relative) {
+        glm::dvec2 point;
+        for (int axis = 0; axis < 2; axis++) {
+            skipSeparators();
+            size_t consumed = 0;
+            point[axis] = std::stod(data.substr(position), &consumed) / units_per_pixel;
+            position += consumed;
+        }
+        return relative ? point + current : point;
+    };
+    auto closeOutline = [&]() {
+        if (current != subpath_start) { current_outline.push_back({ current, 0.5 * (current + subpath_start), subpath_start }); }
+        if (!current_outline.empty()) { outlines.push_back(std::move(current_outline)); }
+        current_outline.clear();
+        current = subpath_start;
+    };
+
+    for (skipSeparators(); position < data.size(); skipSeparators()) {
+        if (std::isalpha(uint8_t(data[position]))) { command = data[position++]; }
+        const bool relative = std::islower(uint8_t(command));
+        switch (std::toupper(uint8_t(command))) {
+        case 'M':
+            if (!current_outline.empty()) { closeOutline(); }
+            current = subpath_start = readPoint(relative);
+            command = relative ? 'l' : 'L'; // Further coordinate pairs are implicit line-tos
+            break;
+        case 'L': {
+            glm::dvec2 end = readPoint(relative);
+            current_outline.push_back({ current, 0.5 * (current + end), end });
+            current = end;
+            break;
+        }
+        case 'Q': {
+            glm::dvec2 control  = readPoint(relative);
+            glm::dvec2 end      = readPoint(relative);
+            current_outline.push_back({ current, control, end });
+            current = end;
+            break;
+        }
+        case 'Z':
+            closeOutline();
+            break;
+        default:
+            throw std::runtime_error(std::string("Unsupported SVG path command: ") + command);
+        }
+    }
+    if (!current_outline.empty()) { closeOutline(); }
+    return outlines;
+}
+
+/**
+ * Parse the filled paths of an SVG document as written by SVGWriter in pixel_io.py
+ *
+ * @param svg Contents of the SVG document
+ * @param width Width of the vectorised source image in pixels
+ * @param height Height of the vectorised source image in pixels
+ * @param units_per_pixel Number of SVG user units per source pixel
+ *
+ * @return Shapes in document (i.e. painting) order
+*/
+inline VectorShapeSet parseSvgShapes(const std::string& svg, int width, int height, double units_per_pixel = SVG_UNITS_PER_PIXEL) {
+    static const std::regex path_regex("<path\\b([^>]*)>");
+    static const std::regex data_regex("\\bd\\s*=\\s*\"([^\"]*)\"");
+    static const std::regex fill_regex("\\bfill\\s*=\\s*\"([^\"]*)\"");
+
+    VectorShapeSet shape_set { width, height, {} };
+    for (auto it = std::sregex_iterator(svg.begin(), svg.end(), path_regex); it != std::sregex_iterator(); ++it) {
+        const std::string attributes = (*it)[1].str();
+        std::smatch data_match, fill_match;
+        VectorShape shape;
+        if (!std::regex_search(attributes, data_match, data_regex) || !std::regex_search(attributes, fill_match, fill_regex) ||
+            !parseSvgColour(fill_match[1].str(), shape.colour)) {
+            continue;
+        }
+        shape.outlines = parseSvgPathData(data_match[1].str(), units_per_pixel);
+        if (shape.outlines.empty()) { continue; }
+        updateBounds(shape);
+        shape_set.shapes.push_back(std::move(shape));
+    }
+    return shape_set;
+}
+
+inline VectorShapeSet loadSvgShapes(const std::filesystem::path& file_path, int width, int height, double units_per_pixel = SVG_UNITS_PER_PIXEL) {
+    std::ifstream file(file_path);
+    if (!file) {
+        std::cerr << "SVG file " << file_path << " could not be opened!" << std::endl;
+        throw std::exception();
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parseSvgShapes(contents.str(), width, height, units_per_pixel);
+}
+
+/**
+ * Accumulate the signed area covered by a line segment into a coverage accumulation buffer. Each cell receives the
+ * exact area between the segment and the cell's right edge, so a running sum along a row yields the analytic
+ * (non-zero winding) coverage of every pixel
+ *
+ * @param accumulation Buffer of (width + 2) * height cells, row by row
+ * @param width Width of the raster
+ * @param height Height of the raster
+ * @param p0 Start of the segment in raster coordinates (x already clamped to [0..width])
+ * @param p1 End of the segment in raster coordinates (x already clamped to [0..width])
+*/
+inline void accumulateLine(std::vector<float>& accumulation, int width, int height, glm::dvec2 p0, glm::dvec2 p1) {
+    if (p0.y == p1.y) { return; }
+    const float direction = (p0.y < p1.y) ? 1.0f : -1.0f;
+    if (p0.y > p1.y) { std::swap(p0, p1); }
+    if (p1.y <= 0.0 || p0.y >= double(height)) { return; }
+
+    const size_t stride = size_t(width) + 2U;
+    const double dxdy   = (p1.x - p0.x) / (p1.y - p0.y);
+    double x            = (p0.y < 0.0) ? p0.x - (p0.y * dxdy) : p0.x;
+    const int y_begin   = std::max(0, int(std::floor(p0.y)));
+    const int y_end     = std::min(height, int(std::ceil(p1.y)));
+    for (int y = y_begin; y < y_end; y++) {
+        float* row          = &accumulation[size_t(y) * stride];
+        const double dy     = std::min(double(y + 1), p1.y) - std::max(double(y), p0.y);
+        const double x_next = x + (dxdy * dy);
+        const float d       = float(dy) * direction;
+        const double x0     = std::min(x, x_next);
+        const double x1     = std::max(x, x_next);
+        const double x0_floor = std::floor(x0);
+        const int x0i       = int(x0_floor);
+        const int x1i       = int(std::ceil(x1));
+
+        if (x1i <= x0i + 1) {
+            // Segment stays within a single pixel column
+            const float xmf = float((0.5 * (x + x_next)) - x0_floor);
+            row[x0i]        += d - (d * xmf);
+            row[x0i + 1]    += d * xmf;
+        } else {
+            const float s   = float(1.0 / (x1 - x0));
+            const float x0f = float(x0 - x0_floor);
+            const float a0  = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+            const float x1f = float(x1 - std::ceil(x1) + 1.0);
+            const float am  = 0.5f * s * x1f * x1f;
+            row[x0i] += d * a0;
+            if (x1i == x0i + 2) {
+                row[x0i + 1] += d * (1.0f - a0 - am);
+            } else {
+                const float a1 = s * (1.5f - x0f);
+                row[x0i + 1] += d * (a1 - a0);
+                for (int xi = x0i + 2; xi < x1i - 1; xi++) { row[xi] += d * s; }
+                const float a2 = a1 + (float(x1i - x0i - 3) * s);
+                row[x1i - 1] += d * (1.0f - a2 - am);
+            }
+            row[x1i] += d * am;
+        }
+        x = x_next;
+    }
+}
+
+/**
+ * Flatten a quadratic curve into line segments and accumulate them
+ *
+ * @param curve Curve in raster coordinates
+ * @param origin_y Raster y-coordinate of the first row of the accumulation buffer
+*/
+inline void accumulateCurve(std::vector<float>& accumulation, int width, int height, const QuadraticBezier& curve, double origin_y) {
+    const double deviation  = glm::length(curve.start - (2.0 * curve.control) + curve.end);
+    const int segments      = std::max(1, int(std::ceil(std::sqrt(deviation / (4.0 * FLATTENING_TOLERANCE)))));
+    auto toBuffer = [&](glm::dvec2 point) { return glm::dvec2(std::clamp(point.x, 0.0, double(width)), point.y - origin_y); };
+
+    glm::dvec2 previous = toBuffer(curve.start);
+    for (int segment = 1; segment <= segments; segment++) {
+        const double t      = double(segment) / double(segments);
+        const glm::dvec2 p  = ((1.0 - t) * (1.0 - t) * curve.start) + (2.0 * (1.0 - t) * t * curve.control) + (t * t * curve.end);
+        const glm::dvec2 next = toBuffer(p);
+        accumulateLine(accumulation, width, height, previous, next);
+        previous = next;
+    }
+}
+
+template<typename T>
+inline T colourToType(glm::vec3 colour) {
+    if constexpr (std::is_same_v<T, glm::uvec3>) { return glm::uvec3(glm::round(glm::clamp(colour, 0.0f, 1.0f) * 255.0f)); }
+    else { return T(colour); }
+}
+
+/**
+ * Rasterise a shape set at an arbitrary (not necessarily integer) factor with analytic anti-aliasing. Shapes are
+ * painted in order over the background, and horizontal strips of the output are rasterised in parallel
+ *
+ * @param shape_set Shapes to rasterise
+ * @param factor Number of output pixels per source pixel
+ * @param background Colour of the canvas in [0..1]
+ *
+ * @return Image of size (width * factor) x (height * factor)
+*/
+template<typename T>
+Image<T> rasterizeShapes(const VectorShapeSet& shape_set, double factor, glm::vec3 background = glm::vec3(1.0f)) {
+    auto result = Image<T>(int(std::lround(shape_set.width * factor)), int(std::lround(shape_set.height * factor)));
+    const int strip_count = (result.height + RASTER_STRIP_HEIGHT - 1) / RASTER_STRIP_HEIGHT;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int strip = 0; strip < strip_count; strip++) {
+        const int y_begin       = strip * RASTER_STRIP_HEIGHT;
+        const int strip_height  = std::min(RASTER_STRIP_HEIGHT, result.height - y_begin);
+        const size_t stride     = size_t(result.width) + 2U;
+        std::vector<glm::vec3> canvas(size_t(result.width) * size_t(strip_height), background);
+        std::vector<float> accumulation(stride * size_t(strip_height));
+
+        for (const VectorShape& shape : shape_set.shapes) {
+            if ((shape.bounds_max.y * factor) <= double(y_begin) || (shape.bounds_min.y * factor) >= double(y_begin + strip_height)) { continue; }
+
+            std::fill(accumulation.begin(), accumulation.end(), 0.0f);
+            for (const auto& outline : shape.outlines) {
+                for (const QuadraticBezier& curve : outline) {
+                    QuadraticBezier scaled { curve.start * factor, curve.control * factor, curve.end * factor };
+                    accumulateCurve(accumulation, result.width, strip_height, scaled, double(y_begin));
+                }
+            }
+
+            for (int y = 0; y < strip_height; y++) {
+                float winding = 0.0f;
+                for (int x = 0; x < result.width; x++) {
+                    winding += accumulation[(size_t(y) * stride) + size_t(x)];
+                    const float coverage = std::min(1.0f, std::abs(winding));
+                    glm::vec3& pixel = canvas[(size_t(y) * size_t(result.width)) + size_t(x)];
+                    pixel = glm::mix(pixel, shape.colour, coverage);
+                }
+            }
+        }
+
+        for (int y = 0; y < strip_height; y++) {
+            for (int x = 0; x < result.width; x++) {
+                result.data[result.getImageOffset(x, y_begin + y)] = colourToType<T>(canvas[(size_t(y) * size_t(result.width)) + size_t(x)]);
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Rasterise one shape set at several factors, e.g. the 2/4/8/16x outputs of the driver
+ *
+ * @param shape_set Shapes to rasterise, parsed/converted only once
+ * @param factors Number of output pixels per source pixel of every output
+ * @param background Colour of the canvas in [0..1]
+ *
+ * @return One image per factor, in the same order
+*/
+template<typename T>
+std::vector<Image<T>> rasterizeShapes(const VectorShapeSet& shape_set, const std::vector<double>& factors, glm::vec3 background = glm::vec3(1.0f)) {
+    std::vector<Image<T>> results;
+    results.reserve(factors.size());
+    for (double factor : factors) { results.push_back(rasterizeShapes<T>(shape_set, factor, background)); }
+    return results;
+}
+
+#endif
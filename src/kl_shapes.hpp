@@ -0,0 +1,286 @@
+#ifndef KL_SHAPES_HPP
+#define KL_SHAPES_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <numbers>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "kl_pixel_graph.hpp"
+#include "kl_similarity_graph.hpp"
+
+// Kopf-Lischinski shapes (section 3.4 of the paper): the connected components of the similarity graph and the outlines
+// of their cells in the pixel cell graph. Native counterpart of Vectorizer._create_shapes/_isolate_outlines/_add_shape_outlines.
+//
+// Components are labelled with a union-find over the connectivity bitmasks, first within horizontal tiles of rows in
+// parallel and then across the tile boundaries. Outlines are traced from a single sweep over the cells, which emits every
+// boundary edge of a cell that is not shared with a cell of the same shape, directed so that the shape lies on its left
+
+constexpr int SHAPE_LABEL_TILE_HEIGHT = 32; // Rows of pixels labelled independently before the merge pass
+
+struct ShapeLabels {
+    int width, height;
+    std::vector<uint32_t> labels;       // Shape of every pixel, stored row by row
+    std::vector<uint32_t> first_pixels; // Offset of the first pixel (in row-major order) of every shape; shapes are numbered in this order
+
+    size_t shapeCount() const { return first_pixels.size(); }
+    uint32_t label(int x, int y) const { return labels[x + (y * width)]; }
+};
+
+struct PixelShape {
+    glm::uvec3 value;
+    // Closed outlines in quarter pixels (see PixelCellGraph), without repeating the first vertex. They are directed so that
+    // the shape lies on their left in image coordinates: outer outlines have a positive signed area, inner ones a negative one
+    std::vector<std::vector<glm::ivec2>> outer;
+    std::vector<std::vector<glm::ivec2>> inner;
+};
+
+// Corner bits of a pixel (see PixelCellGraph::corners) in order of increasing angle around the centre of the pixel,
+// so that consecutive corners of a cell are the ends of one of its boundary edges
+constexpr std::array<uint8_t, 4U * CELL_CORNER_BITS> CELL_CORNER_ORDER = [] {
+    // Offset of a corner from the centre of the pixel, in quarter pixels
+    auto offset = [](uint8_t bit) {
+        const uint32_t corner = bit / CELL_CORNER_BITS, slot = bit % CELL_CORNER_BITS;
+        std::array<int, 2> quarter = { int(corner & 1U) * QUARTERS_PER_PIXEL - 2, int(corner >> 1U) * QUARTERS_PER_PIXEL - 2 };
+        if (slot > 0U) {
+            quarter[0] += QUADRANT_OFFSETS[slot - 1U].x;
+            quarter[1] += QUADRANT_OFFSETS[slot - 1U].y;
+        }
+        return quarter;
+    };
+    auto angleLess = [](std::array<int, 2> a, std::array<int, 2> b) {
+        const bool a_lower = a[1] < 0 || (a[1] == 0 && a[0] < 0);
+        const bool b_lower = b[1] < 0 || (b[1] == 0 && b[0] < 0);
+        if (a_lower != b_lower) { return b_lower; }
+        return (a[0] * b[1]) - (a[1] * b[0]) > 0;
+    };
+
+    std::array<uint8_t, 4U * CELL_CORNER_BITS> order {};
+    for (size_t bit = 0; bit < order.size(); bit++) {
+        size_t index = bit;
+        for (; index > 0 && angleLess(offset(uint8_t(bit)), offset(order[index - 1])); index--) { order[index] = order[index - 1]; }
+        order[index] = uint8_t(bit);
+    }
+    return order;
+}();
+
+inline uint32_t findRoot(std::vector<uint32_t>& parents, uint32_t pixel) {
+    while (parents[pixel] != pixel) {
+        parents[pixel] = parents[parents[pixel]]; // Path halving
+        pixel = parents[pixel];
+    }
+    return pixel;
+}
+
+// Join the sets of two pixels; the root of every set is its first pixel, which makes the labelling deterministic
+inline void uniteSets(std::vector<uint32_t>& parents, uint32_t a, uint32_t b) {
+    a = findRoot(parents, a);
+    b = findRoot(parents, b);
+    if (a < b) { parents[b] = a; }
+    else if (b < a) { parents[a] = b; }
+}
+
+/**
+ * Label the connected components of a similarity graph. Every tile of rows is labelled with its own union-find in
+ * parallel, after which a sequential merge pass unites the edges crossing the tile boundaries
+ *
+ * @param similarity Similarity graph to label
+ * @param tile_height Rows per tile
+ *
+ * @return Shape of every pixel
+*/
+inline ShapeLabels labelShapes(const SimilarityGraph& similarity, int tile_height = SHAPE_LABEL_TILE_HEIGHT) {
+    const int width = similarity.width, height = similarity.height;
+    std::vector<uint32_t> parents(similarity.connections.size());
+    for (size_t pixel = 0; pixel < parents.size(); pixel++) { parents[pixel] = uint32_t(pixel); }
+    // Edges towards the next row and the next pixel of the row; the opposite ones are the same edges seen from the other end
+    constexpr std::array<uint8_t, 4> FORWARD_DIRECTIONS = { EAST, SOUTH_WEST, SOUTH, SOUTH_EAST };
+    auto uniteForward = [&](int x, int y, bool within_row) {
+        const uint8_t mask = similarity.connections[similarity.getOffset(x, y)];
+        for (uint8_t direction : FORWARD_DIRECTIONS) {
+            if ((direction == EAST) != within_row || !(mask & directionBit(direction))) { continue; }
+            const glm::ivec2 neighbour = glm::ivec2(x, y) + NEIGHBOUR_OFFSETS[direction];
+            uniteSets(parents, uint32_t(similarity.getOffset(x, y)), uint32_t(similarity.getOffset(neighbour.x, neighbour.y)));
+        }
+    };
+
+    const int tiles = (height + tile_height - 1) / tile_height;
+    #pragma omp parallel for schedule(static)
+    for (int tile = 0; tile < tiles; tile++) {
+        const int tile_end = std::min(height, (tile + 1) * tile_height);
+        for (int y = tile * tile_height; y < tile_end; y++) {
+            for (int x = 0; x < width; x++) {
+                uniteForward(x, y, true);
+                if (y + 1 < tile_end) { uniteForward(x, y, false); }
+            }
+        }
+    }
+    for (int tile = 1; tile < tiles; tile++) {
+        for (int x = 0; x < width; x++) { uniteForward(x, (tile * tile_height) - 1, false); }
+    }
+
+    ShapeLabels labels { width, height, std::vector<uint32_t>(parents.size()), {} };
+    for (size_t pixel = 0; pixel < parents.size(); pixel++) {
+        if (parents[pixel] != pixel) { continue; }
+        labels.labels[pixel] = uint32_t(labels.first_pixels.size());
+        labels.first_pixels.push_back(uint32_t(pixel));
+    }
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t root = uint32_t(similarity.getOffset(x, y));
+            while (parents[root] != root) { root = parents[root]; }
+            labels.labels[similarity.getOffset(x, y)] = labels.labels[root];
+        }
+    }
+    return labels;
+}
+
+struct OutlineEdge {
+    glm::ivec2 from, to;
+};
+
+/**
+ * Link the outline edges of one shape into closed outlines. Where outlines of the shape touch in a vertex, every edge is
+ * continued by the first edge clockwise from its reverse, which keeps the shape on the left and the outlines apart
+ *
+ * @param edges Outline edges of the shape, sorted in-place
+ * @param shape Shape receiving the outlines
+*/
+inline void linkOutlineEdges(std::vector<OutlineEdge>& edges, PixelShape& shape) {
+    auto vertexLess = [](glm::ivec2 a, glm::ivec2 b) { return a.y != b.y ? a.y < b.y : a.x < b.x; };
+    std::sort(edges.begin(), edges.end(), [&](const OutlineEdge& a, const OutlineEdge& b) {
+        return a.from != b.from ? vertexLess(a.from, b.from) : vertexLess(a.to, b.to);
+    });
+    auto angle = [](glm::ivec2 offset) { return std::atan2(double(offset.y), double(offset.x)); };
+
+    std::vector<bool> linked(edges.size(), false);
+    for (size_t start = 0; start < edges.size(); start++) {
+        if (linked[start]) { continue; }
+        std::vector<glm::ivec2> outline;
+        int64_t doubled_area = 0;
+        size_t current = start;
+        do {
+            linked[current] = true;
+            const OutlineEdge& edge = edges[current];
+            outline.push_back(edge.from);
+            doubled_area += (int64_t(edge.from.x) * edge.to.y) - (int64_t(edge.to.x) * edge.from.y);
+
+            const auto first = std::lower_bound(edges.begin(), edges.end(), edge.to, [&](const OutlineEdge& candidate, glm::ivec2 vertex) {
+                return vertexLess(candidate.from, vertex);
+            });
+            size_t next = size_t(first - edges.begin());
+            const double back = angle(edge.from - edge.to);
+            double best_rotation = 3.0 * std::numbers::pi;
+            for (size_t candidate = next; candidate < edges.size() && edges[candidate].from == edge.to; candidate++) {
+                double rotation = back - angle(edges[candidate].to - edges[candidate].from);
+                while (rotation <= 0.0) { rotation += 2.0 * std::numbers::pi; }
+                if (rotation < best_rotation) {
+                    best_rotation   = rotation;
+                    next            = candidate;
+                }
+            }
+            if (next >= edges.size() || edges[next].from != edge.to || (linked[next] && next != start)) {
+                std::cerr << "Outline of shape with value " << shape.value.x << ", " << shape.value.y << ", " << shape.value.z
+                          << " is not closed at " << edge.to.x << ", " << edge.to.y << std::endl;
+                throw std::exception();
+            }
+            current = next;
+        } while (current != start);
+        (doubled_area > 0 ? shape.outer : shape.inner).push_back(std::move(outline));
+    }
+}
+
+/**
+ * Trace the outer and inner outlines of every shape. A single parallel sweep over the cells emits the boundary edges
+ * between consecutive corners of every cell that are not shared with a neighbouring cell of the same shape (unlike the
+ * Python version, edges between dissimilar pixels of the same shape are interior), after which the edges of every shape
+ * are linked into closed outlines in parallel
+ *
+ * @param src Image the graphs were built for
+ * @param graph Pixel cell graph of the image
+ * @param labels Output of labelShapes
+ *
+ * @return Every shape, indexed by its label
+*/
+inline std::vector<PixelShape> traceShapeOutlines(const Image<glm::uvec3>& src, const PixelCellGraph& graph, const ShapeLabels& labels) {
+    std::vector<std::vector<std::pair<uint32_t, OutlineEdge>>> row_edges(size_t(src.height));
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.height; y++) {
+        for (int x = 0; x < src.width; x++) {
+            const uint32_t mask     = graph.corners[x + (y * graph.width)];
+            const uint32_t label    = labels.label(x, y);
+            std::array<glm::ivec2, CELL_CORNER_ORDER.size()> cell;
+            size_t corner_count = 0U;
+            for (uint8_t bit : CELL_CORNER_ORDER) {
+                if (!(mask & (1U << bit))) { continue; }
+                const uint32_t corner = bit / CELL_CORNER_BITS;
+                cell[corner_count++] = PixelCellGraph::slotVertex(glm::ivec2(x + int(corner & 1U), y + int(corner >> 1U)), bit % CELL_CORNER_BITS);
+            }
+            if (corner_count < 2U) { continue; }
+
+            for (size_t corner = 0; corner < corner_count; corner++) {
+                const OutlineEdge edge { cell[corner], cell[(corner + 1U) % corner_count] };
+                bool interior = false;
+                for (uint8_t direction = 0U; direction < 8U && !interior; direction++) {
+                    const glm::ivec2 neighbour = glm::ivec2(x, y) + NEIGHBOUR_OFFSETS[direction];
+                    if (neighbour.x < 0 || neighbour.x >= src.width || neighbour.y < 0 || neighbour.y >= src.height) { continue; }
+                    interior = labels.label(neighbour.x, neighbour.y) == label &&
+                               graph.isCorner(neighbour.x, neighbour.y, edge.from) && graph.isCorner(neighbour.x, neighbour.y, edge.to);
+                }
+                if (!interior) { row_edges[y].emplace_back(label, edge); }
+            }
+        }
+    }
+
+    // Group the edges by shape
+    std::vector<std::vector<OutlineEdge>> shape_edges(labels.shapeCount());
+    for (const std::vector<std::pair<uint32_t, OutlineEdge>>& edges : row_edges) {
+        for (const auto& [label, edge] : edges) { shape_edges[label].push_back(edge); }
+    }
+
+    // Exceptions cannot leave the parallel loop, so the failure of every shape is kept and the first one rethrown after it
+    std::vector<PixelShape> shapes(labels.shapeCount());
+    std::vector<std::exception_ptr> failures(shapes.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t label = 0; label < int64_t(shapes.size()); label++) {
+        PixelShape& shape = shapes[size_t(label)];
+        shape.value = src.data[labels.first_pixels[size_t(label)]];
+        try {
+            linkOutlineEdges(shape_edges[size_t(label)], shape);
+        } catch (...) {
+            failures[size_t(label)] = std::current_exception();
+        }
+    }
+    for (const std::exception_ptr& failure : failures) {
+        if (failure) { std::rethrow_exception(failure); }
+    }
+    return shapes;
+}
+
+/**
+ * Compute the shapes of an image and their outlines
+ *
+ * @param src Image to compute the shapes of
+ * @param similarity Planar similarity graph of the image (see computeSimilarityGraph)
+ * @param graph Pixel cell graph of the image (see computePixelCellGraph)
+ *
+ * @return Every shape with its outlines
+*/
+inline std::vector<PixelShape> computePixelShapes(const Image<glm::uvec3>& src, const SimilarityGraph& similarity, const PixelCellGraph& graph) {
+    return traceShapeOutlines(src, graph, labelShapes(similarity));
+}
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef KL_SIMILARITY_GRAPH_HPP
+#define KL_SIMILARITY_GRAPH_HPP
+
+#include <array>
+#include <bit>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "common.hpp"
+
+// Kopf-Lischinski similarity graph and diagonal resolution (sections 3.1 and 3.2 of the paper).
+// Native counterpart of Vectorizer._create_similarity_graph/_remove_diagonals and heuristics.py
+
+// Neighbour directions of a pixel, clockwise starting from the east; each one is a bit in the connectivity mask
+enum NeighbourDirection : uint8_t { EAST, SOUTH_EAST, SOUTH, SOUTH_WEST, WEST, NORTH_WEST, NORTH, NORTH_EAST };
+constexpr std::array<glm::ivec2, 8> NEIGHBOUR_OFFSETS = {
+    glm::ivec2( 1,  0), glm::ivec2( 1,  1), glm::ivec2( 0,  1), glm::ivec2(-1,  1),
+    glm::ivec2(-1,  0), glm::ivec2(-1, -1), glm::ivec2( 0, -1), glm::ivec2( 1, -1)};
+
+constexpr uint32_t SPARSE_WINDOW_SIZE       = 8U; // Must be even
+constexpr int32_t ISLAND_HEURISTIC_WEIGHT   = 5;
+
+constexpr inline uint8_t directionBit(uint8_t direction) { return uint8_t(1U << direction); }
+constexpr inline uint8_t oppositeDirection(uint8_t direction) { return uint8_t((direction + 4U) % 8U); }
+
+struct SimilarityGraph {
+    int width, height;
+    std::vector<uint8_t> connections; // One bit per NeighbourDirection for every pixel, stored row by row
+
+    size_t getOffset(int x, int y) const { return x + (y * width); }
+    bool connected(int x, int y, uint8_t direction) const { return connections[getOffset(x, y)] & directionBit(direction); }
+    int valence(int x, int y) const { return std::popcount(connections[getOffset(x, y)]); }
+};
+
+/**
+ * Build the similarity graph of an image, connecting every pixel to each of its 8 neighbours that is 'similar'
+ * according to the hqx YUV channel difference thresholds
+ *
+ * @param src Image to build the graph for
+ *
+ * @return Similarity graph with symmetric connectivity masks
+*/
+inline SimilarityGraph createSimilarityGraph(const Image<glm::uvec3>& src) {
+    SimilarityGraph graph { src.width, src.height, std::vector<uint8_t>(src.data.size(), 0U) };
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.height; y++) {
+        for (int x = 0; x < src.width; x++) {
+            uint8_t mask = 0U;
+            for (uint8_t direction = 0U; direction < 8U; direction++) {
+                glm::ivec2 neighbour = glm::ivec2(x, y) + NEIGHBOUR_OFFSETS[direction];
+                bool in_bounds = (neighbour.x >= 0 && neighbour.x < src.width) && (neighbour.y >= 0 && neighbour.y < src.height);
+                if (in_bounds && !yuvDifference(src.data[src.getImageOffset(x, y)], src.data[src.getImageOffset(neighbour.x, neighbour.y)])) {
+                    mask |= directionBit(direction);
+                }
+            }
+            graph.connections[graph.getOffset(x, y)] = mask;
+        }
+    }
+    return graph;
+}
+
+/**
+ * Compute the 'Curves' heuristic for an edge: the number of edges along the valence-2 path the edge is part of
+ *
+ * @param graph Similarity graph containing the edge
+ * @param start Pixel at one end of the edge
+ * @param direction Direction of the edge as seen from start
+ *
+ * @return Length of the curve in edges (at least 1)
+*/
+inline int32_t curveHeuristic(const SimilarityGraph& graph, glm::ivec2 start, uint8_t direction) {
+    const glm::ivec2 end = start + NEIGHBOUR_OFFSETS[direction];
+    int32_t edges_in_curve = 1;
+
+    // Walk away from the edge in both directions while the path continues through valence-2 pixels
+    for (int side = 0; side < 2; side++) {
+        glm::ivec2 current      = (side == 0) ? end : start;
+        uint8_t arrived_from    = (side == 0) ? oppositeDirection(direction) : direction;
+        while (graph.valence(current.x, current.y) == 2) {
+            uint8_t remaining   = graph.connections[graph.getOffset(current.x, current.y)] & ~directionBit(arrived_from);
+            uint8_t next_dir    = uint8_t(std::countr_zero(remaining));
+            glm::ivec2 next     = current + NEIGHBOUR_OFFSETS[next_dir];
+            // Closed loop back onto the starting edge, so every edge of the curve has been counted
+            if ((current == start && next == end) || (current == end && next == start)) { return edges_in_curve; }
+
+            edges_in_curve++;
+            arrived_from    = oppositeDirection(next_dir);
+            current         = next;
+        }
+    }
+    return edges_in_curve;
+}
+
+/**
+ * Compute the 'Sparse pixels' heuristic for an edge: the negated size of the component connected to the edge
+ * within a SPARSE_WINDOW_SIZE x SPARSE_WINDOW_SIZE window centred on it
+ *
+ * @param graph Similarity graph containing the edge
+ * @param start Pixel at one end of the edge
+ * @param direction Direction of the edge as seen from start
+ *
+ * @return Negated number of pixels connected to the edge inside the window
+*/
+inline int32_t sparseHeuristic(const SimilarityGraph& graph, glm::ivec2 start, uint8_t direction) {
+    static_assert(SPARSE_WINDOW_SIZE * SPARSE_WINDOW_SIZE <= 64U, "Sparse window must fit in a 64-bit visited mask");
+    const glm::ivec2 end            = start + NEIGHBOUR_OFFSETS[direction];
+    const glm::ivec2 window_origin  = glm::min(start, end) - glm::ivec2(int(SPARSE_WINDOW_SIZE / 2) - 1);
+    auto window_bit = [&](glm::ivec2 pixel) {
+        glm::ivec2 local = pixel - window_origin;
+        return uint64_t(1) << (local.x + local.y * int(SPARSE_WINDOW_SIZE));
+    };
+
+    uint64_t visited = window_bit(start) | window_bit(end);
+    std::array<glm::ivec2, SPARSE_WINDOW_SIZE * SPARSE_WINDOW_SIZE> stack;
+    size_t stack_size = 0U;
+    stack[stack_size++] = start;
+    stack[stack_size++] = end;
+    while (stack_size > 0U) {
+        glm::ivec2 pixel = stack[--stack_size];
+        for (uint8_t neighbour_dir = 0U; neighbour_dir < 8U; neighbour_dir++) {
+            if (!graph.connected(pixel.x, pixel.y, neighbour_dir)) { continue; }
+            glm::ivec2 neighbour    = pixel + NEIGHBOUR_OFFSETS[neighbour_dir];
+            glm::ivec2 local        = neighbour - window_origin;
+            bool in_window          = (local.x >= 0 && local.x < int(SPARSE_WINDOW_SIZE)) && (local.y >= 0 && local.y < int(SPARSE_WINDOW_SIZE));
+            if (!in_window || (visited & window_bit(neighbour))) { continue; }
+            visited |= window_bit(neighbour);
+            stack[stack_size++] = neighbour;
+        }
+    }
+    return -std::popcount(visited);
+}
+
+/**
+ * Compute the 'Islands' heuristic for an edge
+ *
+ * @param graph Similarity graph containing the edge
+ * @param start Pixel at one end of the edge
+ * @param direction Direction of the edge as seen from start
+ *
+ * @return ISLAND_HEURISTIC_WEIGHT if removing the edge would leave a valence-0 pixel, 0 otherwise
+*/
+inline int32_t islandHeuristic(const SimilarityGraph& graph, glm::ivec2 start, uint8_t direction) {
+    const glm::ivec2 end = start + NEIGHBOUR_OFFSETS[direction];
+    if (graph.valence(start.x, start.y) == 1 || graph.valence(end.x, end.y) == 1) { return ISLAND_HEURISTIC_WEIGHT; }
+    return 0;
+}
+
+inline int32_t diagonalWeight(const SimilarityGraph& graph, glm::ivec2 start, uint8_t direction) {
+    return curveHeuristic(graph, start, direction) + sparseHeuristic(graph, start, direction) + islandHeuristic(graph, start, direction);
+}
+
+// Diagonals of the 2x2 block whose top-left pixel is (x, y): (x, y)-(x+1, y+1) and (x+1, y)-(x, y+1)
+constexpr uint8_t BLOCK_MAIN_DIAGONAL = 0x1;
+constexpr uint8_t BLOCK_ANTI_DIAGONAL = 0x2;
+
+/**
+ * Remove the diagonals marked in the per-block removal masks. Every pixel only clears its own bits, gathering the
+ * decisions of the (up to) four blocks it is part of, so rows can be processed in parallel without write conflicts
+ *
+ * @param graph Similarity graph to update
+ * @param removals One BLOCK_*_DIAGONAL mask per 2x2 block, indexed by the block's top-left pixel
+*/
+inline void applyDiagonalRemovals(SimilarityGraph& graph, const std::vector<uint8_t>& removals) {
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < graph.height; y++) {
+        for (int x = 0; x < graph.width; x++) {
+            auto removed = [&](int block_x, int block_y, uint8_t diagonal) {
+                bool valid = (block_x >= 0 && block_x < graph.width - 1) && (block_y >= 0 && block_y < graph.height - 1);
+                return valid && (removals[graph.getOffset(block_x, block_y)] & diagonal);
+            };
+            uint8_t& mask = graph.connections[graph.getOffset(x, y)];
+            if (removed(x, y, BLOCK_MAIN_DIAGONAL))         { mask &= ~directionBit(SOUTH_EAST); }
+            if (removed(x - 1, y - 1, BLOCK_MAIN_DIAGONAL)) { mask &= ~directionBit(NORTH_WEST); }
+            if (removed(x - 1, y, BLOCK_ANTI_DIAGONAL))     { mask &= ~directionBit(SOUTH_WEST); }
+            if (removed(x, y - 1, BLOCK_ANTI_DIAGONAL))     { mask &= ~directionBit(NORTH_EAST); }
+        }
+    }
+}
+
+/**
+ * Resolve crossing diagonals in every 2x2 block of the similarity graph. Diagonals of fully connected blocks are
+ * removed outright; in all other blocks with two crossing diagonals the diagonal(s) with the lowest heuristic
+ * weight are removed. All weights are computed on the graph before any of the heuristic removals are applied
+ *
+ * @param graph Similarity graph to planarise
+*/
+inline void removeDiagonals(SimilarityGraph& graph) {
+    if (graph.width < 2 || graph.height < 2) { return; }
+    std::vector<uint8_t> removals(graph.connections.size(), 0U);
+    std::vector<uint8_t> ambiguous(graph.connections.size(), 0U);
+
+    // Fully connected blocks (case 1) carry no information in their diagonals
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < graph.height - 1; y++) {
+        for (int x = 0; x < graph.width - 1; x++) {
+            if (!graph.connected(x, y, SOUTH_EAST) || !graph.connected(x + 1, y, SOUTH_WEST)) { continue; }
+            bool fully_connected = graph.connected(x, y, EAST) && graph.connected(x, y, SOUTH) &&
+                                   graph.connected(x + 1, y, SOUTH) && graph.connected(x, y + 1, EAST);
+            if (fully_connected)    { removals[graph.getOffset(x, y)] = BLOCK_MAIN_DIAGONAL | BLOCK_ANTI_DIAGONAL; }
+            else                    { ambiguous[graph.getOffset(x, y)] = 1U; }
+        }
+    }
+    applyDiagonalRemovals(graph, removals);
+
+    // Crossing diagonals that are not part of a fully connected block (case 2) are resolved with the heuristics.
+    // Blocks with only some of their axis-aligned edges are resolved the same way rather than rejected
+    std::fill(removals.begin(), removals.end(), uint8_t(0U));
+    #pragma omp parallel for schedule(dynamic)
+    for (int y = 0; y < graph.height - 1; y++) {
+        for (int x = 0; x < graph.width - 1; x++) {
+            if (!ambiguous[graph.getOffset(x, y)]) { continue; }
+            int32_t main_weight = diagonalWeight(graph, glm::ivec2(x, y), SOUTH_EAST);
+            int32_t anti_weight = diagonalWeight(graph, glm::ivec2(x + 1, y), SOUTH_WEST);
+            uint8_t removal = 0U;
+            if (main_weight <= anti_weight) { removal |= BLOCK_MAIN_DIAGONAL; }
+            if (anti_weight <= main_weight) { removal |= BLOCK_ANTI_DIAGONAL; }
+            removals[graph.getOffset(x, y)] = removal;
+        }
+    }
+    applyDiagonalRemovals(graph, removals);
+}
+
+/**
+ * Compute the planar similarity graph of an image as in sections 3.1 and 3.2 of the Kopf-Lischinski paper
+ *
+ * @param src Image to build the graph for
+ *
+ * @return Similarity graph without crossing diagonals
+*/
+inline SimilarityGraph computeSimilarityGraph(const Image<glm::uvec3>& src) {
+    SimilarityGraph graph = createSimilarityGraph(src);
+    removeDiagonals(graph);
+    return graph;
+}
+
+#endif
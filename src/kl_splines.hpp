@@ -0,0 +1,184 @@
+#ifndef KL_SPLINES_HPP
+#define KL_SPLINES_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+DISABLE_WARNINGS_POP()
+
+// Kopf-Lischinski spline extraction and smoothing (section 3.4 of the paper).
+// Native counterpart of ClosedBSpline, curve_to_closed_bspline and SplineSmoother in geometry.py
+
+constexpr uint32_t SMOOTHING_ITERATIONS         = 20U;
+constexpr uint32_t SMOOTHING_POINT_GUESSES      = 20U;
+constexpr double SMOOTHING_GUESS_OFFSET         = 0.05;
+constexpr double POSITIONAL_ENERGY_MULTIPLIER   = 1.0;
+constexpr uint64_t DEFAULT_SMOOTHING_SEED       = 0x5eed5eed5eed5eedULL;
+
+struct QuadraticBezier {
+    glm::dvec2 start, control, end;
+};
+
+/**
+ * Closed quadratic B-spline with a uniform knot vector, as produced by curve_to_closed_bspline in geometry.py.
+ * Only the n unique control points are stored; the two wrapped copies at the end are implied by the indexing
+*/
+class ClosedBSpline {
+public:
+    ClosedBSpline() = default;
+    explicit ClosedBSpline(std::vector<glm::dvec2> control_points) : points(std::move(control_points)) {}
+
+    size_t size() const { return points.size(); }
+    const glm::dvec2& point(size_t index) const { return points[index % points.size()]; }
+    void movePoint(size_t index, glm::dvec2 value) { points[index % points.size()] = value; }
+
+    /**
+     * Compute the curve segment spanning knots [index + 2, index + 3] in Bezier form
+     *
+     * @param segment Index of the segment [0..size() - 1]
+     *
+     * @return The quadratic Bezier curve that the segment is equivalent to
+    */
+    QuadraticBezier bezierSegment(size_t segment) const {
+        const glm::dvec2& p0 = point(segment);
+        const glm::dvec2& p1 = point(segment + 1);
+        const glm::dvec2& p2 = point(segment + 2);
+        return { 0.5 * (p0 + p1), p1, 0.5 * (p1 + p2) };
+    }
+
+    std::vector<QuadraticBezier> quadraticBezierSegments() const {
+        std::vector<QuadraticBezier> segments(points.size());
+        for (size_t segment = 0; segment < points.size(); segment++) { segments[segment] = bezierSegment(segment); }
+        return segments;
+    }
+
+    /**
+     * Analytically integrate the curvature of a segment over its knot span. Writing the segment as
+     * C(t) = at^2 + bt + c, the curvature is 2|a x b| / |2at + b|^3 whose antiderivative has a closed form
+     *
+     * @param segment Index of the segment [0..size() - 1]
+     *
+     * @return Integral of the curvature over the segment's span in the knot domain
+    */
+    double segmentCurvatureEnergy(size_t segment) const {
+        const glm::dvec2& p0 = point(segment);
+        const glm::dvec2& p1 = point(segment + 1);
+        const glm::dvec2& p2 = point(segment + 2);
+        const glm::dvec2 a = 0.5 * (p0 - 2.0 * p1 + p2);
+        const glm::dvec2 b = p1 - p0;
+
+        const double cross = std::abs((a.x * b.y) - (a.y * b.x));
+        const double scale = glm::dot(a, a) + glm::dot(b, b);
+        if (cross <= 1e-12 * scale) { return 0.0; } // Straight (or degenerate) segment
+
+        const double A = 4.0 * glm::dot(a, a);
+        const double B = 4.0 * glm::dot(a, b);
+        const double C = glm::dot(b, b);
+        auto antiderivative = [&](double t) { return ((2.0 * A * t) + B) / (4.0 * cross * std::sqrt((A * t * t) + (B * t) + C)); };
+        return (antiderivative(1.0) - antiderivative(0.0)) / knotCount();
+    }
+
+    /**
+     * Compute the curvature energy term of a control point. Matches BSpline.curvature_energy in geometry.py, which
+     * integrates over the two knot spans starting at the point's index (i.e. segments index - 2 and index - 1)
+     *
+     * @param index Index of the control point
+     *
+     * @return The value of the curvature energy term
+    */
+    double curvatureEnergy(size_t index) const {
+        const size_t n = points.size();
+        return segmentCurvatureEnergy((index + n - 2) % n) + segmentCurvatureEnergy((index + n - 1) % n);
+    }
+
+    ClosedBSpline reversed() const { return ClosedBSpline(std::vector<glm::dvec2>(points.rbegin(), points.rend())); }
+
+private:
+    // Number of knot intervals of the equivalent wrapped knot vector, which is the inverse of the knot spacing
+    double knotCount() const { return double(points.size() + 4U); }
+
+    std::vector<glm::dvec2> points;
+};
+
+/**
+ * Fit a closed quadratic B-spline to a closed path by using its nodes directly as control points
+ *
+ * @param path Nodes of a closed path, without repeating the first node at the end
+ *
+ * @return Closed B-spline with uniform knots
+*/
+inline ClosedBSpline curveToClosedBSpline(const std::vector<glm::dvec2>& path) {
+    return ClosedBSpline(path);
+}
+
+/**
+ * Compute the total (positional + curvature) energy of a control point as in section 3.4 of the paper
+ *
+ * @param spline Spline being optimised
+ * @param original Spline before optimisation
+ * @param index Index of the control point
+ *
+ * @return Sum of the curvature and positional energy terms
+*/
+inline double pointEnergy(const ClosedBSpline& spline, const ClosedBSpline& original, size_t index) {
+    double offset       = glm::length(spline.point(index) - original.point(index));
+    double positional   = (offset * offset) * (offset * offset) * POSITIONAL_ENERGY_MULTIPLIER;
+    return spline.curvatureEnergy(index) + positional;
+}
+
+/**
+ * Minimise the energy of a spline by repeatedly trying random offsets for every control point
+ *
+ * @param spline Spline to smooth in-place
+ * @param rng Random number generator driving the guesses
+*/
+template<typename RNG>
+void smoothSpline(ClosedBSpline& spline, RNG& rng) {
+    const ClosedBSpline original = spline;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (uint32_t iteration = 0U; iteration < SMOOTHING_ITERATIONS; iteration++) {
+        for (size_t index = 0; index < spline.size(); index++) {
+            const glm::dvec2 start  = spline.point(index);
+            glm::dvec2 best_point   = start;
+            double best_energy      = pointEnergy(spline, original, index);
+            for (uint32_t guess = 0U; guess < SMOOTHING_POINT_GUESSES; guess++) {
+                double offset   = unit(rng) * SMOOTHING_GUESS_OFFSET;
+                double angle    = unit(rng) * 2.0 * std::numbers::pi;
+                glm::dvec2 candidate = start + (offset * glm::dvec2(std::cos(angle), std::sin(angle)));
+                spline.movePoint(index, candidate);
+                double energy = pointEnergy(spline, original, index);
+                if (energy < best_energy) {
+                    best_energy = energy;
+                    best_point  = candidate;
+                }
+            }
+            spline.movePoint(index, best_point);
+        }
+    }
+}
+
+/**
+ * Smooth independent splines in parallel. Every spline draws from its own generator seeded by (seed, index), so
+ * the result does not depend on the number of threads or on scheduling
+ *
+ * @param splines Splines to smooth in-place
+ * @param seed Seed shared by all generators
+*/
+inline void smoothSplines(std::vector<ClosedBSpline>& splines, uint64_t seed = DEFAULT_SMOOTHING_SEED) {
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t index = 0; index < int64_t(splines.size()); index++) {
+        std::seed_seq seed_sequence { uint32_t(seed), uint32_t(seed >> 32), uint32_t(index), uint32_t(uint64_t(index) >> 32) };
+        std::mt19937_64 rng(seed_sequence);
+        smoothSpline(splines[size_t(index)], rng);
+    }
+}
+
+#endif
@@ -1,7 +1,18 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <framework/disable_all_warnings.h>
@@ -11,22 +22,53 @@ DISABLE_WARNINGS_PUSH()
 DISABLE_WARNINGS_POP()
 #include <framework/image.h>
 
-#ifdef NDEBUG
-#include <omp.h>
-#endif
-
 #include "common.hpp"
 #include "2xsai.hpp"
+#include "auto_tuner.hpp"
+#include "batched_io.hpp"
 #include "eagle.hpp"
 #include "epx.hpp"
+#include "fused_chain.hpp"
 #include "hq2x.hpp"
+#include "hybrid.hpp"
+#include "memory_accountant.hpp"
+#include "mip_writer.hpp"
 #include "nedi.hpp"
+#include "result_cache.hpp"
+#ifdef __unix__
+#include "scale_server.hpp"
+#endif
+#include "streaming.hpp"
+#include "task_scheduler.hpp"
 #include "xbr.hpp"
 
 static constexpr uint32_t MAX_UPSCALE_FACTOR = 16U; // Must be a power of two >=2
 
+// Estimated cost of producing one output pixel (roughly nanoseconds on a single core), used to order the tasks
+static constexpr double EPX_COST        = 10.0;
+static constexpr double ADV_MAME_COST   = 10.0;
+static constexpr double EAGLE_COST      = 9.0;
+static constexpr double SAI_COST        = 13.0;
+static constexpr double HQ2X_COST       = 60.0;
+static constexpr double XBR_COST        = 170.0;
+static constexpr double NEDI_COST       = 5000.0;
+static constexpr double HYBRID_COST     = 500.0; // Depends on the share of gradient tiles, which run NEDI
+static constexpr double PNG_ENCODE_COST = 80.0; // Per pixel of the encoded image
+static constexpr double QOI_ENCODE_COST = 5.0;
+static constexpr double RAW_ENCODE_COST = 1.0;
+
+static constexpr uint64_t RESULT_CACHE_CAPACITY = 1ULL << 30U; // Bytes of cached outputs kept across runs
+static constexpr std::string_view MEMORY_BUDGET_ARGUMENT = "--memory-budget=";
+static constexpr std::string_view FORMAT_ARGUMENT = "--format=";
+static constexpr std::string_view SERVE_ARGUMENT = "--serve";
+static constexpr std::string_view HYBRID_ARGUMENT = "--hybrid";
+static constexpr std::string_view TUNE_ARGUMENT = "--tune";
+static constexpr std::string_view IO_ARGUMENT = "--io=";
+
 static const std::filesystem::path data_dir_path { DATA_DIR };
 static const std::filesystem::path out_dir_path { OUTPUT_DIR };
+static const std::filesystem::path cache_dir_path { out_dir_path / ".cache" };
+static const std::filesystem::path tuning_profile_path { out_dir_path / ".tuning" };
 
 // Is there a better way to do this? Yes.
 // Do I have the time? Questionable.
@@ -51,44 +93,510 @@ static const std::vector<std::string> TEST_FILES = {
     "smw_mario_input",
     "smw_mushroom_input"};
 
+// Encodings of the output files (see Image::writeToFile). Container formats write all the factors of a chain into a
+// single mip container (see mip_writer.hpp) instead of one file per factor
+struct OutputFormat {
+    std::string name, extension;
+    double encode_cost;
+    bool container = false;
+    MipCodec codec = MIP_CODEC_RAW; // Of the levels of a container
+};
+
+static const std::vector<OutputFormat> OUTPUT_FORMATS = {
+    { "png",     ".png", PNG_ENCODE_COST },
+    { "qoi",     ".qoi", QOI_ENCODE_COST },
+    { "raw",     ".raw", RAW_ENCODE_COST },
+    { "mip",     ".pxm", RAW_ENCODE_COST, true, MIP_CODEC_RAW },
+    { "mip-qoi", ".pxm", QOI_ENCODE_COST, true, MIP_CODEC_QOI }};
+
+static const OutputFormat* output_format = &OUTPUT_FORMATS[0]; // Set once from the arguments, before any task is added
+static BatchedIo* batched_io = nullptr; // Writes every output file; set once, before any task is added
+
+static std::vector<std::filesystem::path> outputPaths(const std::string& filename, const std::string& algorithm) {
+    std::vector<std::filesystem::path> paths;
+    for (uint32_t scale_factor = 2U; scale_factor <= MAX_UPSCALE_FACTOR; scale_factor *= 2) {
+        paths.push_back(out_dir_path / (filename + "-scale_" + algorithm + "-" + std::to_string(scale_factor) + "X" + output_format->extension));
+    }
+    return paths;
+}
+
+/**
+ * Create the mip container of a chain if the output format is a container
+ *
+ * @param name Name of the container file, without extension
+ * @param first_factor Factor of the first level, the others doubling it
+ * @param level_count Number of levels
+ *
+ * @return Writer of the container, or nullptr if every factor goes to its own file
+*/
+static std::shared_ptr<MipContainerWriter> openContainer(const std::string& name, uint32_t first_factor, size_t level_count) {
+    if (!output_format->container) { return nullptr; }
+    std::vector<uint32_t> factors;
+    for (size_t level = 0; level < level_count; level++) { factors.push_back(first_factor << level); }
+    return std::make_shared<MipContainerWriter>(out_dir_path / (name + output_format->extension), factors, output_format->codec);
+}
+
+static NediPrecision nedi_precision = NEDI_FLOAT; // Set once from the arguments, before any task is added
+
+// Split of all NEDI pixels between the flat shortcut and the least-squares solve, reported at the end of a run
+static std::atomic<size_t> nedi_flat_pixels     = 0U;
+static std::atomic<size_t> nedi_solved_pixels   = 0U;
+
+static Image<glm::vec3> scaleNediCounted(const Image<glm::vec3>& src) {
+    NediStats stats;
+    Image<glm::vec3> result = scaleNedi(src, &stats, nedi_precision);
+    nedi_flat_pixels    += stats.flat_pixels;
+    nedi_solved_pixels  += stats.solved_pixels;
+    return result;
+}
+
+// Algorithms of the hybrid chains (if enabled) and their class histogram and time, reported at the end of a run
+static HybridConfig hybrid_config = defaultHybridConfig(); // Set once from the arguments, before any task is added
+static const RegisteredScaler* hybrid_reference = nullptr; // Most expensive algorithm of hybrid_config, set with it
+static std::mutex hybrid_stats_mutex;
+static HybridStats hybrid_stats;
+static double hybrid_reference_seconds = 0.0; // Of hybrid_reference on every pixel of the inputs of the hybrid passes
+
+static Image<glm::uvec3> scaleHybridCounted(const Image<glm::uvec3>& src) {
+    HybridStats stats;
+    Image<glm::uvec3> result = scaleHybrid(src, hybrid_config, &stats);
+
+    // The reference pass runs on the input of this pass, so that both times are spent on the same pixels
+    const auto start = std::chrono::steady_clock::now();
+    hybrid_reference->scale_chain(src, 1U);
+    const double reference_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard lock(hybrid_stats_mutex);
+    hybrid_stats.add(stats);
+    hybrid_reference_seconds += reference_seconds;
+    return result;
+}
+
+// Result cache of a run (if any) and the content hash of the input file whose chains are being scheduled
+struct ChainCache {
+    ResultCache* cache = nullptr;
+    uint64_t input_hash = 0U;
+    std::string settings; // Settings of the algorithm that change its outputs, appended to the algorithm in the keys
+
+    ResultKey key(const std::string& algorithm, uint32_t scale_factor, const std::filesystem::path& path) const {
+        return { input_hash, settings.empty() ? algorithm : algorithm + "[" + settings + "]", scale_factor, path.extension().string() };
+    }
+};
+
+/**
+ * Encode an output, store it in the result cache if the run has one and hand it to the batched writer, so that the
+ * calling task does not wait for the file system
+*/
+template<typename T>
+static void writeResult(const ChainCache& chain_cache, const std::string& algorithm, uint32_t scale_factor, const Image<T>& image,
+                        const std::filesystem::path& path) {
+    FileBytes encoded = image.encode(path);
+    if (chain_cache.cache) { chain_cache.cache->insert(chain_cache.key(algorithm, scale_factor, path), image, encoded); }
+    batched_io->write(path, std::move(encoded));
+}
+
+/**
+ * Serve a whole chain (or the copy of the input, as factor 1) from the result cache, if every output of it is cached
+ *
+ * @return True if tasks writing the cached outputs were added, false if the chain has to be computed
+*/
+static bool addCachedTasks(TaskScheduler& scheduler, const ChainCache& chain_cache, const std::string& algorithm,
+                           const std::vector<std::filesystem::path>& paths, uint32_t first_factor) {
+    if (!chain_cache.cache) { return false; }
+    auto results = std::make_shared<std::vector<CachedResult>>();
+    for (size_t level = 0; level < paths.size(); level++) {
+        std::optional<CachedResult> result = chain_cache.cache->find(chain_cache.key(algorithm, first_factor << level, paths[level]));
+        if (!result) { return false; }
+        results->push_back(std::move(*result));
+    }
+    for (size_t level = 0; level < paths.size(); level++) {
+        scheduler.addTask([=] {
+            const CachedResult& result = (*results)[level];
+            batched_io->write(paths[level], FileBytes(result.encoded(), result.encoded() + result.encodedSize()));
+        }, double((*results)[level].encodedSize()));
+    }
+    return true;
+}
+
+/**
+ * Produce the same outputs as the in-memory path, but stream every chain band by band straight into the PNG files
+ * so that the full-resolution outputs are never held in memory. Every chain is a single task
+*/
+template<typename T>
+static void addStreamTask(TaskScheduler& scheduler, const std::string& filename, std::shared_ptr<const Image<T>> input,
+                          ScaleFunction<T> scale, int halo, const std::string& algorithm, double cost_per_pixel, JobId job) {
+    const double output_pixels = double(input->width) * double(input->height) * double(MAX_UPSCALE_FACTOR * MAX_UPSCALE_FACTOR) * (4.0 / 3.0); // Geometric sum over all passes
+    scheduler.addTask([=] {
+        std::cout << "Streaming " << filename << " with " << algorithm << " up to " << MAX_UPSCALE_FACTOR << "x..." << std::endl;
+        streamScaleToPng(*input, scale, halo, outputPaths(filename, algorithm));
+    }, output_pixels * (cost_per_pixel + PNG_ENCODE_COST), {}, job);
+}
+
+/**
+ * Produce the same outputs as the in-memory path, but run every chain tile by tile through all of its passes (see
+ * scaleChainFused) so that the intermediate factors are only written once, as outputs. Every factor is encoded by its
+ * own task
+*/
+template<typename T>
+static void addFusedTasks(TaskScheduler& scheduler, const std::string& filename, std::shared_ptr<const Image<T>> input,
+                          ScaleFunction<T> scale, int halo, const std::string& algorithm, double cost_per_pixel,
+                          const ChainCache& chain_cache, int tile_size, JobId job) {
+    const std::vector<std::filesystem::path> paths = outputPaths(filename, algorithm);
+    const std::shared_ptr<MipContainerWriter> container = openContainer(filename + "-scale_" + algorithm, 2U, paths.size());
+    auto outputs = std::make_shared<std::vector<Image<T>>>();
+
+    const double input_pixels = double(input->width) * double(input->height);
+    const double output_pixels = input_pixels * double(MAX_UPSCALE_FACTOR * MAX_UPSCALE_FACTOR) * (4.0 / 3.0); // Geometric sum over all passes
+    const TaskId scale_task = scheduler.addTask([=] {
+        std::cout << "Scaling " << filename << " with " << algorithm << " up to " << MAX_UPSCALE_FACTOR << "x (fused)..." << std::endl;
+        *outputs = scaleChainFused(*input, scale, halo, std::vector<bool>(paths.size(), true), tile_size);
+    }, output_pixels * cost_per_pixel, {}, job);
+
+    double level_pixels = input_pixels;
+    for (size_t level = 0; level < paths.size(); level++) {
+        level_pixels *= 4.0;
+        scheduler.addTask([=] {
+            if (container) {
+                container->writeLevel(level, (*outputs)[level]);
+            } else {
+                writeResult(chain_cache, algorithm, 2U << level, (*outputs)[level], paths[level]);
+            }
+            (*outputs)[level] = Image<T>(); // Every task owns a different element, so this needs no synchronisation
+        }, level_pixels * output_format->encode_cost, { scale_task }, job);
+    }
+}
+
+// Output of one pass of a chain, handed to exactly two consumers: the next pass and the encoder
+template<typename T>
+struct ChainLevel {
+    std::shared_ptr<const Image<T>> to_scale, to_encode;
+};
+
+/**
+ * Add the tasks of a chain of 2x passes up to MAX_UPSCALE_FACTOR. Every pass depends on the previous one and is followed
+ * by its own encoding task, so that files (or the levels of the container of the chain) are written while later passes (of
+ * this or other chains) are still running
+ *
+ * @param scheduler Scheduler receiving the tasks
+ * @param filename Name of the input file, without extension
+ * @param input Input image
+ * @param scale 2x scaler
+ * @param algorithm Name of the algorithm, as used in the output file names
+ * @param cost_per_pixel Estimated cost of producing one output pixel with this scaler
+ * @param chain_cache Result cache receiving every encoded output
+ * @param job Job whose memory budget every task of the chain uses
+*/
+template<typename T>
+static void addChainTasks(TaskScheduler& scheduler, const std::string& filename, std::shared_ptr<const Image<T>> input,
+                          ScaleFunction<T> scale, const std::string& algorithm, double cost_per_pixel, const ChainCache& chain_cache,
+                          JobId job) {
+    const std::vector<std::filesystem::path> paths = outputPaths(filename, algorithm);
+    const std::shared_ptr<MipContainerWriter> container = openContainer(filename + "-scale_" + algorithm, 2U, paths.size());
+    auto levels = std::make_shared<std::vector<ChainLevel<T>>>(paths.size() + 1U);
+    (*levels)[0].to_scale = std::move(input);
+
+    double output_pixels = double((*levels)[0].to_scale->width) * double((*levels)[0].to_scale->height);
+    std::vector<TaskId> dependencies;
+    for (size_t level = 1; level <= paths.size(); level++) {
+        output_pixels *= 4.0;
+        const uint32_t scale_factor = 1U << level;
+        const TaskId scale_task = scheduler.addTask([=] {
+            std::cout << "Scaling " << filename << " with " << algorithm << " by " << scale_factor << "x..." << std::endl;
+            const std::shared_ptr<const Image<T>> source = std::move((*levels)[level - 1U].to_scale);
+            auto scaled = std::make_shared<const Image<T>>(scale(*source));
+            (*levels)[level].to_encode = scaled;
+            if (level < paths.size()) { (*levels)[level].to_scale = std::move(scaled); }
+        }, output_pixels * cost_per_pixel, dependencies, job);
+        scheduler.addTask([=] {
+            const std::shared_ptr<const Image<T>> scaled = std::move((*levels)[level].to_encode);
+            if (container) {
+                container->writeLevel(level - 1U, *scaled);
+            } else {
+                writeResult(chain_cache, algorithm, scale_factor, *scaled, paths[level - 1U]);
+            }
+        }, output_pixels * output_format->encode_cost, { scale_task }, job);
+        dependencies = { scale_task };
+    }
+}
+
+/**
+ * Add the job of a chain, whose peak memory is predicted for the mode the chain runs in
+ *
+ * @param scheduler Scheduler receiving the job
+ * @param input Input image of the chain
+ * @param halo Number of source rows/columns read around each pixel by the scaler
+ * @param scratch_bytes_per_pixel Scratch memory of the scaler, per output pixel
+ * @param streaming Whether the chain is streamed
+ * @param fused Whether the chain is tile-fused
+ *
+ * @return Identifier of the job
+*/
+template<typename T>
+static JobId addChainJob(TaskScheduler& scheduler, const Image<T>& input, int halo, double scratch_bytes_per_pixel, bool streaming, bool fused) {
+    const uint32_t passes = uint32_t(outputPaths("", "").size());
+    if (streaming) { return scheduler.addJob(streamedChainPeakBytes<T>(input.width, input.height, passes, halo, DEFAULT_BAND_HEIGHT, scratch_bytes_per_pixel)); }
+    if (fused) { return scheduler.addJob(fusedChainPeakBytes<T>(input.width, input.height, passes)); }
+    return scheduler.addJob(chainPeakBytes<T>(input.width, input.height, passes, scratch_bytes_per_pixel));
+}
+
+// Raster scalers on 8-bit pixels, which are run by every mode. Their implementations are those of TUNABLE_SCALERS picked
+// by the tuning profile
+struct RasterScaler {
+    int halo;
+    std::string algorithm;
+    double cost_per_pixel;
+};
+
+static const std::vector<RasterScaler> RASTER_SCALERS = {
+    { EPX_HALO,   "epx",      EPX_COST },
+    { EPX_HALO,   "adv_mame", ADV_MAME_COST },
+    { EAGLE_HALO, "eagle",    EAGLE_COST },
+    { SAI_HALO,   "2xSaI",    SAI_COST },
+    { HQ2X_HALO,  "hq2x",     HQ2X_COST },
+    { XBR_HALO,   "xbr",      XBR_COST }};
+
+// Estimated cost per output pixel of a raster scaler or NEDI
+static double algorithmCost(std::string_view algorithm) {
+    const auto scaler = std::find_if(RASTER_SCALERS.begin(), RASTER_SCALERS.end(), [&](const RasterScaler& s) { return s.algorithm == algorithm; });
+    return scaler != RASTER_SCALERS.end() ? scaler->cost_per_pixel : NEDI_COST;
+}
+
 int main(int argc, char** argv) {
+    // --stream: bound memory by the band height instead of the output size
+    // --fused: run every chain tile by tile instead of writing and reading back every intermediate factor
+    // --cache: reuse the outputs of earlier runs for unchanged inputs (streamed outputs are served but not stored)
+    // --memory-budget=<MiB>: only run as many chains at once as their predicted peak memory allows
+    // --format=png|qoi|raw|mip|mip-qoi: encoding of the output files (streamed outputs are always PNG). mip and mip-qoi
+    //                                   write every chain as one mip container of raw or QOI levels (see mip_writer.hpp)
+    // --serve[=<socket>]: instead of scaling the test files, serve scale jobs over a Unix domain socket until a client
+    //                     shuts the server down (see scale_server.hpp and fin-proj-client); --cache applies to them
+    // --hybrid[=<class>=<algorithm>,...]: also write hybrid chains, which scale every tile with the algorithm of its
+    //                                    class (see hybrid.hpp) and always run pass by pass
+    // --tune: calibrate the scaler variants and fused tile sizes first and keep them as the tuning profile,
+    //         which later runs load at startup (see auto_tuner.hpp)
+    // --io=uring|threads: batched file I/O on io_uring (the default, where available) or on a pool of blocking threads
+    // --nedi-half: run NEDI on half-precision planes, which halves its memory at the cost of rounding every pass
+    bool streaming = false, fused = false, cached = false, hybrid = false, tune = false, use_io_uring = true;
+    std::optional<std::filesystem::path> serve_socket;
+    uint64_t memory_budget = UNLIMITED_MEMORY;
+    for (int arg = 1; arg < argc; arg++) {
+        const std::string argument = argv[arg];
+        streaming   |= argument == "--stream";
+        fused       |= argument == "--fused";
+        cached      |= argument == "--cache";
+        if (argument == "--nedi-half") { nedi_precision = NEDI_HALF; }
+        tune        |= argument == TUNE_ARGUMENT;
+        if (argument == SERVE_ARGUMENT) { serve_socket = DEFAULT_SERVER_SOCKET; }
+        if (argument.starts_with(std::string(SERVE_ARGUMENT) + "=")) { serve_socket = argument.substr(SERVE_ARGUMENT.size() + 1U); }
+        if (argument == HYBRID_ARGUMENT) { hybrid = true; }
+        if (argument.starts_with(std::string(HYBRID_ARGUMENT) + "=")) {
+            const std::optional<HybridConfig> config = parseHybridConfig(argument.substr(HYBRID_ARGUMENT.size() + 1U));
+            if (!config) {
+                std::cerr << "Invalid hybrid configuration " << argument << " (expected <class>=<algorithm>,... with classes flat, axis-aligned, diagonal and gradient)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            hybrid_config   = *config;
+            hybrid          = true;
+        }
+        if (argument.starts_with(IO_ARGUMENT)) {
+            const std::string backend = argument.substr(IO_ARGUMENT.size());
+            if (backend != "uring" && backend != "threads") {
+                std::cerr << "Unknown I/O backend " << backend << " (expected uring or threads)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            use_io_uring = backend == "uring";
+        }
+        if (argument.starts_with(MEMORY_BUDGET_ARGUMENT)) {
+            const std::string value = argument.substr(MEMORY_BUDGET_ARGUMENT.size());
+            uint64_t mebibytes = 0U;
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), mebibytes);
+            if (value.empty() || error != std::errc() || end != value.data() + value.size() || mebibytes > (std::numeric_limits<uint64_t>::max() >> 20U)) {
+                std::cerr << "Invalid memory budget " << value << " (expected a number of MiB)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            memory_budget = mebibytes << 20U;
+        }
+        if (argument.starts_with(FORMAT_ARGUMENT)) {
+            const std::string name = argument.substr(FORMAT_ARGUMENT.size());
+            const auto format = std::find_if(OUTPUT_FORMATS.begin(), OUTPUT_FORMATS.end(), [&](const OutputFormat& f) { return f.name == name; });
+            if (format == OUTPUT_FORMATS.end()) {
+                std::cerr << "Unknown output format " << name << " (expected png, qoi, raw, mip or mip-qoi)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            output_format = &*format;
+        }
+    }
+    hybrid_reference = *std::max_element(hybrid_config.scalers.begin(), hybrid_config.scalers.end(), [](const RegisteredScaler* a, const RegisteredScaler* b) {
+        return algorithmCost(a->algorithm) < algorithmCost(b->algorithm);
+    });
+    if (streaming && output_format->extension != ".png") {
+        std::cerr << "Streamed outputs can only be written as PNG" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (cached && output_format->container) {
+        std::cerr << "Mip containers cannot be served from the result cache" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::unique_ptr<ResultCache> cache = cached ? std::make_unique<ResultCache>(cache_dir_path, RESULT_CACHE_CAPACITY) : nullptr;
+
+    if (serve_socket) {
+        #ifdef __unix__
+        try {
+            ScaleServer server(*serve_socket, 0U, cache.get());
+            std::cout << "Serving scale jobs on " << *serve_socket << std::endl;
+            server.serve();
+            const LatencySummary latencies = server.latencies();
+            std::cout << "Served " << latencies.requests << " scale jobs: p50 " << latencies.p50 << " us, p90 " << latencies.p90 << " us, p99 "
+                      << latencies.p99 << " us, max " << latencies.max << " us" << std::endl;
+        } catch (const std::exception&) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+        #else
+        std::cerr << "Serving scale jobs needs Unix domain sockets" << std::endl;
+        return EXIT_FAILURE;
+        #endif
+    }
+
+    TuningProfile profile;
+    if (tune) {
+        std::cout << "Calibrating the scalers..." << std::endl;
+        profile = calibrate();
+        saveProfile(profile, tuning_profile_path);
+        for (size_t scaler = 0; scaler < TUNABLE_SCALERS.size(); scaler++) {
+            std::cout << TUNABLE_SCALERS[scaler].algorithm << ":";
+            for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+                const TunedConfig& config = profile.configs[scaler][size_class];
+                std::cout << " " << SIZE_CLASS_NAMES[size_class] << " " << TUNABLE_SCALERS[scaler].variants[config.variant].name << "/" << config.tile_size
+                          << (size_class + 1U < SIZE_CLASS_COUNT ? "," : "");
+            }
+            std::cout << std::endl;
+        }
+        std::cout << "Tuning profile written to " << tuning_profile_path << std::endl;
+    } else if (const std::optional<TuningProfile> loaded = loadProfile(tuning_profile_path)) {
+        if (loaded->hardware_threads == profile.hardware_threads) {
+            profile = *loaded;
+        } else {
+            std::cerr << "Tuning profile " << tuning_profile_path << " was calibrated for " << loaded->hardware_threads << " hardware threads, run "
+                      << TUNE_ARGUMENT << " again" << std::endl;
+        }
+    }
+    std::cout << "Threads: " << profile.hardware_threads << " workers" << std::endl;
+
     #ifdef NDEBUG
-    #pragma omp parallel for schedule(guided)
+    TaskScheduler scheduler(profile.hardware_threads, memory_budget);
+    #else
+    TaskScheduler scheduler(1U, memory_budget); // Keep debug runs sequential
     #endif
-    for (int32_t testFileIdx = 0; testFileIdx < TEST_FILES.size(); testFileIdx++) { // No for-each loops because MSVC's OpenMP support is asinine
-        const std::string& filename = TEST_FILES[testFileIdx];
-        Image<glm::uvec3> input     = Image<glm::uvec3>(data_dir_path / (filename + ".png"));
-        Image<glm::vec3> input_flt  = Image<glm::vec3>(data_dir_path / (filename + ".png"));
-        input.writeToFile(out_dir_path / (filename + "-initial_image.png"));
-
-        Image<glm::uvec3> scale_epx         = input;
-        Image<glm::uvec3> scale_adv_mame    = input;
-        Image<glm::uvec3> scale_eagle       = input;
-        Image<glm::uvec3> scale_2xsai       = input;
-        Image<glm::uvec3> scale_hq2x        = input;
-        Image<glm::uvec3> scale_xbr         = input;
-        Image<glm::vec3> scale_nedi         = input_flt;
-
-        for (uint32_t scale_factor = 2U; scale_factor <= MAX_UPSCALE_FACTOR; scale_factor *= 2) {
-            std::cout << "Scaling "<< filename << " by " << scale_factor << "x..." << std::endl;
-
-            scale_epx       = scaleEpx(scale_epx);
-            scale_adv_mame  = scaleAdvMame(scale_adv_mame);
-            scale_eagle     = scaleEagle(scale_eagle);
-            scale_2xsai     = scale2xSaI(scale_2xsai);
-            scale_hq2x      = scaleHq2x(scale_hq2x);
-            scale_xbr       = scaleXbr(scale_xbr);
-            scale_nedi      = scaleNedi(scale_nedi);
-            
-            scale_epx.writeToFile(out_dir_path / (filename + "-scale_epx-" + std::to_string(scale_factor) + "X.png"));
-            scale_adv_mame.writeToFile(out_dir_path / (filename + "-scale_adv_mame-" + std::to_string(scale_factor) + "X.png"));
-            scale_eagle.writeToFile(out_dir_path / (filename + "-scale_eagle-" + std::to_string(scale_factor) + "X.png"));
-            scale_2xsai.writeToFile(out_dir_path / (filename + "-scale_2xSaI-" + std::to_string(scale_factor) + "X.png"));
-            scale_hq2x.writeToFile(out_dir_path / (filename + "-scale_hq2x-" + std::to_string(scale_factor) + "X.png"));
-            scale_xbr.writeToFile(out_dir_path / (filename + "-scale_xbr-" + std::to_string(scale_factor) + "X.png"));
-            scale_nedi.writeToFile(out_dir_path /(filename + "-scale_nedi-" + std::to_string(scale_factor) + "X.png"));
+    // Every input is read ahead while the chains of the earlier ones are added
+    BatchedIo io(use_io_uring);
+    batched_io = &io;
+    std::vector<std::future<FileBytes>> prefetched;
+    for (const std::string& filename : TEST_FILES) { prefetched.push_back(io.read(data_dir_path / (filename + ".png"))); }
+
+    size_t cached_chains = 0U;
+    for (size_t file = 0; file < TEST_FILES.size(); file++) {
+        const std::string& filename = TEST_FILES[file];
+        const std::filesystem::path input_path = data_dir_path / (filename + ".png");
+        const FileBytes input_bytes = prefetched[file].get();
+        const ChainCache chain_cache { cache.get(), cache ? hashBytes(input_bytes) : 0U };
+
+        // Inputs are only decoded once a chain misses the cache
+        std::shared_ptr<const Image<glm::uvec3>> input;
+        std::shared_ptr<const Image<glm::vec3>> input_flt;
+        const auto load = [&] {
+            if (!input) {
+                input       = std::make_shared<const Image<glm::uvec3>>(input_bytes, input_path);
+                input_flt   = std::make_shared<const Image<glm::vec3>>(input_bytes, input_path);
+            }
+        };
+
+        const std::filesystem::path initial_path = out_dir_path / (filename + "-initial_image" + output_format->extension);
+        if (!addCachedTasks(scheduler, chain_cache, "initial", { initial_path }, 1U)) {
+            load();
+            const uint64_t input_pixels = pixelCount(input->width, input->height, 1U);
+            const std::shared_ptr<MipContainerWriter> container = openContainer(filename + "-initial_image", 1U, 1U);
+            scheduler.addTask([=] {
+                if (container) {
+                    container->writeLevel(0U, *input);
+                } else {
+                    writeResult(chain_cache, "initial", 1U, *input, initial_path);
+                }
+            }, double(input_pixels) * output_format->encode_cost, {}, scheduler.addJob(encodeBytes(input_pixels)));
+        }
+
+        for (const RasterScaler& scaler : RASTER_SCALERS) {
+            if (addCachedTasks(scheduler, chain_cache, scaler.algorithm, outputPaths(filename, scaler.algorithm), 2U)) {
+                cached_chains++;
+                continue;
+            }
+            load();
+            const TunableScaler& tunable = *findTunableScaler(scaler.algorithm);
+            const TunedConfig& tuned = profile.lookup(tunable, input->width, input->height);
+            const ScaleFunction<glm::uvec3> scale = tunable.variants[tuned.variant].scale;
+            const JobId job = addChainJob(scheduler, *input, scaler.halo, RASTER_SCRATCH_BYTES_PER_PIXEL, streaming, fused);
+            if (streaming) {
+                addStreamTask<glm::uvec3>(scheduler, filename, input, scale, scaler.halo, scaler.algorithm, scaler.cost_per_pixel, job);
+            } else if (fused) {
+                addFusedTasks<glm::uvec3>(scheduler, filename, input, scale, scaler.halo, scaler.algorithm, scaler.cost_per_pixel, chain_cache, tuned.tile_size, job);
+            } else {
+                addChainTasks<glm::uvec3>(scheduler, filename, input, scale, scaler.algorithm, scaler.cost_per_pixel, chain_cache, job);
+            }
+        }
+
+        const ChainCache hybrid_cache { chain_cache.cache, chain_cache.input_hash, hybridConfigKey(hybrid_config) };
+        if (hybrid && addCachedTasks(scheduler, hybrid_cache, "hybrid", outputPaths(filename, "hybrid"), 2U)) {
+            cached_chains++;
+        } else if (hybrid) {
+            load();
+            const JobId hybrid_job = addChainJob(scheduler, *input, 0, HYBRID_SCRATCH_BYTES_PER_PIXEL, false, false);
+            addChainTasks<glm::uvec3>(scheduler, filename, input, scaleHybridCounted, "hybrid", HYBRID_COST + algorithmCost(hybrid_reference->algorithm),
+                                      hybrid_cache, hybrid_job);
+        }
+
+        // The halo of NEDI grows the source region of a tile so much that recomputing it costs more than the memory
+        // traffic it saves, so NEDI keeps its pass-by-pass chain when fusing
+        const ChainCache nedi_cache { chain_cache.cache, chain_cache.input_hash, nedi_precision == NEDI_HALF ? "half" : "" };
+        if (addCachedTasks(scheduler, nedi_cache, "nedi", outputPaths(filename, "nedi"), 2U)) {
+            cached_chains++;
+            continue;
+        }
+        load();
+        const double nedi_scratch_bytes = nedi_precision == NEDI_HALF ? NEDI_HALF_SCRATCH_BYTES_PER_PIXEL : NEDI_SCRATCH_BYTES_PER_PIXEL;
+        const JobId nedi_job = addChainJob(scheduler, *input_flt, NEDI_HALO, nedi_scratch_bytes, streaming, false);
+        if (streaming) {
+            addStreamTask<glm::vec3>(scheduler, filename, input_flt, scaleNediCounted, NEDI_HALO, "nedi", NEDI_COST, nedi_job);
+        } else {
+            addChainTasks<glm::vec3>(scheduler, filename, input_flt, scaleNediCounted, "nedi", NEDI_COST, nedi_cache, nedi_job);
         }
     }
-    
+    scheduler.run();
+    io.flush();
+    const IoStats io_stats = io.stats();
+    std::cout << "I/O (" << (io.backend() == IO_BACKEND_URING ? "io_uring" : "threads") << "): " << io_stats.reads << " files read, " << io_stats.writes
+              << " files written";
+    if (io_stats.submissions > 0U) { std::cout << ", " << io_stats.operations << " operations in " << io_stats.submissions << " submissions"; }
+    std::cout << std::endl;
+    std::cout << "NEDI: " << nedi_flat_pixels << " flat pixels, " << nedi_solved_pixels << " solved pixels" << std::endl;
+    if (hybrid) {
+        std::cout << "Hybrid tiles:";
+        for (size_t tile_class = 0; tile_class < TILE_CLASS_COUNT; tile_class++) {
+            std::cout << " " << hybrid_stats.tiles[tile_class] << " " << TILE_CLASS_NAMES[tile_class] << " (" << hybrid_config.scalers[tile_class]->algorithm << ", "
+                      << hybrid_stats.scale_seconds[tile_class] << " s)" << (tile_class + 1U < TILE_CLASS_COUNT ? "," : "");
+        }
+        std::cout << std::endl;
+        std::cout << "Hybrid: " << hybrid_stats.seconds << " s";
+        if (hybrid_reference_seconds > 0.0) {
+            std::cout << " against " << hybrid_reference_seconds << " s of " << hybrid_reference->algorithm << " on every pixel ("
+                      << hybrid_reference_seconds - hybrid_stats.seconds << " s saved)";
+        }
+        std::cout << std::endl;
+    }
+    const MemoryStats memory = scheduler.memoryStats();
+    std::cout << "Image memory: " << (memory.peak_bytes >> 20U) << " MiB peak, " << uint64_t(memory.average_bytes) / (1U << 20U) << " MiB average";
+    if (memory_budget != UNLIMITED_MEMORY) { std::cout << " (budget " << (memory_budget >> 20U) << " MiB)"; }
+    std::cout << std::endl;
+    if (cache) { std::cout << "Result cache: " << cached_chains << " chains reused, " << cache->sizeBytes() << " bytes cached" << std::endl; }
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,78 @@
+#ifndef MEMORY_ACCOUNTANT_HPP
+#define MEMORY_ACCOUNTANT_HPP
+
+#include <algorithm>
+#include <cstdint>
+
+// Predicted peak memory of the jobs of a run, used to admit jobs against a memory budget (see TaskScheduler). Every
+// prediction counts the images a job holds at its worst moment plus the scratch memory of the scaler and the PNG encoder
+
+constexpr double RASTER_SCRATCH_BYTES_PER_PIXEL    = 2.0;  // Padded equality/key planes, per output pixel
+constexpr double NEDI_SCRATCH_BYTES_PER_PIXEL      = 21.0; // Float planes of the source, its two padded copies and the output, per output pixel
+constexpr double NEDI_HALF_SCRATCH_BYTES_PER_PIXEL = 10.5; // The same planes in half precision (see NediPrecision)
+constexpr double HYBRID_SCRATCH_BYTES_PER_PIXEL    = 36.0; // Outputs of the runs, plus the scratch of NEDI on gradient runs, per output pixel
+constexpr double ENCODE_BYTES_PER_PIXEL            = 7.0;  // RGB8 copy of the image, filtered rows and compressed output of stb
+
+inline uint64_t pixelCount(int width, int height, uint32_t factor) {
+    return uint64_t(width) * uint64_t(height) * uint64_t(factor) * uint64_t(factor);
+}
+
+inline uint64_t encodeBytes(uint64_t pixels) { return uint64_t(double(pixels) * ENCODE_BYTES_PER_PIXEL); }
+
+/**
+ * Predict the peak memory of a chain of 2x passes that keeps every intermediate image in memory, where the encoding of
+ * every factor overlaps with the next pass
+ *
+ * @param width Width of the input image
+ * @param height Height of the input image
+ * @param passes Number of 2x passes
+ * @param scratch_bytes_per_pixel Scratch memory of the scaler, per output pixel
+ *
+ * @return Predicted peak bytes
+*/
+template<typename T>
+uint64_t chainPeakBytes(int width, int height, uint32_t passes, double scratch_bytes_per_pixel) {
+    uint64_t peak = 0U;
+    for (uint32_t pass = 1U; pass <= passes; pass++) {
+        const uint64_t source_pixels = pixelCount(width, height, 1U << (pass - 1U));
+        const uint64_t output_pixels = pixelCount(width, height, 1U << pass);
+        const uint64_t scratch       = uint64_t(double(output_pixels) * scratch_bytes_per_pixel);
+
+        // Scaling pass k holds its source (which is being encoded at the same time) and its output
+        const uint64_t scaling = (uint64_t(sizeof(T)) * (source_pixels + output_pixels)) + scratch + encodeBytes(source_pixels);
+        // Encoding the last pass no longer overlaps with any scaling
+        const uint64_t last_encode = (uint64_t(sizeof(T)) * output_pixels) + encodeBytes(output_pixels);
+        peak = std::max({ peak, scaling, last_encode });
+    }
+    return peak;
+}
+
+/**
+ * Predict the peak memory of a tile-fused chain (see scaleChainFused), which holds every emitted output until it is
+ * encoded. Intermediate tiles and their scratch memory are negligible next to the outputs
+*/
+template<typename T>
+uint64_t fusedChainPeakBytes(int width, int height, uint32_t passes) {
+    uint64_t outputs = 0U;
+    for (uint32_t pass = 1U; pass <= passes; pass++) { outputs += uint64_t(sizeof(T)) * pixelCount(width, height, 1U << pass); }
+    return outputs + encodeBytes(pixelCount(width, height, 1U << passes));
+}
+
+/**
+ * Predict the peak memory of a streamed chain (see streamScaleToPng), where every pass holds a window of source rows
+ * and its scaled band
+*/
+template<typename T>
+uint64_t streamedChainPeakBytes(int width, int height, uint32_t passes, int halo, int band_height, double scratch_bytes_per_pixel) {
+    uint64_t bytes = 0U;
+    for (uint32_t pass = 1U; pass <= passes; pass++) {
+        const int source_width  = width << (pass - 1U);
+        const int source_height = std::min(height << (pass - 1U), band_height + (2 * halo));
+        const uint64_t window = uint64_t(sizeof(T)) * pixelCount(source_width, source_height, 1U) * 2U; // Row deque and its copy
+        const uint64_t band   = uint64_t(double(pixelCount(source_width, source_height, 2U)) * (double(sizeof(T)) + scratch_bytes_per_pixel));
+        bytes += window + band + (uint64_t(source_width) * 2U * 3U * 2U); // Current and previous row of the PNG writer
+    }
+    return bytes;
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef MIP_WRITER_HPP
+#define MIP_WRITER_HPP
+
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <framework/image.h>
+#include <framework/mip_container.h>
+
+// Writer of a mip container (see framework/mip_container.h) holding every factor of a chain in one file. Levels are
+// appended as soon as their pass is done, in any order and from any thread, and every level only becomes visible to
+// readers once its data is in the file, so the container never has to be assembled in memory
+
+class MipContainerWriter {
+public:
+    /**
+     * Create (or truncate) a container whose levels are all missing
+     *
+     * @param file_path Path of the container, whose parent directories are created if needed
+     * @param factors Factor of every level, in the order of the level table
+     * @param codec Encoding of the level data
+    */
+    MipContainerWriter(const std::filesystem::path& file_path, const std::vector<uint32_t>& factors, MipCodec codec)
+        : file_path(file_path), codec(codec), next_offset(mipDataOffset(uint32_t(factors.size()))) {
+        if (!file_path.parent_path().empty()) { std::filesystem::create_directories(file_path.parent_path()); }
+        file.open(file_path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        writeAt(0U, encodeMipHeader(uint32_t(factors.size()), codec));
+        for (size_t level = 0; level < factors.size(); level++) {
+            levels.push_back({ factors[level] });
+            writeAt(mipLevelEntryOffset(level), encodeMipLevelEntry(levels.back()));
+        }
+        flush();
+    }
+
+    /**
+     * Encode a level and append it to the container
+     *
+     * @param level Index of the level in the level table, which must not have been written yet
+     * @param image Pixels of the level
+    */
+    template<typename T>
+    void writeLevel(size_t level, const Image<T>& image) {
+        std::vector<uint8_t> rgb(image.data.size() * 3U);
+        for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8<T>(&rgb[i * 3U], image.data[i]); }
+        if (codec == MIP_CODEC_QOI) { rgb = encodeQoi(rgb.data(), image.width, image.height); }
+
+        std::lock_guard lock(mutex);
+        if (level >= levels.size() || levels[level].written()) {
+            std::cerr << "Level " << level << " of mip container " << file_path << " does not exist or was already written" << std::endl;
+            throw std::exception();
+        }
+        MipLevel& entry = levels[level];
+        entry.width     = image.width;
+        entry.height    = image.height;
+        entry.offset    = next_offset;
+        entry.size      = rgb.size();
+        writeAt(entry.offset, rgb);
+        flush(); // The data has to reach the file before the entry pointing at it
+        writeAt(mipLevelEntryOffset(level), encodeMipLevelEntry(entry));
+        flush();
+        next_offset = (entry.offset + entry.size + MIP_ALIGNMENT - 1U) / MIP_ALIGNMENT * MIP_ALIGNMENT;
+    }
+
+private:
+    void writeAt(uint64_t offset, const std::vector<uint8_t>& bytes) {
+        file.seekp(std::streamoff(offset));
+        file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    }
+
+    void flush() {
+        file.flush();
+        if (!file) {
+            std::cerr << "Mip container " << file_path << " could not be written!" << std::endl;
+            throw std::exception();
+        }
+    }
+
+    std::filesystem::path file_path;
+    MipCodec codec;
+    std::mutex mutex;
+    std::fstream file;
+    std::vector<MipLevel> levels;
+    uint64_t next_offset; // Of the data of the next level, aligned
+};
+
+#endif
@@ -1,24 +1,44 @@
 #ifndef NEDI_HPP
 #define NEDI_HPP
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <Eigen/Core>
 #include <Eigen/Dense>
 #include <Eigen/LU>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/geometric.hpp>
 DISABLE_WARNINGS_POP()
 #include <framework/image.h>
 
 #include "common.hpp"
+#include "nedi_solver.hpp"
+#include "planar_image.hpp"
 
 
 constexpr glm::vec3 CONDITION_THRESHOLD(2.0f);
 constexpr uint32_t WINDOW_SIZE_MAX = 8U;
+constexpr int NEDI_HALO = 9; // The window origin evaluates to (x + 1, y + 1), so the largest window plus its neighbours reaches 9 pixels down
+constexpr int NEDI_FLAT_EXTENT = int(WINDOW_SIZE_MAX) + 2; // Side of the square of source pixels read by the largest window and its neighbours
+constexpr int NEDI_BAND_ROWS = NEDI_HALO + 1; // Padded rows read by the windows of one source row, starting at that row
+
+// Storage of the planes of the Image overloads of scaleNedi. Half precision halves the source, padded and output planes
+// at the cost of rounding every source and output sample to 11 significant bits
+enum NediPrecision : uint8_t { NEDI_FLOAT, NEDI_HALF };
+
+// Split of the pixels of a scaleNedi call between the flat shortcut and the least-squares solve
+struct NediStats {
+    size_t flat_pixels      = 0U;
+    size_t solved_pixels    = 0U;
+};
 
 
 namespace Eigen {
@@ -89,8 +109,545 @@ bool conditionBelowThreshold(uint32_t window_size, const Eigen::Matrix<T, Eigen:
            !glm::any(glm::isnan(condition_diagonal)) && !glm::any(glm::isnan(condition_axial));
 }
 
+/**
+ * Classify the pixels whose whole sampling region (the largest window plus its neighbours, i.e. the NEDI_FLAT_EXTENT
+ * square starting at the pixel, as the window origin evaluates to (x + 1, y + 1)) lies inside the image and has a
+ * single colour. The covariance matrices of such a region are singular at every window size, so the solve always ends
+ * at WINDOW_SIZE_MAX with NaN weights that are replaced by equal weights; flat pixels can take those weights directly
+ *
+ * @param width Width of the source image
+ * @param height Height of the source image
+ * @param equal Predicate telling whether the pixels at two row-major offsets have the same colour
+ *
+ * @return Per-pixel flags in row-major order, true for flat pixels
+*/
+template<typename Equal>
+std::vector<bool> classifyFlatNedi(int width, int height, Equal equal) {
+    const size_t pixel_count = size_t(width) * size_t(height);
+
+    // Length of the run of identical pixels to the right of (and including) every pixel
+    std::vector<int> row_runs(pixel_count);
+    for (int y = 0; y < height; y++) {
+        for (int x = width - 1; x >= 0; x--) {
+            const size_t offset = (size_t(y) * size_t(width)) + size_t(x);
+            row_runs[offset] = (x + 1 < width && equal(offset, offset + 1)) ? row_runs[offset + 1] + 1 : 1;
+        }
+    }
+
+    // Number of consecutive rows, from every pixel downwards, whose run is long enough and has the same colour
+    std::vector<int> column_runs(pixel_count, 0);
+    std::vector<bool> flat(pixel_count, false);
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) {
+            const size_t offset = (size_t(y) * size_t(width)) + size_t(x);
+            if (row_runs[offset] < NEDI_FLAT_EXTENT) { continue; }
+            const size_t below  = offset + size_t(width);
+            column_runs[offset] = (y + 1 < height && column_runs[below] > 0 && equal(offset, below)) ? column_runs[below] + 1 : 1;
+            flat[offset]        = column_runs[offset] >= NEDI_FLAT_EXTENT;
+        }
+    }
+    return flat;
+}
+
+template<typename T>
+std::vector<bool> classifyFlatNedi(const Image<T>& src) {
+    return classifyFlatNedi(src.width, src.height, [&src](size_t a, size_t b) { return src.data[a] == src.data[b]; });
+}
+
+// Samples of a window: the window pixels and their diagonal and axial neighbours, one row per window pixel
+template<typename T>
+struct NediWindow {
+    Eigen::Matrix<T, Eigen::Dynamic, 1> col_vec_y;
+    Eigen::Matrix<T, Eigen::Dynamic, 4> diagonal_neighbours;
+    Eigen::Matrix<T, Eigen::Dynamic, 4> axial_neighbours;
+};
+
+/**
+ * Sample the window of a pixel
+ *
+ * @param fetch Source pixel accessor with the signature of Image::safeAccess
+ * @param x Horizontal coordinate of the pixel
+ * @param y Vertical coordinate of the pixel
+ * @param window_pxl_length Size of the window
+ * @param window Destination of the samples
+*/
+template<typename Fetch, typename T>
+void sampleNediWindow(const Fetch& fetch, int x, int y, uint32_t window_pxl_length, NediWindow<T>& window) {
+    // Define top left corner of the sampling box. It has always been computed for an empty window, where the unsigned
+    // offset wraps around, so the origin is (x + 1, y + 1) for every window size
+    int top_left_x = x + 1;
+    int top_left_y = y + 1;
+
+    // Construct column vector representing window and matrices representing diagonal and axial neighbours of each pixel in the window
+    window.col_vec_y            = Eigen::Matrix<T, Eigen::Dynamic, 1>(window_pxl_length * window_pxl_length, 1);
+    window.diagonal_neighbours  = Eigen::Matrix<T, Eigen::Dynamic, 4>(window_pxl_length * window_pxl_length, 4);
+    window.axial_neighbours     = Eigen::Matrix<T, Eigen::Dynamic, 4>(window_pxl_length * window_pxl_length, 4);
+    size_t window_pixel_counter = 0U;
+
+    for (int offset_y = 0; offset_y < window_pxl_length; offset_y++) {
+        for (int offset_x = 0; offset_x < window_pxl_length; offset_x++) {
+            int window_pixel_x = top_left_x + offset_x;
+            int window_pixel_y = top_left_y + offset_y;
+
+            window.col_vec_y(window_pixel_counter) = fetch(window_pixel_x, window_pixel_y, NEAREST);
+            std::array<T, 4> diagonal_neighbour_row = {
+                fetch(window_pixel_x - 1, window_pixel_y - 1, ZERO),
+                fetch(window_pixel_x + 1, window_pixel_y - 1, ZERO),
+                fetch(window_pixel_x - 1, window_pixel_y + 1, ZERO),
+                fetch(window_pixel_x + 1, window_pixel_y + 1, ZERO)};
+            for (uint8_t col = 0; col < 4; col++) { window.diagonal_neighbours(window_pixel_counter, col) = diagonal_neighbour_row[col]; }
+            std::array<T, 4> axial_neighbour_row = {
+                fetch(window_pixel_x, window_pixel_y - 1, ZERO),
+                fetch(window_pixel_x - 1, window_pixel_y, ZERO),
+                fetch(window_pixel_x + 1, window_pixel_y, ZERO),
+                fetch(window_pixel_x, window_pixel_y + 1, ZERO)};
+            for (uint8_t col = 0; col < 4; col++) { window.axial_neighbours(window_pixel_counter, col) = axial_neighbour_row[col]; }
+
+            window_pixel_counter++;
+        }
+    }
+}
+
 template<typename T>
-Image<T> scaleNedi(const Image<T>& src) {
+void sampleNediWindow(const Image<T>& src, int x, int y, uint32_t window_pxl_length, NediWindow<T>& window) {
+    sampleNediWindow([&src](int px, int py, OutOfBoundsStrategy strategy) { return src.safeAccess(px, py, strategy); }, x, y, window_pxl_length, window);
+}
+
+/**
+ * Solve for the diagonal and axial interpolation weights of a sampled window
+ *
+ * @param window Samples of the window
+ * @param diagonal_interp_weights Weights of the diagonal neighbours, equal if the solve produced NaNs
+ * @param axial_interp_weights Weights of the axial neighbours, equal if the solve produced NaNs
+*/
+template<typename T>
+void solveNediWindow(const NediWindow<T>& window, Eigen::Matrix<T, 4, 1>& diagonal_interp_weights,
+                     Eigen::Matrix<T, 4, 1>& axial_interp_weights) {
+    // Compute diagonal and axial interpolation weights left sub-term
+    auto diagonal_neighbours_transpose  = window.diagonal_neighbours.transpose();
+    auto axial_neighbours_transpose     = window.axial_neighbours.transpose();
+    auto diagonal_lhs                   = (diagonal_neighbours_transpose * window.diagonal_neighbours).inverse();
+    auto axial_lhs                      = (axial_neighbours_transpose * window.axial_neighbours).inverse();
+    diagonal_interp_weights             = diagonal_lhs * (diagonal_neighbours_transpose * window.col_vec_y);
+    axial_interp_weights                = axial_lhs    * (axial_neighbours_transpose * window.col_vec_y);
+
+    // If either of the weight vectors has NaNs, replace with equal weights
+    for (uint8_t i = 0; i < 4; i++) {
+        if (glm::any(glm::isnan(diagonal_interp_weights(i)))) { setAllRowsToValue(diagonal_interp_weights, glm::vec3(0.25f)); }
+        if (glm::any(glm::isnan(axial_interp_weights(i)))) { setAllRowsToValue(axial_interp_weights, glm::vec3(0.25f)); }
+    }
+}
+
+/**
+ * Grow the sampling window of a pixel until its covariance matrices are well conditioned (or the window reaches
+ * WINDOW_SIZE_MAX) and solve for the diagonal and axial interpolation weights
+ *
+ * @param src Source image
+ * @param x Horizontal coordinate of the pixel
+ * @param y Vertical coordinate of the pixel
+ * @param diagonal_interp_weights Weights of the diagonal neighbours, equal if the solve produced NaNs
+ * @param axial_interp_weights Weights of the axial neighbours, equal if the solve produced NaNs
+*/
+template<typename T>
+void solveNediWeights(const Image<T>& src, int x, int y, Eigen::Matrix<T, 4, 1>& diagonal_interp_weights,
+                      Eigen::Matrix<T, 4, 1>& axial_interp_weights) {
+    uint32_t window_pxl_length = 0U;
+    NediWindow<T> window;
+    do {
+        window_pxl_length += 2U;
+        sampleNediWindow(src, x, y, window_pxl_length, window);
+    } while (!conditionBelowThreshold(window_pxl_length, window.diagonal_neighbours, window.axial_neighbours) && window_pxl_length < WINDOW_SIZE_MAX);
+    solveNediWindow(window, diagonal_interp_weights, axial_interp_weights);
+}
+
+/**
+ * Interpolate the three missing pixels of the 2x2 output block of a source pixel
+ *
+ * @param result Output image, of which the 'b' pixels of the previous rows must already be written
+ * @param x Horizontal coordinate of the source pixel
+ * @param y Vertical coordinate of the source pixel
+ * @param diagonal_interp_weights Weights of the diagonal neighbours
+ * @param axial_interp_weights Weights of the axial neighbours
+*/
+template<typename T>
+void writeNediPixels(Image<T>& result, int x, int y, const Eigen::Matrix<T, 4, 1>& diagonal_interp_weights,
+                     const Eigen::Matrix<T, 4, 1>& axial_interp_weights) {
+    int dst_x;
+    int dst_y;
+
+    // 'b' pixel so diagonal neighbours
+    dst_x = (2 * x) + 1;
+    dst_y = (2 * y) + 1;
+    Eigen::Matrix<T, 4, 1> interp_bot_right_pixels { result.safeAccess(dst_x - 1, dst_y - 1),
+                                                     result.safeAccess(dst_x + 1, dst_y - 1),
+                                                     result.safeAccess(dst_x - 1, dst_y + 1),
+                                                     result.safeAccess(dst_x + 1, dst_y + 1)};
+    T interp_bot_right = diagonal_interp_weights.dot(interp_bot_right_pixels);
+    result.data[result.getImageOffset(dst_x, dst_y)] = interp_bot_right;
+
+    // 'a' pixel so axial neighbours
+    dst_x = (2 * x) + 1;
+    dst_y = (2 * y);
+    Eigen::Matrix<T, 4, 1> interp_top_right_pixels { result.safeAccess(dst_x, dst_y - 1),
+                                                     result.safeAccess(dst_x - 1, dst_y),
+                                                     result.safeAccess(dst_x + 1, dst_y),
+                                                     result.safeAccess(dst_x, dst_y + 1)};
+    T interp_top_right = axial_interp_weights.dot(interp_top_right_pixels);
+    result.data[result.getImageOffset(dst_x, dst_y)] = interp_top_right;
+
+    // 'a' pixel so axial neighbours
+    dst_x = (2 * x);
+    dst_y = (2 * y) + 1;
+    Eigen::Matrix<T, 4, 1> interp_bot_left_pixels { result.safeAccess(dst_x, dst_y - 1),
+                                                    result.safeAccess(dst_x - 1, dst_y),
+                                                    result.safeAccess(dst_x + 1, dst_y),
+                                                    result.safeAccess(dst_x, dst_y + 1)};
+    T interp_bot_left = axial_interp_weights.dot(interp_bot_left_pixels);
+    result.data[result.getImageOffset(dst_x, dst_y)] = interp_bot_left;
+}
+
+/**
+ * Copy the planes of an image into planes that extend NEDI_HALO pixels past its right and bottom edges, so that every
+ * sample of every window of every pixel lies inside them
+ *
+ * @param src Source image
+ * @param out_of_bounds_strategy Value of the samples outside of the source image, as for Image::safeAccess
+ *
+ * @return Padded copy of the source image, in its storage type (so no sample is rounded again)
+*/
+template<typename S>
+PlanarImage<S> padNediSource(const PlanarImage<S>& src, OutOfBoundsStrategy out_of_bounds_strategy) {
+    PlanarImage<S> padded(src.width + NEDI_HALO, src.height + NEDI_HALO);
+    for (int channel = 0; channel < PlanarImage<S>::CHANNELS; channel++) {
+        for (int y = 0; y < padded.height; y++) {
+            if (y >= src.height && out_of_bounds_strategy == ZERO) { continue; }
+            const size_t src_row = src.getImageOffset(0, std::min(y, src.height - 1));
+            for (int x = 0; x < padded.width; x++) {
+                if (x >= src.width && out_of_bounds_strategy == ZERO) { continue; }
+                padded.planes[size_t(channel)][padded.getImageOffset(x, y)] = src.planes[size_t(channel)][src_row + size_t(std::min(x, src.width - 1))];
+            }
+        }
+    }
+    return padded;
+}
+
+/**
+ * Widen the NEDI_BAND_ROWS padded rows that the windows of a source row read into float planes
+ *
+ * @param padded Padded source planes (see padNediSource)
+ * @param y Source row, which is the first row of the band
+ * @param band Float planes of NEDI_BAND_ROWS rows as wide as the padded planes
+*/
+template<typename S>
+void widenNediBand(const PlanarImage<S>& padded, int y, PlanarImage<float>& band) {
+    const size_t first = padded.getImageOffset(0, y);
+    for (int channel = 0; channel < PlanarImage<S>::CHANNELS; channel++) {
+        const S* source = padded.planes[size_t(channel)].data() + first;
+        float* destination = band.planes[size_t(channel)].data();
+        for (size_t i = 0; i < band.planes[size_t(channel)].size(); i++) { destination[i] = float(source[i]); }
+    }
+}
+
+// Covariance matrices (packed) and right-hand sides of the diagonal and axial normal equations of every pixel of a row,
+// as planes indexed by [kind][term][channel][x]
+template<int Channels>
+struct NediRowEquations {
+    std::array<std::array<std::array<Plane<float>, Channels>, NEDI_COVARIANCE_TERMS>, 2> covariance;
+    std::array<std::array<std::array<Plane<float>, Channels>, 4>, 2> rhs;
+
+    void reset(int width) {
+        for (auto& kind : covariance) { for (auto& term : kind) { for (Plane<float>& plane : term) { plane.assign(size_t(width), 0.0f); } } }
+        for (auto& kind : rhs) { for (auto& term : kind) { for (Plane<float>& plane : term) { plane.assign(size_t(width), 0.0f); } } }
+    }
+};
+
+inline void accumulateNediProducts(float* sums, const float* lhs, const float* rhs, int first, int last) {
+    #pragma omp simd
+    for (int x = first; x < last; x++) { sums[x] += lhs[x] * rhs[x]; }
+}
+
+/**
+ * Add the window pixels of a window of the given size which are not part of the next smaller window (whose origin is
+ * the same) to the normal equations of the pixels [first, last) of a row. The window pixels are visited in the order of
+ * sampleNediWindow, so every sum is accumulated in the same order as the full solve would
+ *
+ * @param zero_padded Source planes padded with zeros (see padNediSource), or a band of them
+ * @param nearest_padded Source planes padded with the nearest pixels, or a band of them
+ * @param y Row of the pixels in the padded planes
+ * @param first First pixel of the row whose equations are extended
+ * @param last One past the last pixel of the row whose equations are extended
+ * @param window_size Size of the window
+ * @param equations Normal equations of the next smaller window, which are extended to this window
+*/
+template<int Channels>
+void accumulateNediRing(const PlanarImage<float>& zero_padded, const PlanarImage<float>& nearest_padded, int y, int first, int last,
+                        uint32_t window_size, NediRowEquations<Channels>& equations) {
+    // Same window origin as sampleNediWindow, i.e. (x + 1, y + 1). Pointers are offset so that index x of every row
+    // holds the sample of pixel x
+    const int inner_size = int(window_size) - 2;
+    for (int offset_y = 0; offset_y < int(window_size); offset_y++) {
+        for (int offset_x = 0; offset_x < int(window_size); offset_x++) {
+            if (offset_x < inner_size && offset_y < inner_size) { continue; }
+            for (int channel = 0; channel < Channels; channel++) {
+                const float* value  = nearest_padded.planes[size_t(channel)].data() + nearest_padded.getImageOffset(offset_x + 1, y + offset_y + 1);
+                const float* plane  = zero_padded.planes[size_t(channel)].data();
+                const float* above  = plane + zero_padded.getImageOffset(offset_x, y + offset_y);
+                const float* middle = plane + zero_padded.getImageOffset(offset_x, y + offset_y + 1);
+                const float* below  = plane + zero_padded.getImageOffset(offset_x, y + offset_y + 2);
+                const std::array<std::array<const float*, 4>, 2> neighbours = {{
+                    { above,        above + 2,  below,      below + 2 },
+                    { above + 1,    middle,     middle + 2, below + 1 }}};
+                for (size_t kind = 0; kind < 2; kind++) {
+                    for (size_t row = 0; row < 4; row++) {
+                        for (size_t col = row; col < 4; col++) {
+                            accumulateNediProducts(equations.covariance[kind][covarianceTerm(row, col)][size_t(channel)].data(),
+                                                   neighbours[kind][row], neighbours[kind][col], first, last);
+                        }
+                        accumulateNediProducts(equations.rhs[kind][row][size_t(channel)].data(), neighbours[kind][row], value, first, last);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Interpolation weights of every pixel of a row, as planes indexed by [kind][row][channel][x]
+template<int Channels>
+using NediRowWeights = std::array<std::array<std::array<Plane<float>, Channels>, 4>, 2>;
+
+/**
+ * Solve the diagonal and axial interpolation weights of a set of pixels of a row together, growing the windows of all
+ * pixels in lockstep and handing the normal equations of every still-growing pixel, kind and channel to the batched
+ * solver. Produces the same weights as solveNediWeights up to floating-point rounding
+ *
+ * @param src Source image
+ * @param zero_band Band of the source planes padded with zeros, starting at row y (see widenNediBand)
+ * @param nearest_band Band of the source planes padded with the nearest pixels, starting at row y
+ * @param y Row of the pixels
+ * @param pixels Columns of the pixels, in increasing order
+ * @param weights Weights of the row, of which those of the given pixels are written
+*/
+template<typename S>
+void solveNediRow(const PlanarImage<S>& src, const PlanarImage<float>& zero_band, const PlanarImage<float>& nearest_band,
+                  int y, const std::vector<int>& pixels, NediRowWeights<PlanarImage<S>::CHANNELS>& weights) {
+    constexpr int channels = PlanarImage<S>::CHANNELS;
+    constexpr size_t lanes_per_pixel = 2U * size_t(channels);
+    static_assert(channels == glm::vec3::length(), "Windows that are never well conditioned are solved on glm::vec3");
+
+    NediRowEquations<channels> equations;
+    equations.reset(src.width);
+    std::vector<int> growing = pixels;
+
+    NediSystemBatch batch;
+    NediWindow<glm::vec3> window;
+    Eigen::Matrix<glm::vec3, 4, 1> diagonal_interp_weights, axial_interp_weights;
+    const auto fetch = [&src](int x, int y, OutOfBoundsStrategy out_of_bounds_strategy) {
+        if (out_of_bounds_strategy == ZERO && (x < 0 || x >= src.width || y < 0 || y >= src.height)) { return glm::vec3(0.0f); }
+        const size_t offset = src.getImageOffset(std::clamp(x, 0, src.width - 1), std::clamp(y, 0, src.height - 1));
+        return glm::vec3(src.value(0, offset), src.value(1, offset), src.value(2, offset));
+    };
+
+    for (uint32_t window_pxl_length = 2U; !growing.empty(); window_pxl_length += 2U) {
+        accumulateNediRing(zero_band, nearest_band, 0, growing.front(), growing.back() + 1, window_pxl_length, equations);
+        batch.resize(growing.size() * lanes_per_pixel);
+        for (size_t i = 0; i < growing.size(); i++) {
+            const size_t x = size_t(growing[i]);
+            for (size_t kind = 0; kind < 2; kind++) {
+                for (size_t channel = 0; channel < size_t(channels); channel++) {
+                    const size_t lane = (i * lanes_per_pixel) + (kind * size_t(channels)) + channel;
+                    for (size_t term = 0; term < NEDI_COVARIANCE_TERMS; term++) { batch.covariance[term][lane] = equations.covariance[kind][term][channel][x]; }
+                    for (size_t row = 0; row < 4; row++) { batch.rhs[row][lane] = equations.rhs[kind][row][channel][x]; }
+                }
+            }
+        }
+        solveNediBatch(batch, window_pxl_length);
+
+        // Pixels whose systems are all well conditioned (or whose window is the largest) are done
+        std::vector<int> still_growing;
+        for (size_t i = 0; i < growing.size(); i++) {
+            const size_t x = size_t(growing[i]);
+            const size_t first_lane = i * lanes_per_pixel;
+            bool conditioned = true;
+            for (size_t lane = first_lane; lane < first_lane + lanes_per_pixel; lane++) {
+                conditioned &= batch.condition_squared[lane] < CONDITION_THRESHOLD.x * CONDITION_THRESHOLD.x;
+            }
+            if (!conditioned && window_pxl_length < WINDOW_SIZE_MAX) {
+                still_growing.push_back(growing[i]);
+                continue;
+            }
+
+            // Windows that never become well conditioned are (nearly) singular, where the weights are dominated by
+            // rounding. These lanes are masked out and solved like solveNediWeights does, so that they round the same way
+            if (!conditioned) {
+                sampleNediWindow(fetch, growing[i], y, window_pxl_length, window);
+                solveNediWindow(window, diagonal_interp_weights, axial_interp_weights);
+                for (size_t row = 0; row < 4; row++) {
+                    for (size_t channel = 0; channel < size_t(channels); channel++) {
+                        weights[0][row][channel][x] = diagonal_interp_weights(row)[channel];
+                        weights[1][row][channel][x] = axial_interp_weights(row)[channel];
+                    }
+                }
+                continue;
+            }
+
+            for (size_t kind = 0; kind < 2; kind++) {
+                bool has_nan = false;
+                for (size_t channel = 0; channel < size_t(channels); channel++) {
+                    const size_t lane = first_lane + (kind * size_t(channels)) + channel;
+                    for (size_t row = 0; row < 4; row++) {
+                        weights[kind][row][channel][x] = batch.weights[row][lane];
+                        has_nan |= std::isnan(batch.weights[row][lane]);
+                    }
+                }
+
+                // If either of the weight vectors has NaNs, replace with equal weights
+                if (has_nan) {
+                    for (auto& row : weights[kind]) { for (Plane<float>& plane : row) { plane[x] = 0.25f; } }
+                }
+            }
+        }
+        growing = std::move(still_growing);
+    }
+}
+
+/**
+ * Interpolate one kind of missing pixel of the 2x2 output blocks of a source row, for a single channel. Neighbours
+ * outside of the output image are clamped like Image::safeAccess
+ *
+ * @param result Output plane
+ * @param width Width of the output plane
+ * @param height Height of the output plane
+ * @param dst_x Column of the interpolated pixel of source pixel x is 2x + dst_x
+ * @param dst_y Row of the interpolated pixels
+ * @param neighbours Offsets of the four neighbours from the interpolated pixel, in the order of the weights
+ * @param weights Weights of the four neighbours of every source pixel of the row
+*/
+template<typename S>
+void writeNediPlane(Plane<S>& result, int width, int height, int dst_x, int dst_y, const std::array<glm::ivec2, 4>& neighbours,
+                    const std::array<const float*, 4>& weights) {
+    const int src_width = width / 2;
+    std::array<const S*, 4> rows;
+    for (size_t i = 0; i < 4; i++) { rows[i] = result.data() + (size_t(std::clamp(dst_y + neighbours[i].y, 0, height - 1)) * size_t(width)); }
+    S* destination = result.data() + (size_t(dst_y) * size_t(width));
+
+    for (int x = 0; x < src_width; x++) {
+        const int dst = (2 * x) + dst_x;
+        std::array<float, 4> samples;
+        for (size_t i = 0; i < 4; i++) { samples[i] = float(rows[i][std::clamp(dst + neighbours[i].x, 0, width - 1)]); }
+        // Same association as Eigen's dot product of two 4-vectors
+        destination[dst] = S(((weights[0][x] * samples[0]) + (weights[1][x] * samples[1])) + ((weights[2][x] * samples[2]) + (weights[3][x] * samples[3])));
+    }
+}
+
+/**
+ * Scale a planar image by 2x using NEDI. Only pixels with some local activity pay for the least-squares solve; flat
+ * pixels (see classifyFlatNedi) use the equal weights the solve would have fallen back to. The remaining pixels of every
+ * row are solved together by solveNediRow, and every row of output pixels is interpolated one channel at a time. The
+ * padded source is kept in the storage type of the image, and only the band of it a row reads is widened to float
+ *
+ * @param src Source image
+ * @param stats Optional counters of the flat and solved pixels, which are incremented
+ *
+ * @return Scaled image
+*/
+template<typename S>
+PlanarImage<S> scaleNedi(const PlanarImage<S>& src, NediStats* stats) {
+    constexpr int channels = PlanarImage<S>::CHANNELS;
+    PlanarImage<S> result(src.width * 2, src.height * 2);
+
+    // Solve for 25% of pixels (top-left corner of 2x2 block) - needed for subsequent interpolation of 'b' pixels
+    for (int channel = 0; channel < channels; channel++) {
+        for (int y = 0; y < src.height; y++) {
+            for (int x = 0; x < src.width; x++) {
+                result.planes[size_t(channel)][result.getImageOffset(2*x, 2*y)] = src.planes[size_t(channel)][src.getImageOffset(x, y)];
+            }
+        }
+    }
+
+    const std::vector<bool> flat = classifyFlatNedi(src.width, src.height, [&src](size_t a, size_t b) {
+        for (int channel = 0; channel < channels; channel++) { if (src.value(channel, a) != src.value(channel, b)) { return false; } }
+        return true;
+    });
+    const PlanarImage<S> zero_padded    = padNediSource(src, ZERO);
+    const PlanarImage<S> nearest_padded = padNediSource(src, NEAREST);
+    PlanarImage<float> zero_band(zero_padded.width, NEDI_BAND_ROWS), nearest_band(nearest_padded.width, NEDI_BAND_ROWS);
+
+    NediStats local_stats;
+    std::vector<int> active_pixels;
+    NediRowWeights<channels> weights;
+    for (auto& kind : weights) { for (auto& row : kind) { for (Plane<float>& plane : row) { plane.resize(size_t(src.width)); } } }
+    for (int y = 0; y < src.height; y++) {
+        active_pixels.clear();
+        for (int x = 0; x < src.width; x++) {
+            if (flat[src.getImageOffset(x, y)]) {
+                for (auto& kind : weights) { for (auto& row : kind) { for (Plane<float>& plane : row) { plane[size_t(x)] = 0.25f; } } }
+            } else {
+                active_pixels.push_back(x);
+            }
+        }
+        if (!active_pixels.empty()) {
+            widenNediBand(zero_padded, y, zero_band);
+            widenNediBand(nearest_padded, y, nearest_band);
+            solveNediRow(src, zero_band, nearest_band, y, active_pixels, weights);
+        }
+        local_stats.flat_pixels     += size_t(src.width) - active_pixels.size();
+        local_stats.solved_pixels   += active_pixels.size();
+
+        // 'b' pixels (diagonal neighbours) first, then both 'a' pixels (axial neighbours), which read the 'b' pixels.
+        // No pixel reads another pixel of its own kind, so this matches interpolating the pixels one block at a time
+        for (int channel = 0; channel < channels; channel++) {
+            const auto channel_weights = [&](size_t kind) {
+                const auto& rows = weights[kind];
+                return std::array<const float*, 4> { rows[0][size_t(channel)].data(), rows[1][size_t(channel)].data(),
+                                                     rows[2][size_t(channel)].data(), rows[3][size_t(channel)].data() };
+            };
+            Plane<S>& plane = result.planes[size_t(channel)];
+            writeNediPlane(plane, result.width, result.height, 1, (2 * y) + 1,
+                           { glm::ivec2(-1, -1), glm::ivec2(1, -1), glm::ivec2(-1, 1), glm::ivec2(1, 1) }, channel_weights(0));
+            writeNediPlane(plane, result.width, result.height, 1, 2 * y,
+                           { glm::ivec2(0, -1), glm::ivec2(-1, 0), glm::ivec2(1, 0), glm::ivec2(0, 1) }, channel_weights(1));
+            writeNediPlane(plane, result.width, result.height, 0, (2 * y) + 1,
+                           { glm::ivec2(0, -1), glm::ivec2(-1, 0), glm::ivec2(1, 0), glm::ivec2(0, 1) }, channel_weights(1));
+        }
+    }
+
+    if (stats) {
+        stats->flat_pixels      += local_stats.flat_pixels;
+        stats->solved_pixels    += local_stats.solved_pixels;
+    }
+    return result;
+}
+
+/**
+ * Scale an image by 2x using NEDI on its planes (see scaleNedi for planar images)
+ *
+ * @param src Source image
+ * @param stats Optional counters of the flat and solved pixels, which are incremented
+ * @param precision Storage of the planes
+ *
+ * @return Scaled image
+*/
+template<typename T>
+Image<T> scaleNedi(const Image<T>& src, NediStats* stats, NediPrecision precision = NEDI_FLOAT) {
+    if (precision == NEDI_HALF) { return fromPlanar<T>(scaleNedi(toPlanar<Half>(src), stats)); }
+    return fromPlanar<T>(scaleNedi(toPlanar<float>(src), stats));
+}
+
+template<typename T>
+Image<T> scaleNedi(const Image<T>& src) { return scaleNedi(src, nullptr); }
+
+
+/**
+ * Scale an image by 2x using NEDI, solving every pixel on its own with Eigen. Reference for the batched solver
+ *
+ * @param src Source image
+ * @param skip_flat Whether pixels with a uniform sampling region take the equal weights without a solve (see
+ *                  classifyFlatNedi), as the batched solver does
+ *
+ * @return Scaled image
+*/
+template<typename T>
+Image<T> scaleNediScalar(const Image<T>& src, bool skip_flat) {
     auto result = Image<T>(src.width * 2, src.height * 2);
 
     // Solve for 25% of pixels (top-left corner of 2x2 block) - needed for subsequent interpolation of 'b' pixels
@@ -100,100 +657,25 @@ Image<T> scaleNedi(const Image<T>& src) {
         }
     }
 
+    const std::vector<bool> flat = skip_flat ? classifyFlatNedi(src) : std::vector<bool>(src.data.size(), false);
     for (int y = 0; y < src.height; y++) {
         for (int x = 0; x < src.width; x++) {
-            uint32_t window_pxl_length = 0U;
-
-            // Define top left corner of the sampling box
-            int top_left_x = x - ((window_pxl_length / 2) - 1);
-            int top_left_y = y - ((window_pxl_length / 2) - 1);
-
-            // Construct column vector representing window and matrices representing diagonal and axial neighbours of each pixel in the window
-            Eigen::Matrix<T, Eigen::Dynamic, 1> col_vec_y;
-            Eigen::Matrix<T, Eigen::Dynamic, 4> diagonal_neighbours;
-            Eigen::Matrix<T, Eigen::Dynamic, 4> axial_neighbours;
-            do {
-                window_pxl_length   += 2U;
-                col_vec_y           = Eigen::Matrix<T, Eigen::Dynamic, 1>(window_pxl_length * window_pxl_length, 1);
-                diagonal_neighbours = Eigen::Matrix<T, Eigen::Dynamic, 4>(window_pxl_length * window_pxl_length, 4);
-                axial_neighbours    = Eigen::Matrix<T, Eigen::Dynamic, 4>(window_pxl_length * window_pxl_length, 4);
-                size_t window_pixel_counter = 0U;
-
-                for (int offset_y = 0; offset_y < window_pxl_length; offset_y++) {
-                    for (int offset_x = 0; offset_x < window_pxl_length; offset_x++) {
-                        int window_pixel_x = top_left_x + offset_x;
-                        int window_pixel_y = top_left_y + offset_y;
-
-                        col_vec_y(window_pixel_counter) = src.safeAccess(window_pixel_x, window_pixel_y, NEAREST);
-                        std::array<T, 4> diagonal_neighbour_row = {
-                            src.safeAccess(window_pixel_x - 1, window_pixel_y - 1, ZERO),
-                            src.safeAccess(window_pixel_x + 1, window_pixel_y - 1, ZERO),
-                            src.safeAccess(window_pixel_x - 1, window_pixel_y + 1, ZERO),
-                            src.safeAccess(window_pixel_x + 1, window_pixel_y + 1, ZERO)};
-                        for (uint8_t col = 0; col < 4; col++) { diagonal_neighbours(window_pixel_counter, col) = diagonal_neighbour_row[col]; }
-                        std::array<T, 4> axial_neighbour_row = {
-                            src.safeAccess(window_pixel_x, window_pixel_y - 1, ZERO),
-                            src.safeAccess(window_pixel_x - 1, window_pixel_y, ZERO),
-                            src.safeAccess(window_pixel_x + 1, window_pixel_y, ZERO),
-                            src.safeAccess(window_pixel_x, window_pixel_y + 1, ZERO)};
-                        for (uint8_t col = 0; col < 4; col++) { axial_neighbours(window_pixel_counter, col) = axial_neighbour_row[col]; }
-
-                        window_pixel_counter++;
-                    }
-                }
-            } while (!conditionBelowThreshold(window_pxl_length, diagonal_neighbours, axial_neighbours) && window_pxl_length < WINDOW_SIZE_MAX);
-
-            // Compute diagonal and axial interpolation weights left sub-term
-            auto diagonal_neighbours_transpose  = diagonal_neighbours.transpose();
-            auto axial_neighbours_transpose     = axial_neighbours.transpose();
-            auto diagonal_lhs                   = (diagonal_neighbours_transpose * diagonal_neighbours).inverse();
-            auto axial_lhs                      = (axial_neighbours_transpose * axial_neighbours).inverse();
-            Eigen::Matrix<T, 4, 1> diagonal_interp_weights  = diagonal_lhs * (diagonal_neighbours_transpose * col_vec_y);
-            Eigen::Matrix<T, 4, 1> axial_interp_weights     = axial_lhs    * (axial_neighbours_transpose * col_vec_y);
-
-            // If either of the weight vectors has NaNs, replace with equal weights
-            for (uint8_t i = 0; i < 4; i++) {
-                if (glm::any(glm::isnan(diagonal_interp_weights(i)))) { setAllRowsToValue(diagonal_interp_weights, glm::vec3(0.25f)); }
-                if (glm::any(glm::isnan(axial_interp_weights(i)))) { setAllRowsToValue(axial_interp_weights, glm::vec3(0.25f)); }
+            Eigen::Matrix<T, 4, 1> diagonal_interp_weights;
+            Eigen::Matrix<T, 4, 1> axial_interp_weights;
+            if (flat[src.getImageOffset(x, y)]) {
+                setAllRowsToValue(diagonal_interp_weights, glm::vec3(0.25f));
+                setAllRowsToValue(axial_interp_weights, glm::vec3(0.25f));
+            } else {
+                solveNediWeights(src, x, y, diagonal_interp_weights, axial_interp_weights);
             }
-            
-            int dst_x;
-            int dst_y;
-
-            // 'b' pixel so diagonal neighbours
-            dst_x = (2 * x) + 1;
-            dst_y = (2 * y) + 1;
-            Eigen::Matrix<T, 4, 1> interp_bot_right_pixels { result.safeAccess(dst_x - 1, dst_y - 1),
-                                                             result.safeAccess(dst_x + 1, dst_y - 1),
-                                                             result.safeAccess(dst_x - 1, dst_y + 1),
-                                                             result.safeAccess(dst_x + 1, dst_y + 1)};
-            T interp_bot_right = diagonal_interp_weights.dot(interp_bot_right_pixels);
-            result.data[result.getImageOffset(dst_x, dst_y)] = interp_bot_right;
-            
-            // 'a' pixel so axial neighbours
-            dst_x = (2 * x) + 1;
-            dst_y = (2 * y);
-            Eigen::Matrix<T, 4, 1> interp_top_right_pixels { result.safeAccess(dst_x, dst_y - 1),
-                                                             result.safeAccess(dst_x - 1, dst_y),
-                                                             result.safeAccess(dst_x + 1, dst_y),
-                                                             result.safeAccess(dst_x, dst_y + 1)};
-            T interp_top_right = axial_interp_weights.dot(interp_top_right_pixels);
-            result.data[result.getImageOffset(dst_x, dst_y)] = interp_top_right;
-            
-            // 'a' pixel so axial neighbours
-            dst_x = (2 * x);
-            dst_y = (2 * y) + 1;
-            Eigen::Matrix<T, 4, 1> interp_bot_left_pixels { result.safeAccess(dst_x, dst_y - 1),
-                                                            result.safeAccess(dst_x - 1, dst_y),
-                                                            result.safeAccess(dst_x + 1, dst_y),
-                                                            result.safeAccess(dst_x, dst_y + 1)};
-            T interp_bot_left = axial_interp_weights.dot(interp_bot_left_pixels);
-            result.data[result.getImageOffset(dst_x, dst_y)] = interp_bot_left;
+            writeNediPixels(result, x, y, diagonal_interp_weights, axial_interp_weights);
         }
     }
-
     return result;
 }
 
+template<typename T>
+Image<T> scaleNediScalar(const Image<T>& src) { return scaleNediScalar(src, true); }
+
 
 #endif
@@ -0,0 +1,126 @@
+#ifndef NEDI_SOLVER_HPP
+#define NEDI_SOLVER_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Batched solver for the 4x4 normal equations R w = r of NEDI. Systems are stored structure-of-arrays, so consecutive
+// systems (pixels and channels alike) occupy consecutive SIMD lanes and every step of the factorisation is a single
+// branch-free loop over all lanes. Singular lanes are masked arithmetically instead of branched on, and report NaN
+// condition numbers and weights
+
+constexpr size_t NEDI_LANES             = 16U;  // Batches are padded to a multiple of this, which covers the widest SIMD unit (AVX-512 floats)
+constexpr size_t NEDI_COVARIANCE_TERMS  = 10U;  // Unique entries of a symmetric 4x4 matrix
+
+/**
+ * Index of entry (row, col) of a symmetric 4x4 matrix in its packed upper triangle (00, 01, 02, 03, 11, 12, 13, 22, 23, 33)
+*/
+constexpr size_t covarianceTerm(size_t row, size_t col) {
+    if (row > col) { return covarianceTerm(col, row); }
+    return (row * 4U) - ((row * (row - 1U)) / 2U) + (col - row);
+}
+static_assert(covarianceTerm(0, 3) == 3 && covarianceTerm(1, 1) == 4 && covarianceTerm(2, 3) == 8 && covarianceTerm(3, 3) == 9);
+
+struct NediSystemBatch {
+    std::array<std::vector<float>, NEDI_COVARIANCE_TERMS> covariance;   // R, packed
+    std::array<std::vector<float>, 4> rhs;                              // r
+    std::array<std::vector<float>, 4> weights;                          // w, written by solveNediBatch
+    std::vector<float> condition_squared;                               // Square of the condition of R, written by solveNediBatch
+
+    /**
+     * Resize the batch to hold the given number of systems, padded with zeroed (singular) systems
+    */
+    void resize(size_t system_count) {
+        const size_t padded = ((system_count + NEDI_LANES - 1U) / NEDI_LANES) * NEDI_LANES;
+        for (auto& term : covariance) { term.assign(padded, 0.0f); }
+        for (auto& term : rhs) { term.assign(padded, 0.0f); }
+        for (auto& term : weights) { term.resize(padded); }
+        condition_squared.resize(padded);
+    }
+};
+
+/**
+ * Solve every system of a batch with a square-root free Cholesky (LDL^T) factorisation and compute the condition of
+ * its covariance matrix as defined by the Adaptive NEDI paper, i.e. ||R|| * ||R^-1|| / window_size^2 in the Frobenius
+ * norm. The condition is reported squared, which keeps square roots out of the loop entirely
+ *
+ * @param batch Systems to solve; weights and squared condition are overwritten. Lanes whose matrix is not positive
+ *              definite get NaN weights and condition
+ * @param window_size Size of the local window the systems were sampled from
+*/
+inline void solveNediBatch(NediSystemBatch& batch, uint32_t window_size) {
+    const float scalar_component = 1.0f / (float(window_size) * float(window_size));
+    const size_t lanes = batch.condition_squared.size();
+
+    const float* a00 = batch.covariance[0].data(); const float* a01 = batch.covariance[1].data();
+    const float* a02 = batch.covariance[2].data(); const float* a03 = batch.covariance[3].data();
+    const float* a11 = batch.covariance[4].data(); const float* a12 = batch.covariance[5].data();
+    const float* a13 = batch.covariance[6].data(); const float* a22 = batch.covariance[7].data();
+    const float* a23 = batch.covariance[8].data(); const float* a33 = batch.covariance[9].data();
+    const float* r0 = batch.rhs[0].data(); const float* r1 = batch.rhs[1].data();
+    const float* r2 = batch.rhs[2].data(); const float* r3 = batch.rhs[3].data();
+    float* w0 = batch.weights[0].data(); float* w1 = batch.weights[1].data();
+    float* w2 = batch.weights[2].data(); float* w3 = batch.weights[3].data();
+    float* condition_squared = batch.condition_squared.data();
+
+    #pragma omp simd
+    for (size_t lane = 0; lane < lanes; lane++) {
+        // R = L D L^T with unit lower triangular L, which needs no square roots. A pivot that is not strictly positive
+        // marks the lane as singular, whose results are all turned into NaNs at the end
+        const float d0 = a00[lane];
+        const float e0 = 1.0f / d0;
+        const float l10 = a01[lane] * e0, l20 = a02[lane] * e0, l30 = a03[lane] * e0;
+
+        const float d1 = a11[lane] - (l10 * l10 * d0);
+        const float e1 = 1.0f / d1;
+        const float l21 = (a12[lane] - (l20 * l10 * d0)) * e1;
+        const float l31 = (a13[lane] - (l30 * l10 * d0)) * e1;
+
+        const float d2 = a22[lane] - (l20 * l20 * d0) - (l21 * l21 * d1);
+        const float e2 = 1.0f / d2;
+        const float l32 = (a23[lane] - (l30 * l20 * d0) - (l31 * l21 * d1)) * e2;
+
+        const float d3 = a33[lane] - (l30 * l30 * d0) - (l31 * l31 * d1) - (l32 * l32 * d2);
+        const float e3 = 1.0f / d3;
+
+        // 0 for positive pivots and NaN otherwise, computed without a select so the loop stays free of control flow
+        const float singular = (0.0f / (d0 + std::fabs(d0))) + (0.0f / (d1 + std::fabs(d1))) +
+                               (0.0f / (d2 + std::fabs(d2))) + (0.0f / (d3 + std::fabs(d3)));
+
+        // N = L^-1 (unit lower triangular), so that R^-1 = N^T D^-1 N
+        const float n10 = -l10;
+        const float n21 = -l21;
+        const float n20 = -(l20 + (l21 * n10));
+        const float n32 = -l32;
+        const float n31 = -(l31 + (l32 * n21));
+        const float n30 = -(l30 + (l31 * n10) + (l32 * n20));
+
+        const float v00 = e0 + (n10 * n10 * e1) + (n20 * n20 * e2) + (n30 * n30 * e3);
+        const float v01 = (n10 * e1) + (n20 * n21 * e2) + (n30 * n31 * e3);
+        const float v02 = (n20 * e2) + (n30 * n32 * e3);
+        const float v03 = n30 * e3;
+        const float v11 = e1 + (n21 * n21 * e2) + (n31 * n31 * e3);
+        const float v12 = (n21 * e2) + (n31 * n32 * e3);
+        const float v13 = n31 * e3;
+        const float v22 = e2 + (n32 * n32 * e3);
+        const float v23 = n32 * e3;
+        const float v33 = e3;
+
+        const float norm_r = (a00[lane] * a00[lane]) + (a11[lane] * a11[lane]) + (a22[lane] * a22[lane]) + (a33[lane] * a33[lane]) +
+                             2.0f * ((a01[lane] * a01[lane]) + (a02[lane] * a02[lane]) + (a03[lane] * a03[lane]) +
+                                     (a12[lane] * a12[lane]) + (a13[lane] * a13[lane]) + (a23[lane] * a23[lane]));
+        const float norm_inverse = (v00 * v00) + (v11 * v11) + (v22 * v22) + (v33 * v33) +
+                                   2.0f * ((v01 * v01) + (v02 * v02) + (v03 * v03) + (v12 * v12) + (v13 * v13) + (v23 * v23));
+        condition_squared[lane] = (norm_r * norm_inverse * scalar_component * scalar_component) + singular;
+
+        w0[lane] = (v00 * r0[lane]) + (v01 * r1[lane]) + (v02 * r2[lane]) + (v03 * r3[lane]) + singular;
+        w1[lane] = (v01 * r0[lane]) + (v11 * r1[lane]) + (v12 * r2[lane]) + (v13 * r3[lane]) + singular;
+        w2[lane] = (v02 * r0[lane]) + (v12 * r1[lane]) + (v22 * r2[lane]) + (v23 * r3[lane]) + singular;
+        w3[lane] = (v03 * r0[lane]) + (v13 * r1[lane]) + (v23 * r2[lane]) + (v33 * r3[lane]) + singular;
+    }
+}
+
+#endif
@@ -77,9 +77,6 @@ def read_png(filename):
 
     image_data: List[List[Tuple[int, int, int]]] = []
     for row in image_rows:
-        row_data = []
-        while row:
-            pixel = (row.pop(0), row.pop(0), row.pop(0))
-            row_data.append(pixel)
+        row_data = [tuple(row[i:i + 3]) for i in range(0, len(row), 3)]
         image_data.append(row_data)
     return height, width, image_data
@@ -0,0 +1,227 @@
+#include "pixelscale.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "scaler_registry.hpp"
+
+namespace {
+
+constexpr uint64_t ARENA_RETAINED_BYTES = 256ULL << 20U; // Free buffers kept for reuse beyond this are released
+
+// Pixel buffers of the outputs. Released buffers are kept (up to ARENA_RETAINED_BYTES) and handed out again to outputs
+// of at least half their capacity, so that batches of similar images stop allocating after the first one
+class BufferArena {
+public:
+    uint8_t* acquire(size_t bytes) {
+        std::lock_guard lock(mutex);
+        auto reusable = free_buffers.lower_bound(bytes);
+        if (reusable != free_buffers.end() && reusable->first <= bytes * 2U) {
+            uint8_t* buffer = reusable->second;
+            free_bytes -= reusable->first;
+            free_buffers.erase(reusable);
+            return buffer;
+        }
+        auto storage = std::make_unique<uint8_t[]>(bytes);
+        uint8_t* buffer = storage.get();
+        buffers.emplace(buffer, OwnedBuffer { std::move(storage), bytes });
+        return buffer;
+    }
+
+    void release(uint8_t* buffer) {
+        std::lock_guard lock(mutex);
+        const auto owned = buffers.find(buffer);
+        if (owned == buffers.end()) { return; }
+        if (free_bytes + owned->second.capacity > ARENA_RETAINED_BYTES) {
+            buffers.erase(owned);
+            return;
+        }
+        free_bytes += owned->second.capacity;
+        free_buffers.emplace(owned->second.capacity, buffer);
+    }
+
+private:
+    struct OwnedBuffer {
+        std::unique_ptr<uint8_t[]> storage;
+        size_t capacity;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<const uint8_t*, OwnedBuffer> buffers;
+    std::multimap<size_t, uint8_t*> free_buffers; // By capacity
+    uint64_t free_bytes = 0U;
+};
+
+// Threads that stay alive across batches and run the items of one batch at a time
+class WorkerPool {
+public:
+    explicit WorkerPool(uint32_t worker_count) {
+        for (uint32_t worker = 0U; worker < worker_count; worker++) { threads.emplace_back([this, worker] { workerLoop(worker); }); }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) { thread.join(); }
+    }
+
+    size_t size() const { return threads.size(); }
+
+    /**
+     * Run work(item, worker) for every item of a batch on the workers, and wait until all of them finished
+    */
+    void run(size_t count, const std::function<void(size_t, size_t)>& batch_work) {
+        std::unique_lock lock(mutex);
+        work        = &batch_work;
+        item_count  = count;
+        next_item   = 0U;
+        generation++;
+        wake.notify_all();
+        finished.wait(lock, [this] { return next_item == item_count && busy_workers == 0U; });
+        work = nullptr;
+    }
+
+private:
+    void workerLoop(size_t worker) {
+        uint64_t seen_generation = 0U;
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || (generation != seen_generation && next_item < item_count); });
+            if (stopping) { return; }
+            seen_generation = generation;
+            while (next_item < item_count) {
+                const size_t item = next_item++;
+                busy_workers++;
+                lock.unlock();
+                (*work)(item, worker);
+                lock.lock();
+                busy_workers--;
+            }
+            if (busy_workers == 0U) { finished.notify_all(); }
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    const std::function<void(size_t, size_t)>* work = nullptr;
+    size_t item_count = 0U, next_item = 0U, busy_workers = 0U;
+    uint64_t generation = 0U;
+    bool stopping = false;
+};
+
+}
+
+struct PixelScaleContext {
+    explicit PixelScaleContext(uint32_t thread_count) : workers(thread_count), worker_inputs(thread_count) {}
+
+    std::mutex batch_mutex; // Held for the whole of a batch
+    WorkerPool workers;
+    std::vector<Image<glm::uvec3>> worker_inputs; // Conversion buffer of the input every worker is scaling
+    BufferArena arena;
+    std::string last_error;
+};
+
+extern "C" {
+
+uint32_t pixelscaleApiVersion(void) { return PIXELSCALE_API_VERSION; }
+
+size_t pixelscaleAlgorithmCount(void) { return REGISTERED_SCALERS.size(); }
+
+const char* pixelscaleAlgorithmName(size_t index) {
+    return index < REGISTERED_SCALERS.size() ? REGISTERED_SCALERS[index].algorithm.data() : nullptr;
+}
+
+PixelScaleContext* pixelscaleCreateContext(uint32_t thread_count) {
+    if (thread_count == 0U) { thread_count = std::max(std::thread::hardware_concurrency(), 1U); }
+    try {
+        return new PixelScaleContext(thread_count);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void pixelscaleDestroyContext(PixelScaleContext* context) { delete context; }
+
+PixelScaleStatus pixelscaleScale(PixelScaleContext* context, const PixelScaleImage* inputs, size_t count, const char* algorithm,
+                                 uint32_t factor, PixelScaleImage* outputs) {
+    if (!context) { return PIXELSCALE_INVALID_ARGUMENT; }
+    std::lock_guard lock(context->batch_mutex);
+    auto fail = [&](PixelScaleStatus status, std::string message) {
+        context->last_error = std::move(message);
+        return status;
+    };
+    if (count > 0U && (!inputs || !outputs)) { return fail(PIXELSCALE_INVALID_ARGUMENT, "Inputs and outputs are required"); }
+    const RegisteredScaler* scaler = findScaler(algorithm ? algorithm : "");
+    if (!scaler) { return fail(PIXELSCALE_UNKNOWN_ALGORITHM, std::string("Unknown algorithm ") + (algorithm ? algorithm : "(null)")); }
+    const uint32_t passes = passesOfFactor(factor);
+    if (passes == 0U) { return fail(PIXELSCALE_INVALID_ARGUMENT, "Factor " + std::to_string(factor) + " is not a power of two >= 2"); }
+    for (size_t i = 0; i < count; i++) {
+        const int64_t output_pixels = int64_t(inputs[i].width) * int64_t(inputs[i].height) * int64_t(factor) * int64_t(factor);
+        if (inputs[i].width <= 0 || inputs[i].height <= 0 || !inputs[i].rgb || int64_t(inputs[i].width) * factor > INT32_MAX ||
+            int64_t(inputs[i].height) * factor > INT32_MAX || output_pixels > (int64_t(1) << 40)) {
+            return fail(PIXELSCALE_INVALID_ARGUMENT, "Input " + std::to_string(i) + " has no pixels or an invalid size");
+        }
+    }
+
+    // Every image is scaled by one worker of the context; the scalers have no parallel loops of their own
+    std::vector<std::exception_ptr> failures(count);
+    const std::function<void(size_t, size_t)> scaleItem = [&](size_t item, size_t worker) {
+        try {
+            const PixelScaleImage& input = inputs[item];
+            Image<glm::uvec3>& source = context->worker_inputs[worker];
+            source.width    = input.width;
+            source.height   = input.height;
+            source.data.resize(size_t(input.width) * size_t(input.height));
+            for (size_t i = 0; i < source.data.size(); i++) { source.data[i] = stbToType<glm::uvec3>(input.rgb + (i * 3U)); }
+
+            const Image<glm::uvec3> scaled = scaler->scale_chain(source, passes);
+            PixelScaleImage& output = outputs[item];
+            output.width    = scaled.width;
+            output.height   = scaled.height;
+            output.rgb      = context->arena.acquire(scaled.data.size() * 3U);
+            for (size_t i = 0; i < scaled.data.size(); i++) { typeToRgbUint8(output.rgb + (i * 3U), scaled.data[i]); }
+        } catch (...) {
+            failures[item] = std::current_exception();
+        }
+    };
+    for (size_t i = 0; i < count; i++) { outputs[i].rgb = nullptr; }
+    context->workers.run(count, scaleItem);
+
+    const auto failed = std::find_if(failures.begin(), failures.end(), [](const std::exception_ptr& failure) { return bool(failure); });
+    if (failed == failures.end()) {
+        context->last_error.clear();
+        return PIXELSCALE_OK;
+    }
+    for (size_t i = 0; i < count; i++) { pixelscaleReleaseImage(context, &outputs[i]); }
+    return fail(PIXELSCALE_SCALING_FAILED, "Scaling input " + std::to_string(failed - failures.begin()) + " with " + algorithm + " failed");
+}
+
+void pixelscaleReleaseImage(PixelScaleContext* context, PixelScaleImage* image) {
+    if (!context || !image || !image->rgb) { return; }
+    context->arena.release(image->rgb);
+    image->rgb = nullptr;
+}
+
+const char* pixelscaleLastError(const PixelScaleContext* context) { return context ? context->last_error.c_str() : "No context"; }
+
+}
@@ -0,0 +1,69 @@
+#ifndef PIXELSCALE_H
+#define PIXELSCALE_H
+
+/*
+ * pixelscale: the 2x pixel-art scalers of fin-proj as a library with a stable C interface, for tools that scale many
+ * images in-process.
+ *
+ * All state lives in a context, which is created once and reused for every batch: it owns the worker threads that scale
+ * the images of a batch in parallel and an arena of pixel buffers that outputs are allocated from and released back to.
+ * A context runs one batch at a time; concurrent calls on the same context are serialised.
+ *
+ * Images are 8-bit RGB, stored row by row without padding. Functions report failures through their status, with a
+ * description available from pixelscaleLastError, and never throw.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIXELSCALE_API_VERSION 1
+
+typedef struct PixelScaleContext PixelScaleContext;
+
+typedef struct PixelScaleImage {
+    int32_t width, height;
+    uint8_t* rgb; /* width * height * 3 bytes */
+} PixelScaleImage;
+
+typedef enum PixelScaleStatus {
+    PIXELSCALE_OK = 0,
+    PIXELSCALE_INVALID_ARGUMENT,
+    PIXELSCALE_UNKNOWN_ALGORITHM,
+    PIXELSCALE_SCALING_FAILED
+} PixelScaleStatus;
+
+/* Version of the interface the library was built with, to be compared against PIXELSCALE_API_VERSION */
+uint32_t pixelscaleApiVersion(void);
+
+/* Algorithms accepted by pixelscaleScale, as named in the output files of fin-proj */
+size_t pixelscaleAlgorithmCount(void);
+const char* pixelscaleAlgorithmName(size_t index);
+
+/* Create a context with the given number of threads (0 for one per hardware thread); returns NULL on failure */
+PixelScaleContext* pixelscaleCreateContext(uint32_t thread_count);
+void pixelscaleDestroyContext(PixelScaleContext* context);
+
+/*
+ * Scale a batch of images by a power-of-two factor (>= 2), chaining 2x passes of an algorithm. The images of a batch are
+ * scaled in parallel, each one by a single thread of the context. Every output receives a buffer owned by
+ * the context, which stays valid until it is passed to pixelscaleReleaseImage or the context is destroyed. On failure,
+ * no output is allocated
+ */
+PixelScaleStatus pixelscaleScale(PixelScaleContext* context, const PixelScaleImage* inputs, size_t count, const char* algorithm,
+                                 uint32_t factor, PixelScaleImage* outputs);
+
+/* Return the buffer of an output to the arena of its context, for reuse by later batches */
+void pixelscaleReleaseImage(PixelScaleContext* context, PixelScaleImage* image);
+
+/* Description of the last failure of a call on the context */
+const char* pixelscaleLastError(const PixelScaleContext* context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
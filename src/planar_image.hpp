@@ -0,0 +1,157 @@
+#ifndef PLANAR_IMAGE_HPP
+#define PLANAR_IMAGE_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+// Planar (structure-of-arrays) counterpart of Image<T>: one contiguous, aligned plane per channel, so per-channel
+// arithmetic runs along rows of plain scalars instead of through glm vectors. Channels are stored as float or, to halve
+// the memory footprint, as IEEE 754 half-precision floats which are widened to float for arithmetic
+
+constexpr size_t PLANE_ALIGNMENT = 64U; // Bytes; a cache line, which also covers the widest SIMD register
+
+template<typename S>
+struct AlignedAllocator {
+    using value_type = S;
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    S* allocate(size_t count) { return static_cast<S*>(::operator new(count * sizeof(S), std::align_val_t(PLANE_ALIGNMENT))); }
+    void deallocate(S* pointer, size_t) { ::operator delete(pointer, std::align_val_t(PLANE_ALIGNMENT)); }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+};
+
+template<typename S>
+using Plane = std::vector<S, AlignedAllocator<S>>;
+
+// IEEE 754 binary16 storage type
+struct Half {
+    uint16_t bits = 0U;
+
+    Half() = default;
+
+    /**
+     * Round a float to the nearest half (ties to even), saturating to infinity and keeping NaNs
+    */
+    explicit Half(float value) {
+        const uint32_t f        = std::bit_cast<uint32_t>(value);
+        const uint32_t sign     = (f >> 16U) & 0x8000U;
+        const uint32_t exponent = (f >> 23U) & 0xffU;
+        uint32_t mantissa       = f & 0x7fffffU;
+
+        if (exponent == 0xffU) {
+            bits = uint16_t(sign | 0x7c00U | (mantissa != 0U ? 0x200U : 0U));
+            return;
+        }
+        const int half_exponent = int(exponent) - 127 + 15;
+        if (half_exponent >= 0x1f) {
+            bits = uint16_t(sign | 0x7c00U);
+            return;
+        }
+        if (half_exponent <= 0) {
+            // Subnormal (or zero) half: shift in the implicit bit and round away the rest
+            if (half_exponent < -10) {
+                bits = uint16_t(sign);
+                return;
+            }
+            mantissa |= 0x800000U;
+            const uint32_t shift    = uint32_t(14 - half_exponent);
+            uint32_t half_mantissa  = mantissa >> shift;
+            const uint32_t rest     = mantissa & ((1U << shift) - 1U);
+            const uint32_t halfway  = 1U << (shift - 1U);
+            if (rest > halfway || (rest == halfway && (half_mantissa & 1U))) { half_mantissa++; }
+            bits = uint16_t(sign | half_mantissa);
+            return;
+        }
+
+        uint32_t half = sign | (uint32_t(half_exponent) << 10U) | (mantissa >> 13U);
+        const uint32_t rest = mantissa & 0x1fffU;
+        if (rest > 0x1000U || (rest == 0x1000U && (half & 1U))) { half++; } // A carry into the exponent is still correct
+        bits = uint16_t(half);
+    }
+
+    explicit operator float() const {
+        const uint32_t sign     = uint32_t(bits & 0x8000U) << 16U;
+        const uint32_t exponent = (bits >> 10U) & 0x1fU;
+        const uint32_t mantissa = bits & 0x3ffU;
+        if (exponent == 0U) {
+            // Zero or subnormal: mantissa * 2^-24
+            const float magnitude = float(mantissa) * (1.0f / 16777216.0f);
+            return sign ? -magnitude : magnitude;
+        }
+        if (exponent == 0x1fU) { return std::bit_cast<float>(sign | 0x7f800000U | (mantissa << 13U)); }
+        return std::bit_cast<float>(sign | ((exponent - 15U + 127U) << 23U) | (mantissa << 13U));
+    }
+};
+
+template<typename S = float, int Channels = 3>
+class PlanarImage {
+public:
+    static constexpr int CHANNELS = Channels;
+
+    PlanarImage(int width, int height) : width(width), height(height) {
+        for (Plane<S>& plane : planes) { plane.resize(size_t(width) * size_t(height)); } // Zero-initialised
+    }
+    PlanarImage() : PlanarImage(1, 1) {}
+
+    size_t getImageOffset(int x, int y) const { return (size_t(y) * size_t(width)) + size_t(x); }
+    float value(int channel, size_t offset) const { return float(planes[size_t(channel)][offset]); }
+    void setValue(int channel, size_t offset, float value) { planes[size_t(channel)][offset] = S(value); }
+
+public:
+    int width, height;
+    std::array<Plane<S>, Channels> planes;
+};
+
+/**
+ * Split an image into planes
+ *
+ * @param image Image whose pixel type has PlanarImage::CHANNELS components
+ *
+ * @return Planar copy of the image, rounded to the storage type
+*/
+template<typename S, typename T>
+PlanarImage<S> toPlanar(const Image<T>& image) {
+    static_assert(T::length() == PlanarImage<S>::CHANNELS);
+    PlanarImage<S> planar(image.width, image.height);
+    for (int channel = 0; channel < PlanarImage<S>::CHANNELS; channel++) {
+        S* plane = planar.planes[size_t(channel)].data();
+        for (size_t i = 0; i < image.data.size(); i++) { plane[i] = S(float(image.data[i][channel])); }
+    }
+    return planar;
+}
+
+/**
+ * Interleave the planes of a planar image
+ *
+ * @param planar Planar image
+ *
+ * @return Image with one pixel per planar sample
+*/
+template<typename T, typename S>
+Image<T> fromPlanar(const PlanarImage<S>& planar) {
+    static_assert(T::length() == PlanarImage<S>::CHANNELS);
+    Image<T> image(planar.width, planar.height);
+    for (int channel = 0; channel < PlanarImage<S>::CHANNELS; channel++) {
+        const S* plane = planar.planes[size_t(channel)].data();
+        for (size_t i = 0; i < image.data.size(); i++) { image.data[i][channel] = typename T::value_type(float(plane[i])); }
+    }
+    return image;
+}
+
+#endif
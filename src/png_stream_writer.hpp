@@ -0,0 +1,227 @@
+#ifndef PNG_STREAM_WRITER_HPP
+#define PNG_STREAM_WRITER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <framework/image.h>
+
+// Incremental 8-bit RGB PNG encoder. Rows are filtered, compressed and flushed to disk as IDAT chunks while the
+// image is still being produced, so only the current and previous row are kept in memory
+
+constexpr size_t PNG_FLUSH_THRESHOLD    = 1U << 16U;  // Compressed bytes buffered before an IDAT chunk is written
+constexpr uint32_t DEFLATE_MIN_MATCH    = 3U;
+constexpr uint32_t DEFLATE_MAX_MATCH    = 258U;
+
+enum PngFilter : uint8_t { PNG_FILTER_NONE = 0U, PNG_FILTER_SUB = 1U, PNG_FILTER_UP = 2U };
+
+inline const std::array<uint32_t, 256>& crcTable() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries;
+        for (uint32_t n = 0U; n < 256U; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) { c = (c & 1U) ? (0xedb88320U ^ (c >> 1U)) : (c >> 1U); }
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    return table;
+}
+
+class PngStreamWriter {
+public:
+    /**
+     * Create the file and write the PNG header
+     *
+     * @param file_path Path of the output file, whose parent directories are created if needed
+     * @param width Width of the image in pixels
+     * @param height Height of the image in pixels
+    */
+    PngStreamWriter(const std::filesystem::path& file_path, int width, int height)
+        : width(width), height(height), current_row(size_t(width) * 3U), previous_row(size_t(width) * 3U, 0U) {
+        if (!file_path.parent_path().empty() && !std::filesystem::is_directory(file_path.parent_path())) {
+            std::filesystem::create_directories(file_path.parent_path());
+        }
+        file.open(file_path, std::ios::binary);
+        if (!file) {
+            std::cerr << "PNG file " << file_path << " could not be opened for writing!" << std::endl;
+            throw std::exception();
+        }
+
+        static constexpr uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+        std::vector<uint8_t> header;
+        appendBigEndian(header, uint32_t(width));
+        appendBigEndian(header, uint32_t(height));
+        header.insert(header.end(), { 8U, 2U, 0U, 0U, 0U }); // 8-bit depth, truecolour, deflate, adaptive filtering, no interlace
+        writeChunk("IHDR", header);
+
+        compressed.insert(compressed.end(), { 0x78U, 0x01U }); // zlib header: deflate, 32K window, no dictionary
+        writeBits(0U, 1U); // BFINAL unset; the stream is terminated by an empty final block in finish()
+        writeBits(1U, 2U); // BTYPE 01 (fixed Huffman codes)
+    }
+
+    PngStreamWriter(const PngStreamWriter&) = delete;
+    PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+    ~PngStreamWriter() { if (!finished) { finish(); } }
+
+    /**
+     * Append the next row of the image, quantised like Image<T>::writeToFile
+     *
+     * @param row Pointer to width pixels
+    */
+    template<typename T>
+    void writeRow(const T* row) {
+        for (int x = 0; x < width; x++) { typeToRgbUint8<T>(&current_row[size_t(x) * 3U], row[x]); }
+
+        // Pick the filter with the smallest sum of absolute residuals, which favours long zero runs
+        uint64_t cost_none = 0U, cost_sub = 0U, cost_up = 0U;
+        for (size_t i = 0; i < current_row.size(); i++) {
+            uint8_t left = (i >= 3U) ? current_row[i - 3U] : 0U;
+            cost_none   += residualCost(current_row[i]);
+            cost_sub    += residualCost(uint8_t(current_row[i] - left));
+            cost_up     += residualCost(uint8_t(current_row[i] - previous_row[i]));
+        }
+        PngFilter filter = PNG_FILTER_NONE;
+        if (cost_sub < cost_none) { filter = PNG_FILTER_SUB; }
+        if (cost_up < std::min(cost_none, cost_sub)) { filter = PNG_FILTER_UP; }
+
+        compressByte(filter);
+        for (size_t i = 0; i < current_row.size(); i++) {
+            uint8_t left = (i >= 3U) ? current_row[i - 3U] : 0U;
+            switch (filter) {
+                case PNG_FILTER_NONE:   compressByte(current_row[i]); break;
+                case PNG_FILTER_SUB:    compressByte(uint8_t(current_row[i] - left)); break;
+                case PNG_FILTER_UP:     compressByte(uint8_t(current_row[i] - previous_row[i])); break;
+            }
+        }
+        std::swap(current_row, previous_row);
+        rows_written++;
+        if (compressed.size() >= PNG_FLUSH_THRESHOLD) { flushCompressed(); }
+    }
+
+    /**
+     * Terminate the deflate stream and write the trailing chunks. Called by the destructor if omitted
+    */
+    void finish() {
+        if (rows_written != height) { std::cerr << "PNG stream finished after " << rows_written << " of " << height << " rows" << std::endl; }
+        flushRun();
+        writeFixedCode(256U);   // End of the main block
+        writeBits(1U, 1U);      // Empty final block
+        writeBits(1U, 2U);
+        writeFixedCode(256U);
+        if (bit_count > 0U) { writeBits(0U, 8U - bit_count); }
+        appendBigEndian(compressed, (adler_b << 16U) | adler_a);
+        flushCompressed();
+        writeChunk("IEND", {});
+        file.close();
+        finished = true;
+    }
+
+private:
+    static uint64_t residualCost(uint8_t residual) { return uint64_t(std::min<int>(residual, 256 - residual)); }
+
+    static void appendBigEndian(std::vector<uint8_t>& buffer, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) { buffer.push_back(uint8_t(value >> shift)); }
+    }
+
+    void writeChunk(const char type[4], const std::vector<uint8_t>& payload) {
+        std::vector<uint8_t> chunk;
+        chunk.reserve(payload.size() + 12U);
+        appendBigEndian(chunk, uint32_t(payload.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), payload.begin(), payload.end());
+        uint32_t crc = 0xffffffffU;
+        for (size_t i = 4; i < chunk.size(); i++) { crc = crcTable()[(crc ^ chunk[i]) & 0xffU] ^ (crc >> 8U); }
+        appendBigEndian(chunk, crc ^ 0xffffffffU);
+        file.write(reinterpret_cast<const char*>(chunk.data()), std::streamsize(chunk.size()));
+    }
+
+    void flushCompressed() {
+        if (compressed.empty()) { return; }
+        writeChunk("IDAT", compressed);
+        compressed.clear();
+    }
+
+    // Deflate streams are packed starting at the least significant bit
+    void writeBits(uint32_t value, uint32_t count) {
+        bit_buffer |= uint64_t(value) << bit_count;
+        bit_count += count;
+        while (bit_count >= 8U) {
+            compressed.push_back(uint8_t(bit_buffer));
+            bit_buffer >>= 8U;
+            bit_count -= 8U;
+        }
+    }
+
+    // Huffman codes are packed starting at their most significant bit
+    void writeReversed(uint32_t code, uint32_t length) {
+        uint32_t reversed = 0U;
+        for (uint32_t i = 0U; i < length; i++) { reversed |= ((code >> i) & 1U) << (length - 1U - i); }
+        writeBits(reversed, length);
+    }
+
+    void writeFixedCode(uint32_t symbol) {
+        if (symbol < 144U)      { writeReversed(0x30U + symbol, 8U); }
+        else if (symbol < 256U) { writeReversed(0x190U + (symbol - 144U), 9U); }
+        else if (symbol < 280U) { writeReversed(symbol - 256U, 7U); }
+        else                    { writeReversed(0xc0U + (symbol - 280U), 8U); }
+    }
+
+    // Encode a copy of the previous byte (distance 1) of the given length
+    void writeRunMatch(uint32_t length) {
+        static constexpr std::array<uint32_t, 29> LENGTH_BASE = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static constexpr std::array<uint32_t, 29> LENGTH_EXTRA_BITS = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        size_t code = size_t(std::upper_bound(LENGTH_BASE.begin(), LENGTH_BASE.end(), length) - LENGTH_BASE.begin()) - 1U;
+        writeFixedCode(257U + uint32_t(code));
+        writeBits(length - LENGTH_BASE[code], LENGTH_EXTRA_BITS[code]);
+        writeReversed(0U, 5U); // Distance code 0 (distance 1)
+    }
+
+    void flushRun() {
+        while (run_length >= DEFLATE_MIN_MATCH) {
+            // Avoid leaving a remainder too short to be a match
+            uint32_t length = std::min(run_length, DEFLATE_MAX_MATCH);
+            if (run_length - length > 0U && run_length - length < DEFLATE_MIN_MATCH) { length -= DEFLATE_MIN_MATCH; }
+            writeRunMatch(length);
+            run_length -= length;
+        }
+        for (; run_length > 0U; run_length--) { writeFixedCode(last_byte); }
+    }
+
+    // Run-length compress (distance-1 matches), which suits the filtered rows of upscaled pixel art
+    void compressByte(uint8_t byte) {
+        adler_a = (adler_a + byte) % 65521U;
+        adler_b = (adler_b + adler_a) % 65521U;
+        if (has_last_byte && byte == last_byte) {
+            run_length++;
+            return;
+        }
+        flushRun();
+        writeFixedCode(byte);
+        last_byte       = byte;
+        has_last_byte   = true;
+    }
+
+    int width, height;
+    int rows_written = 0;
+    bool finished = false;
+    std::ofstream file;
+    std::vector<uint8_t> current_row, previous_row, compressed;
+    uint64_t bit_buffer = 0U;
+    uint32_t bit_count  = 0U;
+    uint32_t adler_a = 1U, adler_b = 0U;
+    uint8_t last_byte = 0U;
+    bool has_last_byte = false;
+    uint32_t run_length = 0U;
+};
+
+#endif
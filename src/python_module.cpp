@@ -0,0 +1,287 @@
+// Python extension module 'pixel_scaling', exposing the framework images and the 2x scalers to Python scripts.
+//
+//  - pixel_scaling.Image(path) loads an image, and Image(buffer) / Image(buffer, width, height) copies one from any
+//    C-contiguous buffer of 8-bit or 32-bit unsigned RGB values (shaped (height, width, 3), or flat with an explicit size).
+//  - Images export their pixels through the buffer protocol without copying: memoryview(image) is a writable
+//    (height, width, 3) view of uint32 ('I') values, as stored by Image<glm::uvec3>.
+//  - pixel_scaling.scale(image, algorithm, factor=2) chains 2x passes of a scaler up to a power-of-two factor.
+//
+// No Python object is created per pixel, and the GIL is released while loading, scaling and saving, so that Python
+// threads scale different images in parallel. A single image is scaled on the calling thread.
+// Errors of the C++ side (reported on std::cerr) are raised as OSError for files and ValueError for pixels.
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include <framework/image.h>
+
+#include "scaler_registry.hpp"
+
+static_assert(sizeof(glm::uvec3) == 3U * sizeof(uint32_t), "Pixels are exported as packed uint32 triplets");
+
+namespace {
+
+struct PyImage {
+    PyObject_HEAD
+    Image<glm::uvec3>* image;   // Owned
+    Py_ssize_t shape[3];        // Buffer layout: (height, width, 3)
+    Py_ssize_t strides[3];
+};
+
+extern PyTypeObject PyImageType;
+
+// Wrap an image in a new Python object, taking ownership of it
+PyObject* wrapImage(Image<glm::uvec3>* image) {
+    auto* self = reinterpret_cast<PyImage*>(PyImageType.tp_alloc(&PyImageType, 0));
+    if (!self) {
+        delete image;
+        return nullptr;
+    }
+    self->image         = image;
+    self->shape[0]      = image->height;
+    self->shape[1]      = image->width;
+    self->shape[2]      = 3;
+    self->strides[2]    = Py_ssize_t(sizeof(uint32_t));
+    self->strides[1]    = self->strides[2] * 3;
+    self->strides[0]    = self->strides[1] * image->width;
+    return reinterpret_cast<PyObject*>(self);
+}
+
+// Copy the pixels of a buffer into a new image; returns nullptr with a Python error set if the buffer does not hold RGB
+Image<glm::uvec3>* imageFromBuffer(PyObject* source, Py_ssize_t width, Py_ssize_t height) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(source, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) { return nullptr; }
+    const std::string_view format = view.format ? view.format : "B";
+    const bool bytes    = view.itemsize == 1 && (format == "B" || format == "=B" || format == "<B");
+    const bool words    = view.itemsize == 4 && (format == "I" || format == "=I" || format == "<I" || format == "L" || format == "=L" || format == "<L");
+    if (width < 0) {
+        if (view.ndim == 3 && view.shape[2] == 3) {
+            height  = view.shape[0];
+            width   = view.shape[1];
+        }
+    } else if (view.len != width * height * 3 * view.itemsize) {
+        width = -1;
+    }
+
+    Image<glm::uvec3>* image = nullptr;
+    if (!bytes && !words) {
+        PyErr_Format(PyExc_ValueError, "Pixels must be unsigned 8-bit or 32-bit values, not '%s'", format.data());
+    } else if (width <= 0 || height <= 0 || width > INT32_MAX || height > INT32_MAX) {
+        PyErr_SetString(PyExc_ValueError, "Pixels must be shaped (height, width, 3), or hold width * height * 3 values");
+    } else {
+        image = new Image<glm::uvec3>(int(width), int(height));
+        uint32_t largest = 0U;
+        for (size_t i = 0; i < image->data.size() * 3U; i++) {
+            uint32_t value;
+            if (bytes) {
+                value = static_cast<const uint8_t*>(view.buf)[i];
+            } else {
+                std::memcpy(&value, static_cast<const uint8_t*>(view.buf) + (i * 4U), sizeof(value));
+            }
+            image->data[i / 3U][int(i % 3U)] = value;
+            largest = std::max(largest, value);
+        }
+        if (largest > 255U) {
+            PyErr_SetString(PyExc_ValueError, "Pixel values must be within [0, 255]");
+            delete image;
+            image = nullptr;
+        }
+    }
+    PyBuffer_Release(&view);
+    return image;
+}
+
+PyObject* imageNew(PyTypeObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "source", "width", "height", nullptr };
+    PyObject* source;
+    Py_ssize_t width = -1, height = -1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nn", const_cast<char**>(keywords), &source, &width, &height)) { return nullptr; }
+
+    if (!PyUnicode_Check(source) && !PyObject_HasAttrString(source, "__fspath__")) {
+        Image<glm::uvec3>* image = imageFromBuffer(source, width, height);
+        return image ? wrapImage(image) : nullptr;
+    }
+
+    PyObject* path_bytes;
+    if (!PyUnicode_FSConverter(source, &path_bytes)) { return nullptr; }
+    const std::filesystem::path path { PyBytes_AS_STRING(path_bytes) };
+    Py_DECREF(path_bytes);
+    Image<glm::uvec3>* image = nullptr;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        image = new Image<glm::uvec3>(path);
+    } catch (const std::exception&) {
+        image = nullptr;
+    }
+    Py_END_ALLOW_THREADS
+    if (!image) { return PyErr_Format(PyExc_OSError, "Could not load image %s", path.c_str()); }
+    return wrapImage(image);
+}
+
+void imageDealloc(PyObject* object) {
+    delete reinterpret_cast<PyImage*>(object)->image;
+    Py_TYPE(object)->tp_free(object);
+}
+
+// Export the pixels in place. The vector is never resized after construction, so views stay valid for the image's lifetime
+int imageGetBuffer(PyObject* object, Py_buffer* view, int flags) {
+    auto* self = reinterpret_cast<PyImage*>(object);
+    view->obj           = Py_NewRef(object);
+    view->buf           = self->image->data.data();
+    view->len           = Py_ssize_t(self->image->data.size() * sizeof(glm::uvec3));
+    view->readonly      = 0;
+    view->itemsize      = Py_ssize_t(sizeof(uint32_t));
+    view->format        = (flags & PyBUF_FORMAT) ? const_cast<char*>("I") : nullptr;
+    view->ndim          = 3;
+    view->shape         = (flags & PyBUF_ND) ? self->shape : nullptr;
+    view->strides       = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? self->strides : nullptr;
+    view->suboffsets    = nullptr;
+    view->internal      = nullptr;
+    return 0;
+}
+
+PyObject* imageSave(PyObject* object, PyObject* args) {
+    PyObject* path_bytes;
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path_bytes)) { return nullptr; }
+    const std::filesystem::path path { PyBytes_AS_STRING(path_bytes) };
+    Py_DECREF(path_bytes);
+    const Image<glm::uvec3>& image = *reinterpret_cast<PyImage*>(object)->image;
+    bool written = true;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        image.writeToFile(path);
+    } catch (const std::exception&) {
+        written = false;
+    }
+    Py_END_ALLOW_THREADS
+    if (!written) { return PyErr_Format(PyExc_OSError, "Could not write image %s", path.c_str()); }
+    Py_RETURN_NONE;
+}
+
+// Pixels as packed 8-bit RGB, as written to the output files
+PyObject* imageRgb8(PyObject* object, PyObject*) {
+    const Image<glm::uvec3>& image = *reinterpret_cast<PyImage*>(object)->image;
+    PyObject* bytes = PyBytes_FromStringAndSize(nullptr, Py_ssize_t(image.data.size() * 3U));
+    if (!bytes) { return nullptr; }
+    auto* rgb = reinterpret_cast<stbi_uc*>(PyBytes_AS_STRING(bytes));
+    for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8(rgb + (i * 3U), image.data[i]); }
+    return bytes;
+}
+
+PyObject* imageWidth(PyObject* object, void*) { return PyLong_FromLong(reinterpret_cast<PyImage*>(object)->image->width); }
+PyObject* imageHeight(PyObject* object, void*) { return PyLong_FromLong(reinterpret_cast<PyImage*>(object)->image->height); }
+
+PyMethodDef IMAGE_METHODS[] = {
+    { "save", imageSave, METH_VARARGS, "save(path)\n\nWrite the image to a file, encoded according to its extension." },
+    { "rgb8", imageRgb8, METH_NOARGS, "rgb8() -> bytes\n\nCopy of the pixels as packed 8-bit RGB, row by row." },
+    { nullptr, nullptr, 0, nullptr }};
+
+PyGetSetDef IMAGE_GETSETS[] = {
+    { "width", imageWidth, nullptr, "Width in pixels", nullptr },
+    { "height", imageHeight, nullptr, "Height in pixels", nullptr },
+    { nullptr, nullptr, nullptr, nullptr, nullptr }};
+
+PyBufferProcs IMAGE_BUFFER = { imageGetBuffer, nullptr };
+
+PyTypeObject PyImageType = [] {
+    PyTypeObject type = { PyVarObject_HEAD_INIT(nullptr, 0) };
+    type.tp_name        = "pixel_scaling.Image";
+    type.tp_basicsize   = sizeof(PyImage);
+    type.tp_dealloc     = imageDealloc;
+    type.tp_as_buffer   = &IMAGE_BUFFER;
+    type.tp_flags       = Py_TPFLAGS_DEFAULT;
+    type.tp_doc         = "Image(source, width=None, height=None)\n\n"
+                          "RGB image loaded from a file path, or copied from a buffer of unsigned 8-bit or 32-bit values.\n"
+                          "Exports its pixels as a writable (height, width, 3) buffer of uint32 values.";
+    type.tp_methods     = IMAGE_METHODS;
+    type.tp_getset      = IMAGE_GETSETS;
+    type.tp_new         = imageNew;
+    return type;
+}();
+
+PyObject* moduleScale(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "image", "algorithm", "factor", nullptr };
+    PyObject* source;
+    const char* algorithm;
+    unsigned int factor = 2U;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os|I", const_cast<char**>(keywords), &source, &algorithm, &factor)) { return nullptr; }
+
+    const RegisteredScaler* scaler = findScaler(algorithm);
+    if (!scaler) { return PyErr_Format(PyExc_ValueError, "Unknown algorithm %s", algorithm); }
+    const uint32_t passes = passesOfFactor(factor);
+    if (passes == 0U) { return PyErr_Format(PyExc_ValueError, "Factor %u is not a power of two >= 2", factor); }
+
+    // Buffers are copied into an image first; images are read in place
+    PyObject* image_object;
+    if (PyObject_TypeCheck(source, &PyImageType)) {
+        image_object = Py_NewRef(source);
+    } else {
+        Image<glm::uvec3>* image = imageFromBuffer(source, -1, -1);
+        image_object = image ? wrapImage(image) : nullptr;
+        if (!image_object) { return nullptr; }
+    }
+    const Image<glm::uvec3>& src = *reinterpret_cast<PyImage*>(image_object)->image;
+
+    Image<glm::uvec3>* result = nullptr;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        result = new Image<glm::uvec3>(scaler->scale_chain(src, passes));
+    } catch (const std::exception&) {
+        result = nullptr;
+    }
+    Py_END_ALLOW_THREADS
+    Py_DECREF(image_object);
+    if (!result) { return PyErr_Format(PyExc_ValueError, "Could not scale image with %s", algorithm); }
+    return wrapImage(result);
+}
+
+PyObject* moduleAlgorithms(PyObject*, PyObject*) {
+    PyObject* names = PyList_New(Py_ssize_t(REGISTERED_SCALERS.size()));
+    if (!names) { return nullptr; }
+    for (size_t i = 0; i < REGISTERED_SCALERS.size(); i++) {
+        PyObject* name = PyUnicode_FromStringAndSize(REGISTERED_SCALERS[i].algorithm.data(), Py_ssize_t(REGISTERED_SCALERS[i].algorithm.size()));
+        if (!name) {
+            Py_DECREF(names);
+            return nullptr;
+        }
+        PyList_SET_ITEM(names, Py_ssize_t(i), name);
+    }
+    return names;
+}
+
+PyMethodDef MODULE_METHODS[] = {
+    { "scale", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(moduleScale)), METH_VARARGS | METH_KEYWORDS,
+      "scale(image, algorithm, factor=2) -> Image\n\n"
+      "Scale an Image (or a buffer of RGB values) by chaining 2x passes of an algorithm. The GIL is released meanwhile." },
+    { "algorithms", moduleAlgorithms, METH_NOARGS, "algorithms() -> list\n\nNames of the algorithms accepted by scale()." },
+    { nullptr, nullptr, 0, nullptr }};
+
+PyModuleDef MODULE = {
+    PyModuleDef_HEAD_INIT, "pixel_scaling", "Images and 2x pixel-art scalers of fin-proj, with zero-copy pixel buffers.", -1,
+    MODULE_METHODS, nullptr, nullptr, nullptr, nullptr };
+
+}
+
+PyMODINIT_FUNC PyInit_pixel_scaling() {
+    if (PyType_Ready(&PyImageType) < 0) { return nullptr; }
+    PyObject* module = PyModule_Create(&MODULE);
+    if (!module) { return nullptr; }
+    if (PyModule_AddObjectRef(module, "Image", reinterpret_cast<PyObject*>(&PyImageType)) < 0) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,373 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <framework/image.h>
+
+// Persistent, content-addressed cache of scaled outputs. An entry is keyed by the content hash of the input file, the
+// algorithm, the scale factor, the output format and RESULT_CACHE_ENGINE_VERSION, and holds both the quantised RGB8 pixels
+// (in a raw layout that is used in place through a memory map) and the encoded output file, so a hit skips decoding,
+// scaling and encoding.
+// The directory is bounded in size by evicting the least recently used entries
+
+constexpr uint32_t RESULT_CACHE_ENGINE_VERSION = 1U; // Bump whenever the output of any scaler changes
+constexpr uint32_t RESULT_CACHE_FORMAT_VERSION = 1U;
+constexpr char RESULT_CACHE_EXTENSION[]         = ".pxr";
+constexpr char RESULT_CACHE_TEMPORARY_SUFFIX[]  = ".tmp";
+constexpr std::chrono::hours RESULT_CACHE_STALE_TEMPORARY { 1 }; // Age after which a temporary file was left by a run that died
+
+struct ResultKey {
+    uint64_t input_hash;
+    std::string algorithm;
+    uint32_t factor;
+    std::string format = ".png"; // Extension of the encoded output file
+};
+
+class Fnv1a {
+public:
+    void feed(const uint8_t* bytes, size_t count) {
+        for (size_t i = 0; i < count; i++) { hash = (hash ^ bytes[i]) * 0x100000001b3ULL; }
+    }
+    template<typename U>
+    void feedValue(const U& value) { feed(reinterpret_cast<const uint8_t*>(&value), sizeof(U)); }
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+};
+
+/**
+ * Hash the content of a file with 64-bit FNV-1a
+ *
+ * @param file_path Path of the file
+ *
+ * @return Hash of the bytes of the file
+*/
+inline uint64_t hashFile(const std::filesystem::path& file_path) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        std::cerr << "File " << file_path << " could not be opened for hashing!" << std::endl;
+        throw std::exception();
+    }
+    Fnv1a hash;
+    std::vector<char> buffer(1U << 16U);
+    while (file.read(buffer.data(), std::streamsize(buffer.size())) || file.gcount() > 0) {
+        hash.feed(reinterpret_cast<const uint8_t*>(buffer.data()), size_t(file.gcount()));
+    }
+    return hash.hash;
+}
+
+// Hash of the content of a file read beforehand, equal to hashFile of that file
+inline uint64_t hashBytes(const std::vector<uint8_t>& bytes) {
+    Fnv1a hash;
+    hash.feed(bytes.data(), bytes.size());
+    return hash.hash;
+}
+
+inline uint64_t resultKeyHash(const ResultKey& key) {
+    Fnv1a hash;
+    hash.feedValue(key.input_hash);
+    hash.feed(reinterpret_cast<const uint8_t*>(key.algorithm.data()), key.algorithm.size());
+    hash.feedValue(uint8_t(0U)); // Terminator, so that algorithm names cannot run into the factor
+    hash.feedValue(key.factor);
+    hash.feed(reinterpret_cast<const uint8_t*>(key.format.data()), key.format.size());
+    hash.feedValue(RESULT_CACHE_ENGINE_VERSION);
+    return hash.hash;
+}
+
+// Layout of an entry file, followed by width * height RGB8 pixels and encoded_size bytes of encoded output file
+struct ResultCacheHeader {
+    char magic[4];
+    uint32_t format_version;
+    uint64_t key;
+    uint32_t width, height;
+    uint64_t encoded_size;
+};
+
+// Read-only memory map of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& file_path) {
+#ifdef _WIN32
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file) { return; }
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes   = reinterpret_cast<const uint8_t*>(fallback.data());
+        size    = fallback.size();
+#else
+        const int descriptor = ::open(file_path.c_str(), O_RDONLY);
+        if (descriptor < 0) { return; }
+        struct stat status;
+        if (::fstat(descriptor, &status) == 0 && status.st_size > 0) {
+            void* mapping = ::mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED) {
+                bytes   = static_cast<const uint8_t*>(mapping);
+                size    = size_t(status.st_size);
+            }
+        }
+        ::close(descriptor); // The mapping keeps the file alive, even if it is evicted in the meantime
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(bytes, other.bytes);
+        std::swap(size, other.size);
+#ifdef _WIN32
+        std::swap(fallback, other.fallback);
+#endif
+        return *this;
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (bytes) { ::munmap(const_cast<uint8_t*>(bytes), size); }
+#endif
+    }
+
+    const uint8_t* bytes = nullptr;
+    size_t size = 0U;
+
+private:
+#ifdef _WIN32
+    std::vector<char> fallback;
+#endif
+};
+
+// Entry of the cache, used in place from its memory map
+class CachedResult {
+public:
+    explicit CachedResult(MappedFile&& file) : file(std::move(file)) { std::memcpy(&header, this->file.bytes, sizeof(header)); }
+
+    int width() const { return int(header.width); }
+    int height() const { return int(header.height); }
+    const uint8_t* pixels() const { return file.bytes + sizeof(ResultCacheHeader); } // RGB8, row-major
+    const uint8_t* encoded() const { return pixels() + pixelBytes(); }
+    size_t encodedSize() const { return size_t(header.encoded_size); }
+
+    /**
+     * Write the encoded output file of the entry
+     *
+     * @param file_path Path of the output file, whose parent directories are created if needed
+    */
+    void writeEncoded(const std::filesystem::path& file_path) const {
+        if (!file_path.parent_path().empty()) { std::filesystem::create_directories(file_path.parent_path()); }
+        std::ofstream output(file_path, std::ios::binary);
+        output.write(reinterpret_cast<const char*>(encoded()), std::streamsize(encodedSize()));
+        if (!output) {
+            std::cerr << "Output file " << file_path << " could not be written!" << std::endl;
+            throw std::exception();
+        }
+    }
+
+    size_t pixelBytes() const { return size_t(header.width) * size_t(header.height) * 3U; }
+
+private:
+    MappedFile file;
+    ResultCacheHeader header;
+};
+
+class ResultCache {
+public:
+    /**
+     * Open (or create) a cache directory
+     *
+     * @param directory Directory holding one file per entry
+     * @param capacity_bytes Total size of the entries beyond which the least recently used ones are evicted
+    */
+    ResultCache(std::filesystem::path directory, uint64_t capacity_bytes) : directory(std::move(directory)), capacity_bytes(capacity_bytes) {
+        std::filesystem::create_directories(this->directory);
+
+        // Recency of earlier runs is kept in the modification times, which hits refresh
+        std::vector<std::pair<std::filesystem::file_time_type, uint64_t>> by_time;
+        const auto stale_before = std::filesystem::file_time_type::clock::now() - RESULT_CACHE_STALE_TEMPORARY;
+        for (const auto& file : std::filesystem::directory_iterator(this->directory)) {
+            // Temporary files of other processes sharing the directory may still be renamed into place, so only old ones are removed
+            const std::string name = file.path().filename().string();
+            if (name.find(std::string(RESULT_CACHE_EXTENSION) + RESULT_CACHE_TEMPORARY_SUFFIX) != std::string::npos) {
+                std::error_code error; // Another run may have swept it already
+                const auto modified = file.last_write_time(error);
+                if (!error && modified < stale_before) { std::filesystem::remove(file.path(), error); }
+                continue;
+            }
+
+            // Files that are not named like an entry are not ours, and are left alone
+            if (file.path().extension() != RESULT_CACHE_EXTENSION) { continue; }
+            const std::string stem = file.path().stem().string();
+            uint64_t key = 0U;
+            const auto [end, parse_error] = std::from_chars(stem.data(), stem.data() + stem.size(), key, 16);
+            if (stem.size() != 16U || parse_error != std::errc() || end != stem.data() + stem.size()) { continue; }
+            entries[key] = { file.file_size(), 0U };
+            total_bytes += file.file_size();
+            by_time.emplace_back(file.last_write_time(), key);
+        }
+        std::sort(by_time.begin(), by_time.end());
+        for (const auto& [time, key] : by_time) { entries[key].last_use = ++clock; }
+    }
+
+    bool contains(const ResultKey& key) const {
+        std::lock_guard lock(mutex);
+        return entries.contains(resultKeyHash(key));
+    }
+
+    /**
+     * Look up an entry and mark it as most recently used
+     *
+     * @param key Key of the entry
+     *
+     * @return The entry, or nothing if it is not cached (or its file is damaged, in which case it is removed)
+    */
+    std::optional<CachedResult> find(const ResultKey& key) {
+        const uint64_t hash = resultKeyHash(key);
+        std::lock_guard lock(mutex);
+        auto entry = entries.find(hash);
+        if (entry == entries.end()) { return std::nullopt; }
+
+        MappedFile file(entryPath(hash));
+        ResultCacheHeader header {};
+        if (file.size >= sizeof(header)) { std::memcpy(&header, file.bytes, sizeof(header)); }
+        const bool valid = file.size >= sizeof(header) && std::memcmp(header.magic, "PXRC", 4) == 0 &&
+                           header.format_version == RESULT_CACHE_FORMAT_VERSION && header.key == hash &&
+                           file.size == sizeof(header) + (size_t(header.width) * size_t(header.height) * 3U) + size_t(header.encoded_size);
+        if (!valid) {
+            removeEntry(entry);
+            return std::nullopt;
+        }
+
+        entry->second.last_use = ++clock;
+        std::error_code error; // Losing the recency of an entry for later runs is harmless
+        std::filesystem::last_write_time(entryPath(hash), std::filesystem::file_time_type::clock::now(), error);
+        return CachedResult(std::move(file));
+    }
+
+    /**
+     * Store an output, evicting least recently used entries if the cache grows beyond its capacity
+     *
+     * @param key Key of the entry
+     * @param image Scaled image, which is stored after the 8-bit quantisation that Image::writeToFile applies
+     * @param encoded_path Path of the output file the image was encoded to, whose extension must match the format of the key
+    */
+    template<typename T>
+    void insert(const ResultKey& key, const Image<T>& image, const std::filesystem::path& encoded_path) {
+        std::ifstream encoded_file(encoded_path, std::ios::binary);
+        insert(key, image, std::vector<uint8_t>((std::istreambuf_iterator<char>(encoded_file)), std::istreambuf_iterator<char>()));
+    }
+
+    /**
+     * Store an output whose encoded file is still in memory (see the other overload)
+     *
+     * @param encoded Bytes of the encoded output file
+    */
+    template<typename T>
+    void insert(const ResultKey& key, const Image<T>& image, const std::vector<uint8_t>& encoded) {
+        std::vector<uint8_t> pixels(image.data.size() * 3U);
+        for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8<T>(&pixels[i * 3U], image.data[i]); }
+
+        const uint64_t hash = resultKeyHash(key);
+        ResultCacheHeader header { { 'P', 'X', 'R', 'C' }, RESULT_CACHE_FORMAT_VERSION, hash, uint32_t(image.width), uint32_t(image.height), uint64_t(encoded.size()) };
+
+        // Entries are written under a temporary name and renamed into place, so readers never see partial files
+        const std::filesystem::path path = entryPath(hash);
+        std::filesystem::path temporary = path;
+        temporary += RESULT_CACHE_TEMPORARY_SUFFIX + std::to_string(processId()) + "-" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream output(temporary, std::ios::binary);
+            output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            output.write(reinterpret_cast<const char*>(pixels.data()), std::streamsize(pixels.size()));
+            output.write(reinterpret_cast<const char*>(encoded.data()), std::streamsize(encoded.size()));
+            if (!output) {
+                std::cerr << "Cache entry " << temporary << " could not be written!" << std::endl;
+                throw std::exception();
+            }
+        }
+        std::filesystem::rename(temporary, path);
+
+        std::lock_guard lock(mutex);
+        const uint64_t size = sizeof(header) + pixels.size() + encoded.size();
+        auto existing = entries.find(hash);
+        if (existing != entries.end()) { total_bytes -= existing->second.size; }
+        entries[hash] = { size, ++clock };
+        total_bytes += size;
+        evict(hash);
+    }
+
+    uint64_t sizeBytes() const {
+        std::lock_guard lock(mutex);
+        return total_bytes;
+    }
+
+private:
+    struct Entry {
+        uint64_t size;
+        uint64_t last_use;
+    };
+
+    // Distinguishes the temporary files of runs sharing the directory, such as the server and a command line run
+    static int processId() {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return int(::getpid());
+#endif
+    }
+
+    std::filesystem::path entryPath(uint64_t hash) const {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+        return directory / (std::string(name) + RESULT_CACHE_EXTENSION);
+    }
+
+    void removeEntry(std::unordered_map<uint64_t, Entry>::iterator entry) {
+        std::error_code error; // A file that is already gone needs no removal
+        std::filesystem::remove(entryPath(entry->first), error);
+        total_bytes -= entry->second.size;
+        entries.erase(entry);
+    }
+
+    // Evict least recently used entries (other than the one just inserted) until the cache fits its capacity
+    void evict(uint64_t keep) {
+        if (total_bytes <= capacity_bytes) { return; }
+        std::vector<std::pair<uint64_t, uint64_t>> by_use;
+        for (const auto& [hash, entry] : entries) { if (hash != keep) { by_use.emplace_back(entry.last_use, hash); } }
+        std::sort(by_use.begin(), by_use.end());
+        for (const auto& [last_use, hash] : by_use) {
+            if (total_bytes <= capacity_bytes) { break; }
+            removeEntry(entries.find(hash));
+        }
+    }
+
+    std::filesystem::path directory;
+    uint64_t capacity_bytes;
+
+    mutable std::mutex mutex; // Guards everything below
+    std::unordered_map<uint64_t, Entry> entries;
+    uint64_t total_bytes = 0U;
+    uint64_t clock = 0U;
+};
+
+#endif
@@ -0,0 +1,504 @@
+#ifndef SCALE_SERVER_HPP
+#define SCALE_SERVER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "pixelscale.h"
+#include "result_cache.hpp"
+
+// Daemon mode of fin-proj (POSIX only): a long-lived process that keeps a pixelscale context (worker threads and output
+// arena), the lookup tables of the scalers and the result cache warm, and serves scale jobs over a Unix domain socket.
+//
+// Requests and responses are single lines of tab-separated fields, so that paths may contain spaces:
+//   SCALE <algorithm> <factor> <input> <output>  ->  OK <width> <height> <cached>
+//   STATS                                        ->  OK <requests> <p50> <p90> <p99> <max>  (microseconds)
+//   SHUTDOWN                                     ->  OK
+// and any failure is answered with ERROR <message>. Inputs and outputs are either file paths (encoded by extension, like
+// the outputs of fin-proj) or POSIX shared memory objects holding RGB8 pixels row by row:
+//   shm:<name>:<width>x<height>  an input object created by the client
+//   shm:<name>                   an output object that the server creates with the size of the result, and that the
+//                                client unlinks once it has read it
+// Only jobs from a file to a file go through the result cache, which is keyed by the content of the input.
+
+constexpr char DEFAULT_SERVER_SOCKET[]      = "/tmp/fin-proj.sock";
+constexpr std::string_view SHARED_MEMORY_PREFIX = "shm:";
+constexpr size_t LATENCY_WINDOW             = 1U << 16U; // Most recent requests that the percentiles are taken over
+
+inline std::vector<std::string> splitFields(std::string_view line) {
+    std::vector<std::string> fields;
+    size_t start = 0U;
+    while (true) {
+        const size_t end = line.find('\t', start);
+        fields.emplace_back(line.substr(start, end - start));
+        if (end == std::string_view::npos) { return fields; }
+        start = end + 1U;
+    }
+}
+
+inline std::string joinFields(const std::vector<std::string>& fields) {
+    std::string line;
+    for (const std::string& field : fields) { line += (line.empty() ? "" : "\t") + field; }
+    return line;
+}
+
+template<typename T>
+std::optional<T> parseNumber(std::string_view text) {
+    T value {};
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) { return std::nullopt; }
+    return value;
+}
+
+// Shared memory object named in a request, with the size of its image if it is an input
+struct SharedImageName {
+    std::string name;
+    int width = 0, height = 0;
+};
+
+/**
+ * Parse the name of a shared memory image (shm:<name> or shm:<name>:<width>x<height>)
+ *
+ * @param endpoint Input or output field of a request
+ * @param sized Whether the size is part of the name
+ *
+ * @return The object, or nothing if the field is a file path or malformed
+*/
+inline std::optional<SharedImageName> parseSharedImage(std::string_view endpoint, bool sized) {
+    if (!endpoint.starts_with(SHARED_MEMORY_PREFIX)) { return std::nullopt; }
+    endpoint.remove_prefix(SHARED_MEMORY_PREFIX.size());
+    SharedImageName image;
+    if (!sized) {
+        image.name = std::string(endpoint);
+        return image.name.empty() ? std::nullopt : std::optional(image);
+    }
+    const size_t colon = endpoint.rfind(':'), cross = endpoint.rfind('x');
+    if (colon == std::string_view::npos || cross == std::string_view::npos || cross < colon) { return std::nullopt; }
+    const std::optional<int> width = parseNumber<int>(endpoint.substr(colon + 1U, cross - colon - 1U));
+    const std::optional<int> height = parseNumber<int>(endpoint.substr(cross + 1U));
+    if (colon == 0U || !width || !height || *width <= 0 || *height <= 0) { return std::nullopt; }
+    return SharedImageName { std::string(endpoint.substr(0U, colon)), *width, *height };
+}
+
+// POSIX shared memory object mapped into this process; invalid (without bytes) if it could not be opened or created
+class SharedBuffer {
+public:
+    SharedBuffer() = default;
+
+    /**
+     * Map a shared memory object
+     *
+     * @param name Name of the object (starting with a slash)
+     * @param size Bytes to map; a created object is resized to it, an opened one must be at least that large
+     * @param create Create the object, failing if it already exists, instead of opening an existing one
+    */
+    SharedBuffer(const std::string& name, size_t size, bool create) : name(name), size(size) {
+        const int descriptor = shm_open(name.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, S_IRUSR | S_IWUSR);
+        if (descriptor < 0) { return; }
+        struct stat status {};
+        const bool sized = create ? ftruncate(descriptor, off_t(size)) == 0 : (fstat(descriptor, &status) == 0 && size_t(status.st_size) >= size);
+        void* mapping = sized && size > 0U ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+        close(descriptor);
+        if (mapping != MAP_FAILED) { bytes = static_cast<uint8_t*>(mapping); }
+        else if (create) { shm_unlink(name.c_str()); }
+    }
+
+    SharedBuffer(const SharedBuffer&) = delete;
+    SharedBuffer& operator=(const SharedBuffer&) = delete;
+    SharedBuffer(SharedBuffer&& other) noexcept { *this = std::move(other); }
+    SharedBuffer& operator=(SharedBuffer&& other) noexcept {
+        std::swap(name, other.name);
+        std::swap(bytes, other.bytes);
+        std::swap(size, other.size);
+        return *this;
+    }
+
+    ~SharedBuffer() {
+        if (bytes) { munmap(bytes, size); }
+    }
+
+    bool valid() const { return bytes != nullptr; }
+
+    // Remove the name of the object; the mapping stays valid until the buffer is destroyed
+    void unlink() const { shm_unlink(name.c_str()); }
+
+    std::string name;
+    uint8_t* bytes = nullptr;
+    size_t size = 0U;
+};
+
+// Connected stream socket exchanging newline-terminated lines
+class LineSocket {
+public:
+    explicit LineSocket(int descriptor) : descriptor(descriptor) {}
+
+    /**
+     * Read the next line (without its newline)
+     *
+     * @return False once the peer closed the connection or the socket failed
+    */
+    bool readLine(std::string& line) {
+        while (true) {
+            const size_t newline = pending.find('\n');
+            if (newline != std::string::npos) {
+                line = pending.substr(0U, newline);
+                pending.erase(0U, newline + 1U);
+                return true;
+            }
+            char chunk[4096];
+            const ssize_t received = recv(descriptor, chunk, sizeof(chunk), 0);
+            if (received < 0 && errno == EINTR) { continue; }
+            if (received <= 0) { return false; }
+            pending.append(chunk, size_t(received));
+        }
+    }
+
+    bool writeLine(const std::string& line) {
+        const std::string message = line + "\n";
+        for (size_t sent = 0U; sent < message.size();) {
+            const ssize_t written = send(descriptor, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) { continue; }
+            if (written <= 0) { return false; }
+            sent += size_t(written);
+        }
+        return true;
+    }
+
+private:
+    int descriptor;
+    std::string pending; // Received bytes after the last complete line
+};
+
+inline sockaddr_un socketAddress(const std::filesystem::path& socket_path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    const std::string path = socket_path.string();
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path " << socket_path << " is too long!" << std::endl;
+        throw std::exception();
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1U);
+    return address;
+}
+
+struct LatencySummary {
+    size_t requests = 0U; // Served since the start, of which the last LATENCY_WINDOW make up the percentiles
+    double p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+/**
+ * Summarise latencies by nearest-rank percentiles
+ *
+ * @param latencies Latencies of the requests, in any order
+ * @param requests Number of requests to report, which may exceed the latencies that were kept
+*/
+inline LatencySummary summariseLatencies(std::vector<double> latencies, size_t requests) {
+    LatencySummary summary;
+    summary.requests = requests;
+    if (latencies.empty()) { return summary; }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double fraction) {
+        const size_t rank = size_t(std::ceil(fraction * double(latencies.size())));
+        return latencies[std::clamp<size_t>(rank, 1U, latencies.size()) - 1U];
+    };
+    summary.p50 = percentile(0.5);
+    summary.p90 = percentile(0.9);
+    summary.p99 = percentile(0.99);
+    summary.max = latencies.back();
+    return summary;
+}
+
+// Latencies of the most recent requests, kept in a ring of LATENCY_WINDOW entries
+class LatencyRecorder {
+public:
+    void record(double microseconds) {
+        std::lock_guard lock(mutex);
+        if (latencies.size() < LATENCY_WINDOW) { latencies.push_back(microseconds); }
+        else { latencies[requests % LATENCY_WINDOW] = microseconds; }
+        requests++;
+    }
+
+    LatencySummary summary() const {
+        std::lock_guard lock(mutex);
+        return summariseLatencies(latencies, requests);
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<double> latencies;
+    size_t requests = 0U;
+};
+
+class ScaleServer {
+public:
+    /**
+     * Bind the socket of a server, replacing a stale socket file left by an earlier server
+     *
+     * @param socket_path Path of the Unix domain socket
+     * @param thread_count Threads of the pixelscale context (0 for one per hardware thread)
+     * @param cache Result cache serving and storing jobs from a file to a file, or nullptr
+    */
+    ScaleServer(std::filesystem::path socket_path, uint32_t thread_count, ResultCache* cache)
+        : socket_path(std::move(socket_path)), cache(cache), context(pixelscaleCreateContext(thread_count)) {
+        const sockaddr_un address = socketAddress(this->socket_path);
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        std::error_code error; // A missing socket file needs no removal
+        std::filesystem::remove(this->socket_path, error);
+        if (!context || listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listener, SOMAXCONN) != 0) {
+            std::cerr << "Server socket " << this->socket_path << " could not be opened: " << std::strerror(errno) << std::endl;
+            if (listener >= 0) { close(listener); }
+            pixelscaleDestroyContext(context);
+            throw std::exception();
+        }
+    }
+
+    ScaleServer(const ScaleServer&) = delete;
+    ScaleServer& operator=(const ScaleServer&) = delete;
+
+    ~ScaleServer() {
+        stop();
+        reapConnections(true);
+        close(listener);
+        std::error_code error;
+        std::filesystem::remove(socket_path, error);
+        pixelscaleDestroyContext(context);
+    }
+
+    // Accept and serve connections (each on its own thread) until stop is called or a client sends SHUTDOWN
+    void serve() {
+        while (true) {
+            const int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection < 0 && errno == EINTR && !stopping) { continue; }
+            if (connection < 0 || stopping) {
+                if (connection >= 0) { close(connection); }
+                break;
+            }
+            reapConnections(false);
+            std::lock_guard lock(connections_mutex);
+            connections.emplace(connection, std::thread([this, connection] { serveConnection(connection); }));
+        }
+        reapConnections(true);
+    }
+
+    // Stop accepting and end every connection after its current request; safe to call from any thread
+    void stop() {
+        stopping = true;
+        shutdown(listener, SHUT_RDWR);
+        std::lock_guard lock(connections_mutex);
+        for (const auto& [connection, thread] : connections) { shutdown(connection, SHUT_RD); } // Responses can still be sent
+    }
+
+    LatencySummary latencies() const { return latency_recorder.summary(); }
+
+    /**
+     * Answer one request line
+     *
+     * @param line Request without its newline
+     *
+     * @return The response line
+    */
+    std::string handleRequest(const std::string& line) {
+        const std::vector<std::string> fields = splitFields(line);
+        try {
+            if (fields[0] == "SCALE") { return handleScale(fields); }
+            if (fields[0] == "STATS" && fields.size() == 1U) {
+                const LatencySummary summary = latencies();
+                return joinFields({ "OK", std::to_string(summary.requests), std::to_string(int64_t(summary.p50)), std::to_string(int64_t(summary.p90)),
+                                    std::to_string(int64_t(summary.p99)), std::to_string(int64_t(summary.max)) });
+            }
+            if (fields[0] == "SHUTDOWN" && fields.size() == 1U) {
+                stop();
+                return "OK";
+            }
+            return "ERROR\tUnknown request " + fields[0];
+        } catch (const std::exception&) {
+            return "ERROR\tRequest failed (see the server log)"; // The framework reports the cause on stderr
+        }
+    }
+
+private:
+    std::string handleScale(const std::vector<std::string>& fields) {
+        if (fields.size() != 5U) { return "ERROR\tSCALE expects an algorithm, a factor, an input and an output"; }
+        const std::string& algorithm = fields[1];
+        const std::optional<uint32_t> factor = parseNumber<uint32_t>(fields[2]);
+        if (!factor) { return "ERROR\tInvalid factor " + fields[2]; }
+        const std::string& input = fields[3];
+        const std::string& output = fields[4];
+        const std::optional<SharedImageName> shared_input = parseSharedImage(input, true);
+        const std::optional<SharedImageName> shared_output = parseSharedImage(output, false);
+        if (input.starts_with(SHARED_MEMORY_PREFIX) && !shared_input) { return "ERROR\tInvalid shared memory input " + input; }
+        if (output.starts_with(SHARED_MEMORY_PREFIX) && !shared_output) { return "ERROR\tInvalid shared memory output " + output; }
+
+        std::optional<ResultKey> key;
+        if (cache && !shared_input && !shared_output) {
+            if (!std::filesystem::is_regular_file(input)) { return "ERROR\tInput " + input + " does not exist"; }
+            key = ResultKey { hashFile(input), algorithm, *factor, std::filesystem::path(output).extension().string() };
+            if (std::optional<CachedResult> result = cache->find(*key)) {
+                result->writeEncoded(output);
+                return joinFields({ "OK", std::to_string(result->width()), std::to_string(result->height()), "1" });
+            }
+        }
+
+        PixelScaleImage source {};
+        SharedBuffer shared_source;
+        std::vector<uint8_t> decoded;
+        if (shared_input) {
+            shared_source = SharedBuffer(shared_input->name, size_t(shared_input->width) * size_t(shared_input->height) * 3U, false);
+            if (!shared_source.valid()) { return "ERROR\tShared memory input " + shared_input->name + " could not be mapped"; }
+            source = { shared_input->width, shared_input->height, shared_source.bytes };
+        } else {
+            if (!std::filesystem::is_regular_file(input)) { return "ERROR\tInput " + input + " does not exist"; }
+            const Image<glm::uvec3> image(input);
+            decoded.resize(image.data.size() * 3U);
+            for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8(&decoded[i * 3U], image.data[i]); }
+            source = { image.width, image.height, decoded.data() };
+        }
+
+        PixelScaleImage scaled {};
+        {
+            // The context serialises batches anyway; holding the lock until the error is read keeps it from another job
+            std::lock_guard lock(scale_mutex);
+            if (pixelscaleScale(context, &source, 1U, algorithm.c_str(), *factor, &scaled) != PIXELSCALE_OK) {
+                return std::string("ERROR\t") + pixelscaleLastError(context);
+            }
+        }
+        const std::string response = joinFields({ "OK", std::to_string(scaled.width), std::to_string(scaled.height), "0" });
+        const size_t scaled_bytes = size_t(scaled.width) * size_t(scaled.height) * 3U;
+
+        if (shared_output) {
+            const SharedBuffer destination(shared_output->name, scaled_bytes, true);
+            if (destination.valid()) { std::memcpy(destination.bytes, scaled.rgb, scaled_bytes); }
+            pixelscaleReleaseImage(context, &scaled);
+            return destination.valid() ? response : "ERROR\tShared memory output " + shared_output->name + " could not be created";
+        }
+        Image<glm::uvec3> result(scaled.width, scaled.height);
+        for (size_t i = 0; i < result.data.size(); i++) { result.data[i] = stbToType<glm::uvec3>(scaled.rgb + (i * 3U)); }
+        pixelscaleReleaseImage(context, &scaled);
+        result.writeToFile(output);
+        if (key) { cache->insert(*key, result, output); }
+        return response;
+    }
+
+    void serveConnection(int connection) {
+        LineSocket lines(connection);
+        std::string line;
+        while (lines.readLine(line)) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::string response = handleRequest(line);
+            if (line.starts_with("SCALE")) {
+                latency_recorder.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+            if (!lines.writeLine(response)) { break; }
+        }
+        std::lock_guard lock(connections_mutex);
+        finished_connections.push_back(connection);
+    }
+
+    // Join the threads of connections that were served to the end (or of all connections) and close their sockets
+    void reapConnections(bool all) {
+        std::vector<int> reaped;
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard lock(connections_mutex);
+            reaped.swap(finished_connections);
+            if (all) {
+                reaped.clear();
+                for (const auto& [connection, thread] : connections) {
+                    shutdown(connection, SHUT_RD);
+                    reaped.push_back(connection);
+                }
+            }
+            for (int connection : reaped) {
+                auto entry = connections.find(connection);
+                threads.push_back(std::move(entry->second));
+                connections.erase(entry);
+            }
+        }
+        // Sockets stay open until their threads are joined, so that accept cannot reuse a descriptor still in the map
+        for (std::thread& thread : threads) { thread.join(); }
+        for (int connection : reaped) { close(connection); }
+    }
+
+    std::filesystem::path socket_path;
+    ResultCache* cache;
+    PixelScaleContext* context;
+    int listener = -1;
+    std::atomic<bool> stopping = false;
+    std::mutex scale_mutex;
+    LatencyRecorder latency_recorder;
+
+    std::mutex connections_mutex; // Guards everything below
+    std::unordered_map<int, std::thread> connections; // Serving thread of every open socket
+    std::vector<int> finished_connections; // Whose threads are done and can be joined
+};
+
+// Client side of the protocol, holding one connection to a server
+class ScaleClient {
+public:
+    explicit ScaleClient(const std::filesystem::path& socket_path) : descriptor(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)), lines(descriptor) {
+        const sockaddr_un address = socketAddress(socket_path);
+        if (descriptor < 0 || connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "Could not connect to the server at " << socket_path << ": " << std::strerror(errno) << std::endl;
+            if (descriptor >= 0) { close(descriptor); }
+            throw std::exception();
+        }
+    }
+
+    ScaleClient(const ScaleClient&) = delete;
+    ScaleClient& operator=(const ScaleClient&) = delete;
+
+    ~ScaleClient() { close(descriptor); }
+
+    /**
+     * Send a request and wait for its response
+     *
+     * @param fields Fields of the request
+     *
+     * @return Fields of the response, starting with OK or ERROR
+    */
+    std::vector<std::string> request(const std::vector<std::string>& fields) {
+        std::string response;
+        if (!lines.writeLine(joinFields(fields)) || !lines.readLine(response)) {
+            std::cerr << "The server closed the connection" << std::endl;
+            throw std::exception();
+        }
+        return splitFields(response);
+    }
+
+private:
+    int descriptor;
+    LineSocket lines;
+};
+
+#endif
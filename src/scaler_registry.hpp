@@ -0,0 +1,79 @@
+#ifndef SCALER_REGISTRY_HPP
+#define SCALER_REGISTRY_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "2xsai.hpp"
+#include "eagle.hpp"
+#include "epx.hpp"
+#include "hq2x.hpp"
+#include "nedi.hpp"
+#include "streaming.hpp"
+#include "xbr.hpp"
+
+// Every 2x scaler by name, for the interfaces that pick the algorithm at run time (the Python module and the
+// pixelscale library). All of them scale 8-bit pixels; float scalers convert once before the first pass and quantise
+// after the last one, like Image<glm::vec3>::writeToFile does for the outputs of fin-proj
+
+using ScaleChainFunction = Image<glm::uvec3> (*)(const Image<glm::uvec3>&, uint32_t);
+
+template<ScaleFunction<glm::uvec3> Scale>
+Image<glm::uvec3> scaleChainRgb(const Image<glm::uvec3>& src, uint32_t passes) {
+    if (passes == 0U) { return src; }
+    Image<glm::uvec3> result = Scale(src);
+    for (uint32_t pass = 1U; pass < passes; pass++) { result = Scale(result); }
+    return result;
+}
+
+template<ScaleFunction<glm::vec3> Scale>
+Image<glm::uvec3> scaleChainFloat(const Image<glm::uvec3>& src, uint32_t passes) {
+    Image<glm::vec3> scaled(src.width, src.height);
+    for (size_t i = 0; i < src.data.size(); i++) { scaled.data[i] = glm::vec3(src.data[i]) / 255.0f; }
+    for (uint32_t pass = 0U; pass < passes; pass++) { scaled = Scale(scaled); }
+
+    Image<glm::uvec3> result(scaled.width, scaled.height);
+    for (size_t i = 0; i < scaled.data.size(); i++) {
+        stbi_uc rgb[3];
+        typeToRgbUint8(rgb, scaled.data[i]);
+        result.data[i] = glm::uvec3(rgb[0], rgb[1], rgb[2]);
+    }
+    return result;
+}
+
+struct RegisteredScaler {
+    std::string_view algorithm; // Name of the algorithm, as used in the output file names of fin-proj
+    ScaleChainFunction scale_chain;
+    int halo; // Source rows/columns read around each pixel by a pass
+};
+
+constexpr std::array<RegisteredScaler, 7> REGISTERED_SCALERS = {{
+    { "epx",        scaleChainRgb<scaleEpx<glm::uvec3>>,       EPX_HALO },
+    { "adv_mame",   scaleChainRgb<scaleAdvMame<glm::uvec3>>,   EPX_HALO },
+    { "eagle",      scaleChainRgb<scaleEagle<glm::uvec3>>,     EAGLE_HALO },
+    { "2xSaI",      scaleChainRgb<scale2xSaI<glm::uvec3>>,     SAI_HALO },
+    { "hq2x",       scaleChainRgb<scaleHq2x<glm::uvec3>>,      HQ2X_HALO },
+    { "xbr",        scaleChainRgb<scaleXbr<glm::uvec3>>,       XBR_HALO },
+    { "nedi",       scaleChainFloat<scaleNedi<glm::vec3>>,     NEDI_HALO }}};
+
+// Scaler registered under a name, or nullptr
+inline const RegisteredScaler* findScaler(std::string_view algorithm) {
+    const auto scaler = std::find_if(REGISTERED_SCALERS.begin(), REGISTERED_SCALERS.end(), [&](const RegisteredScaler& s) { return s.algorithm == algorithm; });
+    return scaler == REGISTERED_SCALERS.end() ? nullptr : &*scaler;
+}
+
+// Number of 2x passes making up a factor, or 0 if the factor is not a power of two >= 2
+inline uint32_t passesOfFactor(uint32_t factor) {
+    return (factor >= 2U && (factor & (factor - 1U)) == 0U) ? uint32_t(std::countr_zero(factor)) : 0U;
+}
+
+#endif
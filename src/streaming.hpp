@@ -0,0 +1,153 @@
+#ifndef STREAMING_HPP
+#define STREAMING_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <framework/image.h>
+
+#include "png_stream_writer.hpp"
+
+// Row-band streaming of (chained) 2x scalers. Every stage pulls the source rows of one band plus the halo its kernel
+// reads from the stage before it, runs the unmodified scaler on that band and hands the finished rows downstream, so
+// peak memory is proportional to width * band height instead of the output size
+
+constexpr int DEFAULT_BAND_HEIGHT = 32; // Source rows scaled per band
+
+template<typename T>
+using ScaleFunction = Image<T> (*)(const Image<T>&);
+
+// Pull-based source of rows, which are produced exactly once and from top to bottom
+template<typename T>
+class RowStream {
+public:
+    virtual ~RowStream() = default;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+
+    /**
+     * Produce the next row of the stream
+     *
+     * @param row Destination for width() pixels
+    */
+    virtual void readRow(T* row) = 0;
+};
+
+template<typename T>
+class ImageRowStream : public RowStream<T> {
+public:
+    explicit ImageRowStream(const Image<T>& image) : image(image) {}
+
+    int width() const override { return image.width; }
+    int height() const override { return image.height; }
+    void readRow(T* row) override {
+        std::copy_n(&image.data[image.getImageOffset(0, next_row++)], image.width, row);
+    }
+
+private:
+    const Image<T>& image;
+    int next_row = 0;
+};
+
+template<typename T>
+class ScaledRowStream : public RowStream<T> {
+public:
+    /**
+     * Stream the 2x scaled rows of an upstream stream
+     *
+     * @param upstream Stream of source rows
+     * @param scale 2x scaler, which must only read source pixels within halo of the pixel being scaled
+     * @param halo Number of source rows read above and below each pixel by the scaler
+     * @param band_height Number of source rows scaled at once
+     * @param tap Optional callback receiving every produced row, e.g. to write intermediate factors of a chain
+    */
+    ScaledRowStream(RowStream<T>& upstream, ScaleFunction<T> scale, int halo, int band_height = DEFAULT_BAND_HEIGHT,
+                    std::function<void(const T*)> tap = {})
+        : upstream(upstream), scale(scale), halo(halo), band_height(band_height), tap(std::move(tap)) {}
+
+    int width() const override { return upstream.width() * 2; }
+    int height() const override { return upstream.height() * 2; }
+
+    void readRow(T* row) override {
+        if (next_row >= band_first_row + (band_rows * 2)) { scaleNextBand(); }
+        const T* band_row = &band.data[band.getImageOffset(0, next_row - band_first_row + band_output_offset)];
+        std::copy_n(band_row, width(), row);
+        if (tap) { tap(row); }
+        next_row++;
+    }
+
+private:
+    void scaleNextBand() {
+        const int source_begin  = next_row / 2;
+        const int source_end    = std::min(upstream.height(), source_begin + band_height);
+        const int window_begin  = std::max(0, source_begin - halo);
+        const int window_end    = std::min(upstream.height(), source_end + halo);
+
+        // Slide the window of source rows: drop rows above the halo and pull the rows below the band
+        while (!window.empty() && window_first_row < window_begin) {
+            window.pop_front();
+            window_first_row++;
+        }
+        while (window_first_row + int(window.size()) < window_end) {
+            window.emplace_back(size_t(upstream.width()));
+            upstream.readRow(window.back().data());
+        }
+
+        Image<T> source(upstream.width(), window_end - window_begin);
+        for (int y = 0; y < source.height; y++) {
+            std::copy(window[size_t(y)].begin(), window[size_t(y)].end(), &source.data[source.getImageOffset(0, y)]);
+        }
+        band                = scale(source);
+        band_first_row      = source_begin * 2;
+        band_rows           = source_end - source_begin;
+        band_output_offset  = (source_begin - window_begin) * 2;
+    }
+
+    RowStream<T>& upstream;
+    ScaleFunction<T> scale;
+    int halo, band_height;
+    std::function<void(const T*)> tap;
+
+    std::deque<std::vector<T>> window;  // Source rows [window_first_row, window_first_row + window.size())
+    int window_first_row = 0;
+    Image<T> band;                      // Scaled window, of which only the rows of the band itself are emitted
+    int band_first_row = 0, band_rows = 0, band_output_offset = 0;
+    int next_row = 0;
+};
+
+/**
+ * Stream a chain of 2x passes to PNG files, writing the output of every pass (i.e. 2x, 4x, ...) as it is produced
+ *
+ * @param src Source image
+ * @param scale 2x scaler
+ * @param halo Number of source rows read above and below each pixel by the scaler
+ * @param output_paths Output file of every pass, whose count determines the length of the chain
+ * @param band_height Number of source rows scaled at once by every pass
+*/
+template<typename T>
+void streamScaleToPng(const Image<T>& src, ScaleFunction<T> scale, int halo, const std::vector<std::filesystem::path>& output_paths,
+                      int band_height = DEFAULT_BAND_HEIGHT) {
+    ImageRowStream<T> source(src);
+    std::vector<std::unique_ptr<PngStreamWriter>> writers;
+    std::vector<std::unique_ptr<ScaledRowStream<T>>> stages;
+    RowStream<T>* upstream = &source;
+    for (const std::filesystem::path& output_path : output_paths) {
+        writers.push_back(std::make_unique<PngStreamWriter>(output_path, upstream->width() * 2, upstream->height() * 2));
+        PngStreamWriter* writer = writers.back().get();
+        stages.push_back(std::make_unique<ScaledRowStream<T>>(*upstream, scale, halo, band_height,
+                                                              [writer](const T* row) { writer->writeRow(row); }));
+        upstream = stages.back().get();
+    }
+
+    // Pulling every row of the last pass drives all earlier passes (and their writers) band by band
+    std::vector<T> row(size_t(upstream->width()));
+    for (int y = 0; y < upstream->height(); y++) { upstream->readRow(row.data()); }
+    for (auto& writer : writers) { writer->finish(); }
+}
+
+#endif
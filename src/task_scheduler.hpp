@@ -0,0 +1,269 @@
+#ifndef TASK_SCHEDULER_HPP
+#define TASK_SCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Work-stealing pool for a graph of tasks whose costs differ by orders of magnitude. Every worker owns a queue of
+// ready tasks ordered by priority, where the priority of a task is its own estimated cost plus the most expensive chain
+// of tasks that depends on it. Workers always run their highest priority task and, once their own queue is empty, steal
+// the highest priority task of another worker. Tasks that become ready are queued on the worker that released them, as
+// that worker just produced their input.
+//
+// Tasks can be grouped into jobs that hold a predicted amount of memory from the start of their first task until their
+// last task finishes. A job is only admitted while the memory of all admitted jobs stays within the budget (or when no
+// other job is admitted, so that jobs larger than the budget still run); tasks of jobs that do not fit wait until an
+// admitted job finishes
+
+using TaskId = size_t;
+using JobId = size_t;
+
+constexpr JobId NO_JOB = std::numeric_limits<JobId>::max();
+constexpr uint64_t UNLIMITED_MEMORY = std::numeric_limits<uint64_t>::max();
+
+// Memory reserved by admitted jobs over a run
+struct MemoryStats {
+    uint64_t peak_bytes     = 0U;
+    double average_bytes    = 0.0; // Averaged over the wall-clock time of the run
+};
+
+class TaskScheduler {
+public:
+    /**
+     * @param worker_count Number of threads running tasks, including the thread calling run()
+     * @param memory_budget Bytes the admitted jobs may hold at once
+    */
+    explicit TaskScheduler(unsigned worker_count, uint64_t memory_budget = UNLIMITED_MEMORY)
+        : worker_queues(std::max(worker_count, 1U)), memory_budget(memory_budget) {}
+
+    /**
+     * Add a job, to which tasks are added by passing it to addTask
+     *
+     * @param peak_bytes Predicted peak memory of the job
+     *
+     * @return Identifier of the job
+    */
+    JobId addJob(uint64_t peak_bytes) {
+        jobs.push_back({ peak_bytes, 0U, false });
+        return jobs.size() - 1U;
+    }
+
+    /**
+     * Add a task to the graph. Dependencies must have been added before the task itself
+     *
+     * @param work Function run by the task
+     * @param cost Estimated cost of the task, in arbitrary units shared by all tasks
+     * @param dependencies Tasks which must finish before this task is started
+     * @param job Job whose memory the task uses, if any
+     *
+     * @return Identifier of the task, to be used as a dependency of later tasks
+    */
+    TaskId addTask(std::function<void()> work, double cost, const std::vector<TaskId>& dependencies = {}, JobId job = NO_JOB) {
+        const TaskId id = tasks.size();
+        Task& task          = tasks.emplace_back();
+        task.work           = std::move(work);
+        task.cost           = cost;
+        task.dependencies   = dependencies.size();
+        task.job            = job;
+        if (job != NO_JOB) { jobs[job].remaining_tasks++; }
+        for (TaskId dependency : dependencies) { tasks[dependency].dependents.push_back(id); }
+        return id;
+    }
+
+    /**
+     * Run every task and return once all have finished. If a task throws, no further tasks are started and the first
+     * exception is rethrown
+    */
+    void run() {
+        // Tasks only depend on tasks added before them, so a reverse sweep sees all dependents of a task first
+        for (TaskId id = tasks.size(); id-- > 0;) {
+            Task& task = tasks[id];
+            task.priority = task.cost;
+            for (TaskId dependent : task.dependents) { task.priority = std::max(task.priority, task.cost + tasks[dependent].priority); }
+            task.pending.store(task.dependencies, std::memory_order_relaxed);
+        }
+
+        std::vector<TaskId> roots;
+        for (TaskId id = 0; id < tasks.size(); id++) { if (tasks[id].dependencies == 0U) { roots.push_back(id); } }
+        std::sort(roots.begin(), roots.end(), [this](TaskId a, TaskId b) { return tasks[a].priority > tasks[b].priority; });
+        for (size_t i = 0; i < roots.size(); i++) { push(i % worker_queues.size(), roots[i]); }
+        remaining.store(tasks.size());
+        run_start = last_memory_change = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (size_t worker = 1; worker < worker_queues.size(); worker++) { threads.emplace_back([this, worker] { workerLoop(worker); }); }
+        workerLoop(0);
+        for (std::thread& thread : threads) { thread.join(); }
+
+        const auto run_end = std::chrono::steady_clock::now();
+        accountMemory(run_end);
+        const double run_seconds = std::chrono::duration<double>(run_end - run_start).count();
+        memory_stats.average_bytes = run_seconds > 0.0 ? reserved_byte_seconds / run_seconds : double(memory_stats.peak_bytes);
+        if (failure) { std::rethrow_exception(failure); }
+    }
+
+    MemoryStats memoryStats() const { return memory_stats; }
+
+private:
+    struct Task {
+        std::function<void()> work;
+        double cost = 0.0, priority = 0.0;
+        size_t dependencies = 0U;
+        std::vector<TaskId> dependents;
+        std::atomic<size_t> pending { 0U };
+        JobId job = NO_JOB;
+    };
+
+    struct Job {
+        uint64_t peak_bytes;
+        size_t remaining_tasks;
+        bool admitted;
+    };
+
+    // Binary max-heap of ready tasks by priority
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::vector<TaskId> heap;
+    };
+
+    bool higherPriority(TaskId a, TaskId b) const { return tasks[a].priority < tasks[b].priority; }
+
+    void push(size_t worker, TaskId id) {
+        WorkerQueue& queue = worker_queues[worker];
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.heap.push_back(id);
+            std::push_heap(queue.heap.begin(), queue.heap.end(), [this](TaskId a, TaskId b) { return higherPriority(a, b); });
+        }
+        {
+            std::lock_guard lock(idle_mutex);
+            ready++;
+        }
+        idle.notify_one();
+    }
+
+    bool pop(size_t worker, TaskId& id) {
+        WorkerQueue& queue = worker_queues[worker];
+        std::lock_guard lock(queue.mutex);
+        if (queue.heap.empty()) { return false; }
+        std::pop_heap(queue.heap.begin(), queue.heap.end(), [this](TaskId a, TaskId b) { return higherPriority(a, b); });
+        id = queue.heap.back();
+        queue.heap.pop_back();
+        return true;
+    }
+
+    // Own queue first, then steal from the other workers in round-robin order. Tasks of jobs that cannot be admitted
+    // are set aside until memory is released
+    bool acquire(size_t worker, TaskId& id) {
+        for (size_t offset = 0; offset < worker_queues.size(); offset++) {
+            while (pop((worker + offset) % worker_queues.size(), id)) {
+                std::lock_guard lock(idle_mutex);
+                ready--;
+                if (admit(tasks[id].job)) { return true; }
+                waiting_for_memory.push_back(id);
+            }
+        }
+        return false;
+    }
+
+    // Must be called with idle_mutex held
+    bool admit(JobId job_id) {
+        if (job_id == NO_JOB || jobs[job_id].admitted) { return true; }
+        Job& job = jobs[job_id];
+        if (admitted_jobs > 0U && (job.peak_bytes > memory_budget || reserved_bytes > memory_budget - job.peak_bytes)) { return false; }
+        accountMemory(std::chrono::steady_clock::now());
+        job.admitted    = true;
+        reserved_bytes  += job.peak_bytes;
+        admitted_jobs++;
+        memory_stats.peak_bytes = std::max(memory_stats.peak_bytes, reserved_bytes);
+        return true;
+    }
+
+    // Release the memory of a job once its last task finished, returning the tasks that waited for memory
+    std::vector<TaskId> finishJobTask(JobId job_id) {
+        if (job_id == NO_JOB) { return {}; }
+        std::lock_guard lock(idle_mutex);
+        Job& job = jobs[job_id];
+        if (--job.remaining_tasks > 0U) { return {}; }
+        accountMemory(std::chrono::steady_clock::now());
+        reserved_bytes -= job.peak_bytes;
+        admitted_jobs--;
+        return std::exchange(waiting_for_memory, {});
+    }
+
+    // Must be called with idle_mutex held (or after all workers finished)
+    void accountMemory(std::chrono::steady_clock::time_point now) {
+        reserved_byte_seconds += double(reserved_bytes) * std::chrono::duration<double>(now - last_memory_change).count();
+        last_memory_change = now;
+    }
+
+    void workerLoop(size_t worker) {
+        while (true) {
+            // Once a task threw, workers stop at their next task instead of running the rest of the graph
+            if (aborted) { return; }
+            TaskId id;
+            if (!acquire(worker, id)) {
+                std::unique_lock lock(idle_mutex);
+                idle.wait(lock, [this] { return ready > 0U || remaining.load() == 0U || aborted; });
+                if (remaining.load() == 0U || aborted) { return; }
+                continue;
+            }
+
+            if (aborted) { return; }
+
+            Task& task = tasks[id];
+            try {
+                task.work();
+            } catch (...) {
+                std::lock_guard lock(idle_mutex);
+                if (!failure) { failure = std::current_exception(); }
+                aborted = true;
+                idle.notify_all();
+                return;
+            }
+            task.work = nullptr; // Release whatever the task captured as soon as it is done
+
+            for (TaskId dependent : task.dependents) {
+                if (tasks[dependent].pending.fetch_sub(1U) == 1U) { push(worker, dependent); }
+            }
+            for (TaskId waiting : finishJobTask(task.job)) { push(worker, waiting); }
+            if (remaining.fetch_sub(1U) == 1U) {
+                std::lock_guard lock(idle_mutex);
+                idle.notify_all();
+            }
+        }
+    }
+
+    std::deque<Task> tasks; // Deque so that tasks (and their atomics) never move once added
+    std::deque<WorkerQueue> worker_queues;
+    std::atomic<size_t> remaining { 0U };
+    uint64_t memory_budget;
+    std::atomic<bool> aborted = false; // Only set with idle_mutex held, so that idle workers see it
+
+    std::mutex idle_mutex; // Guards everything below
+    std::condition_variable idle;
+    size_t ready = 0U;
+    std::exception_ptr failure;
+
+    std::vector<Job> jobs;
+    std::vector<TaskId> waiting_for_memory;
+    size_t admitted_jobs = 0U;
+    uint64_t reserved_bytes = 0U;
+    double reserved_byte_seconds = 0.0;
+    std::chrono::steady_clock::time_point run_start, last_memory_change;
+    MemoryStats memory_stats;
+};
+
+#endif
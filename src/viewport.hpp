@@ -0,0 +1,201 @@
+#ifndef VIEWPORT_HPP
+#define VIEWPORT_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "fused_chain.hpp"
+#include "streaming.hpp"
+
+// On-demand rendering of rectangles of a chain of 2x passes (e.g. the visible window of a 16x zoom). Every rectangle
+// is produced from the smallest region of the previous factor it depends on, like the tiles of a fused chain, and the
+// results are cached as tiles of a fixed grid per factor. Panning only computes the tiles that become visible, and
+// zooming in starts from the cached tiles of the largest smaller factor that cover the region it needs
+
+constexpr int DEFAULT_VIEWPORT_TILE_SIZE        = 64;           // Side of the cached tiles, in output pixels
+constexpr uint64_t DEFAULT_VIEWPORT_CACHE_BYTES = 256ULL << 20U;
+constexpr uint32_t MAX_VIEWPORT_PASSES          = 8U;            // Up to 256x
+
+struct ViewportStats {
+    size_t tile_hits = 0U;          // Tiles of a viewport that were cached
+    size_t tiles_computed = 0U;
+    uint64_t computed_pixels = 0U;  // Output pixels of the computed tiles
+};
+
+template<typename T>
+class ViewportRenderer {
+public:
+    /**
+     * Prepare viewports of an image at any power-of-two factor
+     *
+     * @param src Source image
+     * @param scale 2x scaler, which must only read source pixels within halo of the pixel being scaled
+     * @param halo Number of source rows/columns read around each pixel by the scaler
+     * @param tile_size Side of the cached tiles, in output pixels
+     * @param capacity_bytes Size of the cached tiles beyond which the least recently used ones are evicted (tiles of the
+     *                       last viewport are always kept)
+    */
+    ViewportRenderer(Image<T> src, ScaleFunction<T> scale, int halo, int tile_size = DEFAULT_VIEWPORT_TILE_SIZE,
+                     uint64_t capacity_bytes = DEFAULT_VIEWPORT_CACHE_BYTES)
+        : src(std::move(src)), scale(scale), halo(halo), tile_size(std::max(tile_size, 1)), capacity_bytes(capacity_bytes) {}
+
+    glm::ivec2 outputSize(uint32_t passes) const { return glm::ivec2(src.width, src.height) << int(passes); }
+
+    /**
+     * Render a rectangle of the image scaled by a factor, with exactly the pixels of the full chain of 2x passes
+     *
+     * @param factor Power of two (1 for the source itself)
+     * @param viewport Rectangle of output pixels, which is clipped to the output
+     *
+     * @return Pixels of the clipped rectangle
+    */
+    Image<T> render(uint32_t factor, const PixelRect& viewport) {
+        if (factor == 0U || (factor & (factor - 1U)) != 0U || factor > (1U << MAX_VIEWPORT_PASSES)) {
+            std::cerr << "Viewport factor " << factor << " is not a power of two up to " << (1U << MAX_VIEWPORT_PASSES) << std::endl;
+            throw std::exception();
+        }
+        const uint32_t passes = uint32_t(std::countr_zero(factor));
+        const glm::ivec2 size = outputSize(passes);
+        const PixelRect clipped = { glm::clamp(viewport.begin, glm::ivec2(0), size), glm::clamp(viewport.end, glm::ivec2(0), size) };
+        if (clipped.width() <= 0 || clipped.height() <= 0) { return Image<T>(std::max(clipped.width(), 0), std::max(clipped.height(), 0)); }
+
+        generation++;
+        std::vector<glm::ivec2> missing;
+        const glm::ivec2 first_tile = clipped.begin / tile_size, last_tile = (clipped.end - 1) / tile_size;
+        for (int tile_y = first_tile.y; tile_y <= last_tile.y; tile_y++) {
+            for (int tile_x = first_tile.x; tile_x <= last_tile.x; tile_x++) {
+                auto entry = tiles.find(tileKey(passes, glm::ivec2(tile_x, tile_y)));
+                if (entry == tiles.end()) {
+                    missing.emplace_back(tile_x, tile_y);
+                    continue;
+                }
+                entry->second.generation = generation;
+                recency.splice(recency.begin(), recency, entry->second.position);
+                statistics.tile_hits++;
+            }
+        }
+
+        // The cache is only read while the missing tiles are computed
+        std::vector<Image<T>> computed(missing.size());
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < int(missing.size()); i++) { computed[size_t(i)] = computeRect(passes, tileRect(passes, missing[size_t(i)])); }
+        for (size_t i = 0; i < missing.size(); i++) {
+            statistics.tiles_computed++;
+            statistics.computed_pixels += computed[i].data.size();
+            insertTile(tileKey(passes, missing[i]), std::move(computed[i]));
+        }
+        evict();
+
+        Image<T> result(clipped.width(), clipped.height());
+        copyCachedRect(passes, clipped, result);
+        return result;
+    }
+
+    const ViewportStats& stats() const { return statistics; }
+
+    uint64_t cachedBytes() const { return cached_bytes; }
+
+private:
+    struct Tile {
+        Image<T> pixels;
+        std::list<uint64_t>::iterator position; // In recency
+        uint64_t generation; // Of the last viewport the tile was part of
+    };
+
+    static uint64_t tileKey(uint32_t passes, const glm::ivec2& tile) {
+        return (uint64_t(passes) << 58U) | (uint64_t(uint32_t(tile.y)) << 29U) | uint64_t(uint32_t(tile.x));
+    }
+
+    PixelRect tileRect(uint32_t passes, const glm::ivec2& tile) const {
+        return { tile * tile_size, glm::min((tile + 1) * tile_size, outputSize(passes)) };
+    }
+
+    /**
+     * Copy a rectangle of an output from cached tiles
+     *
+     * @return False (leaving the destination partly written) if a tile overlapping the rectangle is not cached
+    */
+    bool copyCachedRect(uint32_t passes, const PixelRect& rect, Image<T>& destination) const {
+        const glm::ivec2 first_tile = rect.begin / tile_size, last_tile = (rect.end - 1) / tile_size;
+        for (int tile_y = first_tile.y; tile_y <= last_tile.y; tile_y++) {
+            for (int tile_x = first_tile.x; tile_x <= last_tile.x; tile_x++) {
+                const auto entry = tiles.find(tileKey(passes, glm::ivec2(tile_x, tile_y)));
+                if (entry == tiles.end()) { return false; }
+                const PixelRect tile = tileRect(passes, glm::ivec2(tile_x, tile_y));
+                const PixelRect overlap = { glm::max(tile.begin, rect.begin), glm::min(tile.end, rect.end) };
+                copyRect(entry->second.pixels, tile.begin, overlap, destination, rect.begin);
+            }
+        }
+        return true;
+    }
+
+    // Compute a rectangle of an output from the deepest factor whose cached tiles cover the region it depends on
+    Image<T> computeRect(uint32_t passes, const PixelRect& rect) const {
+        std::vector<PixelRect> needed(size_t(passes) + 1U);
+        needed[passes] = rect;
+        for (uint32_t pass = passes; pass > 0U; pass--) { needed[pass - 1U] = sourceRect(needed[pass], halo, outputSize(pass - 1U)); }
+
+        uint32_t start = 0U;
+        Image<T> level;
+        for (uint32_t pass = passes - 1U; pass > 0U && pass < passes; pass--) {
+            level = Image<T>(needed[pass].width(), needed[pass].height());
+            if (copyCachedRect(pass, needed[pass], level)) {
+                start = pass;
+                break;
+            }
+        }
+        if (start == 0U) {
+            level = Image<T>(needed[0].width(), needed[0].height());
+            copyRect(src, glm::ivec2(0), needed[0], level, needed[0].begin);
+        }
+        for (uint32_t pass = start + 1U; pass <= passes; pass++) {
+            const Image<T> scaled = scale(level);
+            level = Image<T>(needed[pass].width(), needed[pass].height());
+            copyRect(scaled, needed[pass - 1U].begin * 2, needed[pass], level, needed[pass].begin);
+        }
+        return level;
+    }
+
+    void insertTile(uint64_t key, Image<T>&& pixels) {
+        recency.push_front(key);
+        cached_bytes += pixels.data.size() * sizeof(T);
+        tiles.emplace(key, Tile { std::move(pixels), recency.begin(), generation });
+    }
+
+    void evict() {
+        while (cached_bytes > capacity_bytes && !recency.empty()) {
+            const auto entry = tiles.find(recency.back());
+            if (entry->second.generation == generation) { return; }
+            cached_bytes -= entry->second.pixels.data.size() * sizeof(T);
+            tiles.erase(entry);
+            recency.pop_back();
+        }
+    }
+
+    Image<T> src;
+    ScaleFunction<T> scale;
+    int halo, tile_size;
+    uint64_t capacity_bytes;
+
+    std::unordered_map<uint64_t, Tile> tiles;
+    std::list<uint64_t> recency; // Keys of the tiles, most recently used first
+    uint64_t cached_bytes = 0U;
+    uint64_t generation = 0U;
+    ViewportStats statistics;
+};
+
+#endif
@@ -9,12 +9,15 @@ DISABLE_WARNINGS_POP()
 #include <framework/image.h>
 
 #include "common.hpp"
+#include "kernel.hpp"
+
+constexpr int XBR_HALO = 2; // Source rows/columns read around each pixel
 
 constexpr uint8_t Y_COEFF = 0x30;
 constexpr uint8_t U_COEFF = 0x07;
 constexpr uint8_t V_COEFF = 0x06;
 
-uint32_t dist(glm::uvec3 A, glm::uvec3 B) {
+inline uint32_t dist(glm::uvec3 A, glm::uvec3 B) {
     glm::ivec3 A_yuv = rgbToYuv(A);
     glm::ivec3 B_yuv = rgbToYuv(B);
     glm::uvec3 diff = glm::abs(A_yuv - B_yuv);
@@ -22,112 +25,108 @@ uint32_t dist(glm::uvec3 A, glm::uvec3 B) {
 }
 
 template<typename T>
-Image<T> scaleXbr(const Image<T>& src) {
-    auto result = Image<T>(src.width * 2, src.height * 2);
+struct XbrRule {
+    static constexpr int RADIUS = XBR_HALO;
+    static constexpr int FACTOR = 2;
 
-    for (int y = 0; y < src.height; y++) {
-        for (int x = 0; x < src.width; x++) {
-            // Acquire original pixel grid values (row by row)
-            T A1, B1, C1;
-            A1 = src.safeAccess(x - 1, y - 2, NEAREST), B1 = src.safeAccess(x, y - 2, NEAREST), C1 = src.safeAccess(x + 1, y - 2, NEAREST);
-            T A0, A, B, C, C4;
-            A0 = src.safeAccess(x - 2, y - 1, NEAREST), A = src.safeAccess(x - 1, y - 1, NEAREST), B = src.safeAccess(x, y - 1, NEAREST),
-            C = src.safeAccess(x + 1, y - 1, NEAREST), C4 = src.safeAccess(x + 2, y - 1, NEAREST);
-            T D0, D, E, F, F4;
-            D0 = src.safeAccess(x - 2, y, NEAREST), D = src.safeAccess(x - 1, y, NEAREST), E = src.safeAccess(x, y, NEAREST),
-            F = src.safeAccess(x + 1, y, NEAREST), F4 = src.safeAccess(x + 2, y, NEAREST);
-            T G0, G, H, I, I4;
-            G0 = src.safeAccess(x - 2, y + 1, NEAREST), G = src.safeAccess(x - 1, y + 1, NEAREST), H = src.safeAccess(x, y + 1, NEAREST),
-            I = src.safeAccess(x + 1, y + 1, NEAREST), I4 = src.safeAccess(x + 2, y + 1, NEAREST);
-            T G5, H5, I5;
-            G5 = src.safeAccess(x - 1, y + 2, NEAREST), H5 = src.safeAccess(x, y + 2, NEAREST), I5 = src.safeAccess(x + 1, y + 2, NEAREST);
+    template<typename Window>
+    KernelBlock<T, FACTOR> operator()(const Window& window) const {
+        // Acquire original pixel grid values (row by row)
+        T A1, B1, C1;
+        A1 = window(-1, -2), B1 = window(0, -2), C1 = window(1, -2);
+        T A0, A, B, C, C4;
+        A0 = window(-2, -1), A = window(-1, -1), B = window(0, -1),
+        C = window(1, -1), C4 = window(2, -1);
+        T D0, D, E, F, F4;
+        D0 = window(-2, 0), D = window(-1, 0), E = window(0, 0),
+        F = window(1, 0), F4 = window(2, 0);
+        T G0, G, H, I, I4;
+        G0 = window(-2, 1), G = window(-1, 1), H = window(0, 1),
+        I = window(1, 1), I4 = window(2, 1);
+        T G5, H5, I5;
+        G5 = window(-1, 2), H5 = window(0, 2), I5 = window(1, 2);
 
-            // Detect diagonal edges in the four possible directions
-            uint32_t bot_right_perpendicular_dist   = dist(E, C) + dist(E, G) + dist(I, F4) + dist(I, H5) + 4 * dist(H, F);
-            uint32_t bot_right_parallel_dist        = dist(H, D) + dist(H, I5) + dist(F, I4) + dist(F, B) + 4 * dist(E, I);
-            bool edr_bot_right                      = bot_right_perpendicular_dist < bot_right_parallel_dist;
-            uint32_t bot_left_perpendicular_dist    = dist(A, E) + dist(E, I) + dist(D0, G) + dist(G, H5) + 4 * dist(D, H);
-            uint32_t bot_left_parallel_dist         = dist(B, D) + dist(F, H) + dist(D, G0) + dist(H, G5) + 4 * dist(E, G);
-            bool edr_bot_left                       = bot_left_perpendicular_dist < bot_left_parallel_dist;
-            uint32_t top_left_perpendicular_dist    = dist(G, E) + dist(E, C) + dist(D0, A) + dist(A, B1) + 4 * dist(D, B);
-            uint32_t top_left_parallel_dist         = dist(H, D) + dist(D, A0) + dist(F, B) + dist(B, A1) + 4 * dist(E, A);
-            bool edr_top_left                       = top_left_perpendicular_dist < top_left_parallel_dist;
-            uint32_t top_right_perpendicular_dist   = dist(A, E) + dist(E, I) + dist(B1, C) + dist(C, F4) + 4 * dist(B, F);
-            uint32_t top_right_parallel_dist        = dist(D, B) + dist(B, C1) + dist(H, F) + dist(F, C4) + 4 * dist(E, C);
-            bool edr_top_right                      = top_right_perpendicular_dist < top_right_parallel_dist;
+        // Detect diagonal edges in the four possible directions
+        uint32_t bot_right_perpendicular_dist   = dist(E, C) + dist(E, G) + dist(I, F4) + dist(I, H5) + 4 * dist(H, F);
+        uint32_t bot_right_parallel_dist        = dist(H, D) + dist(H, I5) + dist(F, I4) + dist(F, B) + 4 * dist(E, I);
+        bool edr_bot_right                      = bot_right_perpendicular_dist < bot_right_parallel_dist;
+        uint32_t bot_left_perpendicular_dist    = dist(A, E) + dist(E, I) + dist(D0, G) + dist(G, H5) + 4 * dist(D, H);
+        uint32_t bot_left_parallel_dist         = dist(B, D) + dist(F, H) + dist(D, G0) + dist(H, G5) + 4 * dist(E, G);
+        bool edr_bot_left                       = bot_left_perpendicular_dist < bot_left_parallel_dist;
+        uint32_t top_left_perpendicular_dist    = dist(G, E) + dist(E, C) + dist(D0, A) + dist(A, B1) + 4 * dist(D, B);
+        uint32_t top_left_parallel_dist         = dist(H, D) + dist(D, A0) + dist(F, B) + dist(B, A1) + 4 * dist(E, A);
+        bool edr_top_left                       = top_left_perpendicular_dist < top_left_parallel_dist;
+        uint32_t top_right_perpendicular_dist   = dist(A, E) + dist(E, I) + dist(B1, C) + dist(C, F4) + 4 * dist(B, F);
+        uint32_t top_right_parallel_dist        = dist(D, B) + dist(B, C1) + dist(H, F) + dist(F, C4) + 4 * dist(E, C);
+        bool edr_top_right                      = top_right_perpendicular_dist < top_right_parallel_dist;
 
-            // Initial values are same as pixel being expanded
-            T zero, one, two, three;
-            zero = one = two = three = src.safeAccess(x, y);
+        // Initial values are same as pixel being expanded
+        T zero, one, two, three;
+        zero = one = two = three = window(0, 0);
 
-            if (edr_bot_right) {
-                T new_color = (dist(E, F) <= dist(E, H)) ? F : H;
-                if (F == G && H == C) {
-                    three   = glm::mix(three, new_color, 0.75f);
-                    two     = glm::mix(two, new_color, 0.25f);
-                    one     = glm::mix(one, new_color, 0.25f);
-                } else if (F == G) {
-                    three   = glm::mix(three, new_color, 0.75f);
-                    two     = glm::mix(two, new_color, 0.25f);
-                } else if (H == C) {
-                    three   = glm::mix(three, new_color, 0.75f);
-                    one     = glm::mix(one, new_color, 0.25f);
-                } else { three = glm::mix(three, new_color, 0.5f); }
-            }
-            if (edr_bot_left) {
-                T new_color = (dist(E, H) <= dist(E, D)) ? H : D;
-                if (A == H && D == I) {
-                    two     = glm::mix(two, new_color, 0.75f);
-                    zero    = glm::mix(zero, new_color, 0.25f);
-                    three   = glm::mix(three, new_color, 0.25f);
-                } else if (A == H) {
-                    two     = glm::mix(two, new_color, 0.75f);
-                    zero    = glm::mix(zero, new_color, 0.25f);
-                } else if (D == I) {
-                    two     = glm::mix(two, new_color, 0.75f);
-                    three   = glm::mix(three, new_color, 0.25f);
-                } else { two = glm::mix(two, new_color, 0.5f); }
-            }
-            if (edr_top_left) {
-                T new_color = (dist(E, D) <= dist(E, B)) ? D : B;
-                if (D == C && B == G) {
-                    zero    = glm::mix(zero, new_color, 0.75f);
-                    one     = glm::mix(one, new_color, 0.25f);
-                    two     = glm::mix(two, new_color, 0.25f);
-                } else if (D == C) {
-                    zero    = glm::mix(zero, new_color, 0.75f);
-                    one     = glm::mix(one, new_color, 0.25f);
-                } else if (B == G) {
-                    zero    = glm::mix(zero, new_color, 0.75f);
-                    two     = glm::mix(two, new_color, 0.25f);
-                } else { zero = glm::mix(zero, new_color, 0.5f); }
-            }
-            if (edr_top_right) {
-                T new_color = (dist(E, B) <= dist(E, F)) ? B : F;
-                if (B == I && F == A) {
-                    one     = glm::mix(one, new_color, 0.75f);
-                    three   = glm::mix(three, new_color, 0.25f);
-                    zero    = glm::mix(zero, new_color, 0.25f);
-                } else if (B == I) {
-                    one     = glm::mix(one, new_color, 0.75f);
-                    three   = glm::mix(three, new_color, 0.25f);
-                } else if (F == A) {
-                    one     = glm::mix(one, new_color, 0.75f);
-                    zero    = glm::mix(zero, new_color, 0.25f);
-                } else { one = glm::mix(one, new_color, 0.5f); }
-            }
-
-            // Final assignments
-            int dst_x = 2 * x;
-            int dst_y = 2 * y;
-            result.data[result.getImageOffset(dst_x, dst_y)]            = zero;
-            result.data[result.getImageOffset(dst_x + 1, dst_y)]        = one;
-            result.data[result.getImageOffset(dst_x, dst_y + 1)]        = two;
-            result.data[result.getImageOffset(dst_x + 1, dst_y + 1)]    = three;
+        if (edr_bot_right) {
+            T new_color = (dist(E, F) <= dist(E, H)) ? F : H;
+            if (F == G && H == C) {
+                three   = glm::mix(three, new_color, 0.75f);
+                two     = glm::mix(two, new_color, 0.25f);
+                one     = glm::mix(one, new_color, 0.25f);
+            } else if (F == G) {
+                three   = glm::mix(three, new_color, 0.75f);
+                two     = glm::mix(two, new_color, 0.25f);
+            } else if (H == C) {
+                three   = glm::mix(three, new_color, 0.75f);
+                one     = glm::mix(one, new_color, 0.25f);
+            } else { three = glm::mix(three, new_color, 0.5f); }
+        }
+        if (edr_bot_left) {
+            T new_color = (dist(E, H) <= dist(E, D)) ? H : D;
+            if (A == H && D == I) {
+                two     = glm::mix(two, new_color, 0.75f);
+                zero    = glm::mix(zero, new_color, 0.25f);
+                three   = glm::mix(three, new_color, 0.25f);
+            } else if (A == H) {
+                two     = glm::mix(two, new_color, 0.75f);
+                zero    = glm::mix(zero, new_color, 0.25f);
+            } else if (D == I) {
+                two     = glm::mix(two, new_color, 0.75f);
+                three   = glm::mix(three, new_color, 0.25f);
+            } else { two = glm::mix(two, new_color, 0.5f); }
         }
+        if (edr_top_left) {
+            T new_color = (dist(E, D) <= dist(E, B)) ? D : B;
+            if (D == C && B == G) {
+                zero    = glm::mix(zero, new_color, 0.75f);
+                one     = glm::mix(one, new_color, 0.25f);
+                two     = glm::mix(two, new_color, 0.25f);
+            } else if (D == C) {
+                zero    = glm::mix(zero, new_color, 0.75f);
+                one     = glm::mix(one, new_color, 0.25f);
+            } else if (B == G) {
+                zero    = glm::mix(zero, new_color, 0.75f);
+                two     = glm::mix(two, new_color, 0.25f);
+            } else { zero = glm::mix(zero, new_color, 0.5f); }
+        }
+        if (edr_top_right) {
+            T new_color = (dist(E, B) <= dist(E, F)) ? B : F;
+            if (B == I && F == A) {
+                one     = glm::mix(one, new_color, 0.75f);
+                three   = glm::mix(three, new_color, 0.25f);
+                zero    = glm::mix(zero, new_color, 0.25f);
+            } else if (B == I) {
+                one     = glm::mix(one, new_color, 0.75f);
+                three   = glm::mix(three, new_color, 0.25f);
+            } else if (F == A) {
+                one     = glm::mix(one, new_color, 0.75f);
+                zero    = glm::mix(zero, new_color, 0.25f);
+            } else { one = glm::mix(one, new_color, 0.5f); }
+        }
+        return { zero, one, two, three };
     }
+};
 
-    return result;
+template<typename T>
+Image<T> scaleXbr(const Image<T>& src) {
+    return applyKernel<XbrRule<T>, NEAREST>(src);
 }
 
 #endif
@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "auto_tuner.hpp"
+
+static const std::filesystem::path tuner_test_dir_path { std::filesystem::temp_directory_path() / "fin-proj-tuner-tests" };
+
+TEST_CASE("Size classes split images by their source pixels", "[tuner]") {
+    CHECK(sizeClassOf(1, 1) == SIZE_SMALL);
+    CHECK(sizeClassOf(127, 128) == SIZE_SMALL);
+    CHECK(sizeClassOf(128, 128) == SIZE_MEDIUM);
+    CHECK(sizeClassOf(1024, 255) == SIZE_MEDIUM);
+    CHECK(sizeClassOf(512, 512) == SIZE_LARGE);
+    CHECK(sizeClassOf(0, 1 << 30) == SIZE_SMALL);
+}
+
+TEST_CASE("Calibration picks settings that produce the pixels of the default scalers", "[tuner]") {
+    CalibrationOptions options;
+    options.sides = { 24, 40, 64 };
+    options.tile_sizes = { 16, 64 };
+    options.max_repeats = 1;
+    options.hardware_threads = 2U;
+    const TuningProfile profile = calibrate(options);
+    CHECK(profile.hardware_threads == 2U);
+
+    const Image<glm::uvec3> sprite = syntheticSprite(37, 29, 7U);
+    for (size_t scaler = 0; scaler < TUNABLE_SCALERS.size(); scaler++) {
+        const TunableScaler& tunable = TUNABLE_SCALERS[scaler];
+        INFO(tunable.algorithm);
+        for (const TunedConfig& config : profile.configs[scaler]) {
+            CHECK(config.variant < tunable.variants.size());
+            CHECK((config.tile_size == 16 || config.tile_size == 64));
+            CHECK(config.seconds > 0.0);
+        }
+
+        const TunedConfig& config = profile.lookup(tunable, sprite.width, sprite.height);
+        const std::vector<Image<glm::uvec3>> tuned = scaleChainFused(sprite, tunable.variants[config.variant].scale, tunable.halo, { true, true }, config.tile_size);
+        const Image<glm::uvec3> expected = tunable.variants[0].scale(tunable.variants[0].scale(sprite));
+        CHECK(tuned[1].data == expected.data);
+    }
+}
+
+TEST_CASE("Tuning profiles are written and read back", "[tuner]") {
+    std::filesystem::remove_all(tuner_test_dir_path);
+    const std::filesystem::path profile_path = tuner_test_dir_path / "profiles" / "tuning";
+    CHECK_FALSE(loadProfile(profile_path));
+
+    TuningProfile profile;
+    profile.hardware_threads = 8U;
+    profile.configs[0][SIZE_LARGE] = { 1U, 32, 0.25 };
+    profile.configs[5][SIZE_SMALL] = { 0U, 256, 1e-3 };
+    saveProfile(profile, profile_path);
+
+    const std::optional<TuningProfile> loaded = loadProfile(profile_path);
+    REQUIRE(loaded);
+    CHECK(loaded->hardware_threads == 8U);
+    for (size_t scaler = 0; scaler < TUNABLE_SCALERS.size(); scaler++) {
+        for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; size_class++) {
+            CHECK(loaded->configs[scaler][size_class].variant == profile.configs[scaler][size_class].variant);
+            CHECK(loaded->configs[scaler][size_class].tile_size == profile.configs[scaler][size_class].tile_size);
+            CHECK(loaded->configs[scaler][size_class].seconds == profile.configs[scaler][size_class].seconds);
+        }
+    }
+    CHECK(loaded->lookup(TUNABLE_SCALERS[0], 1024, 1024).variant == 1U);
+
+    // Missing lines keep their defaults, invalid ones discard the profile
+    const auto write = [&](const std::string& contents) { std::ofstream(profile_path) << contents; };
+    write(std::string(TUNING_PROFILE_HEADER) + "\neagle medium equality_mask 64 0.5\n");
+    REQUIRE(loadProfile(profile_path));
+    CHECK(loadProfile(profile_path)->lookup(*findTunableScaler("eagle"), 200, 200).variant == 1U);
+    CHECK(loadProfile(profile_path)->lookup(*findTunableScaler("eagle"), 20, 20).variant == 0U);
+    write(std::string(TUNING_PROFILE_HEADER) + "\nhq2x small equality_mask 64 0.5\n");
+    CHECK_FALSE(loadProfile(profile_path));
+    write(std::string(TUNING_PROFILE_HEADER) + "\nepx huge kernel 64 0.5\n");
+    CHECK_FALSE(loadProfile(profile_path));
+    write(std::string(TUNING_PROFILE_HEADER) + "\nthreads 0\n");
+    CHECK_FALSE(loadProfile(profile_path));
+    write("fin-proj-tuning 1\nthreads 4 4 1\n");
+    CHECK_FALSE(loadProfile(profile_path));
+}
@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/codecs.h>
+
+#include "batched_io.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path io_test_dir_path { std::filesystem::temp_directory_path() / "fin-proj-io-tests" };
+
+/**
+ * Read every data file and write it to a nested output directory with both backends
+ *
+ * @param use_io_uring Whether to try io_uring
+ * @param queue_depth Requests in flight at once on io_uring, small enough that requests wait for each other
+*/
+static void checkRoundTrip(bool use_io_uring, unsigned queue_depth) {
+    std::filesystem::remove_all(io_test_dir_path);
+    std::vector<std::filesystem::path> inputs;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(data_dir_path)) { inputs.push_back(entry.path()); }
+
+    BatchedIo io(use_io_uring, queue_depth, 3U);
+    std::vector<std::future<FileBytes>> reads;
+    for (const std::filesystem::path& input : inputs) { reads.push_back(io.read(input)); }
+    uint64_t total_bytes = 0U;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        FileBytes bytes = reads[i].get();
+        REQUIRE(bytes == readFileBytes(inputs[i]));
+        total_bytes += bytes.size();
+        io.write(io_test_dir_path / std::to_string(i % 3U) / inputs[i].filename(), std::move(bytes));
+    }
+    io.write(io_test_dir_path / "empty", {});
+    io.flush();
+
+    for (size_t i = 0; i < inputs.size(); i++) { CHECK(readFileBytes(io_test_dir_path / std::to_string(i % 3U) / inputs[i].filename()) == readFileBytes(inputs[i])); }
+    CHECK(std::filesystem::file_size(io_test_dir_path / "empty") == 0U);
+    const IoStats stats = io.stats();
+    CHECK(stats.reads == inputs.size());
+    CHECK(stats.writes == inputs.size() + 1U);
+    CHECK(stats.bytes_read == total_bytes);
+    CHECK(stats.bytes_written == total_bytes);
+    if (io.backend() == IO_BACKEND_URING) {
+        CHECK(stats.operations == inputs.size() * 7U + 2U); // Open, statx, read and close; open, write and close; the empty file is not written to
+        CHECK(stats.submissions <= stats.operations);
+    } else {
+        CHECK(stats.submissions == 0U);
+    }
+}
+
+TEST_CASE("Batched I/O reads and writes whole files", "[io]") {
+    checkRoundTrip(true, DEFAULT_IO_QUEUE_DEPTH);
+    checkRoundTrip(true, 2U);
+    checkRoundTrip(false, DEFAULT_IO_QUEUE_DEPTH);
+    #ifdef __linux__
+    // Kernels of every supported distribution have io_uring, unless a sandbox blocks it
+    BatchedIo io;
+    WARN("Batched I/O backend: " << (io.backend() == IO_BACKEND_URING ? "io_uring" : "threads"));
+    #endif
+}
+
+TEST_CASE("Batched I/O reports failed reads and writes", "[io]") {
+    for (bool use_io_uring : { true, false }) {
+        INFO(use_io_uring);
+        std::filesystem::remove_all(io_test_dir_path);
+        std::filesystem::create_directories(io_test_dir_path);
+        BatchedIo io(use_io_uring);
+        std::future<FileBytes> missing = io.read(io_test_dir_path / "missing.png");
+        CHECK_THROWS(missing.get());
+        std::future<FileBytes> directory = io.read(io_test_dir_path);
+        CHECK_THROWS(directory.get());
+
+        // A file cannot be a parent directory
+        io.write(io_test_dir_path / "file", { 1U, 2U, 3U });
+        io.flush();
+        io.write(io_test_dir_path / "file" / "child", { 4U });
+        io.write(io_test_dir_path / "written", { 5U });
+        CHECK_THROWS(io.flush());
+        CHECK(readFileBytes(io_test_dir_path / "written") == std::vector<uint8_t> { 5U });
+        io.flush(); // Failures are only reported once
+        CHECK(io.stats().writes == 3U);
+    }
+}
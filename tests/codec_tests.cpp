@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/codecs.h>
+#include <framework/image.h>
+
+#include "xbr.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path codec_dir_path { std::filesystem::temp_directory_path() / "fin-proj-codec-tests" };
+
+static const std::vector<std::string> CODEC_FILES = { "X1-3_X_Idle", "sma_chest_input", "smw_bowser_input" };
+
+static std::vector<uint8_t> toRgb8(const Image<glm::uvec3>& image) {
+    std::vector<uint8_t> rgb(image.data.size() * 3U);
+    for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8(&rgb[i * 3U], image.data[i]); }
+    return rgb;
+}
+
+TEST_CASE("QOI encoder emits the operations of the specification", "[codecs]") {
+    // Run of the initial pixel, RGB, DIFF, RGB (the colour cache starts transparent), INDEX and LUMA
+    const std::vector<uint8_t> rgb = { 0, 0, 0, 10, 20, 30, 11, 21, 29, 0, 0, 0, 10, 20, 30, 15, 28, 36 };
+    const std::vector<uint8_t> expected = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 6, 0, 0, 0, 1, 3, 0,
+        0xc0, 0xfe, 10, 20, 30, 0x7d, 0xfe, 0, 0, 0, 0x09, 0xa8, 0x56,
+        0, 0, 0, 0, 0, 0, 0, 1 };
+    const std::vector<uint8_t> encoded = encodeQoi(rgb.data(), 6, 1);
+    CHECK(encoded == expected);
+
+    const Rgb8Pixels decoded = decodeQoi(encoded.data(), encoded.size());
+    CHECK(decoded.width == 6);
+    CHECK(decoded.height == 1);
+    CHECK(decoded.rgb == rgb);
+
+    // Runs are split at their maximum length and flushed at the end of the image
+    const std::vector<uint8_t> flat(100U * 3U, 0U);
+    const std::vector<uint8_t> runs = encodeQoi(flat.data(), 100, 1);
+    CHECK(runs.size() == QOI_HEADER_SIZE + 2U + QOI_PADDING_SIZE);
+    CHECK(decodeQoi(runs.data(), runs.size()).rgb == flat);
+}
+
+TEST_CASE("QOI and raw files round trip through images", "[codecs]") {
+    std::filesystem::remove_all(codec_dir_path);
+    for (const std::string& filename : CODEC_FILES) {
+        const Image<glm::uvec3> image(data_dir_path / (filename + ".png"));
+        const Image<glm::uvec3> scaled = scaleXbr(image); // Blended colours exercise every QOI operation
+        const std::filesystem::path png_path = codec_dir_path / (filename + ".png");
+        scaled.writeToFile(png_path);
+        for (const std::string extension : { ".qoi", ".raw" }) {
+            const std::filesystem::path path = codec_dir_path / (filename + extension);
+            scaled.writeToFile(path);
+            const Image<glm::uvec3> read(path);
+            REQUIRE(read.width == scaled.width);
+            REQUIRE(read.height == scaled.height);
+            CHECK(read.data == scaled.data);
+            CHECK(Image<glm::vec3>(path).data == Image<glm::vec3>(png_path).data);
+        }
+        CHECK(std::filesystem::file_size(codec_dir_path / (filename + ".raw")) == RAW_HEADER_SIZE + (scaled.data.size() * 3U));
+    }
+}
+
+TEST_CASE("Images encode and decode in memory like through files", "[codecs]") {
+    std::filesystem::create_directories(codec_dir_path);
+    const Image<glm::uvec3> scaled = scaleXbr(Image<glm::uvec3>(data_dir_path / "sma_chest_input.png"));
+    for (const std::string extension : { ".png", ".qoi", ".raw", ".jpg" }) {
+        INFO(extension);
+        const std::filesystem::path path = codec_dir_path / ("in_memory" + extension);
+        scaled.writeToFile(path);
+        const std::vector<uint8_t> encoded = scaled.encode(path);
+        CHECK(encoded == readFileBytes(path));
+        CHECK(Image<glm::uvec3>(encoded, path).data == Image<glm::uvec3>(path).data);
+        CHECK(Image<glm::vec3>(encoded, path).data == Image<glm::vec3>(path).data);
+    }
+    CHECK_THROWS(Image<glm::uvec3>(std::vector<uint8_t>(16U, 0U), codec_dir_path / "garbage.png"));
+}
+
+TEST_CASE("Malformed QOI and raw data is rejected", "[codecs]") {
+    const Image<glm::uvec3> image(data_dir_path / "X1-3_X_Idle.png");
+    const std::vector<uint8_t> rgb = toRgb8(image);
+
+    std::vector<uint8_t> qoi = encodeQoi(rgb.data(), image.width, image.height);
+    qoi.resize(qoi.size() / 2U);
+    CHECK_THROWS(decodeQoi(qoi.data(), qoi.size()));
+    qoi[0] = 'x';
+    CHECK_THROWS(decodeQoi(qoi.data(), qoi.size()));
+
+    std::vector<uint8_t> raw = encodeRaw(rgb.data(), image.width, image.height);
+    raw.pop_back();
+    CHECK_THROWS(decodeRaw(raw.data(), raw.size()));
+}
+
+// Throughput of the codecs against stb's PNG on an 8x xBR output, run with: fin-proj-tests "[codecs-benchmark]"
+TEST_CASE("Codec throughput", "[.][codecs-benchmark]") {
+    const Image<glm::uvec3> image = scaleXbr(scaleXbr(scaleXbr(Image<glm::uvec3>(data_dir_path / "sma_chest_input.png"))));
+    const std::vector<uint8_t> rgb = toRgb8(image);
+    const auto appendBytes = [](void* context, void* data, int size) {
+        auto* bytes = static_cast<std::vector<uint8_t>*>(context);
+        bytes->insert(bytes->end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+    };
+    std::vector<uint8_t> png;
+    stbi_write_png_to_func(appendBytes, &png, image.width, image.height, 3, rgb.data(), image.width * 3);
+    const std::vector<uint8_t> qoi = encodeQoi(rgb.data(), image.width, image.height);
+    const std::vector<uint8_t> raw = encodeRaw(rgb.data(), image.width, image.height);
+    std::cout << image.width << "x" << image.height << ": PNG " << png.size() << " bytes, QOI " << qoi.size() << " bytes, raw " << raw.size() << " bytes" << std::endl;
+
+    BENCHMARK("PNG encode") {
+        std::vector<uint8_t> bytes;
+        stbi_write_png_to_func(appendBytes, &bytes, image.width, image.height, 3, rgb.data(), image.width * 3);
+        return bytes.size();
+    };
+    BENCHMARK("QOI encode") { return encodeQoi(rgb.data(), image.width, image.height).size(); };
+    BENCHMARK("Raw encode") { return encodeRaw(rgb.data(), image.width, image.height).size(); };
+    BENCHMARK("PNG decode") {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(png.data(), int(png.size()), &width, &height, &channels, 3);
+        stbi_image_free(pixels);
+        return width;
+    };
+    BENCHMARK("QOI decode") { return decodeQoi(qoi.data(), qoi.size()).width; };
+    BENCHMARK("Raw decode") { return decodeRaw(raw.data(), raw.size()).width; };
+}
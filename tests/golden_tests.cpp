@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "2xsai.hpp"
+#include "eagle.hpp"
+#include "epx.hpp"
+#include "equality_mask.hpp"
+#include "hq2x.hpp"
+#include "nedi.hpp"
+#include "xbr.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path golden_dir_path { GOLDEN_DIR };
+static const std::filesystem::path manifest_path { golden_dir_path / "manifest.txt" };
+
+// Tolerant algorithms store a full reference image per golden entry, so they are only checked at 2x
+static const std::vector<uint32_t> EXACT_GOLDEN_FACTORS     = { 2U, 4U };
+static const std::vector<uint32_t> TOLERANT_GOLDEN_FACTORS  = { 2U };
+
+// Error bounds (in 8-bit levels) for algorithms whose float blends may legitimately differ between engines
+static constexpr uint32_t TOLERANT_MAX_ERROR    = 16U;
+static constexpr double TOLERANT_MEAN_ERROR     = 0.5;
+
+// Output of an engine after the same 8-bit quantisation that Image<T>::writeToFile applies
+struct QuantizedImage {
+    int width, height;
+    std::vector<uint8_t> rgb;
+};
+
+struct GoldenEntry {
+    int width, height;
+    uint64_t hash;
+};
+
+using EngineFn = std::function<QuantizedImage(const std::filesystem::path&, uint32_t)>;
+
+struct Engine {
+    std::string algorithm;  // Key of the reference algorithm in the golden manifest
+    std::string name;       // Name of this particular implementation of the algorithm
+    EngineFn run;
+};
+
+static std::vector<std::string> inputFiles() {
+    std::vector<std::string> files;
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir_path)) {
+        if (entry.path().extension() == ".png") { files.push_back(entry.path().stem().string()); }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static uint64_t fnv1a(const QuantizedImage& image) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto feed = [&hash](uint8_t byte) { hash = (hash ^ byte) * 0x100000001b3ULL; };
+    for (int shift = 0; shift < 32; shift += 8) { feed(uint8_t(uint32_t(image.width) >> shift)); }
+    for (int shift = 0; shift < 32; shift += 8) { feed(uint8_t(uint32_t(image.height) >> shift)); }
+    for (uint8_t byte : image.rgb) { feed(byte); }
+    return hash;
+}
+
+template<typename T>
+static QuantizedImage quantize(const Image<T>& image) {
+    QuantizedImage result { image.width, image.height, std::vector<uint8_t>(image.data.size() * 3) };
+    for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8<T>(&result.rgb[i * 3], image.data[i]); }
+    return result;
+}
+
+/**
+ * Wrap a 2x scaler into an engine that chains it until the requested factor is reached
+ *
+ * @param scale 2x scaling function operating on images of type T
+ *
+ * @return Engine function loading the input as Image<T> and applying scale log2(factor) times
+*/
+template<typename T>
+static EngineFn chained(Image<T> (*scale)(const Image<T>&)) {
+    return [scale](const std::filesystem::path& input_path, uint32_t factor) {
+        Image<T> image(input_path);
+        for (uint32_t current = 1U; current < factor; current *= 2U) { image = scale(image); }
+        return quantize(image);
+    };
+}
+
+static const std::vector<Engine>& referenceEngines() {
+    static const std::vector<Engine> engines = {
+        { "epx",        "reference", chained<glm::uvec3>(scaleEpx) },
+        { "adv_mame",   "reference", chained<glm::uvec3>(scaleAdvMame) },
+        { "eagle",      "reference", chained<glm::uvec3>(scaleEagle) },
+        { "2xSaI",      "reference", chained<glm::uvec3>(scale2xSaI) },
+        { "hq2x",       "reference", chained<glm::uvec3>(scaleHq2x) },
+        { "xbr",        "reference", chained<glm::uvec3>(scaleXbr) },
+        { "nedi",       "reference", chained<glm::vec3>(scaleNediScalar) }};
+    return engines;
+}
+
+// Optimised implementations of the algorithms above, validated against the reference golden data
+static const std::vector<Engine>& optimisedEngines() {
+    static const std::vector<Engine> engines = {
+        { "epx",        "equality_mask", chained<glm::uvec3>(scaleEpxEquality) },
+        { "adv_mame",   "equality_mask", chained<glm::uvec3>(scaleAdvMameEquality) },
+        { "eagle",      "equality_mask", chained<glm::uvec3>(scaleEagleEquality) },
+        { "2xSaI",      "equality_mask", chained<glm::uvec3>(scale2xSaIEquality) },
+        { "nedi",       "batched",       chained<glm::vec3>(scaleNedi) }};
+    return engines;
+}
+
+static bool isTolerant(const std::string& algorithm) {
+    return algorithm == "2xSaI" || algorithm == "xbr" || algorithm == "nedi";
+}
+
+static const std::vector<uint32_t>& goldenFactors(const std::string& algorithm) {
+    return isTolerant(algorithm) ? TOLERANT_GOLDEN_FACTORS : EXACT_GOLDEN_FACTORS;
+}
+
+static std::string manifestKey(const std::string& algorithm, const std::string& filename, uint32_t factor) {
+    return algorithm + " " + filename + " " + std::to_string(factor);
+}
+
+static std::filesystem::path goldenImagePath(const std::string& algorithm, const std::string& filename, uint32_t factor) {
+    return golden_dir_path / algorithm / (filename + "-" + std::to_string(factor) + "X.png");
+}
+
+static std::map<std::string, GoldenEntry> readManifest() {
+    std::map<std::string, GoldenEntry> manifest;
+    std::ifstream file(manifest_path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') { continue; }
+        std::istringstream fields(line);
+        std::string algorithm, filename;
+        uint32_t factor;
+        GoldenEntry entry;
+        fields >> algorithm >> filename >> factor >> entry.width >> entry.height >> std::hex >> entry.hash;
+        manifest[manifestKey(algorithm, filename, factor)] = entry;
+    }
+    return manifest;
+}
+
+static QuantizedImage readGoldenImage(const std::filesystem::path& path) {
+    return quantize(Image<glm::uvec3>(path));
+}
+
+static void checkAgainstGolden(const Engine& engine, const std::map<std::string, GoldenEntry>& manifest) {
+    for (const std::string& filename : inputFiles()) {
+        for (uint32_t factor : goldenFactors(engine.algorithm)) {
+            INFO(engine.algorithm << " (" << engine.name << ") on " << filename << " at " << factor << "x");
+            const auto golden = manifest.find(manifestKey(engine.algorithm, filename, factor));
+            REQUIRE(golden != manifest.end());
+
+            QuantizedImage output = engine.run(data_dir_path / (filename + ".png"), factor);
+            REQUIRE(output.width == golden->second.width);
+            REQUIRE(output.height == golden->second.height);
+            if (!isTolerant(engine.algorithm)) {
+                CHECK(fnv1a(output) == golden->second.hash);
+                continue;
+            }
+            if (fnv1a(output) == golden->second.hash) { continue; }
+
+            // Float blends may differ slightly, so compare against the stored reference output instead
+            QuantizedImage reference = readGoldenImage(goldenImagePath(engine.algorithm, filename, factor));
+            REQUIRE(reference.rgb.size() == output.rgb.size());
+            uint32_t max_error  = 0U;
+            double total_error  = 0.0;
+            for (size_t i = 0; i < output.rgb.size(); i++) {
+                uint32_t error = uint32_t(std::abs(int(output.rgb[i]) - int(reference.rgb[i])));
+                max_error = std::max(max_error, error);
+                total_error += error;
+            }
+            double mean_error = total_error / double(output.rgb.size());
+            CHECK(max_error <= TOLERANT_MAX_ERROR);
+            CHECK(mean_error <= TOLERANT_MEAN_ERROR);
+        }
+    }
+}
+
+TEST_CASE("Reference scalers match golden manifest", "[golden]") {
+    const auto manifest = readManifest();
+    REQUIRE(!manifest.empty());
+    for (const Engine& engine : referenceEngines()) { checkAgainstGolden(engine, manifest); }
+}
+
+TEST_CASE("Optimised engines match reference scalers", "[golden]") {
+    const auto manifest = readManifest();
+    REQUIRE(!manifest.empty());
+    for (const Engine& engine : optimisedEngines()) { checkAgainstGolden(engine, manifest); }
+}
+
+TEST_CASE("NEDI only skips the solve for uniform sampling regions", "[golden]") {
+    // A uniform image with a single differing pixel, which must force the solve on every region containing it
+    static constexpr int SIZE = 16, SPOT = 12;
+    Image<glm::vec3> src(SIZE, SIZE);
+    std::fill(src.data.begin(), src.data.end(), glm::vec3(0.25f, 0.5f, 0.75f));
+    src.data[src.getImageOffset(SPOT, SPOT)] = glm::vec3(1.0f);
+
+    NediStats stats;
+    const Image<glm::vec3> result = scaleNedi(src, &stats);
+    size_t expected_flat = 0U;
+    for (int y = 0; y + NEDI_FLAT_EXTENT <= SIZE; y++) {
+        for (int x = 0; x + NEDI_FLAT_EXTENT <= SIZE; x++) {
+            if (SPOT < x || SPOT >= x + NEDI_FLAT_EXTENT || SPOT < y || SPOT >= y + NEDI_FLAT_EXTENT) { expected_flat++; }
+        }
+    }
+    CHECK(stats.flat_pixels == expected_flat);
+    CHECK(stats.flat_pixels + stats.solved_pixels == size_t(SIZE * SIZE));
+
+    // The shortcut yields exactly the weights of the solve it skips, and the batched solver agrees with both
+    const Image<glm::vec3> solved = scaleNediScalar(src, false);
+    CHECK(scaleNediScalar(src).data == solved.data);
+    float max_error = 0.0f;
+    for (size_t i = 0; i < solved.data.size(); i++) {
+        for (int channel = 0; channel < 3; channel++) { max_error = std::max(max_error, std::abs(result.data[i][channel] - solved.data[i][channel])); }
+    }
+    CHECK(max_error < 1e-5f);
+}
+
+TEST_CASE("Batched NEDI solver solves positive definite systems and masks singular ones", "[golden]") {
+    // Lane 0: R = diag(1, 2, 4, 8) plus a symmetric off-diagonal term, lane 1: rank one (singular)
+    NediSystemBatch batch;
+    batch.resize(2U);
+    const std::array<float, NEDI_COVARIANCE_TERMS> definite = { 1.0f, 0.5f, 0.0f, 0.0f, 2.0f, 0.0f, 0.0f, 4.0f, 0.0f, 8.0f };
+    const std::array<float, 4> rhs = { 1.5f, 2.5f, 4.0f, 8.0f }; // R * (1, 1, 1, 1)
+    for (size_t term = 0; term < NEDI_COVARIANCE_TERMS; term++) {
+        batch.covariance[term][0] = definite[term];
+        batch.covariance[term][1] = 1.0f;
+    }
+    for (size_t row = 0; row < 4; row++) {
+        batch.rhs[row][0] = rhs[row];
+        batch.rhs[row][1] = 1.0f;
+    }
+    solveNediBatch(batch, 2U);
+
+    for (size_t row = 0; row < 4; row++) {
+        CHECK(std::abs(batch.weights[row][0] - 1.0f) < 1e-5f);
+        CHECK(std::isnan(batch.weights[row][1]));
+    }
+    CHECK(std::isfinite(batch.condition_squared[0]));
+    CHECK(std::isnan(batch.condition_squared[1]));
+}
+
+TEST_CASE("Batched NEDI solver matches Eigen on every lane of full batches", "[golden]") {
+    // Well-conditioned A^T A + I systems, with exactly singular rank one systems (integer v v^T with v0 = 1) and
+    // indefinite ones interleaved, over several full blocks of lanes and a padded tail
+    static constexpr uint32_t WINDOW_SIZE = 8U;
+    const size_t system_count = (3U * NEDI_LANES) + 5U;
+    std::mt19937 random(35U);
+    std::uniform_real_distribution<double> entry(-1.0, 1.0);
+    std::uniform_int_distribution<int> integer(-3, 3);
+
+    NediSystemBatch batch;
+    batch.resize(system_count);
+    std::vector<Eigen::Matrix4d> matrices(system_count);
+    std::vector<Eigen::Vector4d> rhs(system_count);
+    for (size_t lane = 0; lane < system_count; lane++) {
+        Eigen::Matrix4d& matrix = matrices[lane];
+        if (lane % 5U == 2U) {
+            const Eigen::Vector4d v(1.0, integer(random), integer(random), integer(random));
+            matrix = v * v.transpose();
+        } else if (lane % 7U == 4U) {
+            matrix = Eigen::Vector4d(1.0, -1.0, 2.0, 3.0).asDiagonal();
+        } else {
+            Eigen::Matrix4d a;
+            for (int i = 0; i < 16; i++) { a(i / 4, i % 4) = entry(random); }
+            matrix = (a.transpose() * a) + Eigen::Matrix4d::Identity();
+        }
+        for (int i = 0; i < 4; i++) { rhs[lane](i) = entry(random); }
+
+        // Round to the floats the batch holds, so that both solvers see the same systems
+        for (size_t row = 0; row < 4; row++) {
+            for (size_t col = row; col < 4; col++) {
+                const float value = float(matrix(row, col));
+                batch.covariance[covarianceTerm(row, col)][lane] = value;
+                matrix(row, col) = matrix(col, row) = double(value);
+            }
+            batch.rhs[row][lane] = float(rhs[lane](row));
+            rhs[lane](row) = double(batch.rhs[row][lane]);
+        }
+    }
+    solveNediBatch(batch, WINDOW_SIZE);
+
+    size_t definite_lanes = 0U;
+    for (size_t lane = 0; lane < batch.condition_squared.size(); lane++) {
+        INFO("lane " << lane);
+        if (lane >= system_count) {
+            CHECK(std::isnan(batch.condition_squared[lane])); // Zeroed padding
+            continue;
+        }
+        const Eigen::LLT<Eigen::Matrix4d> cholesky(matrices[lane]);
+        if (cholesky.info() != Eigen::Success) {
+            for (size_t row = 0; row < 4; row++) { CHECK(std::isnan(batch.weights[row][lane])); }
+            CHECK(std::isnan(batch.condition_squared[lane]));
+            continue;
+        }
+        definite_lanes++;
+        const Eigen::Vector4d weights = cholesky.solve(rhs[lane]);
+        for (size_t row = 0; row < 4; row++) {
+            CHECK(std::abs(double(batch.weights[row][lane]) - weights(row)) < 1e-4 * std::max(1.0, std::abs(weights(row))));
+        }
+        const double condition = matrices[lane].norm() * matrices[lane].inverse().norm() / double(WINDOW_SIZE * WINDOW_SIZE);
+        CHECK(std::abs(double(batch.condition_squared[lane]) - (condition * condition)) < 1e-4 * condition * condition);
+    }
+    CHECK(definite_lanes > 2U * NEDI_LANES);
+}
+
+// Run explicitly (fin-proj-tests "[update]") after an intentional change to a reference scaler
+TEST_CASE("Regenerate golden manifest", "[.][update]") {
+    std::ofstream manifest(manifest_path);
+    manifest << "# <algorithm> <input> <factor> <width> <height> <FNV-1a 64 of width, height and RGB8 pixels>\n";
+    for (const Engine& engine : referenceEngines()) {
+        for (const std::string& filename : inputFiles()) {
+            for (uint32_t factor : goldenFactors(engine.algorithm)) {
+                QuantizedImage output = engine.run(data_dir_path / (filename + ".png"), factor);
+                manifest << engine.algorithm << " " << filename << " " << factor << " "
+                         << output.width << " " << output.height << " " << std::hex << fnv1a(output) << std::dec << "\n";
+
+                if (isTolerant(engine.algorithm)) {
+                    Image<glm::uvec3> golden_image(output.width, output.height);
+                    for (size_t i = 0; i < golden_image.data.size(); i++) {
+                        golden_image.data[i] = { output.rgb[i * 3], output.rgb[i * 3 + 1], output.rgb[i * 3 + 2] };
+                    }
+                    golden_image.writeToFile(goldenImagePath(engine.algorithm, filename, factor));
+                }
+            }
+        }
+    }
+}
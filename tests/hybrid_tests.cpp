@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/common.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "hybrid.hpp"
+#include "scaler_registry.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+
+static const std::vector<std::string> HYBRID_FILES = { "X1-3_X_Idle", "smw_bowser_input", "Sonic_screech" };
+
+static TileClass classOf(const Image<glm::uvec3>& image) { return classifyTile(tileStatistics(image, { glm::ivec2(0), glm::ivec2(image.width, image.height) })); }
+
+TEST_CASE("Tiles are classified by palette, edges and gradients", "[hybrid]") {
+    Image<glm::uvec3> tile(8, 8);
+    for (glm::uvec3& pixel : tile.data) { pixel = glm::uvec3(200, 40, 40); }
+    CHECK(classOf(tile) == TILE_FLAT);
+
+    for (int y = 0; y < 8; y++) { for (int x = 4; x < 8; x++) { tile.data[tile.getImageOffset(x, y)] = glm::uvec3(0); } }
+    for (int x = 0; x < 8; x++) { tile.data[tile.getImageOffset(x, 6)] = glm::uvec3(255); }
+    CHECK(classOf(tile) == TILE_AXIS_ALIGNED);
+
+    for (int i = 0; i < 8; i++) { tile.data[tile.getImageOffset(i, i)] = glm::uvec3(0, 0, 255); }
+    CHECK(classOf(tile) == TILE_DIAGONAL);
+
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) { tile.data[tile.getImageOffset(x, y)] = glm::uvec3(100 + 3 * x + 2 * y, 80 + 2 * x, 60); }
+    }
+    CHECK(classOf(tile) == TILE_GRADIENT);
+
+    // Few colours are never a gradient, however small their steps
+    for (int y = 0; y < 8; y++) { for (int x = 0; x < 8; x++) { tile.data[tile.getImageOffset(x, y)] = glm::uvec3(100 + (x / 2), 80, 60); } }
+    CHECK(classOf(tile) == TILE_AXIS_ALIGNED);
+}
+
+TEST_CASE("Hybrid configurations name an algorithm per class", "[hybrid]") {
+    const std::optional<HybridConfig> config = parseHybridConfig("diagonal=hq2x,gradient=xbr");
+    REQUIRE(config);
+    CHECK(config->scalers[TILE_FLAT] == findScaler("epx"));
+    CHECK(config->scalers[TILE_DIAGONAL] == findScaler("hq2x"));
+    CHECK(config->scalers[TILE_GRADIENT] == findScaler("xbr"));
+    CHECK(parseHybridConfig("")->scalers == defaultHybridConfig().scalers);
+    CHECK_FALSE(parseHybridConfig("diagonal=bilinear"));
+    CHECK_FALSE(parseHybridConfig("round=epx"));
+    CHECK_FALSE(parseHybridConfig("flat"));
+
+    // Every setting changes the key of the results
+    const std::string key = hybridConfigKey(defaultHybridConfig());
+    CHECK(hybridConfigKey(*parseHybridConfig("")) == key);
+    CHECK(hybridConfigKey(*config) != key);
+    HybridConfig resized = defaultHybridConfig();
+    resized.tile_size *= 2;
+    CHECK(hybridConfigKey(resized) != key);
+    HybridConfig unblended = defaultHybridConfig();
+    unblended.blend_width = 0;
+    CHECK(hybridConfigKey(unblended) != key);
+}
+
+TEST_CASE("Hybrid scaling without blending matches the algorithm of every tile", "[hybrid]") {
+    HybridConfig config = *parseHybridConfig("gradient=hq2x");
+    config.blend_width = 0;
+    for (const std::string& filename : HYBRID_FILES) {
+        INFO(filename);
+        const Image<glm::uvec3> input(data_dir_path / (filename + ".png"));
+        std::array<Image<glm::uvec3>, TILE_CLASS_COUNT> full;
+        for (size_t tile_class = 0; tile_class < TILE_CLASS_COUNT; tile_class++) { full[tile_class] = config.scalers[tile_class]->scale_chain(input, 1U); }
+
+        HybridStats stats;
+        const Image<glm::uvec3> hybrid = scaleHybrid(input, config, &stats);
+        REQUIRE(hybrid.width == input.width * 2);
+        REQUIRE(hybrid.height == input.height * 2);
+        const size_t tile_count = size_t((input.width + config.tile_size - 1) / config.tile_size) * size_t((input.height + config.tile_size - 1) / config.tile_size);
+        CHECK(std::accumulate(stats.tiles.begin(), stats.tiles.end(), size_t(0)) == tile_count);
+        CHECK(stats.seconds > 0.0);
+
+        size_t mismatches = 0U;
+        for (int y = 0; y < hybrid.height; y++) {
+            for (int x = 0; x < hybrid.width; x++) {
+                const glm::ivec2 tile = glm::ivec2(x, y) / (2 * config.tile_size);
+                const PixelRect core = { tile * config.tile_size, glm::min((tile + 1) * config.tile_size, glm::ivec2(input.width, input.height)) };
+                const TileClass tile_class = classifyTile(tileStatistics(input, core));
+                if (hybrid.data[hybrid.getImageOffset(x, y)] != full[tile_class].data[hybrid.getImageOffset(x, y)]) { mismatches++; }
+            }
+        }
+        CHECK(mismatches == 0U);
+    }
+}
+
+TEST_CASE("Hybrid seams blend both algorithms symmetrically", "[hybrid]") {
+    // Two flat halves with a diagonal staircase on the right, so that the tiles on the left use EPX and the others xBR
+    Image<glm::uvec3> input(32, 16);
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 32; x++) { input.data[input.getImageOffset(x, y)] = (x >= 16 && x - 16 > y) ? glm::uvec3(250, 220, 10) : glm::uvec3(20, 30, 120); }
+    }
+    HybridConfig config = defaultHybridConfig();
+    config.tile_size = 16;
+    const Image<glm::uvec3> epx = config.scalers[TILE_FLAT]->scale_chain(input, 1U);
+    const Image<glm::uvec3> xbr = config.scalers[TILE_DIAGONAL]->scale_chain(input, 1U);
+    HybridStats stats;
+    const Image<glm::uvec3> hybrid = scaleHybrid(input, config, &stats);
+    CHECK(stats.tiles[TILE_FLAT] == 1U);
+    CHECK(stats.tiles[TILE_DIAGONAL] == 1U);
+
+    for (int y = 0; y < hybrid.height; y++) {
+        for (int x = 0; x < hybrid.width; x++) {
+            INFO(x << "," << y);
+            const size_t offset = hybrid.getImageOffset(x, y);
+            const int distance = x < 32 ? 31 - x : x - 32; // From the border between the tiles, in output pixels
+            if (distance >= config.blend_width) {
+                CHECK(hybrid.data[offset] == (x < 32 ? epx.data[offset] : xbr.data[offset]));
+                continue;
+            }
+            const float own = 0.5f + (float(distance) + 0.5f) / float(2 * config.blend_width);
+            const glm::vec3 expected = x < 32 ? glm::vec3(epx.data[offset]) * own + glm::vec3(xbr.data[offset]) * (1.0f - own)
+                                              : glm::vec3(xbr.data[offset]) * own + glm::vec3(epx.data[offset]) * (1.0f - own);
+            CHECK(hybrid.data[offset] == glm::uvec3(glm::round(expected)));
+        }
+    }
+}
+
+TEST_CASE("Hybrid scaling with one algorithm is that algorithm", "[hybrid]") {
+    const HybridConfig config = *parseHybridConfig("flat=hq2x,axis-aligned=hq2x,diagonal=hq2x,gradient=hq2x");
+    const Image<glm::uvec3> input(data_dir_path / "smw_bowser_input.png");
+    HybridStats stats;
+    CHECK(scaleHybrid(input, config, &stats).data == findScaler("hq2x")->scale_chain(input, 1U).data);
+    CHECK(std::accumulate(stats.tiles.begin(), stats.tiles.end(), size_t(0)) > 0U);
+}
@@ -0,0 +1,391 @@
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "kl_pixel_graph.hpp"
+#include "kl_rasterizer.hpp"
+#include "kl_shapes.hpp"
+#include "kl_similarity_graph.hpp"
+#include "kl_splines.hpp"
+
+static const glm::uvec3 DARK(0U, 0U, 0U);
+static const glm::uvec3 LIGHT(255U, 255U, 255U);
+
+/**
+ * Build an image from rows of characters, where '#' is a dark pixel and anything else a light one
+*/
+static Image<glm::uvec3> imageFromRows(const std::vector<std::string>& rows) {
+    Image<glm::uvec3> image(int(rows[0].size()), int(rows.size()));
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) { image.data[image.getImageOffset(x, y)] = (rows[y][x] == '#') ? DARK : LIGHT; }
+    }
+    return image;
+}
+
+static bool isSymmetric(const SimilarityGraph& graph) {
+    for (int y = 0; y < graph.height; y++) {
+        for (int x = 0; x < graph.width; x++) {
+            for (uint8_t direction = 0U; direction < 8U; direction++) {
+                if (!graph.connected(x, y, direction)) { continue; }
+                glm::ivec2 neighbour = glm::ivec2(x, y) + NEIGHBOUR_OFFSETS[direction];
+                if (!graph.connected(neighbour.x, neighbour.y, oppositeDirection(direction))) { return false; }
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE("Similarity graph drops the diagonals of fully connected blocks", "[kopf_lischinski]") {
+    SimilarityGraph graph = computeSimilarityGraph(imageFromRows({ "..", ".." }));
+    CHECK(graph.connections[graph.getOffset(0, 0)] == (directionBit(EAST) | directionBit(SOUTH)));
+    CHECK(graph.connections[graph.getOffset(1, 1)] == (directionBit(WEST) | directionBit(NORTH)));
+    CHECK(isSymmetric(graph));
+}
+
+TEST_CASE("Similarity graph removes both diagonals of a tied checkerboard block", "[kopf_lischinski]") {
+    SimilarityGraph graph = computeSimilarityGraph(imageFromRows({ "#.", ".#" }));
+    for (uint8_t connections : graph.connections) { CHECK(connections == 0U); }
+}
+
+TEST_CASE("Similarity graph keeps the long diagonal curve over the sparse background", "[kopf_lischinski]") {
+    SimilarityGraph graph = computeSimilarityGraph(imageFromRows({
+        "#.....",
+        ".#....",
+        "..#...",
+        "...#..",
+        "....#.",
+        ".....#" }));
+    for (int i = 0; i < 5; i++) {
+        CHECK(graph.connected(i, i, SOUTH_EAST));
+        CHECK_FALSE(graph.connected(i + 1, i, SOUTH_WEST));
+    }
+    CHECK(isSymmetric(graph));
+}
+
+TEST_CASE("Similarity graphs of all inputs are symmetric and planar", "[kopf_lischinski]") {
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path { DATA_DIR })) {
+        INFO(entry.path().filename().string());
+        SimilarityGraph graph = computeSimilarityGraph(Image<glm::uvec3>(entry.path()));
+        CHECK(isSymmetric(graph));
+        int crossings = 0;
+        for (int y = 0; y < graph.height - 1; y++) {
+            for (int x = 0; x < graph.width - 1; x++) {
+                if (graph.connected(x, y, SOUTH_EAST) && graph.connected(x + 1, y, SOUTH_WEST)) { crossings++; }
+            }
+        }
+        CHECK(crossings == 0);
+    }
+}
+
+static bool isSymmetric(const PixelCellGraph& graph) {
+    for (int y = 0; y <= graph.height; y++) {
+        for (int x = 0; x <= graph.width; x++) {
+            for (uint32_t slot = 0U; slot < CELL_VERTEX_SLOTS; slot++) {
+                const glm::ivec2 vertex = PixelCellGraph::slotVertex(glm::ivec2(x, y), slot);
+                for (size_t direction = 0; direction < CELL_EDGE_OFFSETS.size(); direction++) {
+                    if (!(graph.edgeMask(vertex) & (1U << direction))) { continue; }
+                    if (!(graph.edgeMask(vertex + CELL_EDGE_OFFSETS[direction]) & (1U << (direction ^ 1U)))) { return false; }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE("Pixel cell graph without diagonals is the regular lattice", "[kopf_lischinski]") {
+    const Image<glm::uvec3> image = imageFromRows({ "#..", "#..", "#.." });
+    const PixelCellGraph graph = computePixelCellGraph(image, computeSimilarityGraph(image));
+    for (int y = 0; y <= graph.height; y++) {
+        for (int x = 0; x <= graph.width; x++) {
+            const int borders = int(x == 0 || x == graph.width) + int(y == 0 || y == graph.height);
+            CHECK(graph.valence(glm::ivec2(x, y) * QUARTERS_PER_PIXEL) == 4 - borders);
+            for (uint32_t slot = 1U; slot < CELL_VERTEX_SLOTS; slot++) { CHECK_FALSE(graph.present(PixelCellGraph::slotVertex(glm::ivec2(x, y), slot))); }
+        }
+    }
+    CHECK(graph.cellCorners(1, 1) == std::vector<glm::ivec2> { glm::ivec2(4, 4), glm::ivec2(8, 4), glm::ivec2(4, 8), glm::ivec2(8, 8) });
+}
+
+TEST_CASE("Pixel cell graph joins the cells of diagonally connected pixels", "[kopf_lischinski]") {
+    // Dark diagonal between a red and a blue pixel: the centre vertex splits into the two quadrants off the diagonal
+    Image<glm::uvec3> image(2, 2);
+    image.data = { DARK, glm::uvec3(255U, 0U, 0U), glm::uvec3(0U, 0U, 255U), DARK };
+    const PixelCellGraph graph = computePixelCellGraph(image, computeSimilarityGraph(image));
+    CHECK(isSymmetric(graph));
+
+    const glm::ivec2 north_east(5, 3), south_west(3, 5);
+    CHECK(PixelCellGraph::position(north_east) == glm::dvec2(1.25, 0.75));
+    CHECK_FALSE(graph.present(glm::ivec2(4, 4)));
+    CHECK(graph.edgeMask(north_east) == ((1U << cellEdgeDirection(south_west - north_east)) | (1U << cellEdgeDirection(glm::ivec2(4, 0) - north_east)) |
+                                         (1U << cellEdgeDirection(glm::ivec2(8, 4) - north_east))));
+    CHECK(graph.valence(south_west) == 3);
+    CHECK(graph.valence(glm::ivec2(4, 0)) == 3);
+
+    CHECK(graph.cellCorners(0, 0) == std::vector<glm::ivec2> { glm::ivec2(0, 0), glm::ivec2(4, 0), glm::ivec2(0, 4), north_east, south_west });
+    CHECK(graph.cellCorners(1, 0) == std::vector<glm::ivec2> { glm::ivec2(4, 0), glm::ivec2(8, 0), north_east, glm::ivec2(8, 4) });
+    CHECK(graph.cellCorners(1, 1) == std::vector<glm::ivec2> { north_east, south_west, glm::ivec2(8, 4), glm::ivec2(4, 8), glm::ivec2(8, 8) });
+}
+
+TEST_CASE("Collapsing an unrepresentable edge throws after the parallel sweep", "[kopf_lischinski]") {
+    // A straight chain over two pixels, whose middle vertex has valence two and would join both image corners directly
+    PixelCellGraph graph { 2, 1, std::vector<std::array<uint32_t, CELL_VERTEX_SLOTS>>(6U), {} };
+    graph.edges[graph.latticeOffset(0, 0)][0] = 1U << 0U;
+    graph.edges[graph.latticeOffset(1, 0)][0] = (1U << 0U) | (1U << 1U);
+    graph.edges[graph.latticeOffset(2, 0)][0] = 1U << 1U;
+    CHECK_THROWS(collapseValenceTwo(graph));
+}
+
+TEST_CASE("Pixel cell graphs of all inputs are symmetric and fully collapsed", "[kopf_lischinski]") {
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path { DATA_DIR })) {
+        INFO(entry.path().filename().string());
+        const Image<glm::uvec3> image(entry.path());
+        const PixelCellGraph graph = computePixelCellGraph(image, computeSimilarityGraph(image));
+        CHECK(isSymmetric(graph));
+
+        size_t low_valence = 0U, missing_corners = 0U, small_cells = 0U;
+        for (int y = 0; y <= graph.height; y++) {
+            for (int x = 0; x <= graph.width; x++) {
+                for (uint32_t slot = 0U; slot < CELL_VERTEX_SLOTS; slot++) {
+                    const glm::ivec2 vertex = PixelCellGraph::slotVertex(glm::ivec2(x, y), slot);
+                    const bool image_corner = slot == 0U && (x == 0 || x == graph.width) && (y == 0 || y == graph.height);
+                    if (graph.present(vertex) && !image_corner && graph.valence(vertex) <= 2) { low_valence++; }
+                }
+            }
+        }
+        for (int y = 0; y < graph.height; y++) {
+            for (int x = 0; x < graph.width; x++) {
+                const std::vector<glm::ivec2> corners = graph.cellCorners(x, y);
+                for (const glm::ivec2& corner : corners) { missing_corners += !graph.present(corner); }
+                small_cells += corners.size() < 2U;
+            }
+        }
+        CHECK(low_valence == 0U);
+        CHECK(missing_corners == 0U);
+        CHECK(small_cells == 0U);
+    }
+}
+
+// Reference labelling by a flood fill of the similarity graph
+static std::vector<uint32_t> floodFillLabels(const SimilarityGraph& graph) {
+    std::vector<uint32_t> labels(graph.connections.size(), UINT32_MAX);
+    uint32_t shapes = 0U;
+    for (size_t start = 0; start < labels.size(); start++) {
+        if (labels[start] != UINT32_MAX) { continue; }
+        std::vector<size_t> stack = { start };
+        labels[start] = shapes;
+        while (!stack.empty()) {
+            const glm::ivec2 pixel(int(stack.back() % size_t(graph.width)), int(stack.back() / size_t(graph.width)));
+            stack.pop_back();
+            for (uint8_t direction = 0U; direction < 8U; direction++) {
+                if (!graph.connected(pixel.x, pixel.y, direction)) { continue; }
+                const glm::ivec2 neighbour = pixel + NEIGHBOUR_OFFSETS[direction];
+                const size_t offset = graph.getOffset(neighbour.x, neighbour.y);
+                if (labels[offset] == UINT32_MAX) {
+                    labels[offset] = shapes;
+                    stack.push_back(offset);
+                }
+            }
+        }
+        shapes++;
+    }
+    return labels;
+}
+
+static int64_t doubledArea(const std::vector<glm::ivec2>& outline) {
+    int64_t area = 0;
+    for (size_t i = 0; i < outline.size(); i++) {
+        const glm::ivec2 from = outline[i], to = outline[(i + 1) % outline.size()];
+        area += (int64_t(from.x) * to.y) - (int64_t(to.x) * from.y);
+    }
+    return area;
+}
+
+TEST_CASE("Shape labelling merges components across tiles", "[kopf_lischinski]") {
+    // Dark diagonal line through three tiles, splitting the light background in two
+    std::vector<std::string> rows(70, std::string(70, '.'));
+    for (size_t i = 0; i < rows.size(); i++) { rows[i][i] = '#'; }
+    const SimilarityGraph similarity = computeSimilarityGraph(imageFromRows(rows));
+    const ShapeLabels labels = labelShapes(similarity);
+    REQUIRE(labels.shapeCount() == 3U);
+    CHECK(labels.first_pixels == std::vector<uint32_t> { 0U, 1U, 70U });
+    for (int i = 0; i < 70; i++) { CHECK(labels.label(i, i) == 0U); }
+    CHECK(labels.label(69, 0) == 1U);
+    CHECK(labels.label(0, 69) == 2U);
+    CHECK(labelShapes(similarity, 1).labels == labels.labels);
+
+    const ShapeLabels checkerboard = labelShapes(computeSimilarityGraph(imageFromRows({ "#.", ".#" })));
+    CHECK(checkerboard.labels == std::vector<uint32_t> { 0U, 1U, 2U, 3U });
+}
+
+TEST_CASE("Shape outlines of a ring have a hole", "[kopf_lischinski]") {
+    const Image<glm::uvec3> image = imageFromRows({ "###", "#.#", "###" });
+    const SimilarityGraph similarity = computeSimilarityGraph(image);
+    const std::vector<PixelShape> shapes = computePixelShapes(image, similarity, computePixelCellGraph(image, similarity));
+    REQUIRE(shapes.size() == 2U);
+
+    CHECK(shapes[0].value == DARK);
+    REQUIRE(shapes[0].outer.size() == 1U);
+    REQUIRE(shapes[0].inner.size() == 1U);
+    CHECK(doubledArea(shapes[0].outer[0]) == 2 * 12 * 12);
+    CHECK(doubledArea(shapes[0].inner[0]) == -2 * 2 * 2); // The dark diagonals around the hole cut its corners
+    CHECK(shapes[0].outer[0].size() == 12U); // Every lattice vertex on the border of the image
+
+    CHECK(shapes[1].value == LIGHT);
+    REQUIRE(shapes[1].outer.size() == 1U);
+    CHECK(shapes[1].inner.empty());
+    CHECK(shapes[1].outer[0] == std::vector<glm::ivec2> { glm::ivec2(5, 5), glm::ivec2(7, 5), glm::ivec2(7, 7), glm::ivec2(5, 7) });
+}
+
+TEST_CASE("Shape outlines that are not closed throw after the parallel tracing", "[kopf_lischinski]") {
+    const Image<glm::uvec3> image = imageFromRows({ "###", "#.#", "###" });
+    const SimilarityGraph similarity = computeSimilarityGraph(image);
+    PixelCellGraph graph = computePixelCellGraph(image, similarity);
+    graph.corners[0] |= 1U << (CELL_CORNER_BITS + 2U); // A stray quadrant vertex at the top right of the top left cell
+    CHECK_THROWS(traceShapeOutlines(image, graph, labelShapes(similarity)));
+}
+
+TEST_CASE("Shape outlines of all inputs tile the image", "[kopf_lischinski]") {
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path { DATA_DIR })) {
+        INFO(entry.path().filename().string());
+        const Image<glm::uvec3> image(entry.path());
+        const SimilarityGraph similarity = computeSimilarityGraph(image);
+        const PixelCellGraph graph = computePixelCellGraph(image, similarity);
+        const ShapeLabels labels = labelShapes(similarity);
+        CHECK(labels.labels == floodFillLabels(similarity));
+
+        // Outlines run along the edges of the cell graph and enclose every cell exactly once
+        const std::vector<PixelShape> shapes = traceShapeOutlines(image, graph, labels);
+        REQUIRE(shapes.size() == labels.shapeCount());
+        int64_t total_area = 0;
+        size_t missing_edges = 0U, shapes_without_outline = 0U;
+        for (const PixelShape& shape : shapes) {
+            shapes_without_outline += shape.outer.empty();
+            for (const auto* outlines : { &shape.outer, &shape.inner }) {
+                for (const std::vector<glm::ivec2>& outline : *outlines) {
+                    total_area += doubledArea(outline);
+                    for (size_t i = 0; i < outline.size(); i++) {
+                        const int direction = cellEdgeDirection(outline[(i + 1) % outline.size()] - outline[i]);
+                        missing_edges += direction < 0 || !(graph.edgeMask(outline[i]) & (1U << direction));
+                    }
+                }
+            }
+        }
+        CHECK(missing_edges == 0U);
+        CHECK(shapes_without_outline == 0U);
+        CHECK(total_area == 2 * int64_t(image.width * QUARTERS_PER_PIXEL) * int64_t(image.height * QUARTERS_PER_PIXEL));
+    }
+}
+
+TEST_CASE("Analytic segment curvature energy matches numerical integration", "[kopf_lischinski]") {
+    ClosedBSpline spline({ glm::dvec2(0.0, 0.0), glm::dvec2(2.0, 0.5), glm::dvec2(3.0, 2.0), glm::dvec2(1.0, 3.0), glm::dvec2(-0.5, 1.5) });
+    const double knot_spacing = 1.0 / double(spline.size() + 4U);
+    for (size_t segment = 0; segment < spline.size(); segment++) {
+        const glm::dvec2 p0 = spline.point(segment), p1 = spline.point(segment + 1), p2 = spline.point(segment + 2);
+        auto curvature = [&](double t) {
+            glm::dvec2 d1 = ((t - 1.0) * p0) + ((1.0 - 2.0 * t) * p1) + (t * p2);
+            glm::dvec2 d2 = p0 - (2.0 * p1) + p2;
+            return std::abs((d1.x * d2.y) - (d1.y * d2.x)) / std::pow(glm::length(d1), 3.0);
+        };
+        constexpr int intervals = 20000;
+        double numerical = 0.5 * (curvature(0.0) + curvature(1.0));
+        for (int i = 1; i < intervals; i++) { numerical += curvature(double(i) / intervals); }
+        numerical *= knot_spacing / intervals;
+        CHECK(std::abs(spline.segmentCurvatureEnergy(segment) - numerical) < 1e-6);
+    }
+}
+
+TEST_CASE("Bezier segments of a closed spline form a closed chain", "[kopf_lischinski]") {
+    ClosedBSpline spline({ glm::dvec2(0.0, 0.0), glm::dvec2(4.0, 0.0), glm::dvec2(4.0, 4.0), glm::dvec2(0.0, 4.0) });
+    std::vector<QuadraticBezier> segments = spline.quadraticBezierSegments();
+    REQUIRE(segments.size() == 4U);
+    for (size_t i = 0; i < segments.size(); i++) { CHECK(segments[i].end == segments[(i + 1) % segments.size()].start); }
+    CHECK(segments[0].start == glm::dvec2(2.0, 0.0));
+}
+
+TEST_CASE("Parallel spline smoothing is deterministic and reduces curvature", "[kopf_lischinski]") {
+    std::vector<ClosedBSpline> splines;
+    for (int i = 0; i < 8; i++) {
+        std::vector<glm::dvec2> staircase;
+        for (int step = 0; step < 6; step++) {
+            staircase.emplace_back(double(step + i), double(step));
+            staircase.emplace_back(double(step + i + 1), double(step));
+        }
+        staircase.emplace_back(double(i), 6.0);
+        splines.emplace_back(staircase);
+    }
+    std::vector<ClosedBSpline> first = splines, second = splines;
+    smoothSplines(first, 42U);
+    smoothSplines(second, 42U);
+
+    for (size_t i = 0; i < splines.size(); i++) {
+        double energy_before = 0.0, energy_after = 0.0;
+        for (size_t point = 0; point < splines[i].size(); point++) {
+            CHECK(first[i].point(point) == second[i].point(point));
+            energy_before   += splines[i].segmentCurvatureEnergy(point);
+            energy_after    += first[i].segmentCurvatureEnergy(point);
+        }
+        CHECK(energy_after < energy_before);
+    }
+}
+
+TEST_CASE("Rasteriser computes analytic coverage of straight edges", "[kopf_lischinski]") {
+    // Square covering [0.5, 1.5]^2 of a 2x2 source image, drawn black over white
+    VectorShapeSet shape_set = parseSvgShapes(R"svg(<svg><path d="M 5,5 L 15,5 L 15,15 L 5,15 Z" fill="rgb(0,0,0)" /></svg>)svg", 2, 2);
+    REQUIRE(shape_set.shapes.size() == 1U);
+    REQUIRE(shape_set.shapes[0].outlines.size() == 1U);
+
+    Image<glm::vec3> unit = rasterizeShapes<glm::vec3>(shape_set, 1.0);
+    for (const glm::vec3& pixel : unit.data) { CHECK(std::abs(pixel.x - 0.75f) < 1e-5f); }
+
+    Image<glm::uvec3> scaled = rasterizeShapes<glm::uvec3>(shape_set, 4.0);
+    REQUIRE(scaled.width == 8);
+    for (int y = 0; y < scaled.height; y++) {
+        for (int x = 0; x < scaled.width; x++) {
+            bool inside = x >= 2 && x < 6 && y >= 2 && y < 6;
+            CHECK(scaled.data[scaled.getImageOffset(x, y)] == (inside ? DARK : LIGHT));
+        }
+    }
+}
+
+TEST_CASE("Rasteriser reuses one shape set across factors", "[kopf_lischinski]") {
+    std::vector<glm::dvec2> octagon;
+    for (int i = 0; i < 8; i++) {
+        double angle = double(i) * std::numbers::pi / 4.0;
+        octagon.emplace_back(4.0 + 3.0 * std::cos(angle), 4.0 + 3.0 * std::sin(angle));
+    }
+    VectorShape shape { glm::vec3(0.0f), { ClosedBSpline(octagon).quadraticBezierSegments() }, {}, {} };
+    updateBounds(shape);
+    VectorShapeSet shape_set { 8, 8, { shape } };
+
+    // Exact enclosed area from Green's theorem, integrated numerically along every curve
+    double exact_area = 0.0;
+    for (const QuadraticBezier& curve : shape.outlines[0]) {
+        constexpr int samples = 1000;
+        for (int i = 0; i < samples; i++) {
+            double t = (double(i) + 0.5) / samples;
+            glm::dvec2 point    = ((1.0 - t) * (1.0 - t) * curve.start) + (2.0 * (1.0 - t) * t * curve.control) + (t * t * curve.end);
+            glm::dvec2 tangent  = (2.0 * (1.0 - t) * (curve.control - curve.start)) + (2.0 * t * (curve.end - curve.control));
+            exact_area += 0.5 * ((point.x * tangent.y) - (point.y * tangent.x)) / samples;
+        }
+    }
+
+    // Polyline flattening loses at most the tolerance (in output pixels) along the ~19 pixel perimeter
+    std::vector<double> factors = { 1.0, 2.0, 3.5, 8.0 };
+    std::vector<Image<glm::vec3>> images = rasterizeShapes<glm::vec3>(shape_set, factors);
+    REQUIRE(images.size() == factors.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        double area = 0.0;
+        for (const glm::vec3& pixel : images[i].data) { area += 1.0 - pixel.x; }
+        area /= factors[i] * factors[i];
+        CHECK(std::abs(area - exact_area) < FLATTENING_TOLERANCE * 20.0 / factors[i]);
+    }
+}
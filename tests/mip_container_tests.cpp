@@ -0,0 +1,132 @@
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/codecs.h>
+#include <framework/image.h>
+#include <framework/mip_container.h>
+
+#include "mip_writer.hpp"
+#include "xbr.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path mip_dir_path { std::filesystem::temp_directory_path() / "fin-proj-mip-tests" };
+
+static std::vector<uint8_t> toRgb8(const Image<glm::uvec3>& image) {
+    std::vector<uint8_t> rgb(image.data.size() * 3U);
+    for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8(&rgb[i * 3U], image.data[i]); }
+    return rgb;
+}
+
+// Chain of xBR outputs of an input, the input itself being the first
+static std::vector<Image<glm::uvec3>> xbrChain(const std::string& filename, size_t levels) {
+    std::vector<Image<glm::uvec3>> chain = { Image<glm::uvec3>(data_dir_path / (filename + ".png")) };
+    while (chain.size() < levels) { chain.push_back(scaleXbr(chain.back())); }
+    return chain;
+}
+
+TEST_CASE("Mip containers hold every level written, in any order", "[mip]") {
+    std::filesystem::remove_all(mip_dir_path);
+    const std::vector<Image<glm::uvec3>> chain = xbrChain("sma_chest_input", 4U);
+    for (const MipCodec codec : { MIP_CODEC_RAW, MIP_CODEC_QOI }) {
+        INFO(codec);
+        const std::filesystem::path path = mip_dir_path / ("chain" + std::to_string(codec) + ".pxm");
+        {
+            MipContainerWriter writer(path, { 1U, 2U, 4U, 8U }, codec);
+            for (const size_t level : { 2U, 0U, 3U, 1U }) { writer.writeLevel(level, chain[level]); }
+        }
+
+        const MipContainer container(path);
+        CHECK(container.codec == codec);
+        REQUIRE(container.levels.size() == chain.size());
+        for (size_t level = 0; level < chain.size(); level++) {
+            const MipLevel* found = container.findLevel(1U << level);
+            REQUIRE(found == &container.levels[level]);
+            CHECK(found->width == chain[level].width);
+            CHECK(found->height == chain[level].height);
+            CHECK(found->offset % MIP_ALIGNMENT == 0U);
+            const Rgb8Pixels pixels = container.decodeLevel(*found);
+            CHECK(pixels.width == chain[level].width);
+            CHECK(pixels.height == chain[level].height);
+            CHECK(pixels.rgb == toRgb8(chain[level]));
+            if (codec == MIP_CODEC_RAW) {
+                // Raw levels are used in place, without decoding
+                const std::vector<uint8_t> rgb = toRgb8(chain[level]);
+                CHECK(std::vector<uint8_t>(container.levelData(*found), container.levelData(*found) + found->size) == rgb);
+            }
+        }
+        CHECK(container.findLevel(16U) == nullptr);
+    }
+    CHECK(std::filesystem::file_size(mip_dir_path / ("chain" + std::to_string(MIP_CODEC_QOI) + ".pxm"))
+          < std::filesystem::file_size(mip_dir_path / ("chain" + std::to_string(MIP_CODEC_RAW) + ".pxm")));
+}
+
+TEST_CASE("Partly written mip containers miss the levels not written yet", "[mip]") {
+    std::filesystem::create_directories(mip_dir_path);
+    const std::filesystem::path path = mip_dir_path / "partial.pxm";
+    const std::vector<Image<glm::uvec3>> chain = xbrChain("X1-3_X_Idle", 2U);
+    MipContainerWriter writer(path, { 2U, 4U, 8U }, MIP_CODEC_RAW);
+    CHECK(MipContainer(path).findLevel(2U) == nullptr);
+
+    writer.writeLevel(1U, chain[1]);
+    const MipContainer container(path);
+    REQUIRE(container.levels.size() == 3U);
+    CHECK_FALSE(container.levels[0].written());
+    CHECK(container.levels[0].factor == 2U);
+    CHECK(container.findLevel(2U) == nullptr);
+    REQUIRE(container.findLevel(4U) != nullptr);
+    CHECK(container.decodeLevel(*container.findLevel(4U)).rgb == toRgb8(chain[1]));
+    CHECK(container.findLevel(8U) == nullptr);
+    CHECK_THROWS(writer.writeLevel(1U, chain[1]));
+    CHECK_THROWS(writer.writeLevel(3U, chain[1]));
+}
+
+TEST_CASE("Malformed mip containers are rejected", "[mip]") {
+    std::filesystem::create_directories(mip_dir_path);
+    const std::filesystem::path path = mip_dir_path / "malformed.pxm";
+    const std::vector<Image<glm::uvec3>> chain = xbrChain("X1-3_X_Idle", 1U);
+    {
+        MipContainerWriter writer(path, { 1U }, MIP_CODEC_RAW);
+        writer.writeLevel(0U, chain[0]);
+    }
+    const std::vector<uint8_t> bytes = readFileBytes(path);
+    REQUIRE_NOTHROW(MipContainer(path));
+
+    CHECK_THROWS(MipContainer(mip_dir_path / "missing.pxm"));
+
+    std::vector<uint8_t> corrupted = bytes;
+    corrupted[0] = 'x';
+    writeFileBytes(path, corrupted);
+    CHECK_THROWS(MipContainer(path));
+
+    corrupted = bytes;
+    corrupted[4] = 2U; // Version
+    writeFileBytes(path, corrupted);
+    CHECK_THROWS(MipContainer(path));
+
+    corrupted = bytes;
+    corrupted[11] = 1U; // Level count beyond the file
+    writeFileBytes(path, corrupted);
+    CHECK_THROWS(MipContainer(path));
+
+    corrupted = bytes;
+    corrupted[size_t(mipLevelEntryOffset(0U)) + 16U] = 1U; // Misaligned offset
+    writeFileBytes(path, corrupted);
+    CHECK_THROWS(MipContainer(path));
+
+    corrupted = bytes;
+    corrupted.pop_back(); // Truncated level data
+    writeFileBytes(path, corrupted);
+    CHECK_THROWS(MipContainer(path));
+
+    corrupted = bytes;
+    corrupted[size_t(mipLevelEntryOffset(0U)) + 4U]++; // Width not matching the raw pixels
+    writeFileBytes(path, corrupted);
+    CHECK_THROWS(MipContainer(path));
+}
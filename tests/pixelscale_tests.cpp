@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "pixelscale.h"
+#include "scaler_registry.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+
+static const std::vector<std::string> PIXELSCALE_FILES = { "Sonic_screech", "smw_boo_input", "X1-3_X_Idle" };
+
+// Inputs of a batch, holding the pixels that the PixelScaleImages point to
+struct Batch {
+    std::vector<std::vector<uint8_t>> pixels;
+    std::vector<Image<glm::uvec3>> images;
+    std::vector<PixelScaleImage> inputs;
+
+    explicit Batch(const std::vector<std::string>& filenames) {
+        for (const std::string& filename : filenames) {
+            const Image<glm::uvec3>& image = images.emplace_back(data_dir_path / (filename + ".png"));
+            std::vector<uint8_t>& rgb = pixels.emplace_back(image.data.size() * 3U);
+            for (size_t i = 0; i < image.data.size(); i++) { typeToRgbUint8(&rgb[i * 3U], image.data[i]); }
+        }
+        for (size_t i = 0; i < images.size(); i++) { inputs.push_back({ images[i].width, images[i].height, pixels[i].data() }); }
+    }
+};
+
+static std::vector<std::string> allInputFiles() {
+    std::vector<std::string> files;
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir_path)) { files.push_back(entry.path().stem().string()); }
+    return files;
+}
+
+static bool matches(const PixelScaleImage& output, const Image<glm::uvec3>& expected) {
+    if (output.width != expected.width || output.height != expected.height || !output.rgb) { return false; }
+    for (size_t i = 0; i < expected.data.size(); i++) {
+        uint8_t rgb[3];
+        typeToRgbUint8(rgb, expected.data[i]);
+        if (output.rgb[i * 3U] != rgb[0] || output.rgb[i * 3U + 1U] != rgb[1] || output.rgb[i * 3U + 2U] != rgb[2]) { return false; }
+    }
+    return true;
+}
+
+TEST_CASE("Library batches match the scalers", "[pixelscale]") {
+    REQUIRE(pixelscaleApiVersion() == PIXELSCALE_API_VERSION);
+    REQUIRE(pixelscaleAlgorithmCount() == REGISTERED_SCALERS.size());
+    PixelScaleContext* context = pixelscaleCreateContext(3U);
+    REQUIRE(context);
+
+    const Batch batch(PIXELSCALE_FILES);
+    for (size_t algorithm = 0; algorithm < pixelscaleAlgorithmCount(); algorithm++) {
+        const char* name = pixelscaleAlgorithmName(algorithm);
+        INFO(name);
+        std::vector<PixelScaleImage> outputs(batch.inputs.size());
+        REQUIRE(pixelscaleScale(context, batch.inputs.data(), batch.inputs.size(), name, 2U, outputs.data()) == PIXELSCALE_OK);
+        for (size_t i = 0; i < outputs.size(); i++) {
+            CHECK(matches(outputs[i], findScaler(name)->scale_chain(batch.images[i], 1U)));
+            pixelscaleReleaseImage(context, &outputs[i]);
+            CHECK(outputs[i].rgb == nullptr);
+        }
+    }
+    pixelscaleDestroyContext(context);
+}
+
+TEST_CASE("Library contexts are reused across batches and thread counts", "[pixelscale]") {
+    const Batch batch(allInputFiles());
+    std::vector<Image<glm::uvec3>> expected;
+    for (const Image<glm::uvec3>& image : batch.images) { expected.push_back(REGISTERED_SCALERS[0].scale_chain(image, 3U)); }
+
+    for (uint32_t threads : { 1U, 4U, 0U }) {
+        INFO(threads);
+        PixelScaleContext* context = pixelscaleCreateContext(threads);
+        REQUIRE(context);
+        std::vector<uint8_t*> buffers;
+        for (int round = 0; round < 2; round++) {
+            std::vector<PixelScaleImage> outputs(batch.inputs.size());
+            REQUIRE(pixelscaleScale(context, batch.inputs.data(), batch.inputs.size(), "epx", 8U, outputs.data()) == PIXELSCALE_OK);
+            for (size_t i = 0; i < outputs.size(); i++) {
+                CHECK(matches(outputs[i], expected[i]));
+                if (round == 0) { buffers.push_back(outputs[i].rgb); }
+                else { CHECK(std::find(buffers.begin(), buffers.end(), outputs[i].rgb) != buffers.end()); } // Served by the arena
+                pixelscaleReleaseImage(context, &outputs[i]);
+            }
+        }
+        pixelscaleDestroyContext(context);
+    }
+}
+
+TEST_CASE("Library rejects invalid batches", "[pixelscale]") {
+    PixelScaleContext* context = pixelscaleCreateContext(2U);
+    REQUIRE(context);
+    const Batch batch({ "smw_boo_input" });
+    PixelScaleImage output { 0, 0, nullptr };
+
+    CHECK(pixelscaleScale(context, batch.inputs.data(), 1U, "bilinear", 2U, &output) == PIXELSCALE_UNKNOWN_ALGORITHM);
+    CHECK(std::string(pixelscaleLastError(context)) == "Unknown algorithm bilinear");
+    CHECK(pixelscaleScale(context, batch.inputs.data(), 1U, "epx", 6U, &output) == PIXELSCALE_INVALID_ARGUMENT);
+    const PixelScaleImage empty { 0, 4, batch.inputs[0].rgb };
+    CHECK(pixelscaleScale(context, &empty, 1U, "epx", 2U, &output) == PIXELSCALE_INVALID_ARGUMENT);
+    CHECK(output.rgb == nullptr);
+    CHECK(pixelscaleScale(nullptr, batch.inputs.data(), 1U, "epx", 2U, &output) == PIXELSCALE_INVALID_ARGUMENT);
+
+    CHECK(pixelscaleScale(context, nullptr, 0U, "epx", 2U, nullptr) == PIXELSCALE_OK);
+    CHECK(std::string(pixelscaleLastError(context)).empty());
+    pixelscaleDestroyContext(context);
+}
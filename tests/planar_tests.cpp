@@ -0,0 +1,71 @@
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "nedi.hpp"
+#include "planar_image.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+
+// Half precision keeps 11 significant bits, so values in [0, 1] round by at most 2^-12
+static constexpr float HALF_ROUNDING = 1.0f / 4096.0f;
+
+TEST_CASE("Half precision rounds to nearest even and keeps special values", "[planar]") {
+    CHECK(float(Half(1.0f)) == 1.0f);
+    CHECK(float(Half(-2.5f)) == -2.5f);
+    CHECK(float(Half(65504.0f)) == 65504.0f);
+    CHECK(std::isinf(float(Half(1.0e6f))));
+    CHECK(std::isnan(float(Half(std::numeric_limits<float>::quiet_NaN()))));
+    CHECK(float(Half(std::ldexp(1.0f, -24))) == std::ldexp(1.0f, -24)); // Smallest subnormal
+    CHECK(float(Half(1.0f + std::ldexp(1.0f, -11))) == 1.0f);           // Tie, rounded down to the even mantissa
+    CHECK(float(Half(1.0f + (3.0f * std::ldexp(1.0f, -11)))) == 1.0f + std::ldexp(1.0f, -9)); // Tie, rounded up
+    for (uint32_t bits = 0U; bits < 0x7c00U; bits++) {
+        Half half;
+        half.bits = uint16_t(bits);
+        REQUIRE(Half(float(half)).bits == half.bits);
+    }
+}
+
+TEST_CASE("Planar images round trip through interleaved images", "[planar]") {
+    const Image<glm::vec3> image(data_dir_path / "sma_chest_input.png");
+
+    const PlanarImage<float> planar = toPlanar<float>(image);
+    REQUIRE(planar.width == image.width);
+    REQUIRE(planar.height == image.height);
+    for (const auto& plane : planar.planes) { CHECK(reinterpret_cast<uintptr_t>(plane.data()) % PLANE_ALIGNMENT == 0U); }
+    CHECK(fromPlanar<glm::vec3>(planar).data == image.data);
+
+    const Image<glm::vec3> from_half = fromPlanar<glm::vec3>(toPlanar<Half>(image));
+    for (size_t i = 0; i < image.data.size(); i++) {
+        for (int channel = 0; channel < 3; channel++) { REQUIRE(std::abs(from_half.data[i][channel] - image.data[i][channel]) <= HALF_ROUNDING); }
+    }
+
+    const Image<glm::uvec3> quantised(data_dir_path / "sma_chest_input.png");
+    CHECK(fromPlanar<glm::uvec3>(toPlanar<Half>(quantised)).data == quantised.data); // 8-bit values are exact in half precision
+}
+
+TEST_CASE("Planar NEDI on half precision planes stays close to float planes", "[planar]") {
+    const Image<glm::vec3> image(data_dir_path / "sma_chest_input.png");
+
+    NediStats float_stats, half_stats;
+    const Image<glm::vec3> from_float = fromPlanar<glm::vec3>(scaleNedi(toPlanar<float>(image), &float_stats));
+    const Image<glm::vec3> from_half  = fromPlanar<glm::vec3>(scaleNedi(toPlanar<Half>(image), &half_stats));
+    CHECK(from_float.data == scaleNedi(image).data);
+    CHECK(from_half.data == scaleNedi(image, nullptr, NEDI_HALF).data);
+    CHECK(half_stats.flat_pixels == float_stats.flat_pixels);
+
+    // Rounding the source can flip the conditioning of a window, so only the bulk of the error is bounded
+    double error_sum = 0.0;
+    for (size_t i = 0; i < from_float.data.size(); i++) {
+        for (int channel = 0; channel < 3; channel++) { error_sum += std::abs(from_half.data[i][channel] - from_float.data[i][channel]); }
+    }
+    CHECK(error_sum / (3.0 * double(from_float.data.size())) < 1.0 / 255.0);
+}
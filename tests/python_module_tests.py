@@ -0,0 +1,112 @@
+"""Tests of the pixel_scaling extension module, run by ctest with the module on PYTHONPATH."""
+import os
+import tempfile
+import threading
+import unittest
+from concurrent.futures import ThreadPoolExecutor
+
+import pixel_scaling
+
+DATA_DIR = os.environ["DATA_DIR"]
+GOLDEN_DIR = os.environ["GOLDEN_DIR"]
+
+# Algorithms whose golden outputs are exact (see tests/golden_tests.cpp)
+EXACT_ALGORITHMS = ["epx", "adv_mame", "eagle", "hq2x"]
+
+
+def fnv1a(width, height, rgb):
+    """FNV-1a 64 of the width, height and RGB8 pixels, as stored in the golden manifest"""
+    value = 0xcbf29ce484222325
+    for byte in width.to_bytes(4, "little") + height.to_bytes(4, "little") + rgb:
+        value = ((value ^ byte) * 0x100000001b3) & 0xffffffffffffffff
+    return value
+
+
+def golden_entries():
+    entries = {}
+    with open(os.path.join(GOLDEN_DIR, "manifest.txt")) as manifest:
+        for line in manifest:
+            if line.startswith("#"):
+                continue
+            algorithm, filename, factor, width, height, value = line.split()
+            entries[(algorithm, filename, int(factor))] = (int(width), int(height), int(value, 16))
+    return entries
+
+
+def input_files():
+    return sorted(name[:-4] for name in os.listdir(DATA_DIR) if name.endswith(".png"))
+
+
+class PixelScalingTests(unittest.TestCase):
+    def test_buffers_are_shared_without_copies(self):
+        image = pixel_scaling.Image(os.path.join(DATA_DIR, "smw_boo_input.png"))
+        view = memoryview(image)
+        self.assertEqual(view.format, "I")
+        self.assertEqual(view.shape, (image.height, image.width, 3))
+        self.assertEqual(view.nbytes, image.width * image.height * 12)
+
+        view[0, 0, 0] = 7
+        self.assertEqual(image.rgb8()[0], 7)
+        self.assertEqual(memoryview(image)[0, 0, 0], 7)
+
+        # Flat 8-bit buffers and shaped 32-bit buffers round trip through images
+        copy = pixel_scaling.Image(image.rgb8(), image.width, image.height)
+        self.assertEqual(copy.rgb8(), image.rgb8())
+        self.assertEqual(pixel_scaling.Image(view).rgb8(), image.rgb8())
+
+    def test_invalid_input_is_rejected(self):
+        with self.assertRaises(OSError):
+            pixel_scaling.Image(os.path.join(DATA_DIR, "missing.png"))
+        with self.assertRaises(ValueError):
+            pixel_scaling.Image(bytes(10), 2, 2)
+        with self.assertRaises(ValueError):
+            pixel_scaling.Image(memoryview(bytes(12)).cast("H"), 2, 1)
+        with self.assertRaises(ValueError):
+            pixel_scaling.scale(bytes(12), "epx")
+        image = pixel_scaling.Image(bytes(12), 2, 2)
+        with self.assertRaises(ValueError):
+            pixel_scaling.scale(image, "bilinear")
+        with self.assertRaises(ValueError):
+            pixel_scaling.scale(image, "epx", 3)
+
+    def test_scalers_match_golden_outputs(self):
+        entries = golden_entries()
+        for filename in input_files():
+            image = pixel_scaling.Image(os.path.join(DATA_DIR, filename + ".png"))
+            for algorithm in EXACT_ALGORITHMS:
+                for factor in (2, 4):
+                    scaled = pixel_scaling.scale(image, algorithm, factor)
+                    with self.subTest(filename=filename, algorithm=algorithm, factor=factor):
+                        self.assertEqual((scaled.width, scaled.height, fnv1a(scaled.width, scaled.height, scaled.rgb8())),
+                                         entries[(algorithm, filename, factor)])
+
+    def test_threads_scale_in_parallel(self):
+        images = [pixel_scaling.Image(os.path.join(DATA_DIR, filename + ".png")) for filename in input_files()]
+        sequential = [pixel_scaling.scale(image, "xbr").rgb8() for image in images]
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            parallel = list(executor.map(lambda image: pixel_scaling.scale(image, "xbr").rgb8(), images))
+        self.assertEqual(parallel, sequential)
+
+        # Another thread keeps running while the GIL is released by a long scale
+        image = pixel_scaling.scale(images[0], "xbr", 4)
+        done = threading.Event()
+        ticks = 0
+        worker = threading.Thread(target=lambda: (pixel_scaling.scale(image, "nedi"), done.set()))
+        worker.start()
+        while not done.is_set():
+            ticks += 1
+            done.wait(0.001)
+        worker.join()
+        self.assertGreater(ticks, 1)
+
+    def test_images_are_saved_and_loaded(self):
+        image = pixel_scaling.scale(pixel_scaling.Image(os.path.join(DATA_DIR, "smw_boo_input.png")), "hq2x")
+        with tempfile.TemporaryDirectory() as directory:
+            for extension in (".png", ".qoi", ".raw"):
+                path = os.path.join(directory, "boo" + extension)
+                image.save(path)
+                self.assertEqual(pixel_scaling.Image(path).rgb8(), image.rgb8())
+
+
+if __name__ == "__main__":
+    unittest.main()
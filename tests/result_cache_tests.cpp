@@ -0,0 +1,106 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "epx.hpp"
+#include "result_cache.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path cache_test_dir_path { std::filesystem::temp_directory_path() / "fin-proj-cache-tests" };
+
+static std::vector<char> readFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+TEST_CASE("Result cache round-trips pixels and PNG files", "[cache]") {
+    std::filesystem::remove_all(cache_test_dir_path);
+    const std::filesystem::path input_path = data_dir_path / "X1-3_X_Idle.png";
+    const Image<glm::uvec3> scaled = scaleEpx(Image<glm::uvec3>(input_path));
+    const std::filesystem::path png_path = cache_test_dir_path / "scaled.png";
+    scaled.writeToFile(png_path);
+
+    const uint64_t input_hash = hashFile(input_path);
+    {
+        ResultCache cache(cache_test_dir_path / "entries", 1ULL << 30U);
+        CHECK_FALSE(cache.find({ input_hash, "epx", 2U }));
+        cache.insert({ input_hash, "epx", 2U }, scaled, png_path);
+    }
+
+    // A new cache on the same directory (i.e. a later run) sees the entry
+    ResultCache cache(cache_test_dir_path / "entries", 1ULL << 30U);
+    CHECK_FALSE(cache.contains({ input_hash, "epx", 4U }));
+    CHECK_FALSE(cache.contains({ input_hash, "adv_mame", 2U }));
+    CHECK_FALSE(cache.contains({ input_hash + 1U, "epx", 2U }));
+    const std::optional<CachedResult> result = cache.find({ input_hash, "epx", 2U });
+    REQUIRE(result);
+    REQUIRE(result->width() == scaled.width);
+    REQUIRE(result->height() == scaled.height);
+    size_t mismatches = 0U;
+    for (size_t i = 0; i < scaled.data.size(); i++) {
+        const uint8_t* rgb = result->pixels() + (i * 3U);
+        if (glm::uvec3(rgb[0], rgb[1], rgb[2]) != scaled.data[i]) { mismatches++; }
+    }
+    CHECK(mismatches == 0U);
+
+    result->writeEncoded(cache_test_dir_path / "cached.png");
+    CHECK(readFile(cache_test_dir_path / "cached.png") == readFile(png_path));
+}
+
+TEST_CASE("Result cache evicts the least recently used entries", "[cache]") {
+    std::filesystem::remove_all(cache_test_dir_path);
+    const Image<glm::uvec3> image(data_dir_path / "X1-3_X_Idle.png");
+    const std::filesystem::path png_path = cache_test_dir_path / "image.png";
+    image.writeToFile(png_path);
+    const uint64_t entry_bytes = sizeof(ResultCacheHeader) + (image.data.size() * 3U) + std::filesystem::file_size(png_path);
+
+    // Room for three entries
+    ResultCache cache(cache_test_dir_path / "entries", (3U * entry_bytes) + (entry_bytes / 2U));
+    for (uint32_t factor = 1U; factor <= 3U; factor++) { cache.insert({ 0U, "epx", factor }, image, png_path); }
+    CHECK(cache.find({ 0U, "epx", 1U })); // Now more recent than factor 2
+    cache.insert({ 0U, "epx", 4U }, image, png_path);
+
+    CHECK(cache.contains({ 0U, "epx", 1U }));
+    CHECK_FALSE(cache.contains({ 0U, "epx", 2U }));
+    CHECK(cache.contains({ 0U, "epx", 3U }));
+    CHECK(cache.contains({ 0U, "epx", 4U }));
+    CHECK(cache.sizeBytes() == 3U * entry_bytes);
+    size_t files = 0U;
+    for (const auto& entry : std::filesystem::directory_iterator(cache_test_dir_path / "entries")) { files += entry.path().extension() == RESULT_CACHE_EXTENSION; }
+    CHECK(files == 3U);
+}
+
+TEST_CASE("Result cache skips foreign files and sweeps stale temporary files", "[cache]") {
+    std::filesystem::remove_all(cache_test_dir_path);
+    const Image<glm::uvec3> image(data_dir_path / "X1-3_X_Idle.png");
+    const std::filesystem::path png_path = cache_test_dir_path / "image.png";
+    image.writeToFile(png_path);
+    const std::filesystem::path entries_path = cache_test_dir_path / "entries";
+    {
+        ResultCache cache(entries_path, 1ULL << 30U);
+        cache.insert({ 0U, "epx", 2U }, image, png_path);
+    }
+
+    const std::filesystem::path foreign_path = entries_path / "foo.pxr";
+    const std::filesystem::path stale_path = entries_path / "0123456789abcdef.pxr.tmp1-2";
+    const std::filesystem::path fresh_path = entries_path / "fedcba9876543210.pxr.tmp3-4";
+    for (const auto& path : { foreign_path, stale_path, fresh_path }) { std::ofstream(path) << "partial"; }
+    std::filesystem::last_write_time(stale_path, std::filesystem::file_time_type::clock::now() - (2 * RESULT_CACHE_STALE_TEMPORARY));
+
+    ResultCache cache(entries_path, 1ULL << 30U);
+    CHECK(cache.contains({ 0U, "epx", 2U }));
+    CHECK(cache.sizeBytes() == std::filesystem::file_size(png_path) + sizeof(ResultCacheHeader) + (image.data.size() * 3U));
+    CHECK(std::filesystem::exists(foreign_path));
+    CHECK_FALSE(std::filesystem::exists(stale_path));
+    CHECK(std::filesystem::exists(fresh_path)); // May still belong to a run writing into the same directory
+}
@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "result_cache.hpp"
+#include "scale_server.hpp"
+#include "scaler_registry.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path server_test_dir_path { std::filesystem::temp_directory_path() / "fin-proj-server-tests" };
+
+// Server answering on its own thread for the lifetime of the fixture
+struct RunningServer {
+    explicit RunningServer(ResultCache* cache)
+        : socket_path(server_test_dir_path / ("server-" + std::to_string(getpid()) + ".sock")), server(socket_path, 2U, cache),
+          thread([this] { server.serve(); }) {}
+
+    ~RunningServer() {
+        server.stop();
+        thread.join();
+    }
+
+    std::filesystem::path socket_path;
+    ScaleServer server;
+    std::thread thread;
+};
+
+static bool samePixels(const Image<glm::uvec3>& image, const Image<glm::uvec3>& expected) {
+    return image.width == expected.width && image.height == expected.height && image.data == expected.data;
+}
+
+TEST_CASE("Latency percentiles use the nearest rank", "[server]") {
+    std::vector<double> latencies;
+    for (int i = 100; i >= 1; i--) { latencies.push_back(double(i)); }
+    const LatencySummary summary = summariseLatencies(latencies, 250U);
+    CHECK(summary.requests == 250U);
+    CHECK(summary.p50 == 50.0);
+    CHECK(summary.p90 == 90.0);
+    CHECK(summary.p99 == 99.0);
+    CHECK(summary.max == 100.0);
+    CHECK(summariseLatencies({ 7.0 }, 1U).p50 == 7.0);
+    CHECK(summariseLatencies({}, 0U).max == 0.0);
+
+    LatencyRecorder recorder;
+    for (size_t i = 0; i < LATENCY_WINDOW + 10U; i++) { recorder.record(i < 10U ? 1e9 : 1.0); } // The outliers leave the window
+    CHECK(recorder.summary().requests == LATENCY_WINDOW + 10U);
+    CHECK(recorder.summary().max == 1.0);
+}
+
+TEST_CASE("Shared memory names carry the size of inputs", "[server]") {
+    const std::optional<SharedImageName> input = parseSharedImage("shm:/job:1:16x9", true);
+    REQUIRE(input);
+    CHECK(input->name == "/job:1");
+    CHECK(input->width == 16);
+    CHECK(input->height == 9);
+    CHECK(parseSharedImage("shm:/out", false)->name == "/out");
+    CHECK_FALSE(parseSharedImage("/tmp/shm:/a:2x2.png", true));
+    CHECK_FALSE(parseSharedImage("shm:/job", true));
+    CHECK_FALSE(parseSharedImage("shm:/job:0x4", true));
+    CHECK_FALSE(parseSharedImage("shm:", false));
+    CHECK(splitFields("SCALE\tepx\t2\ta b.png\tc.png") == std::vector<std::string> { "SCALE", "epx", "2", "a b.png", "c.png" });
+}
+
+TEST_CASE("Server scales files and serves repeated jobs from the cache", "[server]") {
+    std::filesystem::remove_all(server_test_dir_path);
+    std::filesystem::create_directories(server_test_dir_path);
+    ResultCache cache(server_test_dir_path / "cache", 1ULL << 30U);
+    RunningServer running(&cache);
+    ScaleClient client(running.socket_path);
+
+    const std::filesystem::path input_path = data_dir_path / "smw_boo_input.png";
+    const Image<glm::uvec3> expected = findScaler("hq2x")->scale_chain(Image<glm::uvec3>(input_path), 2U);
+    for (const std::string cached : { "0", "1" }) {
+        const std::filesystem::path output_path = server_test_dir_path / ("boo " + cached + ".qoi"); // Spaces are fine in paths
+        const std::vector<std::string> response = client.request({ "SCALE", "hq2x", "4", input_path.string(), output_path.string() });
+        REQUIRE(response == std::vector<std::string> { "OK", std::to_string(expected.width), std::to_string(expected.height), cached });
+        CHECK(samePixels(Image<glm::uvec3>(output_path), expected));
+    }
+
+    // A second connection is served while the first one stays open
+    ScaleClient other(running.socket_path);
+    CHECK(other.request({ "SCALE", "epx", "2", input_path.string(), (server_test_dir_path / "boo.png").string() })[0] == "OK");
+    const std::vector<std::string> stats = client.request({ "STATS" });
+    REQUIRE(stats.size() == 6U);
+    CHECK(stats[1] == "3");
+    CHECK(std::stoll(stats[2]) <= std::stoll(stats[5]));
+}
+
+TEST_CASE("Server exchanges pixels through shared memory", "[server]") {
+    std::filesystem::create_directories(server_test_dir_path);
+    RunningServer running(nullptr);
+    ScaleClient client(running.socket_path);
+
+    const Image<glm::uvec3> input(data_dir_path / "Sonic_screech.png");
+    const std::string name = "/fin-proj-server-tests-" + std::to_string(getpid());
+    const SharedBuffer source(name + "-in", input.data.size() * 3U, true);
+    REQUIRE(source.valid());
+    for (size_t i = 0; i < input.data.size(); i++) { typeToRgbUint8(source.bytes + (i * 3U), input.data[i]); }
+    const std::string sized_input = "shm:" + source.name + ":" + std::to_string(input.width) + "x" + std::to_string(input.height);
+
+    const std::vector<std::string> response = client.request({ "SCALE", "nedi", "2", sized_input, "shm:" + name + "-out" });
+    source.unlink();
+    REQUIRE(response.size() == 4U);
+    REQUIRE(response[0] == "OK");
+    const Image<glm::uvec3> expected = findScaler("nedi")->scale_chain(input, 1U);
+    const SharedBuffer result(name + "-out", expected.data.size() * 3U, false);
+    result.unlink();
+    REQUIRE(result.valid());
+    Image<glm::uvec3> output(std::stoi(response[1]), std::stoi(response[2]));
+    for (size_t i = 0; i < output.data.size(); i++) { output.data[i] = stbToType<glm::uvec3>(result.bytes + (i * 3U)); }
+    CHECK(samePixels(output, expected));
+}
+
+TEST_CASE("Server reports failed requests and shuts down on request", "[server]") {
+    std::filesystem::create_directories(server_test_dir_path);
+    RunningServer running(nullptr);
+    ScaleClient client(running.socket_path);
+
+    const std::string input = (data_dir_path / "smw_boo_input.png").string();
+    const std::string output = (server_test_dir_path / "failed.png").string();
+    CHECK(client.request({ "SCALE", "bilinear", "2", input, output }) == std::vector<std::string> { "ERROR", "Unknown algorithm bilinear" });
+    CHECK(client.request({ "SCALE", "epx", "3", input, output })[0] == "ERROR");
+    CHECK(client.request({ "SCALE", "epx", "two", input, output })[0] == "ERROR");
+    CHECK(client.request({ "SCALE", "epx", "2", input + ".missing", output })[0] == "ERROR");
+    CHECK(client.request({ "SCALE", "epx", "2", "shm:/fin-proj-server-tests-missing:4x4", output })[0] == "ERROR");
+    CHECK(client.request({ "SCALE", "epx", "2" })[0] == "ERROR");
+    CHECK(client.request({ "RESIZE" })[0] == "ERROR");
+    CHECK_FALSE(std::filesystem::exists(output));
+
+    CHECK(client.request({ "SHUTDOWN" }) == std::vector<std::string> { "OK" });
+    running.thread.join();
+    running.thread = std::thread([] {}); // Joined again by the fixture
+    CHECK(running.server.latencies().requests == 6U); // Every SCALE line, failed or not
+}
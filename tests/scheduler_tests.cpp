@@ -0,0 +1,145 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+DISABLE_WARNINGS_POP()
+
+#include "task_scheduler.hpp"
+
+static constexpr unsigned SCHEDULER_TEST_WORKERS = 4U;
+
+TEST_CASE("Scheduler runs every task after its dependencies", "[scheduler]") {
+    static constexpr size_t CHAINS = 16U, CHAIN_LENGTH = 8U;
+
+    TaskScheduler scheduler(SCHEDULER_TEST_WORKERS);
+    std::mutex order_mutex;
+    std::vector<TaskId> order;
+    std::vector<std::vector<TaskId>> dependencies;
+    for (size_t chain = 0; chain < CHAINS; chain++) {
+        std::vector<TaskId> previous;
+        for (size_t link = 0; link < CHAIN_LENGTH; link++) {
+            const TaskId id = dependencies.size();
+            dependencies.push_back(previous);
+            REQUIRE(scheduler.addTask([&, id] {
+                std::lock_guard lock(order_mutex);
+                order.push_back(id);
+            }, double((chain * 7U) % 5U + 1U), previous) == id);
+
+            // Fan out into an independent side task (like encoding) next to the continuation of the chain
+            const TaskId side = dependencies.size();
+            dependencies.push_back({ id });
+            scheduler.addTask([&, side] {
+                std::lock_guard lock(order_mutex);
+                order.push_back(side);
+            }, 1.0, { id });
+            previous = { id };
+        }
+    }
+    scheduler.run();
+
+    REQUIRE(order.size() == dependencies.size());
+    std::vector<size_t> position(order.size());
+    for (size_t i = 0; i < order.size(); i++) { position[order[i]] = i; }
+    for (TaskId id = 0; id < dependencies.size(); id++) {
+        for (TaskId dependency : dependencies[id]) { REQUIRE(position[dependency] < position[id]); }
+    }
+}
+
+TEST_CASE("Scheduler starts the most expensive chains first", "[scheduler]") {
+    // A cheap task leading into an expensive one outranks a task that is more expensive on its own
+    TaskScheduler scheduler(1U);
+    std::vector<int> order;
+    scheduler.addTask([&] { order.push_back(0); }, 10.0);
+    const TaskId cheap = scheduler.addTask([&] { order.push_back(1); }, 1.0);
+    scheduler.addTask([&] { order.push_back(2); }, 100.0, { cheap });
+    scheduler.addTask([&] { order.push_back(3); }, 5.0);
+    scheduler.run();
+
+    REQUIRE(order == std::vector<int> { 1, 2, 0, 3 });
+}
+
+TEST_CASE("Scheduler rethrows the exception of a failed task", "[scheduler]") {
+    TaskScheduler scheduler(SCHEDULER_TEST_WORKERS);
+    std::atomic<bool> dependent_ran = false;
+    const TaskId failing = scheduler.addTask([] { throw std::runtime_error("task failed"); }, 1.0);
+    scheduler.addTask([&] { dependent_ran = true; }, 1.0, { failing });
+    REQUIRE_THROWS_AS(scheduler.run(), std::runtime_error);
+    REQUIRE_FALSE(dependent_ran);
+}
+
+TEST_CASE("Scheduler starts no queued task after a task threw", "[scheduler]") {
+    // The failing and the blocking task run at once on both workers; the blocking one outlives the failure, after which
+    // its worker must not pick up any of the cheaper tasks still queued
+    TaskScheduler scheduler(2U);
+    std::atomic<bool> failing_started = false, blocking_started = false;
+    std::atomic<unsigned> queued_ran = 0U;
+    const auto waitFor = [](const std::atomic<bool>& flag) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!flag && std::chrono::steady_clock::now() < deadline) { std::this_thread::yield(); }
+    };
+    scheduler.addTask([&] {
+        failing_started = true;
+        waitFor(blocking_started);
+        throw std::runtime_error("task failed");
+    }, 3.0);
+    scheduler.addTask([&] {
+        blocking_started = true;
+        waitFor(failing_started);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }, 2.0);
+    for (int i = 0; i < 16; i++) { scheduler.addTask([&] { queued_ran++; }, 1.0); }
+    REQUIRE_THROWS_AS(scheduler.run(), std::runtime_error);
+    CHECK(queued_ran == 0U);
+}
+
+TEST_CASE("Scheduler only admits jobs that fit the memory budget", "[scheduler]") {
+    static constexpr size_t JOBS = 12U, JOB_LENGTH = 3U;
+    static constexpr uint64_t JOB_BYTES = 100U, BUDGET = 250U; // Room for two jobs at once
+
+    TaskScheduler scheduler(SCHEDULER_TEST_WORKERS, BUDGET);
+    std::atomic<size_t> running_jobs = 0U, max_running_jobs = 0U, finished_tasks = 0U;
+    for (size_t job_index = 0; job_index < JOBS; job_index++) {
+        const JobId job = scheduler.addJob(JOB_BYTES);
+        std::vector<TaskId> previous;
+        for (size_t link = 0; link < JOB_LENGTH; link++) {
+            previous = { scheduler.addTask([&, link] {
+                // The job holds its memory from the start of its first task until the end of its last task
+                if (link == 0U) {
+                    const size_t running = ++running_jobs;
+                    size_t expected = max_running_jobs.load();
+                    while (running > expected && !max_running_jobs.compare_exchange_weak(expected, running)) {}
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                if (link == JOB_LENGTH - 1U) { running_jobs--; }
+                finished_tasks++;
+            }, 1.0, previous, job) };
+        }
+    }
+    scheduler.run();
+
+    CHECK(finished_tasks == JOBS * JOB_LENGTH);
+    CHECK(max_running_jobs <= 2U);
+    CHECK(scheduler.memoryStats().peak_bytes <= BUDGET);
+    CHECK(scheduler.memoryStats().average_bytes > 0.0);
+}
+
+TEST_CASE("Scheduler runs jobs larger than the memory budget on their own", "[scheduler]") {
+    TaskScheduler scheduler(SCHEDULER_TEST_WORKERS, 10U);
+    std::atomic<size_t> finished_tasks = 0U;
+    for (size_t job_index = 0; job_index < 3U; job_index++) {
+        const JobId job = scheduler.addJob(100U);
+        const TaskId first = scheduler.addTask([&] { finished_tasks++; }, 1.0, {}, job);
+        scheduler.addTask([&] { finished_tasks++; }, 1.0, { first }, job);
+    }
+    scheduler.addTask([&] { finished_tasks++; }, 1.0); // Tasks outside of jobs are always admitted
+    scheduler.run();
+
+    CHECK(finished_tasks == 7U);
+    CHECK(scheduler.memoryStats().peak_bytes == 100U);
+}
@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "2xsai.hpp"
+#include "eagle.hpp"
+#include "epx.hpp"
+#include "fused_chain.hpp"
+#include "hq2x.hpp"
+#include "nedi.hpp"
+#include "streaming.hpp"
+#include "xbr.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+static const std::filesystem::path stream_dir_path { std::filesystem::temp_directory_path() / "fin-proj-streaming-tests" };
+
+// Deliberately small and odd band heights so that bands, halos and image borders interact
+static const std::vector<int> BAND_HEIGHTS = { 1, 13 };
+static constexpr uint32_t STREAMED_PASSES = 2U;
+
+// NEDI rescales its 19-row window for every band, so it is only checked on one pass to keep the test fast
+static constexpr uint32_t STREAMED_NEDI_PASSES = 1U;
+
+// Tiles that are not a multiple of the total factor, smaller than the halo and larger than the image
+static const std::vector<int> FUSED_TILE_SIZES = { 12, 64, 4096 };
+static const std::vector<bool> FUSED_EMIT = { true, false, true };
+
+/**
+ * Check that streaming a chain of passes to PNG files produces exactly the in-memory outputs of every pass
+ *
+ * @param filename Name of the input file in the data directory, without extension
+ * @param scale 2x scaler under test
+ * @param halo Halo declared for the scaler
+ * @param passes Number of chained passes
+*/
+template<typename T>
+static void checkStreamedChain(const std::string& filename, ScaleFunction<T> scale, int halo, uint32_t passes = STREAMED_PASSES) {
+    const Image<T> input(data_dir_path / (filename + ".png"));
+    for (int band_height : BAND_HEIGHTS) {
+        std::vector<std::filesystem::path> paths;
+        for (uint32_t pass = 1U; pass <= passes; pass++) {
+            paths.push_back(stream_dir_path / (filename + "-" + std::to_string(band_height) + "-" + std::to_string(pass) + ".png"));
+        }
+        streamScaleToPng(input, scale, halo, paths, band_height);
+
+        Image<T> expected = input;
+        for (const std::filesystem::path& path : paths) {
+            expected = scale(expected);
+            const Image<glm::uvec3> streamed(path);
+            INFO(filename << " with bands of " << band_height << " rows, " << path.filename().string());
+            REQUIRE(streamed.width == expected.width);
+            REQUIRE(streamed.height == expected.height);
+            size_t mismatches = 0U;
+            for (size_t i = 0; i < expected.data.size(); i++) {
+                uint8_t rgb[3];
+                typeToRgbUint8<T>(rgb, expected.data[i]);
+                if (streamed.data[i] != glm::uvec3(rgb[0], rgb[1], rgb[2])) { mismatches++; }
+            }
+            CHECK(mismatches == 0U);
+        }
+    }
+}
+
+TEST_CASE("Streamed chains match in-memory scaling for every scaler", "[streaming]") {
+    for (const std::string filename : { "X1-3_X_Idle" }) {
+        checkStreamedChain<glm::uvec3>(filename, scaleEpx<glm::uvec3>, EPX_HALO);
+        checkStreamedChain<glm::uvec3>(filename, scaleAdvMame<glm::uvec3>, EPX_HALO);
+        checkStreamedChain<glm::uvec3>(filename, scaleEagle<glm::uvec3>, EAGLE_HALO);
+        checkStreamedChain<glm::uvec3>(filename, scale2xSaI<glm::uvec3>, SAI_HALO);
+        checkStreamedChain<glm::uvec3>(filename, scaleHq2x<glm::uvec3>, HQ2X_HALO);
+        checkStreamedChain<glm::uvec3>(filename, scaleXbr<glm::uvec3>, XBR_HALO);
+        checkStreamedChain<glm::vec3>(filename, scaleNedi<glm::vec3>, NEDI_HALO, STREAMED_NEDI_PASSES);
+    }
+}
+
+/**
+ * Check that a tile-fused chain produces exactly the outputs of the unfused chain for the emitted passes
+ *
+ * @param filename Name of the input file in the data directory, without extension
+ * @param scale 2x scaler under test
+ * @param halo Halo declared for the scaler
+ * @param emit Passes whose outputs are emitted
+*/
+template<typename T>
+static void checkFusedChain(const std::string& filename, ScaleFunction<T> scale, int halo, const std::vector<bool>& emit = FUSED_EMIT) {
+    const Image<T> input(data_dir_path / (filename + ".png"));
+    std::vector<Image<T>> expected;
+    Image<T> level = input;
+    for (bool emitted : emit) {
+        level = scale(level);
+        if (emitted) { expected.push_back(level); }
+    }
+
+    for (int tile_size : FUSED_TILE_SIZES) {
+        const std::vector<Image<T>> fused = scaleChainFused(input, scale, halo, emit, tile_size);
+        REQUIRE(fused.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            INFO(filename << " with tiles of " << tile_size << " pixels, output " << i);
+            REQUIRE(fused[i].width == expected[i].width);
+            REQUIRE(fused[i].height == expected[i].height);
+            CHECK(fused[i].data == expected[i].data);
+        }
+    }
+}
+
+TEST_CASE("Tile-fused chains match unfused chains for every scaler", "[streaming]") {
+    for (const std::string filename : { "X1-3_X_Idle" }) {
+        checkFusedChain<glm::uvec3>(filename, scaleEpx<glm::uvec3>, EPX_HALO);
+        checkFusedChain<glm::uvec3>(filename, scaleAdvMame<glm::uvec3>, EPX_HALO);
+        checkFusedChain<glm::uvec3>(filename, scaleEagle<glm::uvec3>, EAGLE_HALO);
+        checkFusedChain<glm::uvec3>(filename, scale2xSaI<glm::uvec3>, SAI_HALO);
+        checkFusedChain<glm::uvec3>(filename, scaleHq2x<glm::uvec3>, HQ2X_HALO);
+        checkFusedChain<glm::uvec3>(filename, scaleXbr<glm::uvec3>, XBR_HALO);
+        checkFusedChain<glm::vec3>(filename, scaleNedi<glm::vec3>, NEDI_HALO, { true });
+    }
+}
+
+TEST_CASE("Incremental PNG encoder round-trips long runs and noise", "[streaming]") {
+    Image<glm::uvec3> image(300, 40);
+    uint32_t state = 12345U;
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            state = (state * 1664525U) + 1013904223U;
+            // Top half flat (long runs across rows), bottom half noisy
+            image.data[image.getImageOffset(x, y)] = (y < 20) ? glm::uvec3(10U, 200U, 30U) : glm::uvec3(state >> 24U, (state >> 16U) & 0xffU, x & 0xff);
+        }
+    }
+    const std::filesystem::path path = stream_dir_path / "roundtrip.png";
+    {
+        PngStreamWriter writer(path, image.width, image.height);
+        for (int y = 0; y < image.height; y++) { writer.writeRow(&image.data[image.getImageOffset(0, y)]); }
+    }
+    const Image<glm::uvec3> decoded(path);
+    REQUIRE(decoded.width == image.width);
+    REQUIRE(decoded.height == image.height);
+    CHECK(decoded.data == image.data);
+}
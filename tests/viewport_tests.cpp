@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_test_macros.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/image.h>
+
+#include "2xsai.hpp"
+#include "epx.hpp"
+#include "fused_chain.hpp"
+#include "hq2x.hpp"
+#include "nedi.hpp"
+#include "viewport.hpp"
+#include "xbr.hpp"
+
+static const std::filesystem::path data_dir_path { DATA_DIR };
+
+// Viewports straddling tiles, touching the borders, beyond the output and smaller than the halo
+static const std::vector<PixelRect> VIEWPORTS = {
+    { { 0, 0 }, { 1 << 20, 1 << 20 } },
+    { { 5, 3 }, { 6, 4 } },
+    { { 37, 50 }, { 170, 111 } },
+    { { -20, 90 }, { 75, 1 << 20 } }};
+
+template<typename T>
+static Image<T> crop(const Image<T>& image, PixelRect rect) {
+    rect = { glm::clamp(rect.begin, glm::ivec2(0), glm::ivec2(image.width, image.height)),
+             glm::clamp(rect.end, glm::ivec2(0), glm::ivec2(image.width, image.height)) };
+    Image<T> result(rect.width(), rect.height());
+    copyRect(image, glm::ivec2(0), rect, result, rect.begin);
+    return result;
+}
+
+/**
+ * Check that viewports of every factor up to a number of passes hold exactly the pixels of the full chain
+ *
+ * @param filename Name of the input file in the data directory, without extension
+ * @param scale 2x scaler under test
+ * @param halo Halo declared for the scaler
+ * @param passes Number of chained passes
+*/
+template<typename T>
+static void checkViewports(const std::string& filename, ScaleFunction<T> scale, int halo, uint32_t passes) {
+    const Image<T> input(data_dir_path / (filename + ".png"));
+    ViewportRenderer<T> renderer(input, scale, halo, 24);
+    std::vector<Image<T>> chain = { input };
+    for (uint32_t pass = 1U; pass <= passes; pass++) { chain.push_back(scale(chain.back())); }
+
+    // Zooming in and out again, so that both cold tiles and tiles computed from cached smaller factors are checked
+    for (uint32_t pass : { 0U, 2U, 1U, 3U }) {
+        if (pass > passes) { continue; }
+        for (const PixelRect& viewport : VIEWPORTS) {
+            INFO(filename << " at " << (1U << pass) << "x, viewport " << viewport.begin.x << "," << viewport.begin.y);
+            const Image<T> rendered = renderer.render(1U << pass, viewport);
+            const Image<T> expected = crop(chain[pass], viewport);
+            REQUIRE(rendered.width == expected.width);
+            REQUIRE(rendered.height == expected.height);
+            CHECK(rendered.data == expected.data);
+        }
+    }
+}
+
+TEST_CASE("Viewports match the full chains of every scaler", "[viewport]") {
+    checkViewports<glm::uvec3>("X1-3_X_Idle", scaleEpx<glm::uvec3>, EPX_HALO, 3U);
+    checkViewports<glm::uvec3>("X1-3_X_Idle", scale2xSaI<glm::uvec3>, SAI_HALO, 3U);
+    checkViewports<glm::uvec3>("X1-3_X_Idle", scaleHq2x<glm::uvec3>, HQ2X_HALO, 3U);
+    checkViewports<glm::uvec3>("smw_boo_input", scaleXbr<glm::uvec3>, XBR_HALO, 3U);
+    checkViewports<glm::vec3>("smw_boo_input", scaleNedi<glm::vec3>, NEDI_HALO, 2U);
+}
+
+static std::atomic<size_t> counted_passes = 0U; // Counted from the parallel tiles of the renderer
+
+static Image<glm::uvec3> scaleEpxCounted(const Image<glm::uvec3>& src) {
+    counted_passes++;
+    return scaleEpx(src);
+}
+
+TEST_CASE("Viewports only compute newly exposed tiles", "[viewport]") {
+    const Image<glm::uvec3> input(data_dir_path / "X1-3_X_Idle.png");
+    constexpr int TILE = 32;
+    ViewportRenderer<glm::uvec3> renderer(input, scaleEpxCounted, EPX_HALO, TILE);
+
+    // A 4x4-tile window at 8x, then panned right by one tile
+    renderer.render(8U, { { 0, 0 }, { 4 * TILE, 4 * TILE } });
+    CHECK(renderer.stats().tiles_computed == 16U);
+    CHECK(renderer.stats().computed_pixels == 16U * TILE * TILE);
+    renderer.render(8U, { { TILE, 0 }, { 5 * TILE, 4 * TILE } });
+    CHECK(renderer.stats().tiles_computed == 20U);
+    CHECK(renderer.stats().tile_hits == 12U);
+
+    // Panning back is free
+    counted_passes = 0U;
+    renderer.render(8U, { { 0, 0 }, { 4 * TILE, 4 * TILE } });
+    CHECK(renderer.stats().tiles_computed == 20U);
+    CHECK(counted_passes == 0U);
+
+    // Zooming in from 8x to 16x only runs the last pass of every tile
+    renderer.render(16U, { { 2 * TILE, 2 * TILE }, { 6 * TILE, 6 * TILE } });
+    CHECK(renderer.stats().tiles_computed == 36U);
+    CHECK(counted_passes == 16U);
+}
+
+TEST_CASE("Viewport caches evict the least recently used tiles", "[viewport]") {
+    const Image<glm::uvec3> input(data_dir_path / "X1-3_X_Idle.png");
+    constexpr int TILE = 16;
+    constexpr uint64_t TILE_BYTES = TILE * TILE * sizeof(glm::uvec3);
+    ViewportRenderer<glm::uvec3> renderer(input, scaleEpx<glm::uvec3>, EPX_HALO, TILE, 6U * TILE_BYTES);
+    const Image<glm::uvec3> full = scaleEpx(scaleEpx(input));
+
+    renderer.render(4U, { { 0, 0 }, { 2 * TILE, 2 * TILE } });
+    renderer.render(4U, { { 2 * TILE, 0 }, { 4 * TILE, 2 * TILE } });
+    CHECK(renderer.cachedBytes() == 6U * TILE_BYTES);
+
+    // A viewport larger than the capacity is still kept whole
+    const PixelRect large = { { 0, 2 * TILE }, { 4 * TILE, 4 * TILE } };
+    CHECK(renderer.render(4U, large).data == crop(full, large).data);
+    CHECK(renderer.cachedBytes() == 8U * TILE_BYTES);
+
+    // The tiles of the first viewport were evicted and are computed again
+    const size_t computed = renderer.stats().tiles_computed;
+    CHECK(renderer.render(4U, { { 0, 0 }, { TILE, TILE } }).data == crop(full, { { 0, 0 }, { TILE, TILE } }).data);
+    CHECK(renderer.stats().tiles_computed == computed + 1U);
+    CHECK_THROWS(renderer.render(3U, large));
+}